@@ -0,0 +1,93 @@
+#include "benchmark.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+
+namespace {
+// long enough that reading the clock does not count
+const auto BatchTime = std::chrono::milliseconds(10);
+const int MinBatches = 5;
+} // namespace
+
+Suite::Suite(Options options) : _options{std::move(options)} {}
+
+void Suite::Add(std::string name, std::function<void()> operation, double bytes) {
+    if (name.find(_options.filter) != std::string::npos) {
+        _benchmarks.push_back({std::move(name), std::move(operation), bytes, {}, {}});
+    }
+}
+
+void Suite::Skip(std::string name, std::string reason) {
+    if (name.find(_options.filter) != std::string::npos) {
+        _benchmarks.push_back({std::move(name), {}, 0, std::move(reason), {}});
+    }
+}
+
+void Suite::Run() {
+    using Clock = std::chrono::steady_clock;
+    for (auto &benchmark : _benchmarks) {
+        if (not benchmark.operation) {
+            std::fprintf(stderr, "%-48s skipped: %s\n", benchmark.name.c_str(), benchmark.skipped.c_str());
+            continue;
+        }
+
+        // warms caches and finds how many operations fill a batch
+        long long iterations{1};
+        for (;;) {
+            const auto start = Clock::now();
+            for (long long i{0}; i < iterations; i++) {
+                benchmark.operation();
+            }
+            if (Clock::now() - start >= BatchTime) {
+                break;
+            }
+            iterations *= 2;
+        }
+
+        std::vector<double> perOperation;
+        const auto runStart = Clock::now();
+        while (static_cast<int>(perOperation.size()) < MinBatches || Clock::now() - runStart < _options.minTime) {
+            const auto start = Clock::now();
+            for (long long i{0}; i < iterations; i++) {
+                benchmark.operation();
+            }
+            const auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            perOperation.push_back(elapsed / static_cast<double>(iterations));
+        }
+
+        std::sort(perOperation.begin(), perOperation.end());
+        const auto median = perOperation[perOperation.size() / 2];
+        const auto mean = std::accumulate(perOperation.begin(), perOperation.end(), 0.) /
+                          static_cast<double>(perOperation.size());
+        double variance{};
+        for (const auto value : perOperation) {
+            variance += (value - mean) * (value - mean);
+        }
+        const auto deviation = std::sqrt(variance / static_cast<double>(perOperation.size()));
+
+        benchmark.result = {{"nsPerOp", median}, {"minNsPerOp", perOperation.front()}, {"meanNsPerOp", mean},
+            {"relativeDeviation", mean > 0 ? deviation / mean : 0.}, {"batches", perOperation.size()},
+            {"iterationsPerBatch", iterations}};
+        if (benchmark.bytes > 0) {
+            benchmark.result["mbPerSecond"] = benchmark.bytes / median * 1e3;
+        }
+        std::fprintf(stderr, "%-48s %12.1lf ns/op  ±%4.1lf%%", benchmark.name.c_str(), median,
+            mean > 0 ? deviation / mean * 100 : 0.);
+        if (benchmark.bytes > 0) {
+            std::fprintf(stderr, "  %9.1lf MB/s", benchmark.bytes / median * 1e3);
+        }
+        std::fprintf(stderr, "\n");
+    }
+}
+
+nlohmann::json Suite::ToJson() const {
+    auto results = nlohmann::json::array();
+    for (const auto &benchmark : _benchmarks) {
+        auto result = benchmark.operation ? benchmark.result : nlohmann::json{{"skipped", benchmark.skipped}};
+        result["name"] = benchmark.name;
+        results.push_back(std::move(result));
+    }
+    return results;
+}
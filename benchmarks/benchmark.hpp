@@ -0,0 +1,60 @@
+#ifndef CONVENTION_NAMETAG_BENCHMARK_HPP
+#define CONVENTION_NAMETAG_BENCHMARK_HPP
+
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Minimal microbenchmark runner, results go to JSON so that runs can be compared across commits
+ *
+ * A benchmark is a function doing one operation. It is run in batches sized to take at least BatchTime each, until
+ * the minimum time has passed; the time per operation is reported as the median over the batches, with the fastest
+ * batch and the spread next to it. Setup belongs outside the function, captured by it.
+ */
+class Suite {
+  public:
+    struct Options {
+        // only benchmarks with this in their name
+        std::string filter;
+        std::chrono::milliseconds minTime{1000};
+        // sample clips for the decode benchmarks
+        std::filesystem::path clips{"benchmarks/clips"};
+    };
+
+    explicit Suite(Options options);
+
+    // bytes is what one operation processes, for a throughput next to the time
+    void Add(std::string name, std::function<void()> operation, double bytes = 0);
+    // listed in the results, so a missing benchmark is told apart from a removed one
+    void Skip(std::string name, std::string reason);
+
+    void Run();
+    [[nodiscard]] nlohmann::json ToJson() const;
+    [[nodiscard]] const Options &GetOptions() const { return _options; }
+
+  private:
+    struct Benchmark {
+        std::string name;
+        std::function<void()> operation;
+        double bytes;
+        std::string skipped;
+        nlohmann::json result;
+    };
+
+    Options _options;
+    std::vector<Benchmark> _benchmarks;
+};
+
+// keeps the compiler from dropping work whose result is never read
+template <class T> inline void keep(const T &value) { asm volatile("" : : "g"(&value) : "memory"); }
+
+void addFramebufferBenchmarks(Suite &suite);
+void addDecodeBenchmarks(Suite &suite);
+void addLibraryBenchmarks(Suite &suite);
+
+#endif // CONVENTION_NAMETAG_BENCHMARK_HPP
@@ -0,0 +1,10 @@
+#!/bin/sh
+# Sample clips for the DecodeFrame benchmarks, at the panel's size and at sizes people upload without scaling them
+# down first. Encoded like phones do, h264 with B-frames, ten seconds of ffmpeg's test pattern at 30 fps.
+set -e
+folder=${1:-$(dirname "$0")/clips}
+mkdir -p "$folder"
+for size in 256x64 480x360 1280x720; do
+    ffmpeg -v error -y -f lavfi -i "testsrc2=size=$size:rate=30:duration=10" -c:v libx264 -preset medium \
+        -pix_fmt yuv420p "$folder/h264-$size.mp4"
+done
@@ -0,0 +1,10 @@
+# Runs on every build of the benchmarks: writes the current commit to OUTPUT, touching the file only when it changed,
+# so results name the commit they were built from without rebuilding anything when it did not
+execute_process(COMMAND git rev-parse --short HEAD WORKING_DIRECTORY ${SOURCE_DIR}
+        OUTPUT_VARIABLE COMMIT OUTPUT_STRIP_TRAILING_WHITESPACE ERROR_QUIET)
+if (NOT COMMIT)
+    set(COMMIT unknown)
+endif ()
+file(WRITE ${OUTPUT}.tmp "#define BENCHMARK_COMMIT \"${COMMIT}\"\n")
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy_if_different ${OUTPUT}.tmp ${OUTPUT})
+file(REMOVE ${OUTPUT}.tmp)
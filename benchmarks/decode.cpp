@@ -0,0 +1,101 @@
+#include "benchmark.hpp"
+
+#include "video/videoDecoder.hpp"
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <utility>
+
+namespace {
+const int PanelWidth = 256;
+const int PanelHeight = 64;
+
+// DecodeFrame paces itself to the clip's timestamps; starting at the epoch makes every frame overdue
+void addClip(Suite &suite, const std::filesystem::path &clip) {
+    struct State {
+        std::unique_ptr<VideoDecoder> decoder;
+        std::vector<uint8_t> rgb = std::vector<uint8_t>(PanelWidth * PanelHeight * 3);
+        int loops{};
+    };
+    auto state = std::make_shared<State>();
+    state->decoder = std::make_unique<VideoDecoder>(clip, PanelWidth, PanelHeight);
+    state->decoder->Start({});
+    suite.Add("DecodeFrame/" + clip.stem().string(), [state]() {
+        state->decoder->DecodeFrame(state->rgb.data(), static_cast<int>(state->rgb.size()));
+        // looping restarts the clock from now, put it back
+        if (const auto loops = state->decoder->GetLoops(); loops != state->loops) {
+            state->loops = loops;
+            state->decoder->Start({});
+        }
+        keep(state->rgb.front());
+    });
+}
+
+// what VideoDecoder asks of swscale, from the decoder's usual output to the panel's gray
+void addScale(Suite &suite, int width, int height) {
+    const std::array<std::pair<const char *, int>, 5> flags{{{"FAST_BILINEAR", SWS_FAST_BILINEAR},
+        {"BILINEAR", SWS_BILINEAR}, {"BICUBIC", SWS_BICUBIC}, {"POINT", SWS_POINT}, {"AREA", SWS_AREA}}};
+    for (const auto &[flagName, flag] : flags) {
+        struct State {
+            SwsContext *context{};
+            AVFrame *source{};
+            std::vector<uint8_t> gray = std::vector<uint8_t>(PanelWidth * PanelHeight);
+            ~State() {
+                sws_freeContext(context);
+                av_frame_free(&source);
+            }
+        };
+        auto state = std::make_shared<State>();
+        state->context = sws_getContext(width, height, AV_PIX_FMT_YUV420P, PanelWidth, PanelHeight, AV_PIX_FMT_GRAY8,
+            flag, nullptr, nullptr, nullptr);
+        state->source = av_frame_alloc();
+        state->source->format = AV_PIX_FMT_YUV420P;
+        state->source->width = width;
+        state->source->height = height;
+        av_frame_get_buffer(state->source, 0);
+        // a gradient, flat frames could take shortcuts
+        for (int plane{0}; plane < 3; plane++) {
+            const int rows = plane == 0 ? height : height / 2;
+            for (int y{0}; y < rows; y++) {
+                for (int x{0}; x < state->source->linesize[plane]; x++) {
+                    state->source->data[plane][y * state->source->linesize[plane] + x] = static_cast<uint8_t>(x + y);
+                }
+            }
+        }
+
+        suite.Add(
+            "sws_scale/" + std::to_string(width) + "x" + std::to_string(height) + "/" + flagName,
+            [state, height]() {
+                uint8_t *planes[4]{state->gray.data()};
+                int linesizes[4]{PanelWidth};
+                sws_scale(state->context, state->source->data, state->source->linesize, 0, height, planes, linesizes);
+                keep(state->gray.front());
+            },
+            static_cast<double>(width * height * 3 / 2));
+    }
+}
+} // namespace
+
+void addDecodeBenchmarks(Suite &suite) {
+    const auto &folder = suite.GetOptions().clips;
+    std::vector<std::filesystem::path> clips;
+    if (std::error_code error; std::filesystem::is_directory(folder, error)) {
+        for (const auto &entry : std::filesystem::directory_iterator(folder)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".mp4") {
+                clips.push_back(entry.path());
+            }
+        }
+    }
+    std::sort(clips.begin(), clips.end());
+    if (clips.empty()) {
+        suite.Skip("DecodeFrame", "no clips in " + folder.string() + ", make them with benchmarks/clips.sh");
+    }
+    for (const auto &clip : clips) {
+        addClip(suite, clip);
+    }
+
+    addScale(suite, 256, 64);
+    addScale(suite, 480, 360);
+    addScale(suite, 1280, 720);
+}
@@ -0,0 +1,35 @@
+#include "benchmark.hpp"
+
+#include "driver.hpp"
+
+#include <random>
+
+namespace {
+// a frame of noise, the converters do not branch on the values but the compiler should not see constants either
+template <class DeviceType> std::vector<uint8_t> randomFrame() {
+    std::vector<uint8_t> rgb(DeviceType::Width * DeviceType::Height * 3);
+    std::mt19937 random(42);
+    std::generate(rgb.begin(), rgb.end(), [&random]() { return static_cast<uint8_t>(random()); });
+    return rgb;
+}
+
+// the converter CopyFramebuffer runs, without a driver and the hardware it would claim
+template <class DeviceType>
+void addConverter(Suite &suite, const std::string &name, void (*convert)(const uint8_t *, uint8_t *)) {
+    auto rgb = std::make_shared<std::vector<uint8_t>>(randomFrame<DeviceType>());
+    auto buffer = std::make_shared<std::vector<uint8_t>>(DeviceType::BufferSize);
+    suite.Add(
+        "CopyFramebuffer/" + name,
+        [rgb, buffer, convert]() {
+            convert(rgb->data(), buffer->data());
+            keep(buffer->front());
+        },
+        static_cast<double>(rgb->size()));
+}
+} // namespace
+
+void addFramebufferBenchmarks(Suite &suite) {
+    addConverter<HardwareSpecs::SH1106>(suite, "SH1106", Wrappers::SH1106::ConvertFramebuffer);
+    addConverter<HardwareSpecs::SSD1322>(suite, "SSD1322", Wrappers::SSD1322::ConvertFramebuffer);
+    addConverter<HardwareSpecs::SSD1305>(suite, "SSD1305", Wrappers::SSD1305::ConvertFramebuffer);
+}
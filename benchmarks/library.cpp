@@ -0,0 +1,51 @@
+#include "benchmark.hpp"
+
+#include "net/server.hpp"
+#include "video/mediaIndex.hpp"
+
+#include <format>
+
+namespace {
+// names as phones make them, the escapes as browsers send them
+std::string encodedName(int i) { return std::format("PXL_2024{:04d}_{:06d}%20%28{}%29.mp4", i % 10000, i, i % 7); }
+
+std::map<std::string, MediaEntry> library(int files) {
+    std::map<std::string, MediaEntry> entries;
+    for (int i{0}; i < files; i++) {
+        MediaEntry entry;
+        entry.size = 1024 * 1024 + static_cast<uintmax_t>(i);
+        entry.mtime = 1700000000000000000 + i;
+        entry.thumbnail = i % 10 != 0;
+        entry.info = VideoInfo{12.5, 480, 360, "h264", 29.97, 375};
+        entries.emplace(std::format("PXL_2024{:04d}_{:06d} ({}).mp4", i % 10000, i, i % 7), std::move(entry));
+    }
+    return entries;
+}
+} // namespace
+
+void addLibraryBenchmarks(Suite &suite) {
+    for (const int length : {16, 256}) {
+        // a name with an escape every few characters, the worst the routes see in practice
+        std::string encoded;
+        for (int i{0}; static_cast<int>(encoded.size()) < length; i++) {
+            encoded += encodedName(i);
+        }
+        encoded.resize(static_cast<size_t>(length));
+        suite.Add(
+            "UrlDecode/" + std::to_string(length),
+            [encoded]() {
+                auto decoded = UrlDecode(encoded);
+                keep(decoded);
+            },
+            length);
+    }
+
+    // GET /videos answers with a cached body, building it is the cost whenever the library changes
+    for (const int files : {100, 1000, 10000}) {
+        auto entries = std::make_shared<const std::map<std::string, MediaEntry>>(library(files));
+        suite.Add("getVideos/" + std::to_string(files), [entries]() {
+            auto listing = MediaIndex::BuildListing(*entries);
+            keep(listing);
+        });
+    }
+}
@@ -0,0 +1,60 @@
+#include "benchmark.hpp"
+
+#include <sys/utsname.h>
+
+#include <charconv>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+
+// generated by benchmarks/commit.cmake on every build
+#if __has_include("benchmarkCommit.hpp")
+#include "benchmarkCommit.hpp"
+#else
+#define BENCHMARK_COMMIT "unknown"
+#endif
+
+/**
+ * Runs from the repository root: `./build/benchmarks --json results.json`, with --filter to pick benchmarks by name,
+ * --min-time in ms per benchmark and --clips for a different folder of sample clips
+ */
+int main(int argc, char **argv) {
+    Suite::Options options;
+    std::string output;
+    for (int i{1}; i + 1 < argc; i += 2) {
+        const std::string_view argument(argv[i]);
+        const std::string_view value(argv[i + 1]);
+        if (argument == "--filter") {
+            options.filter = value;
+        } else if (argument == "--min-time") {
+            long long milliseconds{};
+            std::from_chars(value.data(), value.data() + value.size(), milliseconds);
+            options.minTime = std::chrono::milliseconds(milliseconds);
+        } else if (argument == "--clips") {
+            options.clips = value;
+        } else if (argument == "--json") {
+            output = value;
+        } else {
+            std::cerr << "Unknown option " << argument << std::endl;
+            return 1;
+        }
+    }
+
+    Suite suite(options);
+    addFramebufferBenchmarks(suite);
+    addDecodeBenchmarks(suite);
+    addLibraryBenchmarks(suite);
+    suite.Run();
+
+    // what runs are compared by
+    utsname host{};
+    uname(&host);
+    const nlohmann::json results{{"commit", BENCHMARK_COMMIT}, {"machine", host.machine}, {"host", host.nodename},
+        {"compiler", __VERSION__}, {"time", std::time(nullptr)}, {"results", suite.ToJson()}};
+    if (output.empty()) {
+        std::cout << results.dump(2) << std::endl;
+    } else {
+        std::ofstream(output) << results.dump(2) << std::endl;
+    }
+}
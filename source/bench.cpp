@@ -0,0 +1,247 @@
+#include "bench.hpp"
+#include "driver.hpp"
+#include "simulatedPanel.hpp"
+#include "drawers/compositor.hpp"
+#include "util/perfCounters.hpp"
+#include "util/trace.hpp"
+#include "video/playerLayer.hpp"
+#include "video/videoPlayer.hpp"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <new>
+#include <string_view>
+
+#include <nlohmann/json.hpp>
+
+namespace {
+// C++ allocations of the whole process while the bench plays, counted by the operator new below; libav allocates with
+// malloc and only shows up in the peak RSS. The operators are linked into every nametag binary, so outside the bench
+// an allocation only pays the relaxed load of counting, a plain load, and no atomic add shared by all threads
+std::atomic<bool> counting{};
+std::atomic<long long> allocations{};
+
+// spans are read out of the trace rings this often, the ring of the render thread has to hold that many frames
+const int CollectInterval = 256;
+const size_t TraceEvents = 4096;
+
+struct Stage {
+    long long count{};
+    std::chrono::nanoseconds total{};
+    std::chrono::nanoseconds max{};
+};
+} // namespace
+
+void *operator new(std::size_t size) {
+    if (counting.load(std::memory_order_relaxed)) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (void *memory = std::malloc(std::max<std::size_t>(size, 1))) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment) {
+    if (counting.load(std::memory_order_relaxed)) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    const auto align = static_cast<std::size_t>(alignment);
+    // aligned_alloc wants a multiple of the alignment
+    if (void *memory = std::aligned_alloc(align, (std::max<std::size_t>(size, 1) + align - 1) / align * align)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept { std::free(memory); }
+void operator delete(void *memory, std::size_t) noexcept { std::free(memory); }
+void operator delete(void *memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete(void *memory, std::size_t, std::align_val_t) noexcept { std::free(memory); }
+
+int runBench(int argc, char **argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: nametag --bench <file> [--loops <n>] [--json <file>] [--min-fps <fps>]" << std::endl;
+        return 1;
+    }
+    const std::filesystem::path file(argv[2]);
+    int loops{3};
+    std::string output;
+    double minFps{};
+    for (int i{3}; i + 1 < argc; i += 2) {
+        const std::string_view argument(argv[i]);
+        const std::string_view value(argv[i + 1]);
+        if (argument == "--loops") {
+            std::from_chars(value.data(), value.data() + value.size(), loops);
+        } else if (argument == "--json") {
+            output = value;
+        } else if (argument == "--min-fps") {
+            minFps = std::strtod(argv[i + 1], nullptr);
+        } else {
+            std::cerr << "Unknown option " << argument << std::endl;
+            return 1;
+        }
+    }
+
+    loops = std::max(loops, 1);
+
+    // the stages are taken from the trace, whatever the configuration says, and counted where the kernel allows
+    Trace::Configure(true, TraceEvents);
+    Perf::Configure(true);
+    Trace::SetThreadName("render");
+
+    using Device = HardwareSpecs::SSD1322;
+    VideoPlayer player(Device::Width, Device::Height, Device::Format);
+    Compositor compositor(Device::Width, Device::Height, Device::Format);
+    compositor.Add(std::make_shared<PlayerLayer>(player, Wrappers::SSD1322::ConvertFramebuffer),
+        {0, 0, 15, BlendMode::Replace});
+    Wrappers::SimulatedPanel<Device> panel(false);
+
+    std::unique_ptr<VideoDecoder> decoder;
+    try {
+        decoder = std::make_unique<VideoDecoder>(file, Device::Width, Device::Height);
+    } catch (const std::exception &error) {
+        std::cerr << "Could not open " << file << ": " << error.what() << std::endl;
+        return 1;
+    }
+    decoder->SetLoopLimit(loops);
+    decoder->SetPaced(false);
+    const auto interval = decoder->GetFrameInterval();
+    // owned by the player from here on, which only lets go of it when told to play something else
+    const auto *playing = decoder.get();
+    player.Play(std::move(decoder));
+
+    std::map<std::string_view, Stage> stages;
+    const auto addUp = [&stages](std::chrono::steady_clock::time_point since) {
+        for (const auto &span : Trace::Collect(since)) {
+            if (span.duration.count() < 0) {
+                continue;
+            }
+            auto &stage = stages[span.name];
+            stage.count++;
+            stage.total += span.duration;
+            stage.max = std::max(stage.max, span.duration);
+        }
+    };
+
+    // the virtual clock: frame i is due at i intervals; a frame starts once it is due and the previous one is done,
+    // and is late if it is not done before the next one is due
+    std::chrono::nanoseconds virtualTime{};
+    long long lateFrames{};
+
+    counting.store(true, std::memory_order_relaxed);
+    const auto start = std::chrono::steady_clock::now();
+    auto collected = start;
+    long long iterations{};
+    while (not playing->Finished()) {
+        const auto begin = std::chrono::steady_clock::now();
+        const auto transferBefore = panel.GetTransferTime();
+
+        // as the render loop does it
+        const auto &dirty = compositor.Compose(panel.GetFrame(), begin);
+        int dirtyPixels{};
+        for (const auto &area : dirty) {
+            dirtyPixels += area.width * area.height;
+        }
+        if (dirtyPixels * 2 > panel.GetWidth() * panel.GetHeight()) {
+            panel.Display();
+        } else {
+            for (const auto &area : dirty) {
+                panel.DisplayRegion(area);
+            }
+        }
+
+        const auto cost = (std::chrono::steady_clock::now() - begin) + (panel.GetTransferTime() - transferBefore);
+        if (interval.count() > 0) {
+            const std::chrono::nanoseconds due = interval * iterations;
+            virtualTime = std::max(virtualTime, due) + cost;
+            if (virtualTime > due + interval) {
+                lateFrames++;
+            }
+        }
+
+        if (++iterations % CollectInterval == 0) {
+            const auto now = std::chrono::steady_clock::now();
+            addUp(collected);
+            collected = now;
+        }
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    counting.store(false, std::memory_order_relaxed);
+    const auto allocated = allocations.load(std::memory_order_relaxed);
+    addUp(collected);
+
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+
+    const auto toMs = [](std::chrono::nanoseconds time) { return static_cast<double>(time.count()) / 1e6; };
+    const auto frames = playing->GetFramesShown();
+    const auto seconds = std::chrono::duration<double>(elapsed).count();
+    const auto fps = seconds > 0. ? static_cast<double>(frames) / seconds : 0.;
+    const auto clipFps = interval.count() > 0 ? 1e6 / static_cast<double>(interval.count()) : 0.;
+    const auto perFrame = [frames](double value) { return frames > 0 ? value / static_cast<double>(frames) : 0.; };
+
+    printf("Bench:              %s, %d loops on a simulated %dx%d panel\n", file.c_str(), loops, Device::Width,
+        Device::Height);
+    printf("Frames:             %lld in %.3lfs, %.1lf fps (clip %.1lf fps, %.1lfx real time)\n", frames, seconds, fps,
+        clipFps, clipFps > 0. ? fps / clipFps : 0.);
+
+    auto stageJson = nlohmann::json::object();
+    const auto counted = Perf::Collect();
+    // compose includes what the player layer does for it: decoding, scaling and conversion
+    for (const char *name : {"decode", "sws_scale", "convert", "compose"}) {
+        const auto stage = stages[name];
+        const auto average = stage.count > 0 ? toMs(stage.total) / static_cast<double>(stage.count) : 0.;
+        printf("  %-18s%09.3lfms average, %09.3lfms max, %lld times\n", name, average, toMs(stage.max), stage.count);
+        stageJson[name] = {{"count", stage.count}, {"averageMs", average}, {"maxMs", toMs(stage.max)},
+            {"totalMs", toMs(stage.total)}};
+
+        const auto perf = std::find_if(counted.begin(), counted.end(),
+            [name](const Perf::StageStats &stats) { return std::string_view(stats.name) == name; });
+        if (perf == counted.end()) {
+            continue;
+        }
+        printf("  %-18s%s\n", "", Perf::Summary(*perf).c_str());
+        auto counters = nlohmann::json::object();
+        const auto calls = static_cast<double>(std::max(perf->count, 1LL));
+        for (int i{0}; i < Perf::EventCount; i++) {
+            if (perf->counts[i].has_value()) {
+                counters[Perf::EventName(static_cast<Perf::Event>(i))] = {{"total", *perf->counts[i]},
+                    {"perCall", static_cast<double>(*perf->counts[i]) / calls}, {"coverage", perf->coverage[i]}};
+            }
+        }
+        stageJson[name]["counters"] = counters;
+    }
+    const auto status = Perf::GetStatus();
+    printf("Counters:           %s\n", status.available ? (status.userOnly ? "user space only" : "available")
+                                                          : status.reason.c_str());
+    const auto transferMs = perFrame(toMs(panel.GetTransferTime()));
+    printf("  %-18s%09.3lfms average per frame, simulated at %lld Hz\n", "transfer", transferMs,
+        Wrappers::SimulatedPanel<Device>::SpiClock);
+    if (interval.count() > 0) {
+        printf("Late frames:        %lld of %lld at the clip's rate, SPI included\n", lateFrames, iterations);
+    }
+    printf("Peak RSS:           %.1lf MiB\n", static_cast<double>(usage.ru_maxrss) / 1024.);
+    printf("Allocations:        %lld, %.2lf per frame\n", allocated, perFrame(static_cast<double>(allocated)));
+
+    if (not output.empty()) {
+        const nlohmann::json results{{"file", file.string()}, {"loops", loops}, {"frames", frames},
+            {"seconds", seconds}, {"fps", fps}, {"clipFps", clipFps}, {"lateFrames", lateFrames}, {"stages", stageJson},
+            {"transferMsPerFrame", transferMs}, {"counters", status.available}, {"peakRssKiB", usage.ru_maxrss},
+            {"allocations", allocated}, {"allocationsPerFrame", perFrame(static_cast<double>(allocated))}};
+        std::ofstream(output) << results.dump(2) << std::endl;
+    }
+    if (fps < minFps) {
+        std::cerr << "Ran at " << fps << " fps, below --min-fps " << minFps << std::endl;
+        return 1;
+    }
+    return 0;
+}
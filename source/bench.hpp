@@ -0,0 +1,15 @@
+#ifndef CONVENTION_NAMETAG_BENCH_HPP
+#define CONVENTION_NAMETAG_BENCH_HPP
+
+/**
+ * `nametag --bench <file> [--loops <n>] [--json <file>] [--min-fps <fps>]`
+ *
+ * Plays a video through the whole render path, player, conversion, compositor and panel, as fast as it decodes: the
+ * decoder does not wait for presentation times and the panel only adds up how long its SPI transfers would take.
+ * Frames are then replayed on a virtual clock at the clip's rate, which tells whether it would hold its frame rate on
+ * the machine it runs on. Prints frames per second, time and hardware counters per stage, peak RSS and allocations;
+ * the exit code is 1 if it ran slower than --min-fps, for scripts that catch regressions.
+ */
+int runBench(int argc, char **argv);
+
+#endif // CONVENTION_NAMETAG_BENCH_HPP
@@ -0,0 +1,397 @@
+#include "compositor.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+// more dirty rectangles than this are merged into one, past that the bookkeeping costs more than it saves
+const auto MaxDirtyRects = 8;
+
+constexpr uint32_t LowNibbles = 0x0F0F0F0F;
+constexpr uint32_t NibbleLsbs = 0x11111111;
+constexpr uint32_t NibbleMsbs = 0x88888888;
+
+// 0xF in every nibble that isn't zero
+uint32_t nonZeroNibbles(uint32_t value) {
+    return ((value | value >> 1 | value >> 2 | value >> 3) & NibbleLsbs) * 0xF;
+}
+
+// value * alpha / 16 per nibble, alpha 0-16; even and odd nibbles are spread to bytes so products can't overflow
+uint32_t scaleNibbles(uint32_t value, uint32_t alpha) {
+    const uint32_t low = ((value & LowNibbles) * alpha >> 4) & LowNibbles;
+    const uint32_t high = (((value >> 4) & LowNibbles) * alpha) & ~LowNibbles;
+    return low | high;
+}
+
+// (above * alpha + below * (16 - alpha)) / 16 per nibble
+uint32_t mixNibbles(uint32_t below, uint32_t above, uint32_t alpha) {
+    const uint32_t inverse = 16 - alpha;
+    const uint32_t low = (((above & LowNibbles) * alpha + (below & LowNibbles) * inverse) >> 4) & LowNibbles;
+    const uint32_t high =
+        (((above >> 4) & LowNibbles) * alpha + ((below >> 4) & LowNibbles) * inverse) & ~LowNibbles;
+    return low | high;
+}
+
+// per nibble min(a + b, 15): add the low 3 bits, fix up the top bit and saturate where it carried out
+uint32_t addNibbles(uint32_t a, uint32_t b) {
+    const uint32_t sum = ((a & ~NibbleMsbs) + (b & ~NibbleMsbs)) ^ ((a ^ b) & NibbleMsbs);
+    const uint32_t carry = ((a & b) | ((a | b) & ~sum)) & NibbleMsbs;
+    return sum | ((carry >> 3) * 0xF);
+}
+
+template <BlendMode Mode> uint32_t blendWord(uint32_t below, uint32_t above, uint32_t coverage, uint32_t alpha) {
+    if constexpr (Mode == BlendMode::Over || Mode == BlendMode::Replace) {
+        if constexpr (Mode == BlendMode::Over) {
+            coverage &= nonZeroNibbles(above);
+        }
+        const uint32_t mixed = alpha >= 16 ? above : mixNibbles(below, above, alpha);
+        return (below & ~coverage) | (mixed & coverage);
+    } else if constexpr (Mode == BlendMode::Add) {
+        return (below & ~coverage) | (addNibbles(below, scaleNibbles(above, alpha)) & coverage);
+    } else {
+        return below ^ (above & coverage);
+    }
+}
+
+template <BlendMode Mode>
+void blendRow(uint8_t *row, const uint32_t *pixels, const uint32_t *coverage, int bytes, uint32_t alpha) {
+    for (int offset{0}; offset < bytes; offset += 4, pixels++, coverage++) {
+        if (*coverage == 0) {
+            continue;
+        }
+        // the last word of a frame whose width isn't a multiple of 8 is partial
+        const auto length = static_cast<size_t>(std::min(4, bytes - offset));
+        uint32_t below{};
+        std::memcpy(&below, row + offset, length);
+        const uint32_t blended = blendWord<Mode>(below, *pixels, *coverage, alpha);
+        std::memcpy(row + offset, &blended, length);
+    }
+}
+
+uint8_t getNibble(const uint8_t *row, int index) {
+    return (index & 1) ? (row[index / 2] & 0x0F) : (row[index / 2] >> 4);
+}
+
+void setNibble(uint8_t *row, int index, uint8_t value) {
+    auto &out = row[index / 2];
+    out = (index & 1) ? static_cast<uint8_t>((out & 0xF0) | value) : static_cast<uint8_t>((out & 0x0F) | (value << 4));
+}
+
+// 4x4 ordered dither thresholds, mono panels show opacity as pixel density
+constexpr uint8_t Bayer[4][4] = {{0, 8, 2, 10}, {12, 4, 14, 6}, {3, 11, 1, 9}, {15, 7, 13, 5}};
+
+// opacity 0-15 to the 0-16 range the kernels divide by with a shift
+uint32_t toAlpha(uint8_t opacity) { return (std::min<uint32_t>(opacity, 15) * 16 + 7) / 15; }
+} // namespace
+
+Compositor::Compositor(int width, int height, PixelFormat format)
+    : _width{width}, _height{height}, _format{format} {}
+
+Rect Compositor::Entry::Bounds() const {
+    const auto &surface = layer->GetSurface();
+    return {placement.x, placement.y, surface.width, surface.height};
+}
+
+int Compositor::Add(std::shared_ptr<Layer> layer, const LayerPlacement &placement) {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    if (layer->GetSurface().format != _format) {
+        return -1;
+    }
+    const int id = _nextId++;
+    _layers.push_back({id, std::move(layer), placement});
+    return id;
+}
+
+bool Compositor::Remove(int id) {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    return std::erase_if(_layers, [id](const Entry &entry) { return entry.id == id; }) > 0;
+}
+
+bool Compositor::SetPlacement(int id, const LayerPlacement &placement) {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    for (auto &entry : _layers) {
+        if (entry.id == id) {
+            entry.placement = placement;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::optional<LayerPlacement> Compositor::GetPlacement(int id) const {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    for (const auto &entry : _layers) {
+        if (entry.id == id) {
+            return entry.placement;
+        }
+    }
+    return std::nullopt;
+}
+
+std::vector<Compositor::LayerInfo> Compositor::GetLayers() const {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    std::vector<LayerInfo> layers;
+    for (const auto &entry : _layers) {
+        const auto &surface = entry.layer->GetSurface();
+        layers.push_back({entry.id, entry.layer->GetType(), surface.width, surface.height, entry.placement});
+    }
+    return layers;
+}
+
+Compositor::Stats Compositor::GetStats() const {
+    auto lock = std::lock_guard<std::mutex>(_statsAccess);
+    return _stats;
+}
+
+const std::vector<Rect> &Compositor::Compose(const FrameView &frame, std::chrono::steady_clock::time_point now) {
+    Trace::Stage stage{"render", "compose"};
+    std::vector<Entry> layers;
+    {
+        auto lock = std::lock_guard<std::mutex>(_access);
+        layers = _layers;
+    }
+
+    _dirty.clear();
+    if (_invalidated) {
+        MarkDirty({0, 0, _width, _height});
+        _invalidated = false;
+    }
+
+    // every layer is updated, hidden ones included, so their animations keep their pace
+    for (const auto &entry : layers) {
+        const auto changed = entry.layer->Update(now);
+        if (entry.placement.visible && not changed.Empty()) {
+            MarkDirty({changed.x + entry.placement.x, changed.y + entry.placement.y, changed.width, changed.height});
+        }
+    }
+
+    // layers that were added, moved, faded or removed since the last frame
+    for (const auto &entry : layers) {
+        const auto previous = std::find_if(
+            _composed.begin(), _composed.end(), [&entry](const Entry &other) { return other.id == entry.id; });
+        if (previous != _composed.end() && previous->layer == entry.layer && previous->placement == entry.placement) {
+            continue;
+        }
+        if (previous != _composed.end() && previous->placement.visible) {
+            MarkDirty(previous->Bounds());
+        }
+        if (entry.placement.visible) {
+            MarkDirty(entry.Bounds());
+        }
+    }
+    for (const auto &previous : _composed) {
+        const bool removed = std::none_of(
+            layers.begin(), layers.end(), [&previous](const Entry &entry) { return entry.id == previous.id; });
+        if (removed && previous.placement.visible) {
+            MarkDirty(previous.Bounds());
+        }
+    }
+    _composed = std::move(layers);
+
+    Stats stats;
+    for (const auto &area : _dirty) {
+        // clear to black, then redraw the stack within the area
+        if (_format == PixelFormat::Gray4) {
+            for (int y{area.y}; y < area.Bottom(); y++) {
+                std::memset(frame.data + (y * frame.width + area.x) / 2, 0, area.width / 2);
+            }
+        } else {
+            for (int page{area.y / 8}; page < area.Bottom() / 8; page++) {
+                std::memset(frame.data + page * frame.width + area.x, 0, area.width);
+            }
+        }
+
+        for (const auto &entry : _composed) {
+            const auto overlap = area.Intersect(entry.Bounds());
+            if (not entry.placement.visible || entry.placement.opacity == 0 || overlap.Empty()) {
+                stats.skippedBlends++;
+                continue;
+            }
+            Blend(frame, entry, overlap);
+            stats.blends++;
+        }
+        stats.composedPixels += static_cast<long long>(area.width) * area.height;
+    }
+
+    auto lock = std::lock_guard<std::mutex>(_statsAccess);
+    _stats.frames++;
+    _stats.idleFrames += _dirty.empty() ? 1 : 0;
+    _stats.composedPixels += stats.composedPixels;
+    _stats.blends += stats.blends;
+    _stats.skippedBlends += stats.skippedBlends;
+    return _dirty;
+}
+
+void Compositor::MarkDirty(const Rect &area) {
+    auto dirty = area.Intersect({0, 0, _width, _height});
+    if (dirty.Empty()) {
+        return;
+    }
+    // widen to what the kernels and the panel's addressing work in
+    if (_format == PixelFormat::Gray4) {
+        const int right = std::min((dirty.Right() + 7) & ~7, _width & ~1);
+        dirty.x &= ~7;
+        dirty.width = right - dirty.x;
+    } else {
+        const int bottom = std::min((dirty.Bottom() + 7) & ~7, _height & ~7);
+        dirty.y &= ~7;
+        dirty.height = bottom - dirty.y;
+    }
+
+    // overlapping rectangles are merged, which may make the result overlap others again
+    for (auto it = _dirty.begin(); it != _dirty.end();) {
+        if (it->Overlaps(dirty)) {
+            dirty = dirty.Union(*it);
+            _dirty.erase(it);
+            it = _dirty.begin();
+        } else {
+            ++it;
+        }
+    }
+    _dirty.push_back(dirty);
+
+    if (_dirty.size() > MaxDirtyRects) {
+        Rect all;
+        for (const auto &rect : _dirty) {
+            all = all.Union(rect);
+        }
+        _dirty.assign(1, all);
+    }
+}
+
+void Compositor::Blend(const FrameView &frame, const Entry &entry, const Rect &area) {
+    if (_format == PixelFormat::Gray4) {
+        BlendGray4(frame, entry, area);
+    } else {
+        BlendMono(frame, entry, area);
+    }
+}
+
+void Compositor::BlendGray4(const FrameView &frame, const Entry &entry, const Rect &area) {
+    const auto &surface = entry.layer->GetSurface();
+    const auto &placement = entry.placement;
+    const uint32_t alpha = toAlpha(placement.opacity);
+    if (placement.blend == BlendMode::Xor && alpha < 8) {
+        return;
+    }
+
+    // the area widened to whole words, coverage masks out what lies outside the layer
+    const int x0 = area.x & ~7;
+    const int bytes = (std::min((area.Right() + 7) & ~7, frame.width) - x0) / 2;
+    const auto words = static_cast<size_t>((bytes + 3) / 4);
+    _stagedPixels.resize(words);
+    _stagedCoverage.resize(words);
+    auto *pixels = reinterpret_cast<uint8_t *>(_stagedPixels.data());
+    auto *coverage = reinterpret_cast<uint8_t *>(_stagedCoverage.data());
+
+    for (int y{area.y}; y < area.Bottom(); y++) {
+        std::fill(_stagedPixels.begin(), _stagedPixels.end(), 0);
+        std::fill(_stagedCoverage.begin(), _stagedCoverage.end(), 0);
+
+        const uint8_t *source = surface.data + (y - placement.y) * surface.width / 2;
+        const auto stage = [&](int column) {
+            setNibble(pixels, column - x0, getNibble(source, column - placement.x));
+            setNibble(coverage, column - x0, 0x0F);
+        };
+
+        int column = area.x;
+        if ((placement.x & 1) == 0) {
+            // nibbles of the layer line up with the frame, whole bytes can be copied
+            if (column & 1) {
+                stage(column++);
+            }
+            const int pairs = (area.Right() - column) / 2;
+            std::memcpy(pixels + (column - x0) / 2, source + (column - placement.x) / 2, pairs);
+            std::memset(coverage + (column - x0) / 2, 0xFF, pairs);
+            column += pairs * 2;
+        }
+        for (; column < area.Right(); column++) {
+            stage(column);
+        }
+
+        uint8_t *row = frame.data + (y * frame.width + x0) / 2;
+        switch (placement.blend) {
+        case BlendMode::Over:
+            blendRow<BlendMode::Over>(row, _stagedPixels.data(), _stagedCoverage.data(), bytes, alpha);
+            break;
+        case BlendMode::Replace:
+            blendRow<BlendMode::Replace>(row, _stagedPixels.data(), _stagedCoverage.data(), bytes, alpha);
+            break;
+        case BlendMode::Add:
+            blendRow<BlendMode::Add>(row, _stagedPixels.data(), _stagedCoverage.data(), bytes, alpha);
+            break;
+        case BlendMode::Xor:
+            blendRow<BlendMode::Xor>(row, _stagedPixels.data(), _stagedCoverage.data(), bytes, alpha);
+            break;
+        }
+    }
+}
+
+void Compositor::BlendMono(const FrameView &frame, const Entry &entry, const Rect &area) const {
+    const auto &surface = entry.layer->GetSurface();
+    const auto &placement = entry.placement;
+    const uint32_t alpha = toAlpha(placement.opacity);
+    if (placement.blend == BlendMode::Xor && alpha < 8) {
+        return;
+    }
+
+    // which rows of a column byte are lit at this opacity, repeating every 4 columns
+    uint8_t dither[4]{};
+    for (int x{0}; x < 4; x++) {
+        for (int bit{0}; bit < 8; bit++) {
+            if (alpha > Bayer[bit & 3][x]) {
+                dither[x] |= static_cast<uint8_t>(1 << bit);
+            }
+        }
+    }
+
+    const int surfacePages = surface.height / 8;
+    for (int page{area.y / 8}; page <= (area.Bottom() - 1) / 8; page++) {
+        // the layer row at bit 0 of this page, a layer not on a page boundary straddles two of its pages
+        const int offset = page * 8 - placement.y;
+        const int sourcePage = offset >= 0 ? offset / 8 : -((7 - offset) / 8);
+        const int shift = offset - sourcePage * 8;
+        const uint8_t *upper =
+            sourcePage >= 0 && sourcePage < surfacePages ? surface.data + sourcePage * surface.width : nullptr;
+        const uint8_t *lower = shift != 0 && sourcePage + 1 >= 0 && sourcePage + 1 < surfacePages
+                                   ? surface.data + (sourcePage + 1) * surface.width
+                                   : nullptr;
+
+        uint8_t rows{};
+        for (int bit{0}; bit < 8; bit++) {
+            const int y = page * 8 + bit;
+            if (y >= area.y && y < area.Bottom()) {
+                rows |= static_cast<uint8_t>(1 << bit);
+            }
+        }
+
+        uint8_t *destination = frame.data + page * frame.width;
+        for (int x{area.x}; x < area.Right(); x++) {
+            const int column = x - placement.x;
+            uint8_t value{};
+            if (upper != nullptr) {
+                value = static_cast<uint8_t>(upper[column] >> shift);
+            }
+            if (lower != nullptr) {
+                value |= static_cast<uint8_t>(lower[column] << (8 - shift));
+            }
+
+            auto &out = destination[x];
+            switch (placement.blend) {
+            case BlendMode::Over:
+            case BlendMode::Add:
+                out |= value & rows & dither[x & 3];
+                break;
+            case BlendMode::Replace: {
+                const uint8_t mask = rows & dither[x & 3];
+                out = static_cast<uint8_t>((out & ~mask) | (value & mask));
+                break;
+            }
+            case BlendMode::Xor:
+                out ^= value & rows;
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef CONVENTION_NAMETAG_COMPOSITOR_HPP
+#define CONVENTION_NAMETAG_COMPOSITOR_HPP
+
+#include "frame.hpp"
+#include "layer.hpp"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Stacks layers into the panel buffer, redrawing only what changed
+ *
+ * Every frame, each layer reports the area its content changed in, and moving, fading or removing a layer marks its
+ * old and new rectangle. Only those dirty rectangles are cleared and re-blended from the layers overlapping them, so
+ * the cost follows the changed area rather than layers times frame size, and the rectangles tell the driver which
+ * part of the panel to send.
+ *
+ * Blending works on the packed panel format directly, 8 pixels per uint32_t on Gray4 and 8 rows per byte on
+ * Mono1Paged. Dirty rectangles are widened to 8 pixel columns on Gray4 and to whole pages on Mono1Paged to keep the
+ * kernels word aligned.
+ *
+ * Layers are added and changed from any thread, Compose runs on the render thread.
+ */
+class Compositor {
+  public:
+    Compositor(int width, int height, PixelFormat format);
+
+    // layers are drawn bottom to top in the order they were added, returns the id of the layer
+    int Add(std::shared_ptr<Layer> layer, const LayerPlacement &placement);
+    bool Remove(int id);
+    bool SetPlacement(int id, const LayerPlacement &placement);
+    [[nodiscard]] std::optional<LayerPlacement> GetPlacement(int id) const;
+
+    struct LayerInfo {
+        int id;
+        std::string type;
+        int width;
+        int height;
+        LayerPlacement placement;
+    };
+    [[nodiscard]] std::vector<LayerInfo> GetLayers() const;
+
+    // updates every layer and recomposes the changed areas into the frame, which must keep its contents between calls
+    const std::vector<Rect> &Compose(const FrameView &frame, std::chrono::steady_clock::time_point now);
+    // the next Compose redraws the whole frame
+    void Invalidate() { _invalidated = true; }
+
+    struct Stats {
+        long long frames{};
+        // frames where nothing changed and nothing was drawn
+        long long idleFrames{};
+        long long composedPixels{};
+        // layer and dirty rectangle pairs that were blended, and those skipped for not overlapping
+        long long blends{};
+        long long skippedBlends{};
+    };
+    [[nodiscard]] Stats GetStats() const;
+
+  private:
+    struct Entry {
+        int id;
+        std::shared_ptr<Layer> layer;
+        LayerPlacement placement;
+
+        [[nodiscard]] Rect Bounds() const;
+    };
+
+    void MarkDirty(const Rect &area);
+    void Blend(const FrameView &frame, const Entry &entry, const Rect &area);
+    void BlendGray4(const FrameView &frame, const Entry &entry, const Rect &area);
+    void BlendMono(const FrameView &frame, const Entry &entry, const Rect &area) const;
+
+    const int _width;
+    const int _height;
+    const PixelFormat _format;
+
+    std::vector<Entry> _layers;
+    int _nextId{};
+    mutable std::mutex _access;
+
+    // render thread only: what the frame currently shows and the areas to redraw
+    std::vector<Entry> _composed;
+    std::vector<Rect> _dirty;
+    bool _invalidated{true};
+
+    // staged source row and coverage of the layer being blended, one word per 8 pixels
+    std::vector<uint32_t> _stagedPixels;
+    std::vector<uint32_t> _stagedCoverage;
+
+    Stats _stats;
+    mutable std::mutex _statsAccess;
+};
+
+#endif // CONVENTION_NAMETAG_COMPOSITOR_HPP
@@ -0,0 +1,19 @@
+#include "frame.hpp"
+
+void unpackToRgb(const FrameView &frame, uint8_t *rgb, int size) {
+    const int pixels = std::min(size / 3, frame.width * frame.height);
+    for (int i{0}; i < pixels; i++) {
+        uint8_t value;
+        if (frame.format == PixelFormat::Gray4) {
+            const uint8_t packed = frame.data[i / 2];
+            value = static_cast<uint8_t>(((i & 1) ? (packed & 0x0F) : (packed >> 4)) * 0x11);
+        } else {
+            const int x = i % frame.width;
+            const int y = i / frame.width;
+            value = ((frame.data[x + (y / 8) * frame.width] >> (y % 8)) & 1) ? 0xFF : 0x00;
+        }
+        rgb[i * 3 + 0] = value;
+        rgb[i * 3 + 1] = value;
+        rgb[i * 3 + 2] = value;
+    }
+}
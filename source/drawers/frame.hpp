@@ -0,0 +1,66 @@
+#ifndef CONVENTION_NAMETAG_FRAME_HPP
+#define CONVENTION_NAMETAG_FRAME_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Memory layouts of the panels' display buffers
+ *
+ * Gray4: row-major, 2 pixels per byte, left pixel in the high nibble (SSD1322)
+ * Mono1Paged: 8 rows per page, a byte is a column of 8 pixels with the top pixel in bit 0 (SH1106, SSD1305)
+ */
+enum class PixelFormat { Gray4, Mono1Paged };
+
+struct Rect {
+    int x{};
+    int y{};
+    int width{};
+    int height{};
+
+    [[nodiscard]] bool Empty() const { return width <= 0 || height <= 0; }
+    [[nodiscard]] int Right() const { return x + width; }
+    [[nodiscard]] int Bottom() const { return y + height; }
+
+    [[nodiscard]] Rect Intersect(const Rect &other) const {
+        const int left = std::max(x, other.x);
+        const int top = std::max(y, other.y);
+        return {left, top, std::min(Right(), other.Right()) - left, std::min(Bottom(), other.Bottom()) - top};
+    }
+    [[nodiscard]] Rect Union(const Rect &other) const {
+        if (Empty()) {
+            return other;
+        }
+        if (other.Empty()) {
+            return *this;
+        }
+        const int left = std::min(x, other.x);
+        const int top = std::min(y, other.y);
+        return {left, top, std::max(Right(), other.Right()) - left, std::max(Bottom(), other.Bottom()) - top};
+    }
+    [[nodiscard]] bool Overlaps(const Rect &other) const { return not Intersect(other).Empty(); }
+
+    bool operator==(const Rect &other) const = default;
+};
+
+/**
+ * @brief Non-owning view of a packed panel framebuffer
+ */
+struct FrameView {
+    uint8_t *data;
+    int width;
+    int height;
+    PixelFormat format;
+
+    [[nodiscard]] Rect Bounds() const { return {0, 0, width, height}; }
+    [[nodiscard]] size_t Size() const {
+        return format == PixelFormat::Gray4 ? static_cast<size_t>(width * height / 2)
+                                            : static_cast<size_t>(width * height / 8);
+    }
+};
+
+// expands a packed frame to the rgb layout decoders hand to the drivers, at most size bytes
+void unpackToRgb(const FrameView &frame, uint8_t *rgb, int size);
+
+#endif // CONVENTION_NAMETAG_FRAME_HPP
@@ -0,0 +1,205 @@
+#include "glyphAtlas.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+// FreeType 26.6 fixed point to whole pixels
+int toPixels(FT_Pos value) { return static_cast<int>((value + 63) >> 6); }
+
+// per-nibble "is covered" mask, 0xF0/0x0F/0xFF/0x00 for any byte of two gray4 pixels
+constexpr std::array<uint8_t, 256> makeCoverageMasks() {
+    std::array<uint8_t, 256> masks{};
+    for (int i{0}; i < 256; i++) {
+        masks[i] = static_cast<uint8_t>(((i & 0xF0) ? 0xF0 : 0x00) | ((i & 0x0F) ? 0x0F : 0x00));
+    }
+    return masks;
+}
+constexpr auto CoverageMasks = makeCoverageMasks();
+
+// coverage scaled by intensity for both nibbles of a byte at once
+std::array<uint8_t, 256> makeIntensityTable(uint8_t intensity) {
+    std::array<uint8_t, 256> table{};
+    for (int i{0}; i < 256; i++) {
+        const int high = ((i >> 4) * intensity + 7) / 15;
+        const int low = ((i & 0x0F) * intensity + 7) / 15;
+        table[i] = static_cast<uint8_t>((high << 4) | low);
+    }
+    return table;
+}
+} // namespace
+
+GlyphAtlas::GlyphAtlas(const std::filesystem::path &font, int pixelSize, PixelFormat format, int capacity)
+    : _format{format} {
+    if (FT_Init_FreeType(&_library) != 0) {
+        throw std::runtime_error("failed to initialize freetype!");
+    }
+    if (FT_New_Face(_library, font.c_str(), 0, &_face) != 0) {
+        FT_Done_FreeType(_library);
+        throw std::runtime_error("failed to load font!");
+    }
+    FT_Set_Pixel_Sizes(_face, 0, static_cast<FT_UInt>(std::clamp(pixelSize, 4, 64)));
+
+    const auto &metrics = _face->size->metrics;
+    _ascender = toPixels(metrics.ascender);
+    _lineHeight = toPixels(metrics.height);
+
+    _cellWidth = toPixels(metrics.max_advance);
+    // mono glyph columns are 64 bit wide
+    _cellHeight = std::min(toPixels(metrics.ascender - metrics.descender), 64);
+    _cellSize = _format == PixelFormat::Gray4 ? static_cast<size_t>((_cellWidth + 1) / 2 * _cellHeight)
+                                              : static_cast<size_t>(_cellWidth) * sizeof(uint64_t);
+
+    _cells.resize(_cellSize * capacity);
+    for (int cell{capacity - 1}; cell >= 0; cell--) {
+        _freeCells.push_back(cell);
+    }
+}
+
+GlyphAtlas::~GlyphAtlas() {
+    FT_Done_Face(_face);
+    FT_Done_FreeType(_library);
+}
+
+const GlyphAtlas::Glyph *GlyphAtlas::Get(char32_t codepoint) {
+    if (auto it = _entries.find(codepoint); it != _entries.end()) {
+        _stats.hits++;
+        _usage.splice(_usage.begin(), _usage, it->second.usage);
+        return &it->second.glyph;
+    }
+    _stats.misses++;
+
+    const auto index = FT_Get_Char_Index(_face, codepoint);
+    if (index == 0) {
+        return nullptr;
+    }
+    // hinting for the target, mono panels get crisp 1 bit rasterization instead of thresholded gray
+    const auto target = _format == PixelFormat::Mono1Paged ? FT_LOAD_TARGET_MONO : FT_LOAD_TARGET_NORMAL;
+    if (FT_Load_Glyph(_face, index, FT_LOAD_RENDER | target) != 0) {
+        return nullptr;
+    }
+
+    if (_freeCells.empty()) {
+        const auto evicted = _usage.back();
+        _usage.pop_back();
+        _freeCells.push_back(_entries[evicted].cell);
+        _entries.erase(evicted);
+        _stats.evictions++;
+    }
+    const int cell = _freeCells.back();
+    _freeCells.pop_back();
+
+    const auto *slot = _face->glyph;
+    uint8_t *pixels = _cells.data() + static_cast<size_t>(cell) * _cellSize;
+    Rasterize(slot->bitmap, pixels);
+
+    _usage.push_front(codepoint);
+    Glyph glyph{slot->bitmap_left, slot->bitmap_top, std::min(static_cast<int>(slot->bitmap.width), _cellWidth),
+        std::min(static_cast<int>(slot->bitmap.rows), _cellHeight), toPixels(slot->advance.x), (_cellWidth + 1) / 2,
+        pixels};
+    return &_entries.emplace(codepoint, Entry{glyph, cell, _usage.begin()}).first->second.glyph;
+}
+
+void GlyphAtlas::Rasterize(const FT_Bitmap &bitmap, uint8_t *cell) const {
+    std::memset(cell, 0, _cellSize);
+
+    const int width = std::min(static_cast<int>(bitmap.width), _cellWidth);
+    const int height = std::min(static_cast<int>(bitmap.rows), _cellHeight);
+    const auto coverage = [&bitmap](int x, int y) -> uint8_t {
+        const auto *row = bitmap.buffer + y * bitmap.pitch;
+        if (bitmap.pixel_mode == FT_PIXEL_MODE_MONO) {
+            return ((row[x / 8] >> (7 - x % 8)) & 1) ? 0xFF : 0x00;
+        }
+        return row[x];
+    };
+
+    if (_format == PixelFormat::Gray4) {
+        const int stride = (_cellWidth + 1) / 2;
+        for (int y{0}; y < height; y++) {
+            for (int x{0}; x < width; x++) {
+                const uint8_t value = coverage(x, y) >> 4;
+                cell[y * stride + x / 2] |= (x % 2 == 0) ? static_cast<uint8_t>(value << 4) : value;
+            }
+        }
+    } else {
+        auto *columns = reinterpret_cast<uint64_t *>(cell);
+        for (int x{0}; x < width; x++) {
+            for (int y{0}; y < height; y++) {
+                if (coverage(x, y) > 0x7F) {
+                    columns[x] |= uint64_t{1} << y;
+                }
+            }
+        }
+    }
+}
+
+void GlyphAtlas::Blit(const FrameView &frame, const Glyph &glyph, int x, int y, uint8_t intensity) {
+    // clip against the frame once, the loops below don't check bounds
+    const int firstColumn = std::max(0, -x);
+    const int lastColumn = std::min(glyph.width, frame.width - x);
+    const int firstRow = std::max(0, -y);
+    const int lastRow = std::min(glyph.height, frame.height - y);
+    if (firstColumn >= lastColumn || firstRow >= lastRow || intensity == 0) {
+        return;
+    }
+
+    if (frame.format == PixelFormat::Gray4) {
+        // only rebuilt when the intensity changes, which in practice is never within a frame
+        static thread_local uint8_t tableIntensity{15};
+        static thread_local auto table = makeIntensityTable(15);
+        if (intensity != tableIntensity) {
+            table = makeIntensityTable(intensity);
+            tableIntensity = intensity;
+        }
+
+        const int frameStride = frame.width / 2;
+        for (int row{firstRow}; row < lastRow; row++) {
+            const uint8_t *src = glyph.pixels + row * glyph.stride;
+            uint8_t *dst = frame.data + (y + row) * frameStride;
+
+            if ((x & 1) == 0) {
+                // nibbles line up, two pixels per byte operation
+                for (int column{firstColumn}; column < lastColumn; column += 2) {
+                    const uint8_t value = table[src[column / 2]];
+                    uint8_t mask = CoverageMasks[value];
+                    if (column + 1 >= lastColumn) {
+                        mask &= 0xF0;
+                    }
+                    auto &out = dst[(x + column) / 2];
+                    out = static_cast<uint8_t>((out & ~mask) | (value & mask));
+                }
+            } else {
+                // odd destination column, every glyph pixel lands in the other nibble
+                for (int column{firstColumn}; column < lastColumn; column++) {
+                    const uint8_t packed = table[src[column / 2]];
+                    const uint8_t value = (column & 1) ? (packed & 0x0F) : (packed >> 4);
+                    if (value == 0) {
+                        continue;
+                    }
+                    auto &out = dst[(x + column) / 2];
+                    out = ((x + column) & 1) ? static_cast<uint8_t>((out & 0xF0) | value)
+                                             : static_cast<uint8_t>((out & 0x0F) | (value << 4));
+                }
+            }
+        }
+    } else {
+        const auto *columns = reinterpret_cast<const uint64_t *>(glyph.pixels);
+        // rows outside the frame were clipped above, shift what remains into place
+        const uint64_t rowMask = (lastRow >= 64 ? ~uint64_t{0} : (uint64_t{1} << lastRow) - 1) &
+                                 ~((uint64_t{1} << firstRow) - 1);
+        for (int column{firstColumn}; column < lastColumn; column++) {
+            const uint64_t bits = columns[column] & rowMask;
+            if (bits == 0) {
+                continue;
+            }
+            const uint64_t shifted = y >= 0 ? bits << y : bits >> -y;
+            for (int page{0}; page < frame.height / 8; page++) {
+                if (const auto byte = static_cast<uint8_t>(shifted >> (page * 8)); byte != 0) {
+                    frame.data[page * frame.width + x + column] |= byte;
+                }
+            }
+        }
+    }
+}
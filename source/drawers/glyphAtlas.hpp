@@ -0,0 +1,89 @@
+#ifndef CONVENTION_NAMETAG_GLYPHATLAS_HPP
+#define CONVENTION_NAMETAG_GLYPHATLAS_HPP
+
+#include "frame.hpp"
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include <filesystem>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Fixed-capacity cache of rasterized glyphs in the panel's pixel format
+ *
+ * Glyphs are rasterized by FreeType once and stored in equally sized cells of a single allocation, so the memory used
+ * never exceeds capacity * cell size. When full, the least recently used glyph is evicted.
+ *
+ * Cell layout per format:
+ *  Gray4: rows of (cellWidth + 1) / 2 bytes, 4 bit coverage, left pixel in the high nibble
+ *  Mono1Paged: one uint64_t per column, bit n is row n, so a column blits into pages with a shift
+ */
+class GlyphAtlas {
+  public:
+    GlyphAtlas(const std::filesystem::path &font, int pixelSize, PixelFormat format, int capacity = 128);
+    ~GlyphAtlas();
+
+    GlyphAtlas(const GlyphAtlas &) = delete;
+    GlyphAtlas &operator=(const GlyphAtlas &) = delete;
+
+    struct Glyph {
+        // offset of the bitmap from the pen position on the baseline
+        int left;
+        int top;
+        int width;
+        int height;
+        int advance;
+        // bytes per row, gray4 only
+        int stride;
+        const uint8_t *pixels;
+    };
+
+    // nullptr if the font has no such glyph
+    const Glyph *Get(char32_t codepoint);
+
+    // intensity 0-15, pixels of the glyph with zero coverage leave the frame untouched
+    static void Blit(const FrameView &frame, const Glyph &glyph, int x, int y, uint8_t intensity);
+
+    [[nodiscard]] int GetAscender() const { return _ascender; }
+    [[nodiscard]] int GetLineHeight() const { return _lineHeight; }
+    [[nodiscard]] size_t GetMemoryUsage() const { return _cells.size(); }
+
+    struct Stats {
+        int hits{};
+        int misses{};
+        int evictions{};
+    };
+    [[nodiscard]] const Stats &GetStats() const { return _stats; }
+
+  private:
+    void Rasterize(const FT_Bitmap &bitmap, uint8_t *cell) const;
+
+    FT_Library _library{};
+    FT_Face _face{};
+
+    PixelFormat _format;
+    int _ascender{};
+    int _lineHeight{};
+
+    int _cellWidth{};
+    int _cellHeight{};
+    size_t _cellSize{};
+    std::vector<uint8_t> _cells;
+
+    struct Entry {
+        Glyph glyph;
+        int cell;
+        std::list<char32_t>::iterator usage;
+    };
+    std::unordered_map<char32_t, Entry> _entries;
+    // most recently used first
+    std::list<char32_t> _usage;
+    std::vector<int> _freeCells;
+
+    Stats _stats;
+};
+
+#endif // CONVENTION_NAMETAG_GLYPHATLAS_HPP
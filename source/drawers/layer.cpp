@@ -0,0 +1,124 @@
+#include "layer.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+// animated text layers redraw at the panel's pace
+const auto AnimatedFrameInterval = std::chrono::microseconds(1000000 / 60);
+
+const std::pair<const char *, BlendMode> BlendModeNames[] = {
+    {"over", BlendMode::Over}, {"replace", BlendMode::Replace}, {"add", BlendMode::Add}, {"xor", BlendMode::Xor}};
+
+int paddedWidth(int width, PixelFormat format) { return format == PixelFormat::Gray4 ? (width + 1) & ~1 : width; }
+int paddedHeight(int height, PixelFormat format) {
+    return format == PixelFormat::Mono1Paged ? (height + 7) & ~7 : height;
+}
+
+void setPixel(const FrameView &frame, int x, int y, uint8_t value) {
+    if (frame.format == PixelFormat::Gray4) {
+        auto &out = frame.data[(y * frame.width + x) / 2];
+        out = (x & 1) ? static_cast<uint8_t>((out & 0xF0) | value) : static_cast<uint8_t>((out & 0x0F) | (value << 4));
+    } else if (value > 7) {
+        frame.data[x + (y / 8) * frame.width] |= static_cast<uint8_t>(1 << (y % 8));
+    }
+}
+} // namespace
+
+std::optional<BlendMode> parseBlendMode(std::string_view name) {
+    for (const auto &[candidate, mode] : BlendModeNames) {
+        if (name == candidate) {
+            return mode;
+        }
+    }
+    return std::nullopt;
+}
+
+const char *toString(BlendMode mode) {
+    for (const auto &[name, candidate] : BlendModeNames) {
+        if (mode == candidate) {
+            return name;
+        }
+    }
+    return "over";
+}
+
+Layer::Layer(int width, int height, PixelFormat format) : _surface{nullptr, 0, 0, format} { Resize(width, height); }
+
+void Layer::Resize(int width, int height) {
+    if (width < 0 || height < 0) {
+        throw std::runtime_error("negative layer size!");
+    }
+    _surface.width = paddedWidth(width, _surface.format);
+    _surface.height = paddedHeight(height, _surface.format);
+    _pixels.assign(_surface.Size(), 0);
+    _surface.data = _pixels.data();
+}
+
+SolidLayer::SolidLayer(int width, int height, PixelFormat format, uint8_t intensity) : Layer(width, height, format) {
+    const uint8_t value = std::min<uint8_t>(intensity, 15);
+    if (format == PixelFormat::Gray4) {
+        std::memset(_pixels.data(), value * 0x11, _pixels.size());
+    } else {
+        std::memset(_pixels.data(), value > 7 ? 0xFF : 0x00, _pixels.size());
+    }
+}
+
+Rect SolidLayer::Update(std::chrono::steady_clock::time_point) {
+    if (_drawn) {
+        return {};
+    }
+    _drawn = true;
+    return _surface.Bounds();
+}
+
+SpriteLayer::SpriteLayer(int width, int height, PixelFormat format, const std::vector<uint8_t> &values)
+    : Layer(width, height, format) {
+    if (values.size() != static_cast<size_t>(width) * height) {
+        throw std::runtime_error("sprite size does not match its pixels!");
+    }
+    for (int y{0}; y < height; y++) {
+        for (int x{0}; x < width; x++) {
+            setPixel(_surface, x, y, std::min<uint8_t>(values[y * width + x], 15));
+        }
+    }
+}
+
+Rect SpriteLayer::Update(std::chrono::steady_clock::time_point) {
+    if (_drawn) {
+        return {};
+    }
+    _drawn = true;
+    return _surface.Bounds();
+}
+
+TextLayer::TextLayer(const std::string &text, const TextStyle &style, const std::filesystem::path &font,
+    int pixelSize, int width, PixelFormat format)
+    : Layer(0, 0, format), _renderer{font, pixelSize, format}, _style{style} {
+    _renderer.SetText(text);
+
+    // the layer's placement positions the text, the wave swings around the middle of the layer
+    const int amplitude = _style.wavy ? std::abs(_style.waveAmplitude) : 0;
+    _style.x = 0;
+    _style.y = amplitude;
+    Resize(width > 0 ? width : _renderer.GetWidth(), _renderer.GetLineHeight() + 2 * amplitude);
+}
+
+Rect TextLayer::Update(std::chrono::steady_clock::time_point now) {
+    const bool animated = _style.wavy || _style.scrollSpeed != 0;
+    if (_startTime.has_value() && (not animated || now < _nextFrame)) {
+        return {};
+    }
+    if (not _startTime.has_value()) {
+        _startTime = now;
+        _nextFrame = now;
+    }
+    _nextFrame = std::max(_nextFrame + AnimatedFrameInterval, now);
+
+    std::memset(_pixels.data(), 0, _pixels.size());
+    _renderer.Render(_surface, _style, std::chrono::duration_cast<std::chrono::microseconds>(now - *_startTime));
+    return _surface.Bounds();
+}
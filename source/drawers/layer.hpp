@@ -0,0 +1,107 @@
+#ifndef CONVENTION_NAMETAG_LAYER_HPP
+#define CONVENTION_NAMETAG_LAYER_HPP
+
+#include "frame.hpp"
+#include "textRenderer.hpp"
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class BlendMode {
+    // layer pixels of 0 are transparent, the rest is mixed over what is below by opacity
+    Over,
+    // the whole layer rectangle is mixed over what is below by opacity, zeros included
+    Replace,
+    // saturating add of the layer scaled by opacity
+    Add,
+    Xor
+};
+
+[[nodiscard]] std::optional<BlendMode> parseBlendMode(std::string_view name);
+[[nodiscard]] const char *toString(BlendMode mode);
+
+struct LayerPlacement {
+    // top left on the screen, may be partly or fully outside
+    int x{};
+    int y{};
+    // 0-15, mono panels dither anything in between
+    uint8_t opacity{15};
+    BlendMode blend{BlendMode::Over};
+    bool visible{true};
+
+    bool operator==(const LayerPlacement &other) const = default;
+};
+
+/**
+ * @brief Content of one compositor layer, kept in a surface of the panel's format
+ *
+ * Surfaces are padded so they consist of whole bytes: even widths for Gray4, heights of whole pages for Mono1Paged.
+ * Update is only ever called from the render thread.
+ */
+class Layer {
+  public:
+    Layer(int width, int height, PixelFormat format);
+    virtual ~Layer() = default;
+
+    Layer(const Layer &) = delete;
+    Layer &operator=(const Layer &) = delete;
+
+    // redraws the surface if the content changed, returns the changed area in surface coordinates, empty if unchanged
+    virtual Rect Update(std::chrono::steady_clock::time_point now) = 0;
+
+    [[nodiscard]] virtual const char *GetType() const = 0;
+    [[nodiscard]] const FrameView &GetSurface() const { return _surface; }
+
+  protected:
+    // for layers that only know their size once their members exist
+    void Resize(int width, int height);
+
+    std::vector<uint8_t> _pixels;
+    FrameView _surface;
+};
+
+class SolidLayer : public Layer {
+  public:
+    // intensity 0-15
+    SolidLayer(int width, int height, PixelFormat format, uint8_t intensity);
+
+    Rect Update(std::chrono::steady_clock::time_point now) override;
+    [[nodiscard]] const char *GetType() const override { return "solid"; }
+
+  private:
+    bool _drawn{false};
+};
+
+class SpriteLayer : public Layer {
+  public:
+    // one 0-15 value per pixel, row-major
+    SpriteLayer(int width, int height, PixelFormat format, const std::vector<uint8_t> &values);
+
+    Rect Update(std::chrono::steady_clock::time_point now) override;
+    [[nodiscard]] const char *GetType() const override { return "sprite"; }
+
+  private:
+    bool _drawn{false};
+};
+
+class TextLayer : public Layer {
+  public:
+    // width 0 fits the layer to the text, the height always fits the line and the wave
+    TextLayer(const std::string &text, const TextStyle &style, const std::filesystem::path &font, int pixelSize,
+        int width, PixelFormat format);
+
+    Rect Update(std::chrono::steady_clock::time_point now) override;
+    [[nodiscard]] const char *GetType() const override { return "text"; }
+
+  private:
+    TextRenderer _renderer;
+    TextStyle _style;
+
+    std::optional<std::chrono::steady_clock::time_point> _startTime;
+    std::chrono::steady_clock::time_point _nextFrame;
+};
+
+#endif // CONVENTION_NAMETAG_LAYER_HPP
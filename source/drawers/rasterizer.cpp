@@ -0,0 +1,201 @@
+#include "rasterizer.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+namespace {
+const auto Half = Fixed::FromRaw(Fixed::One / 2);
+
+// x where the edge from -> to crosses row center y, slope precomputed per edge
+Fixed edgeX(Point from, Fixed slope, Fixed y) { return from.x + slope * (y - from.y); }
+} // namespace
+
+Rasterizer::Rasterizer(const FrameView &frame) : _frame{frame} {}
+
+void Rasterizer::Fill(uint8_t intensity) {
+    if (_frame.format == PixelFormat::Gray4) {
+        std::memset(_frame.data, (intensity & 0x0F) * 0x11, _frame.Size());
+    } else {
+        std::memset(_frame.data, intensity > 7 ? 0xFF : 0x00, _frame.Size());
+    }
+}
+
+void Rasterizer::Pixel(int x, int y, uint8_t intensity) { Span(y, x, x + 1, intensity); }
+
+void Rasterizer::Span(int y, int x0, int x1, uint8_t intensity) {
+    x0 = std::max(x0, 0);
+    x1 = std::min(x1, _frame.width);
+    if (y < 0 || y >= _frame.height || x0 >= x1) {
+        return;
+    }
+
+    if (_frame.format == PixelFormat::Gray4) {
+        const uint8_t value = intensity & 0x0F;
+        uint8_t *row = _frame.data + y * _frame.width / 2;
+        // odd ends are single nibbles, everything between is whole bytes
+        if (x0 & 1) {
+            row[x0 / 2] = static_cast<uint8_t>((row[x0 / 2] & 0xF0) | value);
+            x0++;
+        }
+        if (x1 & 1) {
+            row[x1 / 2] = static_cast<uint8_t>((row[x1 / 2] & 0x0F) | (value << 4));
+            x1--;
+        }
+        if (x0 < x1) {
+            std::memset(row + x0 / 2, value * 0x11, (x1 - x0) / 2);
+        }
+    } else {
+        const auto bit = static_cast<uint8_t>(1 << (y % 8));
+        uint8_t *page = _frame.data + (y / 8) * _frame.width;
+        if (intensity > 7) {
+            for (int x{x0}; x < x1; x++) {
+                page[x] |= bit;
+            }
+        } else {
+            for (int x{x0}; x < x1; x++) {
+                page[x] &= static_cast<uint8_t>(~bit);
+            }
+        }
+    }
+}
+
+void Rasterizer::Line(Point from, Point to, uint8_t intensity) {
+    // Liang-Barsky against the frame first, lines far off screen would otherwise be walked pixel by pixel
+    const Fixed dx = to.x - from.x;
+    const Fixed dy = to.y - from.y;
+    Fixed enter{};
+    Fixed leave = Fixed::FromInt(1);
+    const std::pair<Fixed, Fixed> boundaries[] = {{-dx, from.x}, {dx, Fixed::FromInt(_frame.width) - from.x},
+        {-dy, from.y}, {dy, Fixed::FromInt(_frame.height) - from.y}};
+    for (const auto &[direction, distance] : boundaries) {
+        if (direction.raw == 0) {
+            if (distance.raw < 0) {
+                return;
+            }
+            continue;
+        }
+        const Fixed t = distance / direction;
+        if (direction.raw < 0) {
+            if (t > leave) {
+                return;
+            }
+            enter = std::max(enter, t);
+        } else {
+            if (t < enter) {
+                return;
+            }
+            leave = std::min(leave, t);
+        }
+    }
+
+    // Bresenham between the pixels containing the clipped end points
+    int x0 = (from.x + dx * enter).Floor();
+    int y0 = (from.y + dy * enter).Floor();
+    const int x1 = (from.x + dx * leave).Floor();
+    const int y1 = (from.y + dy * leave).Floor();
+    const int stepX = x0 < x1 ? 1 : -1;
+    const int stepY = y0 < y1 ? 1 : -1;
+    const int distanceX = std::abs(x1 - x0);
+    const int distanceY = -std::abs(y1 - y0);
+    int error = distanceX + distanceY;
+    while (true) {
+        Pixel(x0, y0, intensity);
+        if (x0 == x1 && y0 == y1) {
+            break;
+        }
+        const int doubled = 2 * error;
+        if (doubled >= distanceY) {
+            error += distanceY;
+            x0 += stepX;
+        }
+        if (doubled <= distanceX) {
+            error += distanceX;
+            y0 += stepY;
+        }
+    }
+}
+
+void Rasterizer::Triangle(Point a, Point b, Point c, uint8_t intensity, bool filled) {
+    if (not filled) {
+        Line(a, b, intensity);
+        Line(b, c, intensity);
+        Line(c, a, intensity);
+        return;
+    }
+
+    if (a.y > b.y) {
+        std::swap(a, b);
+    }
+    if (b.y > c.y) {
+        std::swap(b, c);
+    }
+    if (a.y > b.y) {
+        std::swap(a, b);
+    }
+    if (c.y == a.y) {
+        return;
+    }
+
+    // flat edges get a saturated slope, but are never sampled: rows are only taken between their end points
+    const Fixed longSlope = (c.x - a.x) / (c.y - a.y);
+    const Fixed upperSlope = (b.x - a.x) / (b.y - a.y);
+    const Fixed lowerSlope = (c.x - b.x) / (c.y - b.y);
+
+    // rows whose centers lie within [a.y, c.y)
+    const int first = std::max(0, (a.y - Half).Ceil());
+    const int last = std::min(_frame.height, (c.y - Half).Ceil());
+    for (int y{first}; y < last; y++) {
+        const Fixed center = Fixed::FromInt(y) + Half;
+        const Fixed x0 = edgeX(a, longSlope, center);
+        const Fixed x1 = center < b.y ? edgeX(a, upperSlope, center) : edgeX(b, lowerSlope, center);
+        const auto [left, right] = std::minmax(x0, x1);
+        Span(y, (left - Half).Ceil(), (right - Half).Ceil(), intensity);
+    }
+}
+
+void Rasterizer::Circle(Point center, Fixed radius, uint8_t intensity, bool filled) {
+    if (radius.raw <= 0) {
+        return;
+    }
+
+    if (filled) {
+        // squares in Q32.32, the root of which is Q16.16 again
+        const int64_t radiusSquared = int64_t{radius.raw} * radius.raw;
+        const int first = std::max(0, (center.y - radius - Half).Ceil());
+        const int last = std::min(_frame.height, (center.y + radius - Half).Ceil());
+        for (int y{first}; y < last; y++) {
+            const int64_t dy = (Fixed::FromInt(y) + Half - center.y).raw;
+            const int64_t remaining = radiusSquared - dy * dy;
+            if (remaining <= 0) {
+                continue;
+            }
+            const auto halfWidth = Fixed::FromRaw(static_cast<int32_t>(isqrt(static_cast<uint64_t>(remaining))));
+            Span(y, (center.x - halfWidth - Half).Ceil(), (center.x + halfWidth - Half).Ceil(), intensity);
+        }
+        return;
+    }
+
+    // midpoint circle on whole pixels, one octant mirrored eight ways
+    const int cx = center.x.Floor();
+    const int cy = center.y.Floor();
+    int x = radius.Round();
+    int y{0};
+    int error = 1 - x;
+    while (x >= y) {
+        for (const auto &[px, py] : {std::pair{x, y}, std::pair{y, x}}) {
+            Pixel(cx + px, cy + py, intensity);
+            Pixel(cx - px, cy + py, intensity);
+            Pixel(cx + px, cy - py, intensity);
+            Pixel(cx - px, cy - py, intensity);
+        }
+        y++;
+        if (error < 0) {
+            error += 2 * y + 1;
+        } else {
+            x--;
+            error += 2 * (y - x) + 1;
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef CONVENTION_NAMETAG_RASTERIZER_HPP
+#define CONVENTION_NAMETAG_RASTERIZER_HPP
+
+#include "frame.hpp"
+#include "util/fixed.hpp"
+
+#include <cstdint>
+
+struct Point {
+    Fixed x;
+    Fixed y;
+};
+
+/**
+ * @brief Draws primitives straight into a packed frame
+ *
+ * Coordinates are Q16.16 pixels, pixel centers sit at +0.5. Intensities are 0-15, mono panels light anything above 7
+ * and clear the rest, so drawing with 0 paints black on every format.
+ */
+class Rasterizer {
+  public:
+    explicit Rasterizer(const FrameView &frame);
+
+    void Fill(uint8_t intensity);
+    void Pixel(int x, int y, uint8_t intensity);
+    // pixels [x0, x1) of row y, clipped
+    void Span(int y, int x0, int x1, uint8_t intensity);
+
+    void Line(Point from, Point to, uint8_t intensity);
+    void Triangle(Point a, Point b, Point c, uint8_t intensity, bool filled);
+    void Circle(Point center, Fixed radius, uint8_t intensity, bool filled);
+
+    [[nodiscard]] const FrameView &GetFrame() const { return _frame; }
+
+  private:
+    FrameView _frame;
+};
+
+#endif // CONVENTION_NAMETAG_RASTERIZER_HPP
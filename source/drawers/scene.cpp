@@ -0,0 +1,272 @@
+#include "scene.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+namespace {
+// uploads are small scenes, and coordinates times scales must stay far from the Q16.16 limit of 32768
+const auto MaxShapes = 128;
+const auto MaxKeyframes = 32;
+const auto MaxSpriteSize = 64;
+const auto MaxCoordinate = 2048.;
+const auto MaxScale = 8.;
+const auto MaxDuration = 3600.;
+
+Fixed readCoordinate(const nlohmann::json &json, const char *key, Fixed fallback) {
+    if (not json.contains(key)) {
+        return fallback;
+    }
+    return Fixed::FromDouble(std::clamp(json[key].get<double>(), -MaxCoordinate, MaxCoordinate));
+}
+
+// missing fields keep the value of the previous keyframe, or of the shape itself
+Transform readTransform(const nlohmann::json &json, const Transform &base) {
+    Transform transform;
+    transform.x = readCoordinate(json, "x", base.x);
+    transform.y = readCoordinate(json, "y", base.y);
+    transform.rotation =
+        json.contains("rotation") ? Fixed::FromDouble(std::fmod(json["rotation"].get<double>(), 3600.) / 360.)
+                                  : base.rotation;
+    transform.scale = json.contains("scale")
+                          ? Fixed::FromDouble(std::clamp(json["scale"].get<double>(), -MaxScale, MaxScale))
+                          : base.scale;
+    transform.intensity = static_cast<uint8_t>(std::clamp(json.value("intensity", int{base.intensity}), 0, 15));
+    return transform;
+}
+
+std::optional<Easing> parseEasing(const std::string &name) {
+    if (name == "linear") {
+        return Easing::Linear;
+    }
+    if (name == "in") {
+        return Easing::In;
+    }
+    if (name == "out") {
+        return Easing::Out;
+    }
+    if (name == "inOut") {
+        return Easing::InOut;
+    }
+    return std::nullopt;
+}
+
+Fixed ease(Easing easing, Fixed t) {
+    const auto one = Fixed::FromInt(1);
+    switch (easing) {
+    case Easing::In:
+        return t * t;
+    case Easing::Out:
+        return t * (Fixed::FromInt(2) - t);
+    case Easing::InOut:
+        // smoothstep
+        return t * t * (Fixed::FromInt(3) - Fixed::FromInt(2) * t);
+    case Easing::Linear:
+        break;
+    }
+    return std::clamp(t, Fixed{}, one);
+}
+
+std::optional<std::vector<Point>> readPoints(const nlohmann::json &json, size_t count) {
+    if (not json.is_array() || json.size() != count) {
+        return std::nullopt;
+    }
+    std::vector<Point> points;
+    for (const auto &point : json) {
+        if (not point.is_array() || point.size() != 2) {
+            return std::nullopt;
+        }
+        points.push_back({Fixed::FromDouble(std::clamp(point[0].get<double>(), -MaxCoordinate, MaxCoordinate)),
+            Fixed::FromDouble(std::clamp(point[1].get<double>(), -MaxCoordinate, MaxCoordinate))});
+    }
+    return points;
+}
+
+std::optional<Shape> readShape(const nlohmann::json &json) {
+    if (not json.is_object()) {
+        return std::nullopt;
+    }
+
+    Shape shape;
+    const auto type = json.value("type", std::string());
+    shape.filled = json.value("filled", true);
+    if (type == "line" || type == "triangle") {
+        shape.type = type == "line" ? Shape::Type::Line : Shape::Type::Triangle;
+        if (json.contains("points")) {
+            auto points = readPoints(json["points"], shape.type == Shape::Type::Line ? 2 : 3);
+            if (not points.has_value()) {
+                return std::nullopt;
+            }
+            shape.points = std::move(points.value());
+        } else if (shape.type == Shape::Type::Triangle) {
+            // equilateral, pointing up and centered on the position, like the triangles of the old web ui
+            const double size = std::clamp(json.value("size", 16.), 0., MaxCoordinate);
+            const double height = size * std::sqrt(3.) / 2.;
+            shape.points = {{Fixed{}, Fixed::FromDouble(-height * 2. / 3.)},
+                {Fixed::FromDouble(size / 2.), Fixed::FromDouble(height / 3.)},
+                {Fixed::FromDouble(-size / 2.), Fixed::FromDouble(height / 3.)}};
+        } else {
+            return std::nullopt;
+        }
+    } else if (type == "circle") {
+        shape.type = Shape::Type::Circle;
+        shape.radius = Fixed::FromDouble(std::clamp(json.value("radius", 8.), 0., MaxCoordinate));
+    } else if (type == "sprite") {
+        shape.type = Shape::Type::Sprite;
+        shape.width = json.value("width", 0);
+        shape.height = json.value("height", 0);
+        if (shape.width <= 0 || shape.height <= 0 || shape.width > MaxSpriteSize || shape.height > MaxSpriteSize ||
+            not json.contains("pixels") || not json["pixels"].is_array() ||
+            json["pixels"].size() != static_cast<size_t>(shape.width * shape.height)) {
+            return std::nullopt;
+        }
+        for (const auto &value : json["pixels"]) {
+            shape.pixels.push_back(static_cast<uint8_t>(std::clamp(value.get<int>(), 0, 15)));
+        }
+    } else {
+        return std::nullopt;
+    }
+
+    shape.transform = readTransform(json, {});
+    if (json.contains("keyframes")) {
+        const auto &keyframes = json["keyframes"];
+        if (not keyframes.is_array() || keyframes.size() > MaxKeyframes) {
+            return std::nullopt;
+        }
+        auto previous = shape.transform;
+        for (const auto &entry : keyframes) {
+            if (not entry.is_object()) {
+                return std::nullopt;
+            }
+            const auto easing = parseEasing(entry.value("easing", std::string("linear")));
+            if (not easing.has_value()) {
+                return std::nullopt;
+            }
+            ShapeKeyframe keyframe{Fixed::FromDouble(std::clamp(entry.value("time", 0.), 0., MaxDuration)),
+                readTransform(entry, previous), easing.value()};
+            previous = keyframe.transform;
+            shape.keyframes.push_back(keyframe);
+        }
+        std::stable_sort(shape.keyframes.begin(), shape.keyframes.end(),
+            [](const ShapeKeyframe &a, const ShapeKeyframe &b) { return a.time < b.time; });
+    }
+    return shape;
+}
+} // namespace
+
+Transform Shape::TransformAt(Fixed time) const {
+    if (keyframes.empty()) {
+        return transform;
+    }
+    const auto next = std::find_if(keyframes.begin(), keyframes.end(),
+        [time](const ShapeKeyframe &keyframe) { return keyframe.time > time; });
+    if (next == keyframes.begin()) {
+        return next->transform;
+    }
+    if (next == keyframes.end()) {
+        return keyframes.back().transform;
+    }
+
+    const auto &from = std::prev(next)->transform;
+    const auto &to = next->transform;
+    const Fixed t = ease(next->easing, (time - std::prev(next)->time) / (next->time - std::prev(next)->time));
+
+    Transform tweened;
+    tweened.x = lerp(from.x, to.x, t);
+    tweened.y = lerp(from.y, to.y, t);
+    tweened.rotation = lerp(from.rotation, to.rotation, t);
+    tweened.scale = lerp(from.scale, to.scale, t);
+    tweened.intensity = static_cast<uint8_t>(from.intensity + ((to.intensity - from.intensity) * t.raw >> 16));
+    return tweened;
+}
+
+std::optional<Scene> Scene::FromJson(const nlohmann::json &json) {
+    if (not json.is_object() || not json.contains("shapes") || not json["shapes"].is_array() ||
+        json["shapes"].size() > MaxShapes) {
+        return std::nullopt;
+    }
+
+    // wrongly typed values throw from get and value
+    try {
+        Scene scene;
+        scene.duration = Fixed::FromDouble(std::clamp(json.value("duration", 0.), 0., MaxDuration));
+        scene.loop = json.value("loop", true);
+        scene.background = static_cast<uint8_t>(std::clamp(json.value("background", 0), 0, 15));
+        for (const auto &entry : json["shapes"]) {
+            auto shape = readShape(entry);
+            if (not shape.has_value()) {
+                return std::nullopt;
+            }
+            scene.shapes.push_back(std::move(shape.value()));
+        }
+        return scene;
+    } catch (const nlohmann::json::exception &) {
+        return std::nullopt;
+    }
+}
+
+void Scene::Render(Rasterizer &rasterizer, Fixed time) const {
+    rasterizer.Fill(background);
+
+    for (const auto &shape : shapes) {
+        const auto transform = shape.TransformAt(time);
+
+        // rotation and scale folded into one matrix, applied to every point of the shape
+        const Fixed cosine = cosTurns(transform.rotation) * transform.scale;
+        const Fixed sine = sinTurns(transform.rotation) * transform.scale;
+        const auto apply = [&](Point point) -> Point {
+            return {transform.x + point.x * cosine - point.y * sine, transform.y + point.x * sine + point.y * cosine};
+        };
+
+        switch (shape.type) {
+        case Shape::Type::Line:
+            rasterizer.Line(apply(shape.points[0]), apply(shape.points[1]), transform.intensity);
+            break;
+        case Shape::Type::Triangle:
+            rasterizer.Triangle(apply(shape.points[0]), apply(shape.points[1]), apply(shape.points[2]),
+                transform.intensity, shape.filled);
+            break;
+        case Shape::Type::Circle:
+            rasterizer.Circle({transform.x, transform.y}, shape.radius * abs(transform.scale), transform.intensity,
+                shape.filled);
+            break;
+        case Shape::Type::Sprite: {
+            if (transform.scale.raw == 0) {
+                break;
+            }
+            // walk the screen box around the rotated sprite and map every pixel center back into the sprite
+            const Fixed halfWidth = Fixed::FromInt(shape.width) * Fixed::FromRaw(Fixed::One / 2);
+            const Fixed halfHeight = Fixed::FromInt(shape.height) * Fixed::FromRaw(Fixed::One / 2);
+            const Fixed reach = abs(transform.scale) * sqrt(halfWidth * halfWidth + halfHeight * halfHeight);
+            const auto &frame = rasterizer.GetFrame();
+            const int left = std::max(0, (transform.x - reach).Floor());
+            const int right = std::min(frame.width, (transform.x + reach).Ceil());
+            const int top = std::max(0, (transform.y - reach).Floor());
+            const int bottom = std::min(frame.height, (transform.y + reach).Ceil());
+
+            // inverse rotation divided by the scale, stepped per pixel instead of multiplied
+            const Fixed inverseScale = Fixed::FromInt(1) / transform.scale;
+            const Fixed stepU = cosTurns(transform.rotation) * inverseScale;
+            const Fixed stepV = -sinTurns(transform.rotation) * inverseScale;
+            const Fixed half = Fixed::FromRaw(Fixed::One / 2);
+            for (int y{top}; y < bottom; y++) {
+                const Fixed dx = Fixed::FromInt(left) + half - transform.x;
+                const Fixed dy = Fixed::FromInt(y) + half - transform.y;
+                Fixed u = dx * stepU - dy * stepV + halfWidth;
+                Fixed v = dx * stepV + dy * stepU + halfHeight;
+                for (int x{left}; x < right; x++, u += stepU, v += stepV) {
+                    const int column = u.Floor();
+                    const int row = v.Floor();
+                    if (column < 0 || row < 0 || column >= shape.width || row >= shape.height) {
+                        continue;
+                    }
+                    if (const uint8_t value = shape.pixels[row * shape.width + column]; value != 0) {
+                        rasterizer.Pixel(x, y, static_cast<uint8_t>((value * transform.intensity + 7) / 15));
+                    }
+                }
+            }
+            break;
+        }
+        }
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef CONVENTION_NAMETAG_SCENE_HPP
+#define CONVENTION_NAMETAG_SCENE_HPP
+
+#include "rasterizer.hpp"
+#include "util/fixed.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <optional>
+#include <vector>
+
+enum class Easing { Linear, In, Out, InOut };
+
+struct Transform {
+    Fixed x;
+    Fixed y;
+    // in turns, 1 is a full rotation
+    Fixed rotation;
+    Fixed scale{Fixed::FromInt(1)};
+    // 0-15
+    uint8_t intensity{15};
+};
+
+struct ShapeKeyframe {
+    // seconds from the start of the loop
+    Fixed time;
+    Transform transform;
+    // how the tween from the previous keyframe arrives at this one
+    Easing easing{Easing::Linear};
+};
+
+struct Shape {
+    enum class Type { Line, Triangle, Circle, Sprite };
+    Type type{Type::Triangle};
+
+    // 2 for lines, 3 for triangles, relative to the shape's position and before rotation and scale
+    std::vector<Point> points;
+    Fixed radius;
+    bool filled{true};
+
+    // sprites are centered on the position, one 0-15 value per pixel, 0 is transparent
+    int width{};
+    int height{};
+    std::vector<uint8_t> pixels;
+
+    Transform transform;
+    // sorted by time, the transform above applies if there are none
+    std::vector<ShapeKeyframe> keyframes;
+
+    [[nodiscard]] Transform TransformAt(Fixed time) const;
+};
+
+/**
+ * @brief Procedural animation of vector shapes and sprites, uploaded as a small JSON document
+ *
+ * {"duration": 4, "loop": true, "background": 0, "shapes": [{"type": "triangle", "x": 128, "y": 32, "size": 24,
+ *   "keyframes": [{"time": 0, "rotation": 0}, {"time": 4, "rotation": 360, "easing": "inOut"}]}]}
+ *
+ * Shape types are line and triangle ("points"), circle ("radius") and sprite ("width", "height", "pixels"); all take
+ * x, y, rotation (degrees), scale, intensity and keyframes of those. Coordinates are pixels.
+ */
+struct Scene {
+    // seconds per loop, zero for a still image
+    Fixed duration;
+    bool loop{true};
+    uint8_t background{};
+    std::vector<Shape> shapes;
+
+    // nullopt if the document is malformed or exceeds the limits
+    static std::optional<Scene> FromJson(const nlohmann::json &json);
+
+    // time in seconds, already wrapped into the loop
+    void Render(Rasterizer &rasterizer, Fixed time) const;
+};
+
+#endif // CONVENTION_NAMETAG_SCENE_HPP
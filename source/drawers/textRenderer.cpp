@@ -0,0 +1,107 @@
+#include "textRenderer.hpp"
+
+#include <array>
+#include <cmath>
+#include <numbers>
+
+namespace {
+// one period of sin scaled to +-127, wave offsets are a lookup instead of a libm call per glyph
+std::array<int8_t, 64> makeSineTable() {
+    std::array<int8_t, 64> table{};
+    for (size_t i{0}; i < table.size(); i++) {
+        table[i] = static_cast<int8_t>(std::lround(127. * std::sin(2. * std::numbers::pi * i / table.size())));
+    }
+    return table;
+}
+const auto SineTable = makeSineTable();
+
+// phase distance between neighbouring glyphs, in table steps
+const auto WaveSpread = 6;
+
+std::u32string decodeUtf8(std::string_view utf8) {
+    std::u32string result;
+    for (size_t i{0}; i < utf8.size();) {
+        const auto lead = static_cast<uint8_t>(utf8[i]);
+        const int length = lead < 0x80            ? 1
+                           : (lead >> 5) == 0x06 ? 2
+                           : (lead >> 4) == 0x0E ? 3
+                           : (lead >> 3) == 0x1E ? 4
+                                                 : 0;
+        if (length == 0 || i + length > utf8.size()) {
+            // broken sequence, skip the byte
+            result.push_back(U'�');
+            i++;
+            continue;
+        }
+
+        char32_t codepoint = length == 1 ? lead : lead & (0x7F >> length);
+        for (int j{1}; j < length; j++) {
+            codepoint = (codepoint << 6) | (static_cast<uint8_t>(utf8[i + j]) & 0x3F);
+        }
+        result.push_back(codepoint);
+        i += length;
+    }
+    return result;
+}
+} // namespace
+
+TextRenderer::TextRenderer(const std::filesystem::path &font, int pixelSize, PixelFormat format)
+    : _atlas{font, pixelSize, format} {}
+
+void TextRenderer::SetText(std::string_view utf8) {
+    _text = decodeUtf8(utf8);
+    _width = 0;
+    for (const auto codepoint : _text) {
+        if (const auto *glyph = _atlas.Get(codepoint); glyph != nullptr) {
+            _width += glyph->advance;
+        }
+    }
+}
+
+void TextRenderer::Render(const FrameView &frame, const TextStyle &style, std::chrono::microseconds elapsed) {
+    // one wave period per second
+    const int wavePhase = style.wavy ? static_cast<int>(elapsed.count() * SineTable.size() / 1000000) : 0;
+
+    if (style.scrollSpeed == 0) {
+        RenderLine(frame, style, style.x, wavePhase);
+        return;
+    }
+
+    // marquee: the line followed by a gap, repeated for as long as it covers the frame
+    const int period = _width + frame.width / 4;
+    if (period <= 0) {
+        // no text and a frame too narrow for a gap, nothing to draw
+        return;
+    }
+    const auto travelled = elapsed.count() * style.scrollSpeed / 1000000;
+    // negative speeds scroll to the right
+    const auto shift = static_cast<int>((travelled % period + period) % period);
+    int x = style.x - shift;
+    while (x > 0) {
+        x -= period;
+    }
+    for (; x < frame.width; x += period) {
+        RenderLine(frame, style, x, wavePhase);
+    }
+}
+
+void TextRenderer::RenderLine(const FrameView &frame, const TextStyle &style, int x, int wavePhase) {
+    const int baseline = style.y + _atlas.GetAscender();
+
+    for (size_t i{0}; i < _text.size() && x < frame.width; i++) {
+        const auto *glyph = _atlas.Get(_text[i]);
+        if (glyph == nullptr) {
+            continue;
+        }
+
+        int offset{0};
+        if (style.wavy) {
+            const auto step = static_cast<size_t>(wavePhase + static_cast<int>(i) * WaveSpread) % SineTable.size();
+            offset = style.waveAmplitude * SineTable[step] / 127;
+        }
+        if (x + glyph->advance > 0) {
+            GlyphAtlas::Blit(frame, *glyph, x + glyph->left, baseline - glyph->top + offset, style.intensity);
+        }
+        x += glyph->advance;
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef CONVENTION_NAMETAG_TEXTRENDERER_HPP
+#define CONVENTION_NAMETAG_TEXTRENDERER_HPP
+
+#include "frame.hpp"
+#include "glyphAtlas.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+struct TextStyle {
+    // top left of the text line
+    int x{};
+    int y{};
+    // 0-15, mono panels show anything above 0
+    uint8_t intensity{15};
+    // marquee speed in pixels per second, 0 keeps the text in place
+    int scrollSpeed{};
+    bool wavy{false};
+    int waveAmplitude{3};
+};
+
+/**
+ * @brief Lays out a line of text by blitting glyphs from a GlyphAtlas
+ */
+class TextRenderer {
+  public:
+    TextRenderer(const std::filesystem::path &font, int pixelSize, PixelFormat format);
+
+    void SetText(std::string_view utf8);
+    // draws over the frame's contents, elapsed drives scrolling and the wave
+    void Render(const FrameView &frame, const TextStyle &style, std::chrono::microseconds elapsed);
+
+    [[nodiscard]] int GetWidth() const { return _width; }
+    [[nodiscard]] int GetLineHeight() const { return _atlas.GetLineHeight(); }
+    [[nodiscard]] const GlyphAtlas &GetAtlas() const { return _atlas; }
+
+  private:
+    void RenderLine(const FrameView &frame, const TextStyle &style, int x, int wavePhase);
+
+    GlyphAtlas _atlas;
+    std::u32string _text;
+    int _width{};
+};
+
+#endif // CONVENTION_NAMETAG_TEXTRENDERER_HPP
@@ -1,14 +1,40 @@
+#include "bench.hpp"
 #include "driver.hpp"
+#include "gpioKeys.hpp"
+#include "simulatedPanel.hpp"
+#include "drawers/compositor.hpp"
+#include "net/peerSync.hpp"
 #include "net/server.hpp"
+#include "util/configuration.hpp"
+#include "util/deadlineMonitor.hpp"
+#include "util/governor.hpp"
+#include "util/perfCounters.hpp"
+#include "util/realtime.hpp"
+#include "util/trace.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <ctime>
+#include <future>
+#include <string_view>
 #include <thread>
 
 #include <csignal>
+#include <video/mediaIndex.hpp>
+#include <video/playerLayer.hpp>
+#include <video/resumeState.hpp>
 #include <video/videoPlayer.hpp>
 
 static bool run{true};
 
+// the keys of the SH1106 HAT, in the order GpioKeys numbers them
+static constexpr std::array KeyPins{Wrappers::SH1106::Pins::KeyUpPin, Wrappers::SH1106::Pins::KeyDownPin,
+    Wrappers::SH1106::Pins::KeyLeftPin, Wrappers::SH1106::Pins::KeyRightPin, Wrappers::SH1106::Pins::KeyPressPin,
+    Wrappers::SH1106::Pins::Key1Pin, Wrappers::SH1106::Pins::Key2Pin, Wrappers::SH1106::Pins::Key3Pin};
+static const auto processStart = std::chrono::steady_clock::now();
+
 void signalHandler(int dummy) {
     if (not run) {
         std::exit(-1);
@@ -17,72 +43,248 @@ void signalHandler(int dummy) {
     printf("Quitting\n");
 }
 
-int main(int argc, char **argv) {
-    signal(SIGINT, signalHandler);
-    signal(SIGTERM, signalHandler);
-
-    Wrappers::SSD1322 driver;
+// CLOCK_BOOTTIME counts from the kernel's start, which is power-on give or take the bootloader
+void reportBoot(const char *what) {
+    timespec boot{};
+    clock_gettime(CLOCK_BOOTTIME, &boot);
+    const auto sinceStart =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - processStart);
+    printf("Boot to %s: %lldms since power-on, %lldms since start\n", what,
+        static_cast<long long>(boot.tv_sec) * 1000 + boot.tv_nsec / 1000000,
+        static_cast<long long>(sinceStart.count()));
+}
 
-    // rgb buffer
-    uint8_t glBuffer[HardwareSpecs::SSD1322::Size * 3];
+// the HAT's joystick and keys: left and right step through the playlist, the middle pauses and resets the brightness
+// when held, up and down change the brightness and repeat; keys 1 to 3 pause, go back and go on
+Wrappers::GpioKeys::Handler keyActions(VideoPlayer &player, std::atomic<int> &contrast) {
+    using Pins = Wrappers::SH1106::Pins;
+    using Event = Wrappers::GpioKeys::Event;
+    const auto step = 0x20;
+    return [&player, &contrast, level = 0xFF, step](int key, Event event) mutable {
+        const auto setLevel = [&](int value) {
+            level = std::clamp(value, 0x0F, 0xFF);
+            contrast.store(level, std::memory_order_relaxed);
+        };
+        const auto pin = KeyPins[key];
+        if (event == Event::LongPress && pin == Pins::KeyPressPin) {
+            setLevel(0xFF);
+        } else if (event == Event::Press || event == Event::Repeat) {
+            if (pin == Pins::KeyUpPin) {
+                setLevel(level + step);
+            } else if (pin == Pins::KeyDownPin) {
+                setLevel(level - step);
+            }
+        }
+        if (event != Event::Press) {
+            return;
+        }
+        if (pin == Pins::KeyLeftPin || pin == Pins::Key2Pin) {
+            player.Previous();
+        } else if (pin == Pins::KeyRightPin || pin == Pins::Key3Pin) {
+            player.Next();
+        } else if (pin == Pins::KeyPressPin || pin == Pins::Key1Pin) {
+            player.TogglePause();
+        }
+    };
+}
 
+// runs until a signal arrives, then prints where the time went
+template <class Panel>
+void render(Panel &driver, Compositor &compositor, PreviewRing &preview, VideoPlayer &player,
+    DeadlineMonitor &deadlines, Governor &governor, ResumeState &resume, std::atomic<int> &contrast) {
     int frameCount{};
 
-    // AnimationController animation(driver.GetWidth(), driver.GetHeight());
-
     auto current = std::chrono::steady_clock::now();
     auto prev = std::chrono::steady_clock::now();
 
     long long int totalFrameTimes{};
 
-    decltype(current) sectionTimes[4];
-    long long int sectionDeltas[3]{0, 0, 0};
-
-    VideoPlayer player(HardwareSpecs::SSD1322::Width, HardwareSpecs::SSD1322::Height);
-
-    WebServer server;
-    std::thread serverThread([&server, &player]() { server.run(player); });
+    decltype(current) sectionTimes[3];
+    long long int sectionDeltas[2]{0, 0};
 
     while (run) {
-        // animation.ProcessRequests();
+        // brightness from the keys, between frames since the panel is only ever written to from this thread
+        if (const int level = contrast.exchange(-1, std::memory_order_relaxed); level >= 0) {
+            driver.SetContrast(static_cast<uint8_t>(level));
+        }
 
         sectionTimes[0] = std::chrono::steady_clock::now();
 
-        // section 1: video decode
-        player.FetchFrame(glBuffer, sizeof(glBuffer));
+        // section 1: video decode and composition, only what changed is redrawn into the driver buffer
+        const auto &dirty = compositor.Compose(driver.GetFrame(), sectionTimes[0]);
+        if (not dirty.empty()) {
+            preview.Publish(driver.GetFrame());
+        }
 
         sectionTimes[1] = std::chrono::steady_clock::now();
 
-        // section 2: output buffer conversion and transfer
-        // expected to be constant
-        driver.CopyFramebuffer(glBuffer);
+        // section 2: transfer, a single full write once most of the panel changed
+        int dirtyPixels{};
+        for (const auto &area : dirty) {
+            dirtyPixels += area.width * area.height;
+        }
+        if (dirtyPixels * 2 > driver.GetWidth() * driver.GetHeight()) {
+            Trace::Stage stage{"render", "transfer", driver.GetWidth() * driver.GetHeight()};
+            driver.Display();
+        } else if (not dirty.empty()) {
+            Trace::Stage stage{"render", "transfer", dirtyPixels};
+            for (const auto &area : dirty) {
+                driver.DisplayRegion(area);
+            }
+        }
 
         sectionTimes[2] = std::chrono::steady_clock::now();
 
-        // section 3: clear buffer, wipe screen
-        driver.Display();
-        driver.Clear();
-
-        sectionTimes[3] = std::chrono::steady_clock::now();
+        if (frameCount == 0) {
+            reportBoot("first frame");
+        }
+        resume.OfferFrame(driver.GetFrame());
 
         current = std::chrono::steady_clock::now();
 
         totalFrameTimes += std::chrono::duration_cast<std::chrono::milliseconds>(current - prev).count();
-        for (int i = 0; i < 3; i++) {
+        for (int i = 0; i < 2; i++) {
             auto timeDifference{
                 std::chrono::duration_cast<std::chrono::microseconds>(sectionTimes[i + 1] - sectionTimes[i]).count()};
             sectionDeltas[i] += timeDifference;
         }
+        // the governor holds the loop back below the content's rate when it can, deadlines follow what it asked for
+        governor.Pace(sectionTimes[0], player.GetFrameInterval(), not dirty.empty());
+        deadlines.FrameDone(current, governor.GetInterval());
         frameCount++;
         std::swap(current, prev);
     }
 
-    server.halt();
-    serverThread.join();
-
     printf("Avarage timing:\n");
     printf("Total time:           %07.3lfms\n", static_cast<double>(totalFrameTimes) / frameCount);
-    printf("Section 1 (gl)  :   %09.3lfµs\n", static_cast<double>(sectionDeltas[0]) / frameCount);
-    printf("Section 2 (copy):   %09.3lfµs\n", static_cast<double>(sectionDeltas[1]) / frameCount);
-    printf("Section 3 (cls) :   %09.3lfµs\n", static_cast<double>(sectionDeltas[2]) / frameCount);
+    printf("Section 1 (comp):   %09.3lfµs\n", static_cast<double>(sectionDeltas[0]) / frameCount);
+    printf("Section 2 (disp):   %09.3lfµs\n", static_cast<double>(sectionDeltas[1]) / frameCount);
+
+    const auto stats = compositor.GetStats();
+    printf("Composed pixels:    %09.1lf per frame (%lld of %lld frames idle)\n",
+        static_cast<double>(stats.composedPixels) / frameCount, stats.idleFrames, stats.frames);
+
+    const auto misses = deadlines.GetStats();
+    printf("Deadline misses:    %lld of %lld frames\n", misses.misses, misses.frames);
+
+    // with perf.enabled; the stages overlap, compose holds the decoder's
+    const auto stages = Perf::Collect();
+    if (not stages.empty()) {
+        const auto status = Perf::GetStatus();
+        printf("Counters:           %s\n", status.available ? (status.userOnly ? "user space only" : "available")
+                                                              : status.reason.c_str());
+    }
+    for (const auto &stage : stages) {
+        printf("  %-18s%09.3lfµs average, %s\n", stage.name,
+            static_cast<double>(stage.time.count()) / 1000. / static_cast<double>(std::max(stage.count, 1LL)),
+            Perf::Summary(stage).c_str());
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && std::string_view(argv[1]) == "--bench") {
+        return runBench(argc, argv);
+    }
+
+    signal(SIGINT, signalHandler);
+    signal(SIGTERM, signalHandler);
+
+    // --simulate renders without a panel attached, for development and load tests on any machine
+    const bool simulate = argc > 1 && std::string_view(argv[1]) == "--simulate";
+
+    const auto configuration = Configuration::Load("configuration.toml");
+    Trace::Configure(configuration.trace.enabled, static_cast<size_t>(configuration.trace.eventsPerThread));
+    Perf::Configure(configuration.perf.enabled);
+
+    // before any thread is started, they all inherit it
+    Realtime::Schedule schedule;
+    Realtime::DemoteBackground(configuration.realtime, schedule);
+
+    // resetting and setting up the panel takes most of a second, the rest starts up meanwhile
+    using SimulatedPanel = Wrappers::SimulatedPanel<HardwareSpecs::SSD1322>;
+    std::future<std::unique_ptr<SimulatedPanel>> simulatedPanel;
+    std::future<std::unique_ptr<Wrappers::SSD1322>> panel;
+    if (simulate) {
+        simulatedPanel = std::async(std::launch::async, []() { return std::make_unique<SimulatedPanel>(); });
+    } else {
+        panel = std::async(std::launch::async, []() { return std::make_unique<Wrappers::SSD1322>(); });
+    }
+
+    VideoPlayer player(HardwareSpecs::SSD1322::Width, HardwareSpecs::SSD1322::Height, HardwareSpecs::SSD1322::Format);
+
+    // the video at the bottom, overlays are stacked on top through the web server
+    Compositor compositor(
+        HardwareSpecs::SSD1322::Width, HardwareSpecs::SSD1322::Height, HardwareSpecs::SSD1322::Format);
+    compositor.Add(std::make_shared<PlayerLayer>(player, Wrappers::SSD1322::ConvertFramebuffer),
+        {0, 0, 15, BlendMode::Replace});
+
+    MediaIndex index("videos");
+    index.Start();
+
+    // what played before the restart, its decoder is opened while the panel starts
+    ResumeState resume(index.GetMetadataFolder());
+    const bool resumed = resume.Restore(player, index.GetFolder());
+    resume.Start(player);
+
+    // what the panel shows, for viewers of the web preview
+    PreviewRing preview(
+        HardwareSpecs::SSD1322::Width, HardwareSpecs::SSD1322::Height, HardwareSpecs::SSD1322::Format);
+
+    // frames without a rate of their own are due as often as animations run
+    DeadlineMonitor deadlines(std::chrono::microseconds(1000000 / configuration.animation.frameRate));
+
+    Governor governor(configuration.power);
+    governor.Start();
+
+    // in lockstep with other badges, if configured
+    PeerSync sync(configuration.sync, player, index.GetFolder());
+    sync.Start();
+
+    WebServer server(player, index, compositor, preview, deadlines, governor, sync, configuration);
+    std::thread serverThread([&server]() {
+        Trace::SetThreadName("server");
+        server.run();
+    });
+
+    // contrast for the panel to be set to by the render thread, -1 while unchanged
+    std::atomic<int> contrast{-1};
+    Wrappers::GpioKeys keys(configuration.keys, {KeyPins.begin(), KeyPins.end()}, keyActions(player, contrast));
+    if (configuration.keys.enabled) {
+        keys.Start();
+    }
+
+    // this thread renders from here on
+    Realtime::EnterRenderThread(configuration.realtime, schedule);
+    deadlines.SetSchedule(schedule);
+    Trace::SetThreadName("render");
+
+    // the frame saved with what was resumed goes up as soon as the panel is ready, until the decoder catches up
+    const auto start = [&](auto &driver) {
+        if (resumed && resume.LoadFrame(driver.GetFrame())) {
+            driver.Display();
+            reportBoot("cached frame");
+        }
+        render(driver, compositor, preview, player, deadlines, governor, resume, contrast);
+    };
+    if (simulate) {
+        const auto driver = simulatedPanel.get();
+        start(*driver);
+    } else {
+        const auto driver = panel.get();
+        start(*driver);
+    }
+
+    keys.Stop();
+    if (const auto stats = keys.GetStats(); stats.handled > 0) {
+        printf("Key latency:        %07.3lfms average, %07.3lfms max (%lld presses and releases, %lld bounces)\n",
+            static_cast<double>(stats.totalLatency.count()) / 1000. / static_cast<double>(stats.handled),
+            static_cast<double>(stats.maxLatency.count()) / 1000., stats.handled, stats.bounces);
+    }
+
+    server.halt();
+    serverThread.join();
+    resume.Stop();
+    sync.Stop();
+    governor.Stop();
+    index.Stop();
 }
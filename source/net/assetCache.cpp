@@ -0,0 +1,305 @@
+#include "assetCache.hpp"
+
+#include "util/hash.hpp"
+
+#include <brotli/encode.h>
+#include <sys/inotify.h>
+#include <zlib.h>
+
+#include <array>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace {
+// larger files are still served, but read for every request instead of being kept
+const uintmax_t MaxAssetSize = 8 * 1024 * 1024;
+const long long MaxCacheSize = 48 * 1024 * 1024;
+// below this the headers outweigh what compression saves
+const size_t MinCompressSize = 256;
+
+struct ContentType {
+    std::string_view extension;
+    std::string_view type;
+    bool compressible;
+};
+const std::array<ContentType, 15> ContentTypes{{
+    {".html", "text/html; charset=utf-8", true},
+    {".js", "application/javascript", true},
+    {".mjs", "application/javascript", true},
+    {".css", "text/css", true},
+    {".json", "application/json", true},
+    {".map", "application/json", true},
+    {".svg", "image/svg+xml", true},
+    {".txt", "text/plain; charset=utf-8", true},
+    {".ico", "image/x-icon", true},
+    {".png", "image/png", false},
+    {".jpg", "image/jpeg", false},
+    {".jpeg", "image/jpeg", false},
+    {".webp", "image/webp", false},
+    {".woff", "font/woff", false},
+    {".woff2", "font/woff2", false},
+}};
+const ContentType Binary{"", "application/octet-stream", false};
+
+const ContentType &contentType(const fs::path &path) {
+    const auto extension = path.extension().string();
+    for (const auto &type : ContentTypes) {
+        if (type.extension == extension) {
+            return type;
+        }
+    }
+    return Binary;
+}
+
+std::string gzipCompress(std::string_view data) {
+    z_stream stream{};
+    // 16 on top of the window bits asks for a gzip header instead of a zlib one
+    if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return {};
+    }
+    std::string compressed(deflateBound(&stream, data.size()), '\0');
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = reinterpret_cast<Bytef *>(compressed.data());
+    stream.avail_out = static_cast<uInt>(compressed.size());
+    const bool done = deflate(&stream, Z_FINISH) == Z_STREAM_END;
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+    return done ? compressed : std::string();
+}
+
+std::string brotliCompress(std::string_view data) {
+    size_t size = BrotliEncoderMaxCompressedSize(data.size());
+    if (size == 0) {
+        return {};
+    }
+    std::string compressed(size, '\0');
+    // the highest quality is slow, but paid once per file off the server thread
+    if (not BrotliEncoderCompress(BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, data.size(),
+            reinterpret_cast<const uint8_t *>(data.data()), &size, reinterpret_cast<uint8_t *>(compressed.data()))) {
+        return {};
+    }
+    compressed.resize(size);
+    return compressed;
+}
+
+// whether the Accept-Encoding header lists the coding without ruling it out through q=0
+bool accepts(std::string_view header, std::string_view coding) {
+    while (not header.empty()) {
+        const auto comma = header.find(',');
+        auto entry = header.substr(0, comma);
+        header = comma == std::string_view::npos ? std::string_view() : header.substr(comma + 1);
+
+        const auto semicolon = entry.find(';');
+        auto name = entry.substr(0, semicolon);
+        while (not name.empty() && name.front() == ' ') {
+            name.remove_prefix(1);
+        }
+        while (not name.empty() && name.back() == ' ') {
+            name.remove_suffix(1);
+        }
+        if (name != coding) {
+            continue;
+        }
+        if (semicolon == std::string_view::npos) {
+            return true;
+        }
+        const auto q = entry.find("q=", semicolon);
+        return q == std::string_view::npos || std::strtod(std::string(entry.substr(q + 2)).c_str(), nullptr) > 0.;
+    }
+    return false;
+}
+
+std::string variantETag(const std::string &etag, std::string_view suffix) {
+    return etag.substr(0, etag.size() - 1) + std::string(suffix) + "\"";
+}
+
+long long footprint(const Asset &asset) {
+    return static_cast<long long>(asset.identity.body.size() + asset.gzip.body.size() + asset.brotli.body.size());
+}
+} // namespace
+
+const Asset::Variant &Asset::Select(std::string_view acceptEncoding) const {
+    if (not brotli.body.empty() && accepts(acceptEncoding, "br")) {
+        return brotli;
+    }
+    if (not gzip.body.empty() && accepts(acceptEncoding, "gzip")) {
+        return gzip;
+    }
+    return identity;
+}
+
+AssetCache::AssetCache(fs::path root, std::string immutablePrefix)
+    : _root{std::move(root)}, _immutablePrefix{std::move(immutablePrefix)} {}
+
+AssetCache::~AssetCache() { Stop(); }
+
+void AssetCache::Start() {
+    if (fs::is_directory(_root)) {
+        WatchTree(_root);
+    } else {
+        std::cerr << "Asset folder " << _root << " does not exist, files will be read on demand" << std::endl;
+    }
+    _watcher.Post([this]() { Reconcile(); });
+    _watcher.Start();
+}
+
+void AssetCache::Stop() { _watcher.Stop(); }
+
+std::shared_ptr<const Asset> AssetCache::Get(std::string_view name) {
+    const auto relative = fs::path(name).lexically_normal();
+    if (relative.empty() || relative.is_absolute() || *relative.begin() == "..") {
+        return nullptr;
+    }
+    const auto key = relative.generic_string();
+    {
+        auto lock = std::lock_guard<std::mutex>(_access);
+        if (auto it = _assets.find(key); it != _assets.end()) {
+            _hits++;
+            return it->second;
+        }
+    }
+
+    _misses++;
+    const auto path = _root / relative;
+    std::error_code error;
+    if (not fs::is_regular_file(path, error)) {
+        return nullptr;
+    }
+    std::shared_ptr<const Asset> asset = Load(path, false);
+    if (asset && Store(key, asset)) {
+        // served as is this time, the compressed variants follow from the watcher thread
+        _watcher.Post([this, path, key]() {
+            if (auto compressed = Load(path, true)) {
+                Store(key, std::move(compressed));
+            }
+        });
+    }
+    return asset;
+}
+
+AssetCache::Stats AssetCache::GetStats() const {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    return {static_cast<int>(_assets.size()), _bytes, _hits, _misses};
+}
+
+void AssetCache::WatchTree(const fs::path &directory) {
+    // inotify does not recurse, every directory gets its own watch
+    _watcher.Watch(directory, IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CREATE,
+        [this](const fs::path &parent, const std::string &name, uint32_t mask) {
+            if (name.empty() || name[0] == '.') {
+                return;
+            }
+            const auto path = parent / name;
+            const auto key = path.lexically_relative(_root).generic_string();
+            if (mask & IN_ISDIR) {
+                if (mask & (IN_CREATE | IN_MOVED_TO)) {
+                    WatchTree(path);
+                    Reconcile();
+                }
+                return;
+            }
+            if (mask & (IN_DELETE | IN_MOVED_FROM)) {
+                Remove(key);
+            } else if (mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                if (auto asset = Load(path, true)) {
+                    Store(key, std::move(asset));
+                }
+            }
+        });
+
+    std::error_code error;
+    for (const auto &entry : fs::directory_iterator(directory, error)) {
+        if (entry.is_directory(error) && not entry.path().filename().string().starts_with(".")) {
+            WatchTree(entry.path());
+        }
+    }
+}
+
+void AssetCache::Reconcile() {
+    std::error_code error;
+    for (auto it = fs::recursive_directory_iterator(_root, error); it != fs::recursive_directory_iterator();
+         it.increment(error)) {
+        if (error || not it->is_regular_file(error) || it->path().filename().string().starts_with(".")) {
+            continue;
+        }
+        const auto key = it->path().lexically_relative(_root).generic_string();
+        {
+            // loaded already, and not just on demand without compression
+            auto lock = std::lock_guard<std::mutex>(_access);
+            auto existing = _assets.find(key);
+            if (existing != _assets.end() && existing->second->mtime == it->last_write_time(error) &&
+                (not existing->second->gzip.body.empty() || not contentType(it->path()).compressible)) {
+                continue;
+            }
+        }
+        if (auto asset = Load(it->path(), true)) {
+            Store(key, std::move(asset));
+        }
+    }
+}
+
+std::shared_ptr<Asset> AssetCache::Load(const fs::path &path, bool compress) const {
+    std::error_code error;
+    const auto size = fs::file_size(path, error);
+    const auto mtime = fs::last_write_time(path, error);
+    std::ifstream file(path, std::ios::binary);
+    if (error || not file.good()) {
+        return nullptr;
+    }
+
+    auto asset = std::make_shared<Asset>();
+    asset->size = size;
+    asset->mtime = mtime;
+    asset->identity.body.resize(size);
+    file.read(asset->identity.body.data(), static_cast<std::streamsize>(size));
+    asset->identity.body.resize(static_cast<size_t>(file.gcount()));
+    asset->identity.etag = makeETag(asset->identity.body);
+
+    const auto &type = contentType(path);
+    asset->contentType = type.type;
+    const bool immutable =
+        not _immutablePrefix.empty() && path.lexically_relative(_root).generic_string().starts_with(_immutablePrefix);
+    asset->cacheControl = immutable ? "public, max-age=31536000, immutable" : "no-cache";
+
+    if (compress && type.compressible && size >= MinCompressSize && size <= MaxAssetSize) {
+        const auto &body = asset->identity.body;
+        if (auto gzip = gzipCompress(body); not gzip.empty() && gzip.size() < body.size()) {
+            asset->gzip = {std::move(gzip), variantETag(asset->identity.etag, "-gz"), "gzip"};
+        }
+        if (auto brotli = brotliCompress(body); not brotli.empty() && brotli.size() < body.size()) {
+            asset->brotli = {std::move(brotli), variantETag(asset->identity.etag, "-br"), "br"};
+        }
+    }
+    return asset;
+}
+
+bool AssetCache::Store(const std::string &name, std::shared_ptr<const Asset> asset) {
+    if (asset->size > MaxAssetSize) {
+        return false;
+    }
+    auto lock = std::lock_guard<std::mutex>(_access);
+    auto &slot = _assets[name];
+    const long long previous = slot ? footprint(*slot) : 0;
+    if (_bytes - previous + footprint(*asset) > MaxCacheSize) {
+        // keeping the stale version would serve outdated content, so it goes either way
+        _bytes -= previous;
+        _assets.erase(name);
+        return false;
+    }
+    _bytes += footprint(*asset) - previous;
+    slot = std::move(asset);
+    return true;
+}
+
+void AssetCache::Remove(const std::string &name) {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    if (auto it = _assets.find(name); it != _assets.end()) {
+        _bytes -= footprint(*it->second);
+        _assets.erase(it);
+    }
+}
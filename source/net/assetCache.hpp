@@ -0,0 +1,91 @@
+#ifndef CONVENTION_NAMETAG_ASSETCACHE_HPP
+#define CONVENTION_NAMETAG_ASSETCACHE_HPP
+
+#include "util/fileWatcher.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+struct Asset {
+    struct Variant {
+        std::string body;
+        std::string etag;
+        // Content-Encoding, empty for the file as is
+        std::string_view encoding;
+    };
+    Variant identity;
+    // bodies are empty where compressing did not pay off
+    Variant gzip;
+    Variant brotli;
+
+    std::string_view contentType;
+    std::string_view cacheControl;
+
+    std::filesystem::file_time_type mtime;
+    uintmax_t size{};
+
+    // best variant the client accepts according to its Accept-Encoding header
+    [[nodiscard]] const Variant &Select(std::string_view acceptEncoding) const;
+};
+
+/**
+ * @brief Files of a directory held in memory, ready to be sent
+ *
+ * Every file is read once and compressed with gzip and brotli right away, so a request costs a lookup and nothing
+ * else. Loading and compressing happen on the watcher thread, at start and whenever inotify reports a file changed;
+ * files not loaded yet are read on demand without compression.
+ *
+ * Files under immutablePrefix are expected to carry a content hash in their name and may be cached by clients for good,
+ * everything else is revalidated through its ETag.
+ */
+class AssetCache {
+  public:
+    explicit AssetCache(std::filesystem::path root, std::string immutablePrefix = {});
+    ~AssetCache();
+
+    AssetCache(const AssetCache &) = delete;
+    AssetCache &operator=(const AssetCache &) = delete;
+
+    void Start();
+    void Stop();
+
+    // name relative to the root, nullptr if missing or outside of it
+    [[nodiscard]] std::shared_ptr<const Asset> Get(std::string_view name);
+
+    struct Stats {
+        int assets{};
+        long long bytes{};
+        long long hits{};
+        long long misses{};
+    };
+    [[nodiscard]] Stats GetStats() const;
+
+  private:
+    void WatchTree(const std::filesystem::path &directory);
+    void Reconcile();
+    std::shared_ptr<Asset> Load(const std::filesystem::path &path, bool compress) const;
+    // false if the asset is too large or the cache is full
+    bool Store(const std::string &name, std::shared_ptr<const Asset> asset);
+    void Remove(const std::string &name);
+
+    std::filesystem::path _root;
+    std::string _immutablePrefix;
+
+    std::unordered_map<std::string, std::shared_ptr<const Asset>> _assets;
+    long long _bytes{};
+    mutable std::mutex _access;
+
+    std::atomic<long long> _hits{};
+    std::atomic<long long> _misses{};
+
+    // last, its callbacks use everything above
+    FileWatcher _watcher;
+};
+
+#endif // CONVENTION_NAMETAG_ASSETCACHE_HPP
@@ -0,0 +1,124 @@
+#include "controlChannel.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+const auto HTTP_400_BAD_REQUEST = "400 Bad Request";
+const auto HTTP_404_NOT_FOUND = "404 Not Found";
+const auto HTTP_500_INTERNAL_SERVER_ERROR = "500 Internal Server Error";
+} // namespace
+
+void ControlChannel::Register(std::string command, Handler handler) {
+    _handlers.insert_or_assign(std::move(command), std::move(handler));
+}
+
+void ControlChannel::Start() {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    _loop = uWS::Loop::get();
+}
+
+void ControlChannel::Stop() {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    _loop = nullptr;
+}
+
+void ControlChannel::Open(ControlSocket *socket) { _clients.push_back(socket); }
+
+void ControlChannel::Close(ControlSocket *socket) { std::erase(_clients, socket); }
+
+void ControlChannel::CloseAll() {
+    // closing calls back into Close
+    const auto clients = _clients;
+    for (auto *socket : clients) {
+        socket->close();
+    }
+}
+
+void ControlChannel::Receive(ControlSocket *socket, std::string_view message) {
+    const auto start = std::chrono::steady_clock::now();
+
+    const auto request = nlohmann::json::parse(message, nullptr, false);
+    nlohmann::json reply;
+    if (request.is_object() && request.contains("id")) {
+        reply["id"] = request["id"];
+    }
+
+    CommandResult result{HTTP_400_BAD_REQUEST};
+    if (request.is_object() && request.contains("cmd") && request["cmd"].is_string()) {
+        const auto handler = _handlers.find(request["cmd"].get<std::string>());
+        if (handler == _handlers.end()) {
+            result = {HTTP_404_NOT_FOUND};
+        } else {
+            try {
+                result = handler->second(request);
+            } catch (const nlohmann::json::exception &) {
+                // an argument of the wrong type
+                result = {HTTP_400_BAD_REQUEST};
+            } catch (const std::exception &e) {
+                std::cerr << "Control command " << request["cmd"] << " failed: " << e.what() << std::endl;
+                result = {HTTP_500_INTERNAL_SERVER_ERROR};
+            }
+        }
+    }
+
+    const int status = std::atoi(result.status);
+    reply["status"] = status;
+    if (not result.body.is_null()) {
+        reply["result"] = std::move(result.body);
+    }
+    socket->send(reply.dump(), uWS::OpCode::TEXT);
+
+    const auto elapsed =
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    _stats.commands++;
+    _stats.failed += status >= 400 ? 1 : 0;
+    _stats.commandTime += elapsed;
+    _stats.maxCommandTime = std::max(_stats.maxCommandTime, static_cast<long long>(elapsed));
+}
+
+void ControlChannel::Publish(const nlohmann::json &event) {
+    if (not _clients.empty()) {
+        Broadcast(event.dump());
+    }
+}
+
+void ControlChannel::Broadcast(std::string_view message) {
+    if (_clients.empty()) {
+        return;
+    }
+    for (auto *socket : _clients) {
+        socket->send(message, uWS::OpCode::TEXT);
+    }
+    _stats.events++;
+}
+
+void ControlChannel::Notify(const std::string &name, std::function<std::string()> build) {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    if (_loop == nullptr) {
+        return;
+    }
+    if (not _pending.insert(name).second) {
+        _coalesced++;
+        return;
+    }
+    _loop->defer([this, name, build = std::move(build)]() {
+        {
+            auto pendingLock = std::lock_guard<std::mutex>(_access);
+            _pending.erase(name);
+        }
+        if (not _clients.empty()) {
+            Broadcast(build());
+        }
+    });
+}
+
+ControlChannel::Stats ControlChannel::GetStats() const {
+    auto stats = _stats;
+    stats.clients = static_cast<int>(_clients.size());
+    auto lock = std::lock_guard<std::mutex>(_access);
+    stats.coalesced = _coalesced;
+    return stats;
+}
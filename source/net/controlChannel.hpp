@@ -0,0 +1,89 @@
+#ifndef CONVENTION_NAMETAG_CONTROLCHANNEL_HPP
+#define CONVENTION_NAMETAG_CONTROLCHANNEL_HPP
+
+#include <App.h>
+#include <nlohmann/json.hpp>
+
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// outcome of a command, shared by the REST routes and the control channel
+struct CommandResult {
+    // an HTTP status line, WebSocket replies carry its code
+    const char *status;
+    // null if there is nothing to send back
+    nlohmann::json body{};
+};
+
+struct ControlClient {};
+using ControlSocket = uWS::WebSocket<false, true, ControlClient>;
+
+/**
+ * @brief Commands and state changes over one WebSocket per client, all on the server thread
+ *
+ * A request is a JSON object naming the command, its arguments alongside: {"id": 7, "cmd": "play", "file": "a.mp4"}.
+ * It is answered with {"id": 7, "status": 204}, plus "result" where the command returns something. Requests are
+ * handled in the order they arrive, so clients may send several without waiting and match replies by id.
+ *
+ * Events are pushed to every client as {"event": "<name>", ...} and carry the new state, never just a hint to poll.
+ */
+class ControlChannel {
+  public:
+    using Handler = std::function<CommandResult(const nlohmann::json &request)>;
+
+    ControlChannel() = default;
+    ControlChannel(const ControlChannel &) = delete;
+    ControlChannel &operator=(const ControlChannel &) = delete;
+
+    // before the server runs
+    void Register(std::string command, Handler handler);
+
+    // binds to the loop of the calling thread
+    void Start();
+    // notifications after this are dropped
+    void Stop();
+
+    void Open(ControlSocket *socket);
+    void Close(ControlSocket *socket);
+    void CloseAll();
+    void Receive(ControlSocket *socket, std::string_view message);
+
+    // server thread only
+    void Publish(const nlohmann::json &event);
+    // any thread; build runs on the server thread later and returns the serialized event, so an event still pending
+    // under the same name is not sent twice but once with the state of then
+    void Notify(const std::string &name, std::function<std::string()> build);
+
+    struct Stats {
+        int clients{};
+        long long commands{};
+        long long failed{};
+        long long events{};
+        long long coalesced{};
+        // µs spent handling commands
+        long long commandTime{};
+        long long maxCommandTime{};
+    };
+    [[nodiscard]] Stats GetStats() const;
+
+  private:
+    void Broadcast(std::string_view message);
+
+    std::unordered_map<std::string, Handler> _handlers;
+    std::vector<ControlSocket *> _clients;
+
+    uWS::Loop *_loop{};
+    std::set<std::string> _pending;
+    long long _coalesced{};
+    // guards the three above, which Notify touches from other threads
+    mutable std::mutex _access;
+
+    Stats _stats;
+};
+
+#endif // CONVENTION_NAMETAG_CONTROLCHANNEL_HPP
@@ -0,0 +1,169 @@
+#include "fileStreamer.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <format>
+#include <iostream>
+
+namespace {
+const auto HTTP_206_PARTIAL_CONTENT = "206 Partial Content";
+const auto HTTP_404_NOT_FOUND = "404 Not Found";
+const auto HTTP_416_RANGE_NOT_SATISFIABLE = "416 Range Not Satisfiable";
+
+std::optional<uintmax_t> parseNumber(std::string_view text) {
+    uintmax_t value{};
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (error != std::errc() || end != text.data() + text.size()) {
+        return std::nullopt;
+    }
+    return value;
+}
+} // namespace
+
+std::optional<ByteRange> parseRange(std::string_view header, uintmax_t size) {
+    const ByteRange whole{0, size, false};
+    // several ranges would need a multipart body, sending everything instead is allowed
+    if (not header.starts_with("bytes=") || header.find(',') != std::string_view::npos) {
+        return whole;
+    }
+    const auto spec = header.substr(6);
+    const auto dash = spec.find('-');
+    if (dash == std::string_view::npos) {
+        return whole;
+    }
+    const auto first = spec.substr(0, dash);
+    const auto last = spec.substr(dash + 1);
+
+    if (first.empty()) {
+        // bytes=-n are the last n bytes
+        const auto suffix = parseNumber(last);
+        if (not suffix.has_value()) {
+            return whole;
+        }
+        if (suffix.value() == 0 || size == 0) {
+            return std::nullopt;
+        }
+        const auto length = std::min(suffix.value(), size);
+        return ByteRange{size - length, length, true};
+    }
+
+    const auto start = parseNumber(first);
+    const auto end = last.empty() ? std::optional<uintmax_t>(size - 1) : parseNumber(last);
+    if (not start.has_value() || not end.has_value() || end.value() < start.value()) {
+        return whole;
+    }
+    if (start.value() >= size) {
+        return std::nullopt;
+    }
+    return ByteRange{start.value(), std::min(end.value(), size - 1) - start.value() + 1, true};
+}
+
+void FileStreamer::Serve(uWS::HttpResponse<false> *res, uWS::HttpRequest *req, const std::filesystem::path &path,
+    std::string_view contentType) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat status {};
+    if (fd < 0 || fstat(fd, &status) != 0 || not S_ISREG(status.st_mode)) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        res->writeStatus(HTTP_404_NOT_FOUND);
+        res->writeHeader("Access-Control-Allow-Origin", "*");
+        res->end();
+        return;
+    }
+    const auto size = static_cast<uintmax_t>(status.st_size);
+
+    const auto range = parseRange(req->getHeader("range"), size);
+    if (not range.has_value()) {
+        close(fd);
+        res->writeStatus(HTTP_416_RANGE_NOT_SATISFIABLE);
+        res->writeHeader("Content-Range", std::format("bytes */{}", size));
+        res->writeHeader("Access-Control-Allow-Origin", "*");
+        res->end();
+        return;
+    }
+
+    // read ahead for the whole range, the card is read sequentially from here on
+    posix_fadvise(fd, static_cast<off_t>(range->start), static_cast<off_t>(range->length), POSIX_FADV_SEQUENTIAL);
+
+    if (range->partial) {
+        res->writeStatus(HTTP_206_PARTIAL_CONTENT);
+        res->writeHeader("Content-Range",
+            std::format("bytes {}-{}/{}", range->start, range->start + range->length - 1, size));
+    } else {
+        res->writeStatus(uWS::HTTP_200_OK);
+    }
+    res->writeHeader("content-type", contentType);
+    res->writeHeader("Accept-Ranges", "bytes");
+    res->writeHeader("Access-Control-Allow-Origin", "*");
+
+    auto streamer = std::make_shared<FileStreamer>(res, fd, range.value());
+    res->onWritable([streamer](uintmax_t) { return streamer->Pump(); });
+    res->onAborted([streamer]() {
+        streamer->_aborted = true;
+        streamer->Close();
+    });
+    streamer->Pump();
+}
+
+FileStreamer::FileStreamer(uWS::HttpResponse<false> *res, int fd, ByteRange range)
+    : _res{res}, _fd{fd}, _range{range}, _buffer{std::make_unique<char[]>(BufferSize)} {}
+
+FileStreamer::~FileStreamer() { Close(); }
+
+bool FileStreamer::Pump() {
+    if (_aborted || _fd < 0) {
+        return true;
+    }
+    if (_range.length == 0) {
+        _res->end();
+        Close();
+        return true;
+    }
+
+    while (true) {
+        // what the client has been sent so far, parts of a chunk may have been refused
+        const uintmax_t sent = _res->getWriteOffset();
+        if (sent >= _bufferOffset + _bufferSize) {
+            const size_t wanted = std::min<uintmax_t>(BufferSize, _range.length - sent);
+            ssize_t count;
+            do {
+                count = pread(_fd, _buffer.get(), wanted, static_cast<off_t>(_range.start + sent));
+            } while (count < 0 && errno == EINTR);
+            if (count <= 0) {
+                // the status line is out already, the client can only learn of this by the connection closing
+                std::cerr << "Could not read file for streaming: " << (count < 0 ? std::strerror(errno) : "truncated")
+                          << std::endl;
+                Close();
+                _res->close();
+                return true;
+            }
+            _bufferOffset = sent;
+            _bufferSize = static_cast<size_t>(count);
+        }
+
+        const auto skip = static_cast<size_t>(sent - _bufferOffset);
+        const auto [ok, done] =
+            _res->tryEnd(std::string_view(_buffer.get() + skip, _bufferSize - skip), _range.length);
+        if (done) {
+            Close();
+            return true;
+        }
+        if (not ok) {
+            return false;
+        }
+    }
+}
+
+void FileStreamer::Close() {
+    if (_fd >= 0) {
+        close(_fd);
+        _fd = -1;
+    }
+}
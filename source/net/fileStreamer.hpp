@@ -0,0 +1,59 @@
+#ifndef CONVENTION_NAMETAG_FILESTREAMER_HPP
+#define CONVENTION_NAMETAG_FILESTREAMER_HPP
+
+#include <App.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string_view>
+
+struct ByteRange {
+    uintmax_t start{};
+    uintmax_t length{};
+    // whether a Range header asked for it, answered with 206 even if it covers the whole file
+    bool partial{};
+};
+
+// nullopt if the header asks for nothing inside the file; the whole file if there is no header or it is not usable
+std::optional<ByteRange> parseRange(std::string_view header, uintmax_t size);
+
+/**
+ * @brief Sends a file, or a range of it, as fast as the client takes it
+ *
+ * Only one fixed size buffer per connection is held, no matter how large the file. Each chunk is offered to uWS with
+ * tryEnd; if the socket is full the rest of the chunk stays in the buffer and sending continues from onWritable.
+ */
+class FileStreamer : public std::enable_shared_from_this<FileStreamer> {
+  public:
+    static constexpr size_t BufferSize = 64 * 1024;
+
+    // answers 404, 416, 200 or 206 by itself
+    static void Serve(uWS::HttpResponse<false> *res, uWS::HttpRequest *req, const std::filesystem::path &path,
+        std::string_view contentType);
+
+    FileStreamer(uWS::HttpResponse<false> *res, int fd, ByteRange range);
+    ~FileStreamer();
+
+    FileStreamer(const FileStreamer &) = delete;
+    FileStreamer &operator=(const FileStreamer &) = delete;
+
+  private:
+    // false while the socket cannot take more
+    bool Pump();
+    void Close();
+
+    uWS::HttpResponse<false> *_res;
+    int _fd;
+    ByteRange _range;
+
+    std::unique_ptr<char[]> _buffer;
+    // response offset of the first byte in the buffer, and how much it holds
+    uintmax_t _bufferOffset{};
+    size_t _bufferSize{};
+
+    bool _aborted{};
+};
+
+#endif // CONVENTION_NAMETAG_FILESTREAMER_HPP
@@ -0,0 +1,120 @@
+#include "liveInput.hpp"
+#include "util/packBits.hpp"
+
+#include <utility>
+
+namespace {
+// sent when a delta cannot be applied
+const auto KeyframeRequest = R"({"request":"keyframe"})";
+} // namespace
+
+LiveInput::LiveInput(VideoPlayer &player)
+    : _player{player},
+      _frameSize{FrameView{nullptr, player.GetWidth(), player.GetHeight(), player.GetFormat()}.Size()} {}
+
+void LiveInput::Open(LiveSocket *socket) {
+    if (_sender != nullptr) {
+        // the earlier sender learns from the close code why it was dropped
+        std::exchange(_sender, nullptr)->end(4001, "another sender took over");
+        _feed->Close();
+    }
+    _sender = socket;
+    _feed = std::make_shared<LiveFeed>();
+    _last.clear();
+    _lastSequence.reset();
+    _keyframeRequested = false;
+    _stats.sessions++;
+    _player.Play(std::make_unique<LiveDecoder>(_feed, _player.GetWidth(), _player.GetHeight(), _player.GetFormat()));
+}
+
+void LiveInput::Receive(LiveSocket *socket, std::string_view message) {
+    if (socket != _sender) {
+        return;
+    }
+    _stats.received++;
+    _stats.bytes += static_cast<long long>(message.size());
+
+    const auto *data = reinterpret_cast<const uint8_t *>(message.data());
+    const auto read16 = [data](size_t offset) { return data[offset] | data[offset + 1] << 8; };
+    const auto read32 = [data](size_t offset) {
+        return static_cast<uint32_t>(data[offset]) | static_cast<uint32_t>(data[offset + 1]) << 8 |
+               static_cast<uint32_t>(data[offset + 2]) << 16 | static_cast<uint32_t>(data[offset + 3]) << 24;
+    };
+    if (message.size() < HeaderSize || data[0] > 1 || data[1] > 1 ||
+        (data[1] == 0 ? PixelFormat::Gray4 : PixelFormat::Mono1Paged) != _player.GetFormat() ||
+        read16(2) != _player.GetWidth() || read16(4) != _player.GetHeight()) {
+        _stats.rejected++;
+        return;
+    }
+    const bool delta = data[0] == 1;
+    const uint32_t sequence = read32(6);
+    const uint32_t timestamp = read32(10);
+
+    if (_lastSequence.has_value()) {
+        const auto gap = static_cast<int32_t>(sequence - _lastSequence.value() - 1);
+        if (gap < 0 && delta) {
+            _stats.rejected++;
+            return;
+        }
+        // a full frame from the past is a sender that started counting anew
+        if (gap > 0) {
+            _stats.lost += gap;
+            // whatever the next delta was made against went missing
+            _last.clear();
+        }
+    }
+    _lastSequence = sequence;
+
+    std::vector<uint8_t> frame(_frameSize);
+    if (not unpackBits(data + HeaderSize, message.size() - HeaderSize, frame.data(), frame.size())) {
+        _stats.rejected++;
+        _last.clear();
+        return;
+    }
+    if (delta) {
+        if (_last.empty()) {
+            _stats.undecodable++;
+            if (not std::exchange(_keyframeRequested, true)) {
+                socket->send(KeyframeRequest, uWS::OpCode::TEXT);
+            }
+            return;
+        }
+        for (size_t i{0}; i < frame.size(); i++) {
+            frame[i] ^= _last[i];
+        }
+        _stats.deltas++;
+    } else {
+        _stats.keyframes++;
+        _keyframeRequested = false;
+    }
+    _last = frame;
+    _feed->Push(timestamp, std::move(frame));
+}
+
+void LiveInput::Close(LiveSocket *socket) {
+    if (socket != _sender) {
+        return;
+    }
+    _sender = nullptr;
+    _feed->Close();
+}
+
+void LiveInput::CloseAll() {
+    if (_sender != nullptr) {
+        // closing calls back into Close
+        _sender->close();
+    }
+}
+
+LiveInput::Stats LiveInput::GetStats() const {
+    auto stats = _stats;
+    stats.senders = _sender != nullptr ? 1 : 0;
+    return stats;
+}
+
+std::optional<LiveFeed::Stats> LiveInput::GetFeedStats() const {
+    if (not _feed) {
+        return std::nullopt;
+    }
+    return _feed->GetStats();
+}
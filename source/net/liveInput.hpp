@@ -0,0 +1,73 @@
+#ifndef CONVENTION_NAMETAG_LIVEINPUT_HPP
+#define CONVENTION_NAMETAG_LIVEINPUT_HPP
+
+#include "video/liveDecoder.hpp"
+#include "video/videoPlayer.hpp"
+
+#include <App.h>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// state of one sender, kept by uWS with the socket
+struct LiveClient {};
+using LiveSocket = uWS::WebSocket<false, true, LiveClient>;
+
+/**
+ * @brief Takes frames rendered elsewhere from a WebSocket and plays them through a LiveFeed, all on the server thread
+ *
+ * Messages are binary, laid out like the preview's with the sender's time added: type (0 full frame, 1 delta), format
+ * (0 Gray4, 1 Mono1Paged), width and height as uint16, sequence number and the sender's time in ms as uint32, all
+ * little endian, followed by the PackBits data of the packed frame, or of its XOR with the frame sent before. The
+ * sequence number counts frames actually sent, a gap means frames were lost; deltas are dropped from then on and the
+ * sender is asked for a full frame with a text message {"request":"keyframe"}.
+ *
+ * One sender at a time, a new one takes the panel over from the last.
+ */
+class LiveInput {
+  public:
+    static constexpr size_t HeaderSize = 14;
+
+    explicit LiveInput(VideoPlayer &player);
+
+    void Open(LiveSocket *socket);
+    void Receive(LiveSocket *socket, std::string_view message);
+    void Close(LiveSocket *socket);
+    void CloseAll();
+
+    struct Stats {
+        int senders{};
+        long long sessions{};
+        long long received{};
+        long long keyframes{};
+        long long deltas{};
+        long long bytes{};
+        // missing sequence numbers
+        long long lost{};
+        // deltas to a frame that never arrived, dropped until the next full frame
+        long long undecodable{};
+        // malformed, out of order, or not in the panel's format and size
+        long long rejected{};
+    };
+    [[nodiscard]] Stats GetStats() const;
+    // of the current or last sender, nullopt if there was none yet
+    [[nodiscard]] std::optional<LiveFeed::Stats> GetFeedStats() const;
+
+  private:
+    VideoPlayer &_player;
+    size_t _frameSize;
+
+    LiveSocket *_sender{};
+    std::shared_ptr<LiveFeed> _feed;
+    // what deltas apply to, empty while there is no base
+    std::vector<uint8_t> _last;
+    std::optional<uint32_t> _lastSequence;
+    bool _keyframeRequested{};
+
+    Stats _stats;
+};
+
+#endif // CONVENTION_NAMETAG_LIVEINPUT_HPP
@@ -0,0 +1,359 @@
+#include "peerSync.hpp"
+#include "util/trace.hpp"
+
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+namespace {
+// a change of what the master plays reaches the followers at most this late
+const auto MasterPollInterval = std::chrono::milliseconds(20);
+// followers not heard from for this long get no more pushes
+const auto FollowerTimeout = std::chrono::seconds(10);
+// exchanges the offset and drift are estimated from
+const size_t MaxSamples = 16;
+// crystals are within a few tens of ppm, more is noise from a short window
+const double MaxDrift = 500e-6;
+// further off than this, seeking beats skipping frames one by one
+const auto MaxShift = std::chrono::seconds(1);
+
+int64_t toUs(std::chrono::steady_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+}
+
+bool sameAddress(const sockaddr_in &a, const sockaddr_in &b) {
+    return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
+}
+} // namespace
+
+PeerSync::PeerSync(const Configuration::Sync &configuration, VideoPlayer &player, std::filesystem::path videoFolder)
+    : _configuration{configuration}, _player{player}, _videoFolder{std::move(videoFolder)} {}
+
+PeerSync::~PeerSync() { Stop(); }
+
+void PeerSync::Start() {
+    using Role = Configuration::Sync::Role;
+    if (_configuration.role == Role::Off) {
+        return;
+    }
+
+    _socket = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (_socket < 0) {
+        std::cerr << "Sync: failed to create socket: " << std::strerror(errno) << std::endl;
+        return;
+    }
+    const int on{1};
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (_configuration.role == Role::Master) {
+        setsockopt(_socket, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        address.sin_port = htons(static_cast<uint16_t>(_configuration.port));
+    } else if (_configuration.master.empty()) {
+        setsockopt(_socket, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
+    }
+    if (bind(_socket, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) < 0) {
+        std::cerr << "Sync: failed to bind port " << _configuration.port << ": " << std::strerror(errno) << std::endl;
+        close(_socket);
+        _socket = -1;
+        return;
+    }
+    _wake = eventfd(0, EFD_CLOEXEC);
+
+    _thread = std::thread(_configuration.role == Role::Master ? &PeerSync::RunMaster : &PeerSync::RunFollower, this);
+}
+
+void PeerSync::Stop() {
+    if (_thread.joinable()) {
+        const uint64_t one{1};
+        if (write(_wake, &one, sizeof(one)) < 0) {
+            std::cerr << "Sync: failed to wake the sync thread: " << std::strerror(errno) << std::endl;
+        }
+        _thread.join();
+    }
+    if (_socket >= 0) {
+        close(_socket);
+        _socket = -1;
+    }
+    if (_wake >= 0) {
+        close(_wake);
+        _wake = -1;
+    }
+}
+
+PeerSync::Stats PeerSync::GetStats() const {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    return _stats;
+}
+
+void PeerSync::RunMaster() {
+    Trace::SetThreadName("sync");
+    struct Follower {
+        sockaddr_in address;
+        std::chrono::steady_clock::time_point seen;
+    };
+    std::vector<Follower> followers;
+    auto changes = _player.GetChanges();
+    pollfd fds[2]{{_socket, POLLIN, 0}, {_wake, POLLIN, 0}};
+    char buffer[1500];
+
+    while (true) {
+        if (poll(fds, 2, static_cast<int>(MasterPollInterval.count())) < 0 && errno != EINTR) {
+            std::cerr << "Sync: poll failed: " << std::strerror(errno) << std::endl;
+            return;
+        }
+        if ((fds[1].revents & POLLIN) != 0) {
+            return;
+        }
+        const auto now = std::chrono::steady_clock::now();
+
+        if ((fds[0].revents & POLLIN) != 0) {
+            sockaddr_in from{};
+            socklen_t length = sizeof(from);
+            const auto bytes =
+                recvfrom(_socket, buffer, sizeof(buffer), 0, reinterpret_cast<sockaddr *>(&from), &length);
+            // taken before anything else, the time the request is answered from
+            const auto received = toUs(std::chrono::steady_clock::now());
+            const auto request =
+                nlohmann::json::parse(buffer, buffer + std::max<ssize_t>(bytes, 0), nullptr, false);
+            // anything can arrive on the port, a datagram that is not a request of ours is ignored
+            try {
+                if (request.is_object() && request.value("type", "") == "time" && request.contains("t1")) {
+                    Send(TimelineMessage("time", request.at("t1").get<int64_t>(), received), from);
+                    const auto known = std::find_if(followers.begin(), followers.end(),
+                        [&from](const Follower &follower) { return sameAddress(follower.address, from); });
+                    if (known != followers.end()) {
+                        known->seen = now;
+                    } else {
+                        followers.push_back({from, now});
+                    }
+                }
+            } catch (const nlohmann::json::exception &) {
+            }
+        }
+
+        std::erase_if(followers, [now](const Follower &follower) { return now - follower.seen > FollowerTimeout; });
+        if (const auto current = _player.GetChanges(); current != changes) {
+            changes = current;
+            const auto message = TimelineMessage("timeline", 0, 0);
+            for (const auto &follower : followers) {
+                Send(message, follower.address);
+            }
+        }
+        auto lock = std::lock_guard<std::mutex>(_access);
+        _stats.followers = static_cast<int>(followers.size());
+    }
+}
+
+void PeerSync::RunFollower() {
+    Trace::SetThreadName("sync");
+    sockaddr_in master{};
+    master.sin_family = AF_INET;
+    master.sin_port = htons(static_cast<uint16_t>(_configuration.port));
+    if (_configuration.master.empty()) {
+        master.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+    } else if (inet_pton(AF_INET, _configuration.master.c_str(), &master.sin_addr) != 1) {
+        std::cerr << "Sync: not an IPv4 address: " << _configuration.master << std::endl;
+        return;
+    }
+
+    bool locked{};
+    std::optional<int64_t> pending;
+    const auto interval = std::chrono::milliseconds(_configuration.intervalMs);
+    auto next = std::chrono::steady_clock::now();
+    pollfd fds[2]{{_socket, POLLIN, 0}, {_wake, POLLIN, 0}};
+    char buffer[1500];
+
+    while (true) {
+        const auto left = std::chrono::ceil<std::chrono::milliseconds>(next - std::chrono::steady_clock::now());
+        if (poll(fds, 2, static_cast<int>(std::max<int64_t>(left.count(), 0))) < 0 && errno != EINTR) {
+            std::cerr << "Sync: poll failed: " << std::strerror(errno) << std::endl;
+            return;
+        }
+        if ((fds[1].revents & POLLIN) != 0) {
+            return;
+        }
+
+        if ((fds[0].revents & POLLIN) != 0) {
+            sockaddr_in from{};
+            socklen_t length = sizeof(from);
+            const auto bytes =
+                recvfrom(_socket, buffer, sizeof(buffer), 0, reinterpret_cast<sockaddr *>(&from), &length);
+            const auto arrival = std::chrono::steady_clock::now();
+            const auto message =
+                nlohmann::json::parse(buffer, buffer + std::max<ssize_t>(bytes, 0), nullptr, false);
+            const bool fromMaster = not locked || sameAddress(from, master);
+            // anything can arrive on the port, a datagram that is not an answer of the master's is ignored; the
+            // times are read before anything changes, so one that is not gets no further than that
+            try {
+                if (message.is_object() && fromMaster) {
+                    const auto type = message.value("type", "");
+                    if (type == "time" && pending.has_value() && message.value("t1", int64_t{}) == pending.value()) {
+                        const auto t1 = pending.value();
+                        const auto t2 = message.at("t2").get<int64_t>();
+                        const auto t3 = message.at("t3").get<int64_t>();
+                        const auto t4 = toUs(arrival);
+                        pending.reset();
+                        if (not locked) {
+                            // the first master to answer a broadcast is the one
+                            locked = true;
+                            master = from;
+                            char name[INET_ADDRSTRLEN]{};
+                            inet_ntop(AF_INET, &from.sin_addr, name, sizeof(name));
+                            auto lock = std::lock_guard<std::mutex>(_access);
+                            _stats.locked = true;
+                            _stats.master = name;
+                        }
+                        AddSample(arrival, ((t2 - t1) + (t3 - t4)) / 2, (t4 - t1) - (t3 - t2));
+                    }
+                    if ((type == "time" || type == "timeline") && locked && message.contains("timeline") &&
+                        message.at("timeline").is_object()) {
+                        const auto &timeline = message.at("timeline");
+                        Follow(timeline.value("file", ""), timeline.value("start", int64_t{}),
+                            timeline.value("duration", int64_t{}));
+                    }
+                }
+            } catch (const nlohmann::json::exception &) {
+            }
+        }
+
+        if (std::chrono::steady_clock::now() >= next) {
+            if (pending.has_value()) {
+                auto lock = std::lock_guard<std::mutex>(_access);
+                _stats.unanswered++;
+            }
+            pending = toUs(std::chrono::steady_clock::now());
+            Send(nlohmann::json{{"type", "time"}, {"t1", pending.value()}}.dump(), master);
+            next = std::max(next + interval, std::chrono::steady_clock::now());
+        }
+    }
+}
+
+std::string PeerSync::TimelineMessage(const char *type, int64_t t1, int64_t t2) {
+    nlohmann::json message{{"type", type}, {"t1", t1}, {"t2", t2}, {"timeline", nullptr}};
+    if (const auto timeline = _player.GetTimeline(); timeline.has_value()) {
+        message["timeline"] = {{"file", timeline->file.filename().string()}, {"start", toUs(timeline->start)},
+            {"duration", timeline->duration.count()}};
+    }
+    // as late as possible, the time spent answering is taken out of the round trip
+    message["t3"] = toUs(std::chrono::steady_clock::now());
+    return message.dump();
+}
+
+void PeerSync::Send(const std::string &message, const sockaddr_in &to) {
+    if (sendto(_socket, message.data(), message.size(), 0, reinterpret_cast<const sockaddr *>(&to), sizeof(to)) < 0) {
+        std::cerr << "Sync: failed to send: " << std::strerror(errno) << std::endl;
+    }
+}
+
+void PeerSync::AddSample(std::chrono::steady_clock::time_point at, int64_t offset, int64_t roundTrip) {
+    _samples.push_back({at, offset, roundTrip});
+    if (_samples.size() > MaxSamples) {
+        _samples.pop_front();
+    }
+
+    // drift is the slope of the offset over the window, least squares
+    if (_samples.size() >= 4) {
+        double meanX{};
+        double meanY{};
+        for (const auto &sample : _samples) {
+            meanX += std::chrono::duration<double>(sample.at - _samples.front().at).count();
+            meanY += static_cast<double>(sample.offset) / 1e6;
+        }
+        meanX /= static_cast<double>(_samples.size());
+        meanY /= static_cast<double>(_samples.size());
+        double covariance{};
+        double variance{};
+        for (const auto &sample : _samples) {
+            const auto x = std::chrono::duration<double>(sample.at - _samples.front().at).count() - meanX;
+            covariance += x * (static_cast<double>(sample.offset) / 1e6 - meanY);
+            variance += x * x;
+        }
+        _drift = variance > 0. ? std::clamp(covariance / variance, -MaxDrift, MaxDrift) : 0.;
+    }
+
+    const auto &best = *std::min_element(_samples.begin(), _samples.end(),
+        [](const Sample &a, const Sample &b) { return a.roundTrip < b.roundTrip; });
+    auto lock = std::lock_guard<std::mutex>(_access);
+    _stats.exchanges++;
+    _stats.offset = std::chrono::microseconds(Offset(at).value_or(0));
+    _stats.driftPpm = _drift * 1e6;
+    _stats.roundTrip = std::chrono::microseconds(best.roundTrip);
+}
+
+std::optional<int64_t> PeerSync::Offset(std::chrono::steady_clock::time_point at) const {
+    if (_samples.empty()) {
+        return std::nullopt;
+    }
+    // the shortest round trip had the least queueing in it, which is what makes offsets asymmetric
+    const auto &best = *std::min_element(_samples.begin(), _samples.end(),
+        [](const Sample &a, const Sample &b) { return a.roundTrip < b.roundTrip; });
+    const auto since = std::chrono::duration<double>(at - best.at).count();
+    return best.offset + static_cast<int64_t>(_drift * since * 1e6);
+}
+
+void PeerSync::Follow(const std::string &file, int64_t start, int64_t duration) {
+    const auto now = std::chrono::steady_clock::now();
+    const auto offset = Offset(now);
+    if (file.empty() || not offset.has_value()) {
+        return;
+    }
+    const auto masterStart = std::chrono::steady_clock::time_point(std::chrono::microseconds(start - offset.value()));
+    const auto loop = std::chrono::microseconds(duration);
+
+    auto timeline = _player.GetTimeline();
+    const bool switched = not timeline.has_value() || timeline->file.filename() != file;
+    if (switched) {
+        // only ever a name in the own library
+        if (not _player.PlayFile(_videoFolder / std::filesystem::path(file).filename())) {
+            auto lock = std::lock_guard<std::mutex>(_access);
+            _stats.missingFiles++;
+            return;
+        }
+        timeline = _player.GetTimeline();
+        if (not timeline.has_value()) {
+            return;
+        }
+    }
+
+    // in the same loop as the master, whichever that is
+    auto error = std::chrono::duration_cast<std::chrono::microseconds>(timeline->start - masterStart);
+    if (loop.count() > 0) {
+        error = (error % loop + loop) % loop;
+        if (error > loop / 2) {
+            error -= loop;
+        }
+    }
+    const auto magnitude = std::chrono::abs(error);
+
+    auto lock = std::unique_lock<std::mutex>(_access);
+    // right after switching the error is how long the master has been playing, not how well the two are in sync
+    if (not switched) {
+        _stats.errorSamples++;
+        _stats.lastError = error;
+        _stats.maxError = std::max(_stats.maxError, magnitude);
+        _stats.totalError += magnitude;
+    }
+    if (magnitude > MaxShift && loop.count() > 0) {
+        _stats.seeks++;
+        lock.unlock();
+        const auto position = ((now - masterStart) % loop + loop) % loop;
+        Trace::Instant("sync", "seek", std::chrono::duration_cast<std::chrono::microseconds>(position).count());
+        _player.Seek(std::chrono::duration<double>(position).count(), nullptr);
+    } else if (magnitude > std::chrono::milliseconds(_configuration.toleranceMs)) {
+        _stats.corrections++;
+        lock.unlock();
+        // earlier skips the frames due meanwhile, later holds the current one
+        Trace::Instant("sync", "shift", -error.count());
+        _player.Shift(-error);
+    }
+}
@@ -0,0 +1,107 @@
+#ifndef CONVENTION_NAMETAG_PEERSYNC_HPP
+#define CONVENTION_NAMETAG_PEERSYNC_HPP
+
+#include "util/configuration.hpp"
+#include "video/videoPlayer.hpp"
+
+#include <netinet/in.h>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Plays the same video on several badges in lockstep
+ *
+ * One badge is the master: it answers clock requests over UDP with its receive and send times, as NTP does, along
+ * with what it plays and when the current loop started on its steady clock. Followers ask every interval, estimate
+ * the offset to the master's clock from the exchanges with the shortest round trip and the drift from how the offset
+ * moves, and map the master's timeline onto their own clock. They play the same file from their own library, and
+ * whenever their timeline is further off than the tolerance they move it into line: frames due already are skipped,
+ * or the current one is held. The master pushes a change of file to its followers right away, so they start along
+ * within the round trip and the time to open the file.
+ *
+ * The error a follower measures before each correction is its sync error, as far as its clock estimate goes.
+ */
+class PeerSync {
+  public:
+    PeerSync(const Configuration::Sync &configuration, VideoPlayer &player, std::filesystem::path videoFolder);
+    ~PeerSync();
+
+    PeerSync(const PeerSync &) = delete;
+    PeerSync &operator=(const PeerSync &) = delete;
+
+    // nothing happens with the role off
+    void Start();
+    void Stop();
+
+    struct Stats {
+        // master: followers heard from recently
+        int followers{};
+
+        // follower: the master answered
+        bool locked{};
+        std::string master;
+        long long exchanges{};
+        // requests not answered before the next one went out
+        long long unanswered{};
+        // master clock minus local clock, and how fast that changes
+        std::chrono::microseconds offset{};
+        double driftPpm{};
+        // round trip of the exchange the offset is based on, half of it bounds the offset's error
+        std::chrono::microseconds roundTrip{};
+
+        // follower: own timeline minus the master's before correcting, in the same loop
+        long long errorSamples{};
+        std::chrono::microseconds lastError{};
+        std::chrono::microseconds maxError{};
+        std::chrono::microseconds totalError{};
+        long long corrections{};
+        long long seeks{};
+        // files the master played that are not in the library here
+        long long missingFiles{};
+    };
+    [[nodiscard]] Stats GetStats() const;
+
+  private:
+    struct Sample {
+        std::chrono::steady_clock::time_point at;
+        int64_t offset;
+        int64_t roundTrip;
+    };
+
+    void RunMaster();
+    void RunFollower();
+    // the master's timeline as it goes out, null if no video file is playing
+    std::string TimelineMessage(const char *type, int64_t t1, int64_t t2);
+    void Send(const std::string &message, const sockaddr_in &to);
+    void AddSample(std::chrono::steady_clock::time_point at, int64_t offset, int64_t roundTrip);
+    // master clock minus local clock at the given time, nullopt before the first exchange
+    [[nodiscard]] std::optional<int64_t> Offset(std::chrono::steady_clock::time_point at) const;
+    // moves the player into line with the master's timeline
+    void Follow(const std::string &file, int64_t start, int64_t duration);
+
+    const Configuration::Sync _configuration;
+    VideoPlayer &_player;
+    const std::filesystem::path _videoFolder;
+
+    int _socket{-1};
+    // written by Stop to wake the thread
+    int _wake{-1};
+
+    // follower thread only
+    std::deque<Sample> _samples;
+    double _drift{};
+
+    Stats _stats;
+    mutable std::mutex _access;
+    std::thread _thread;
+};
+
+#endif // CONVENTION_NAMETAG_PEERSYNC_HPP
@@ -0,0 +1,177 @@
+#include "preview.hpp"
+#include "util/packBits.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+namespace {
+// a viewer with more than this still unsent skips frames
+const unsigned int MaxBacklog = 16 * 1024;
+const size_t HeaderSize = 10;
+
+void updateMax(std::atomic<long long> &max, long long value) {
+    long long current = max;
+    while (value > current && not max.compare_exchange_weak(current, value)) {
+    }
+}
+
+void writeHeader(std::string &out, bool delta, PixelFormat format, int width, int height, uint64_t frame) {
+    const uint8_t header[HeaderSize]{static_cast<uint8_t>(delta ? 1 : 0),
+        static_cast<uint8_t>(format == PixelFormat::Gray4 ? 0 : 1), static_cast<uint8_t>(width),
+        static_cast<uint8_t>(width >> 8), static_cast<uint8_t>(height), static_cast<uint8_t>(height >> 8),
+        static_cast<uint8_t>(frame), static_cast<uint8_t>(frame >> 8), static_cast<uint8_t>(frame >> 16),
+        static_cast<uint8_t>(frame >> 24)};
+    out.append(reinterpret_cast<const char *>(header), HeaderSize);
+}
+} // namespace
+
+PreviewRing::PreviewRing(int width, int height, PixelFormat format)
+    : _width{width}, _height{height}, _format{format}, _size{FrameView{nullptr, width, height, format}.Size()} {
+    for (auto &slot : _slots) {
+        slot.data = std::make_unique<uint8_t[]>(_size);
+    }
+}
+
+void PreviewRing::Publish(const FrameView &frame) {
+    const auto start = std::chrono::steady_clock::now();
+
+    const uint64_t number = _latest.load(std::memory_order_relaxed) + 1;
+    auto &slot = _slots[number % Slots];
+    slot.version.store(2 * number - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(slot.data.get(), frame.data, std::min(_size, frame.Size()));
+    slot.version.store(2 * number, std::memory_order_release);
+    _latest.store(number, std::memory_order_release);
+
+    const auto elapsed =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    _publishTime.fetch_add(elapsed, std::memory_order_relaxed);
+    updateMax(_maxPublishTime, elapsed);
+}
+
+uint64_t PreviewRing::Read(std::vector<uint8_t> &out) const {
+    out.resize(_size);
+    while (true) {
+        const uint64_t number = Latest();
+        if (number == 0) {
+            return 0;
+        }
+        const auto &slot = _slots[number % Slots];
+        if (slot.version.load(std::memory_order_acquire) != 2 * number) {
+            // overwritten already, a newer frame is out
+            continue;
+        }
+        std::memcpy(out.data(), slot.data.get(), _size);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.version.load(std::memory_order_relaxed) == 2 * number) {
+            return number;
+        }
+    }
+}
+
+PreviewRing::Stats PreviewRing::GetStats() const {
+    return {static_cast<long long>(Latest()), _publishTime, _maxPublishTime};
+}
+
+PreviewBroadcaster::PreviewBroadcaster(const PreviewRing &ring, int maxFrameRate)
+    : _ring{ring}, _minInterval{std::chrono::microseconds(1000000 / maxFrameRate)} {}
+
+PreviewBroadcaster::~PreviewBroadcaster() { Stop(); }
+
+void PreviewBroadcaster::Start() {
+    // falls through, an idle timer must not keep the loop from ending when the server halts
+    _timer = us_create_timer(reinterpret_cast<us_loop_t *>(uWS::Loop::get()), 1, sizeof(PreviewBroadcaster *));
+    *static_cast<PreviewBroadcaster **>(us_timer_ext(_timer)) = this;
+    const auto interval =
+        std::max(1, static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(_minInterval).count()));
+    us_timer_set(
+        _timer, [](us_timer_t *timer) { (*static_cast<PreviewBroadcaster **>(us_timer_ext(timer)))->Tick(); },
+        interval, interval);
+}
+
+void PreviewBroadcaster::Stop() {
+    if (_timer != nullptr) {
+        us_timer_close(_timer);
+        _timer = nullptr;
+    }
+}
+
+PreviewClient PreviewBroadcaster::MakeClient(int frameRate) const {
+    PreviewClient client;
+    client.interval = frameRate > 0 ? std::max(_minInterval, std::chrono::steady_clock::duration(
+                                                                 std::chrono::microseconds(1000000 / frameRate)))
+                                    : _minInterval;
+    return client;
+}
+
+void PreviewBroadcaster::Open(PreviewSocket *socket) { _clients.push_back(socket); }
+
+void PreviewBroadcaster::Close(PreviewSocket *socket) { std::erase(_clients, socket); }
+
+void PreviewBroadcaster::CloseAll() {
+    // closing calls back into Close
+    const auto clients = _clients;
+    for (auto *socket : clients) {
+        socket->close();
+    }
+}
+
+PreviewBroadcaster::Stats PreviewBroadcaster::GetStats() const {
+    auto stats = _stats;
+    stats.viewers = static_cast<int>(_clients.size());
+    return stats;
+}
+
+void PreviewBroadcaster::Tick() {
+    if (_clients.empty()) {
+        return;
+    }
+    if (_ring.Latest() != _currentFrame) {
+        _currentFrame = _ring.Read(_current);
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    // encoded once per frame the viewers have, usually they all have the same one
+    std::map<uint64_t, std::string> messages;
+    for (auto *socket : _clients) {
+        auto &client = *socket->getUserData();
+        if (client.sentFrame == _currentFrame || now < client.nextDue) {
+            continue;
+        }
+        if (socket->getBufferedAmount() > MaxBacklog) {
+            _stats.dropped++;
+            continue;
+        }
+
+        auto [message, added] = messages.try_emplace(client.sentFrame);
+        if (added) {
+            const auto start = std::chrono::steady_clock::now();
+            auto &encoded = message->second;
+            const bool delta = client.sentFrame != 0;
+            writeHeader(encoded, delta, _ring.GetFormat(), _ring.GetWidth(), _ring.GetHeight(), _currentFrame);
+            if (delta) {
+                _delta.resize(_current.size());
+                for (size_t i{0}; i < _current.size(); i++) {
+                    _delta[i] = _current[i] ^ client.last[i];
+                }
+                packBits(_delta.data(), _delta.size(), encoded);
+            } else {
+                packBits(_current.data(), _current.size(), encoded);
+                _stats.keyframes++;
+            }
+            _stats.encodes++;
+            _stats.encodeTime +=
+                std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start)
+                    .count();
+        }
+
+        socket->send(message->second, uWS::OpCode::BINARY);
+        _stats.sent++;
+        _stats.bytes += static_cast<long long>(message->second.size());
+        client.last = _current;
+        client.sentFrame = _currentFrame;
+        // half a tick early, so timer jitter does not push a viewer at the full rate to every other tick
+        client.nextDue = now + client.interval - _minInterval / 2;
+    }
+}
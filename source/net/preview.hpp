@@ -0,0 +1,132 @@
+#ifndef CONVENTION_NAMETAG_PREVIEW_HPP
+#define CONVENTION_NAMETAG_PREVIEW_HPP
+
+#include "drawers/frame.hpp"
+
+#include <App.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Hands the panel's framebuffer from the render thread to the web server
+ *
+ * Publishing is a copy into the next of a few slots and never waits for readers. Each slot carries a sequence
+ * number that is odd while it is written, readers retry if it changed under them.
+ */
+class PreviewRing {
+  public:
+    PreviewRing(int width, int height, PixelFormat format);
+
+    // render thread
+    void Publish(const FrameView &frame);
+
+    // number of the newest frame, 0 until the first one
+    [[nodiscard]] uint64_t Latest() const { return _latest.load(std::memory_order_acquire); }
+    // copies the newest frame into out and returns its number, 0 if there is none yet
+    uint64_t Read(std::vector<uint8_t> &out) const;
+
+    [[nodiscard]] int GetWidth() const { return _width; }
+    [[nodiscard]] int GetHeight() const { return _height; }
+    [[nodiscard]] PixelFormat GetFormat() const { return _format; }
+    [[nodiscard]] size_t GetSize() const { return _size; }
+
+    struct Stats {
+        long long published{};
+        // ns the render thread spent publishing
+        long long publishTime{};
+        long long maxPublishTime{};
+    };
+    [[nodiscard]] Stats GetStats() const;
+
+  private:
+    static constexpr int Slots = 4;
+    struct Slot {
+        // 2n while frame n is readable, odd while being written
+        std::atomic<uint64_t> version{};
+        std::unique_ptr<uint8_t[]> data;
+    };
+
+    int _width;
+    int _height;
+    PixelFormat _format;
+    size_t _size;
+
+    std::array<Slot, Slots> _slots;
+    std::atomic<uint64_t> _latest{};
+
+    std::atomic<long long> _publishTime{};
+    std::atomic<long long> _maxPublishTime{};
+};
+
+// state of one viewer, kept by uWS with the socket
+struct PreviewClient {
+    std::chrono::steady_clock::duration interval{};
+    std::chrono::steady_clock::time_point nextDue{};
+    // the frame the client has, deltas are encoded against it
+    uint64_t sentFrame{};
+    std::vector<uint8_t> last;
+};
+using PreviewSocket = uWS::WebSocket<false, true, PreviewClient>;
+
+/**
+ * @brief Sends the panel's contents to WebSocket viewers, all on the server thread
+ *
+ * A timer at the highest allowed rate looks for a new frame. Each viewer gets the XOR of the new frame and the one it
+ * has, PackBits encoded, no more often than it asked for. Viewers with data still unsent skip frames instead of
+ * building a queue, their next delta simply spans more changes. Viewers sharing a base frame share one encoding.
+ *
+ * Messages are binary: type (0 full frame, 1 delta), format (0 Gray4, 1 Mono1Paged), width and height as uint16 and
+ * the frame number as uint32, all little endian, followed by the PackBits data.
+ */
+class PreviewBroadcaster {
+  public:
+    PreviewBroadcaster(const PreviewRing &ring, int maxFrameRate);
+    ~PreviewBroadcaster();
+
+    PreviewBroadcaster(const PreviewBroadcaster &) = delete;
+    PreviewBroadcaster &operator=(const PreviewBroadcaster &) = delete;
+
+    // starts the timer on the loop of the calling thread
+    void Start();
+    void Stop();
+
+    // 0 or anything above the maximum rate means the maximum
+    [[nodiscard]] PreviewClient MakeClient(int frameRate) const;
+    void Open(PreviewSocket *socket);
+    void Close(PreviewSocket *socket);
+    void CloseAll();
+
+    struct Stats {
+        int viewers{};
+        long long sent{};
+        long long dropped{};
+        long long keyframes{};
+        long long encodes{};
+        long long bytes{};
+        // µs spent encoding
+        long long encodeTime{};
+    };
+    [[nodiscard]] Stats GetStats() const;
+
+  private:
+    void Tick();
+
+    const PreviewRing &_ring;
+    std::chrono::steady_clock::duration _minInterval;
+
+    std::vector<PreviewSocket *> _clients;
+    std::vector<uint8_t> _current;
+    uint64_t _currentFrame{};
+    std::vector<uint8_t> _delta;
+
+    us_timer_t *_timer{};
+    Stats _stats;
+};
+
+#endif // CONVENTION_NAMETAG_PREVIEW_HPP
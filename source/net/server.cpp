@@ -1,31 +1,20 @@
 #include "server.hpp"
 
+#include <algorithm>
+#include <charconv>
+#include <ctime>
 #include <filesystem>
-#include <fstream>
+#include <format>
+#include <utility>
 
+#include "util/base64.hpp"
+#include "util/perfCounters.hpp"
+#include "util/trace.hpp"
 #include "video/helper.hpp"
+#include "video/textDecoder.hpp"
 
 namespace fs = std::filesystem;
 
-// files delivered expected to be small, so skipping async data delivery for simplicity
-std::optional<std::string> AttemptLoadFile(const fs::path &file) {
-    if (not fs::exists(file)) {
-        return std::nullopt;
-    }
-    std::ifstream t(file);
-    if (not t.good()) {
-        return std::nullopt;
-    }
-    std::string str;
-
-    t.seekg(0, std::ios::end);
-    str.reserve(t.tellg());
-    t.seekg(0, std::ios::beg);
-
-    str.assign((std::istreambuf_iterator<char>(t)), std::istreambuf_iterator<char>());
-    return str;
-}
-
 std::string UrlDecode(std::string encoded) {
     for (size_t i = 0; i < encoded.size() - 2; i++) {
         if (encoded[i] == '%' && (i + 2) < encoded.size()) {
@@ -40,10 +29,19 @@ std::string UrlDecode(std::string encoded) {
 
 namespace ResponseCodes {
 const auto HTTP_200_OK = uWS::HTTP_200_OK;
+const auto HTTP_201_CREATED = "201 Created";
 const auto HTTP_204_NO_CONTENT = "204 No Content";
+const auto HTTP_304_NOT_MODIFIED = "304 Not Modified";
 const auto HTTP_400_BAD_REQUEST = "400 Bad Request";
 const auto HTTP_404_NOT_FOUND = "404 Not Found";
 const auto HTTP_409_CONFLICT = "409 Conflict";
+const auto HTTP_412_PRECONDITION_FAILED = "412 Precondition Failed";
+const auto HTTP_413_PAYLOAD_TOO_LARGE = "413 Payload Too Large";
+const auto HTTP_415_UNSUPPORTED_MEDIA_TYPE = "415 Unsupported Media Type";
+const auto HTTP_423_LOCKED = "423 Locked";
+// tus' checksum extension
+const auto HTTP_460_CHECKSUM_MISMATCH = "460 Checksum Mismatch";
+const auto HTTP_500_INTERNAL_SERVER_ERROR = "500 Internal Server Error";
 } // namespace ResponseCodes
 
 const auto RESPONSE_404 = "<!doctype html>\n"
@@ -54,38 +52,113 @@ const auto RESPONSE_404 = "<!doctype html>\n"
 
 const auto videoFolder = fs::path("videos");
 
-template <bool SSL = false> void serveFile(uWS::HttpResponse<SSL> *res, const fs::path &path) {
-    // uWS::HttpRequest *req,
-    // const fs::path &fileBasePath = fs::current_path().parent_path() / "frontend/build") {
+// request bodies other than uploads are small json documents
+const auto MaxJsonBodySize = 64 * 1024;
+
+/**
+ * Collect a json request body and hand it to the handler once complete, answers 400/413 by itself.
+ */
+template <class Handler> void readJsonBody(uWS::HttpResponse<false> *res, Handler handler) {
+    auto body = std::make_shared<std::string>();
+    auto aborted = std::make_shared<bool>(false);
+
+    res->onData([res, body, aborted, handler = std::move(handler)](std::string_view chunk, bool isLast) mutable {
+        if (*aborted) {
+            return;
+        }
+        if (body->size() + chunk.size() > MaxJsonBodySize) {
+            *aborted = true;
+            res->writeStatus(ResponseCodes::HTTP_413_PAYLOAD_TOO_LARGE);
+            res->writeHeader("Access-Control-Allow-Origin", "*");
+            res->end();
+            return;
+        }
+        body->append(chunk);
+        if (not isLast) {
+            return;
+        }
+
+        auto json = nlohmann::json::parse(*body, nullptr, false);
+        if (json.is_discarded()) {
+            res->writeStatus(ResponseCodes::HTTP_400_BAD_REQUEST);
+            res->writeHeader("Access-Control-Allow-Origin", "*");
+            res->end();
+            return;
+        }
+        handler(res, json);
+    });
+    res->onAborted([aborted]() { *aborted = true; });
+}
+
+void respondJson(uWS::HttpResponse<false> *res, const nlohmann::json &json) {
+    res->writeStatus(ResponseCodes::HTTP_200_OK);
+    res->writeHeader("content-type", "application/json");
+    res->writeHeader("Access-Control-Allow-Origin", "*");
+    res->end(json.dump());
+}
+
+void respondNoContent(uWS::HttpResponse<false> *res) {
+    res->writeStatus(ResponseCodes::HTTP_204_NO_CONTENT);
+    res->writeHeader("Access-Control-Allow-Origin", "*");
+    res->end();
+}
+
+void respondStatus(uWS::HttpResponse<false> *res, const char *status) {
+    res->writeStatus(status);
+    res->writeHeader("Access-Control-Allow-Origin", "*");
+    res->end();
+}
 
-    auto file = AttemptLoadFile(path);
-    if (not file.has_value()) {
+void respondResult(uWS::HttpResponse<false> *res, const CommandResult &result) {
+    if (result.body.is_null()) {
+        respondStatus(res, result.status);
+        return;
+    }
+    res->writeStatus(result.status);
+    res->writeHeader("content-type", "application/json");
+    res->writeHeader("Access-Control-Allow-Origin", "*");
+    res->end(result.body.dump());
+}
+
+/**
+ * Send a file from one of the asset caches, or 304 if the client's copy is still current. The cached body is written
+ * straight from the cache, without copying it per request.
+ */
+void serveAsset(uWS::HttpResponse<false> *res, uWS::HttpRequest *req, AssetCache &cache, std::string_view name) {
+    const auto asset = cache.Get(name);
+    if (not asset) {
         res->writeStatus(ResponseCodes::HTTP_404_NOT_FOUND);
         res->writeHeader("Access-Control-Allow-Origin", "*");
         res->end(RESPONSE_404);
-    } else {
-        res->writeStatus(ResponseCodes::HTTP_200_OK);
+        return;
+    }
+
+    const auto &variant = asset->Select(req->getHeader("accept-encoding"));
+    if (req->getHeader("if-none-match").find(variant.etag) != std::string_view::npos) {
+        res->writeStatus(ResponseCodes::HTTP_304_NOT_MODIFIED);
+        res->writeHeader("ETag", variant.etag);
+        res->writeHeader("Cache-Control", asset->cacheControl);
+        res->writeHeader("Vary", "Accept-Encoding");
         res->writeHeader("Access-Control-Allow-Origin", "*");
-        res->end(file.value());
+        res->end();
+        return;
     }
-}
 
-std::vector<fs::path> listFiles() {
-    if (fs::exists(videoFolder) && fs::is_directory(videoFolder)) {
-        std::vector<fs::path> files;
-        auto iterator = fs::directory_iterator(videoFolder);
-        std::copy_if(fs::begin(iterator), fs::end(iterator), std::back_inserter(files),
-            [](auto it) { return !fs::is_directory(it); });
-        return files;
+    res->writeStatus(ResponseCodes::HTTP_200_OK);
+    res->writeHeader("content-type", asset->contentType);
+    if (not variant.encoding.empty()) {
+        res->writeHeader("Content-Encoding", variant.encoding);
     }
-    return {};
+    res->writeHeader("ETag", variant.etag);
+    res->writeHeader("Cache-Control", asset->cacheControl);
+    res->writeHeader("Vary", "Accept-Encoding");
+    res->writeHeader("Access-Control-Allow-Origin", "*");
+    res->end(variant.body);
 }
 
 const auto frontendRoot = fs::current_path().parent_path() / "frontend/build";
 
-void getRoot(uWS::HttpResponse<false> *res, uWS::HttpRequest *req) { serveFile(res, frontendRoot / "index.html"); }
-
-void getFile(uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
+void getFile(uWS::HttpResponse<false> *res, uWS::HttpRequest *req, AssetCache &frontend) {
     // cut off '/' or c++ will interpret it as root path
     const auto requestUrl = req->getUrl();
     std::string url = requestUrl[0] == '/' ? std::string(requestUrl).substr(1) : std::string(requestUrl);
@@ -95,38 +168,74 @@ void getFile(uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
         url = "index.html";
     }
 
-    url = frontendRoot / url;
-    serveFile(res, url);
+    serveAsset(res, req, frontend, url);
 }
 
-std::string thumbnailFilename(const std::string &filename) { return std::format("{}.thumb.webp", filename); }
 std::string thumbnailPath(const std::string &filename) {
     return std::format("videos/thumbnails/{}", thumbnailFilename(filename));
 }
 
-void getVideos(uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
-    auto files = listFiles();
-    std::vector<nlohmann::json> fileNames;
-    std::transform(
-        files.begin(), files.end(), std::back_inserter(fileNames), [](const fs::path &path) -> nlohmann::json {
-            nlohmann::json entry{
-                {"filename", std::string(path.filename())}, {"thumbnail", thumbnailFilename(path.filename())}};
-            if (const auto duration = getVideoDuration(path); duration.has_value()) {
-                entry["duration"] = duration.value();
-            }
-            return entry;
-        });
-    auto json = nlohmann::json({{"videos", fileNames}});
+void getVideos(uWS::HttpResponse<false> *res, uWS::HttpRequest *req, const MediaIndex &index) {
+    const auto listing = index.GetListing();
+
+    if (req->getHeader("if-none-match") == listing.etag) {
+        res->writeStatus(ResponseCodes::HTTP_304_NOT_MODIFIED);
+        res->writeHeader("ETag", listing.etag);
+        res->writeHeader("Access-Control-Allow-Origin", "*");
+        res->end();
+        return;
+    }
 
     res->writeStatus(ResponseCodes::HTTP_200_OK);
     res->writeHeader("content-type", "application/json");
+    res->writeHeader("ETag", listing.etag);
+    res->writeHeader("Cache-Control", "no-cache");
     res->writeHeader("Access-Control-Allow-Origin", "*");
-    res->end(json.dump());
+    res->end(*listing.body);
+}
+
+// upload progress is pushed at most this often per upload
+const auto UploadProgressInterval = std::chrono::milliseconds(250);
+
+nlohmann::json uploadEvent(const fs::path &path, std::string_view stage, uintmax_t received, uintmax_t total) {
+    nlohmann::json event{
+        {"event", "upload"}, {"file", path.filename().string()}, {"stage", stage}, {"received", received}};
+    if (total > 0) {
+        event["total"] = total;
+    }
+    return event;
+}
+
+// stops a video that was played while it was uploaded, once its upload failed
+void stopUploadPlayback(VideoPlayer &player, const fs::path &path) {
+    if (player.GetCurrentFile() == path) {
+        player.Play(std::make_unique<IdleDecoder>());
+    }
 }
 
-void postVideo(uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
+// a name an upload may be stored under: no directories, nothing hidden, nothing a tool would take for an option, and
+// no control characters, which would end up in listings and logs
+bool acceptableUploadName(const std::string &filename) {
+    if (filename.empty() || filename.size() > 255 || filename[0] == '.' || filename[0] == '-') {
+        return false;
+    }
+    return std::none_of(filename.begin(), filename.end(), [](char c) {
+        const auto byte = static_cast<unsigned char>(c);
+        return byte < 0x20 || byte == 0x7F || c == '/' || c == '\\';
+    });
+}
+
+void postVideo(uWS::HttpResponse<false> *res, uWS::HttpRequest *req, UploadWriter &writer, Thumbnailer &thumbnailer,
+    uWS::Loop *loop, ControlChannel &control, VideoPlayer &player, const Configuration::Uploads &configuration) {
     auto urlDecoded = UrlDecode(std::string(req->getParameter(0)));
-    auto *path = new fs::path(videoFolder / fs::path(urlDecoded).filename());
+    auto path = videoFolder / fs::path(urlDecoded).filename();
+    if (not acceptableUploadName(path.filename().string())) {
+        respondStatus(res, ResponseCodes::HTTP_400_BAD_REQUEST);
+        return;
+    }
+    // ?play=1 starts playback as soon as enough of the file is there
+    const auto play = req->getQuery("play");
+    const bool playWhileUploading = not play.empty() && play != "0";
 
     if (!fs::exists(videoFolder)) {
         fs::create_directory(videoFolder);
@@ -135,77 +244,947 @@ void postVideo(uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
         fs::create_directory(videoFolder / "thumbnails");
     }
 
-    if (exists(*path)) {
-        res->writeStatus(ResponseCodes::HTTP_409_CONFLICT);
-        res->writeHeader("Access-Control-Allow-Origin", "*");
-        res->end();
+    // everything but the writer's callbacks runs on the server thread, res is only valid while not aborted
+    struct State {
+        std::shared_ptr<UploadWriter::Upload> upload;
+        bool aborted{};
+        bool paused{};
+        bool finished{};
+        uintmax_t received{};
+        uintmax_t total{};
+        std::chrono::steady_clock::time_point lastProgress{};
+    };
+    auto state = std::make_shared<State>();
+    const auto contentLength = req->getHeader("content-length");
+    std::from_chars(contentLength.data(), contentLength.data() + contentLength.size(), state->total);
+    auto growing = playWhileUploading ? std::make_shared<GrowingFile>(path, state->total) : nullptr;
+    // weak, the upload holding its own state would never be freed
+    state->upload = writer.Open(
+        path,
+        [res, weak = std::weak_ptr<State>(state), loop]() {
+            loop->defer([res, weak]() {
+                auto current = weak.lock();
+                if (current && not current->aborted && current->paused) {
+                    current->paused = false;
+                    res->resume();
+                }
+            });
+        },
+        growing);
+    if (not state->upload) {
+        respondStatus(
+            res, exists(path) ? ResponseCodes::HTTP_409_CONFLICT : ResponseCodes::HTTP_500_INTERNAL_SERVER_ERROR);
         return;
     }
+    if (growing) {
+        player.PlayGrowing(std::move(growing), std::chrono::milliseconds(configuration.stallTimeoutMs));
+    }
 
-    FILE *out = fopen(path->c_str(), "wb");
+    res->onData([res, state, path, &writer, &thumbnailer, loop, &control, &player](
+                    std::string_view chunk, bool isLast) {
+        if (not writer.Append(state->upload, chunk) && not state->paused) {
+            state->paused = true;
+            res->pause();
+        }
+        state->received += chunk.size();
+        if (not isLast) {
+            const auto now = std::chrono::steady_clock::now();
+            if (now - state->lastProgress >= UploadProgressInterval) {
+                state->lastProgress = now;
+                control.Publish(uploadEvent(path, "receiving", state->received, state->total));
+            }
+            return;
+        }
 
-    res->onData([res, out, path](std::string_view chunk, bool isLast) {
-        fwrite(chunk.data(), chunk.size(), 1, out);
+        state->finished = true;
+        writer.Finish(state->upload,
+            [res, state, path, loop, &thumbnailer, &control, &player](const UploadWriter::Result &result) {
+                const bool success = result.success;
+                loop->defer([res, state, path, success, &control, &player]() {
+                    // the thumbnail is made next, the library event announces it
+                    control.Publish(
+                        uploadEvent(path, success ? "thumbnail" : "failed", state->received, state->total));
+                    if (not success) {
+                        stopUploadPlayback(player, path);
+                    }
+                    if (not state->aborted) {
+                        // a paused socket would not flush the reply either
+                        if (std::exchange(state->paused, false)) {
+                            res->resume();
+                        }
+                        respondStatus(res, success ? ResponseCodes::HTTP_204_NO_CONTENT
+                                                   : ResponseCodes::HTTP_500_INTERNAL_SERVER_ERROR);
+                    }
+                });
+                // the writer goes on with other uploads while ffmpeg runs
+                if (success) {
+                    thumbnailer.Queue(path, thumbnailPath(path.filename()), [state, path, loop, &control]() {
+                        loop->defer([state, path, &control]() {
+                            control.Publish(uploadEvent(path, "done", state->received, state->total));
+                        });
+                    });
+                }
+            });
+    });
 
-        if (isLast) {
-            fclose(out);
+    res->onAborted([state, path, &writer, &control, &player]() {
+        state->aborted = true;
+        // a complete upload is kept even if the client left before the reply
+        if (not state->finished) {
+            writer.Abort(state->upload);
+            control.Publish(uploadEvent(path, "failed", state->received, state->total));
+            stopUploadPlayback(player, path);
+        }
+    });
+}
 
-            std::system(std::format(
-                "ffmpeg -i {} -filter:v thumbnail=500 -frames:v 1 {}", path->c_str(), thumbnailPath(path->filename()))
-                            .c_str());
+void getUploads(uWS::HttpResponse<false> *res, uWS::HttpRequest *req, const UploadWriter &writer,
+    const UploadSessions &sessions, VideoPlayer &player) {
+    const auto stats = writer.GetStats();
+    const auto resumable = sessions.GetStats();
+    const auto progressive = player.GetProgressiveStats();
 
-            delete path;
+    const auto toMs = [](std::chrono::microseconds us) { return static_cast<double>(us.count()) / 1000.; };
+    nlohmann::json playback{{"started", progressive.started},
+        {"waitedForCompletion", progressive.waitedForCompletion}, {"cancelled", progressive.cancelled},
+        {"stalls", progressive.stalls}};
+    if (progressive.firstFrames > 0) {
+        playback["uploadToFirstFrameMs"] = {{"last", toMs(progressive.lastFirstFrame)},
+            {"min", toMs(progressive.minFirstFrame)},
+            {"average", toMs(progressive.totalFirstFrame) / progressive.firstFrames}};
+    }
 
-            res->writeStatus(ResponseCodes::HTTP_204_NO_CONTENT);
-            res->writeHeader("Access-Control-Allow-Origin", "*");
-            res->end();
+    respondJson(res, {{"active", stats.active}, {"completed", stats.completed}, {"failed", stats.failed},
+                         {"bytes", stats.bytes}, {"lastMBps", stats.lastMBps}, {"averageMBps", stats.averageMBps},
+                         {"pauses", stats.pauses}, {"checksumMismatches", stats.checksumMismatches},
+                         {"maxFsyncUs", stats.maxFsyncTime}, {"loopStallUs", stats.loopTime},
+                         {"maxLoopStallUs", stats.maxLoopTime},
+                         {"sessions", {{"active", resumable.sessions}, {"created", resumable.created},
+                                          {"completed", resumable.completed}, {"expired", resumable.expired},
+                                          {"terminated", resumable.terminated},
+                                          {"committedBytes", resumable.committedBytes},
+                                          {"discardedBytes", resumable.discardedBytes}}},
+                         {"playWhileUploading", std::move(playback)}});
+}
+
+namespace Tus {
+const auto Version = "1.0.0";
+const auto Extensions = "creation,checksum,termination,expiration";
+// scripts in a browser only get to see these if they are listed
+const auto ExposedHeaders = "Location, Upload-Offset, Upload-Length, Upload-Expires, Tus-Resumable, Tus-Version, "
+                            "Tus-Extension, Tus-Checksum-Algorithm";
+} // namespace Tus
+
+void respondTus(uWS::HttpResponse<false> *res, const char *status, const std::optional<UploadSession> &session = {},
+    std::string_view location = {}) {
+    res->writeStatus(status);
+    if (not location.empty()) {
+        res->writeHeader("Location", location);
+    }
+    res->writeHeader("Tus-Resumable", Tus::Version);
+    res->writeHeader("Cache-Control", "no-store");
+    if (session.has_value()) {
+        res->writeHeader("Upload-Offset", std::to_string(session->offset));
+        res->writeHeader("Upload-Length", std::to_string(session->length));
+    }
+    if (session.has_value() && session->expires != std::chrono::system_clock::time_point()) {
+        std::array<char, 64> expires{};
+        const auto time = std::chrono::system_clock::to_time_t(session->expires);
+        std::tm tm{};
+        gmtime_r(&time, &tm);
+        std::strftime(expires.data(), expires.size(), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+        res->writeHeader("Upload-Expires", expires.data());
+    }
+    res->writeHeader("Access-Control-Allow-Origin", "*");
+    res->writeHeader("Access-Control-Expose-Headers", Tus::ExposedHeaders);
+    res->end();
+}
+
+std::optional<uintmax_t> parseHeaderNumber(std::string_view text) {
+    uintmax_t value{};
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (text.empty() || error != std::errc() || end != text.data() + text.size()) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+// one value of an Upload-Metadata header: comma separated keys, each followed by a space and its value in base64
+std::optional<std::string> metadataValue(std::string_view metadata, std::string_view key) {
+    while (not metadata.empty()) {
+        const auto comma = metadata.find(',');
+        auto pair = metadata.substr(0, comma);
+        metadata = comma == std::string_view::npos ? std::string_view() : metadata.substr(comma + 1);
+
+        while (not pair.empty() && pair.front() == ' ') {
+            pair.remove_prefix(1);
         }
-    });
+        const auto space = pair.find(' ');
+        if (pair.substr(0, space) == key) {
+            return space == std::string_view::npos ? std::optional<std::string>(std::string())
+                                                   : decodeBase64(pair.substr(space + 1));
+        }
+    }
+    return std::nullopt;
+}
 
-    res->onAborted([res, out, path]() {
-        fclose(out);
-        remove(*path);
-        delete path;
+void optionsUploads(uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
+    res->writeStatus(ResponseCodes::HTTP_204_NO_CONTENT);
+    res->writeHeader("Tus-Resumable", Tus::Version);
+    res->writeHeader("Tus-Version", Tus::Version);
+    res->writeHeader("Tus-Extension", Tus::Extensions);
+    res->writeHeader("Tus-Checksum-Algorithm", Checksum::Algorithms);
+    res->writeHeader("Access-Control-Allow-Origin", "*");
+    res->writeHeader("Access-Control-Allow-Methods", "POST, HEAD, PATCH, DELETE, OPTIONS");
+    res->writeHeader("Access-Control-Allow-Headers", "Content-Type, Upload-Offset, Upload-Length, Upload-Metadata, "
+                                                     "Upload-Checksum, Tus-Resumable, X-Requested-With");
+    res->writeHeader("Access-Control-Expose-Headers", Tus::ExposedHeaders);
+    res->writeHeader("Access-Control-Max-Age", "86400");
+    res->end();
+}
 
-        res->writeStatus(ResponseCodes::HTTP_400_BAD_REQUEST);
+// false after answering 412 to a client speaking another protocol version
+bool checkTusVersion(uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
+    const auto version = req->getHeader("tus-resumable");
+    if (not version.empty() && version != Tus::Version) {
+        res->writeStatus(ResponseCodes::HTTP_412_PRECONDITION_FAILED);
+        res->writeHeader("Tus-Version", Tus::Version);
         res->writeHeader("Access-Control-Allow-Origin", "*");
         res->end();
+        return false;
+    }
+    return true;
+}
+
+void postUploadSession(uWS::HttpResponse<false> *res, uWS::HttpRequest *req, UploadSessions &sessions) {
+    if (not checkTusVersion(res, req)) {
+        return;
+    }
+    const auto length = parseHeaderNumber(req->getHeader("upload-length"));
+    const auto name = metadataValue(req->getHeader("upload-metadata"), "filename");
+    const auto filename = fs::path(name.value_or(std::string())).filename().string();
+    if (not length.has_value() || not acceptableUploadName(filename)) {
+        respondTus(res, ResponseCodes::HTTP_400_BAD_REQUEST);
+        return;
+    }
+    if (fs::exists(videoFolder / filename) || sessions.IsTarget(filename)) {
+        respondTus(res, ResponseCodes::HTTP_409_CONFLICT);
+        return;
+    }
+    // refused now rather than after the card filled up halfway through
+    if (std::error_code error; length.value() > fs::space(videoFolder, error).available) {
+        respondTus(res, ResponseCodes::HTTP_413_PAYLOAD_TOO_LARGE);
+        return;
+    }
+
+    const auto session = sessions.Create(filename, length.value());
+    if (not session.has_value()) {
+        respondTus(res, ResponseCodes::HTTP_500_INTERNAL_SERVER_ERROR);
+        return;
+    }
+    respondTus(res, ResponseCodes::HTTP_201_CREATED, session, std::format("/uploads/{}", session->id));
+}
+
+void headUploadSession(uWS::HttpResponse<false> *res, uWS::HttpRequest *req, const UploadSessions &sessions) {
+    const auto session = sessions.Find(req->getParameter(0));
+    respondTus(res, session.has_value() ? ResponseCodes::HTTP_200_OK : ResponseCodes::HTTP_404_NOT_FOUND, session);
+}
+
+void deleteUploadSession(uWS::HttpResponse<false> *res, uWS::HttpRequest *req, UploadSessions &sessions) {
+    const auto id = req->getParameter(0);
+    if (not sessions.Find(id).has_value()) {
+        respondTus(res, ResponseCodes::HTTP_404_NOT_FOUND);
+        return;
+    }
+    respondTus(res, sessions.Terminate(id) ? ResponseCodes::HTTP_204_NO_CONTENT : ResponseCodes::HTTP_423_LOCKED);
+}
+
+/**
+ * One chunk of a resumable upload. It is written like any other upload, then fsynced and committed before the reply;
+ * if the connection drops, whatever arrived is kept unless the chunk came with a checksum, which it cannot match.
+ */
+void patchUploadSession(uWS::HttpResponse<false> *res, uWS::HttpRequest *req, UploadSessions &sessions,
+    UploadWriter &writer, Thumbnailer &thumbnailer, uWS::Loop *loop, ControlChannel &control) {
+    if (not checkTusVersion(res, req)) {
+        return;
+    }
+    const auto id = std::string(req->getParameter(0));
+    const auto session = sessions.Find(id);
+    if (not session.has_value()) {
+        respondTus(res, ResponseCodes::HTTP_404_NOT_FOUND);
+        return;
+    }
+    if (req->getHeader("content-type") != "application/offset+octet-stream") {
+        respondTus(res, ResponseCodes::HTTP_415_UNSUPPORTED_MEDIA_TYPE);
+        return;
+    }
+    const auto offset = parseHeaderNumber(req->getHeader("upload-offset"));
+    std::optional<Checksum> checksum;
+    if (const auto header = req->getHeader("upload-checksum"); not header.empty()) {
+        checksum = Checksum::FromHeader(header);
+        if (not checksum.has_value()) {
+            respondTus(res, ResponseCodes::HTTP_400_BAD_REQUEST);
+            return;
+        }
+    }
+    if (not offset.has_value()) {
+        respondTus(res, ResponseCodes::HTTP_400_BAD_REQUEST);
+        return;
+    }
+    if (offset.value() != session->offset) {
+        // typically a client that lost the reply to its last chunk, the header tells it where to go on
+        respondTus(res, ResponseCodes::HTTP_409_CONFLICT, session);
+        return;
+    }
+    const auto contentLength = parseHeaderNumber(req->getHeader("content-length"));
+    if (contentLength.has_value() && offset.value() + contentLength.value() > session->length) {
+        respondTus(res, ResponseCodes::HTTP_413_PAYLOAD_TOO_LARGE, session);
+        return;
+    }
+    // one chunk at a time; a client that reconnected before the old connection timed out retries on this
+    if (not sessions.Acquire(id)) {
+        respondTus(res, ResponseCodes::HTTP_423_LOCKED, session);
+        return;
+    }
+
+    struct State {
+        std::shared_ptr<UploadWriter::Upload> upload;
+        bool aborted{};
+        bool paused{};
+        bool finished{};
+        uintmax_t received{};
+    };
+    auto state = std::make_shared<State>();
+    state->upload = writer.Resume(sessions.GetPartPath(id), offset.value(), std::move(checksum),
+        [res, weak = std::weak_ptr<State>(state), loop]() {
+            loop->defer([res, weak]() {
+                auto current = weak.lock();
+                if (current && not current->aborted && current->paused) {
+                    current->paused = false;
+                    res->resume();
+                }
+            });
+        });
+    if (not state->upload) {
+        sessions.Commit(id, offset.value(), 0);
+        respondTus(res, ResponseCodes::HTTP_500_INTERNAL_SERVER_ERROR);
+        return;
+    }
+
+    const auto path = videoFolder / session->filename;
+    const auto length = session->length;
+    // the end of the body and a dropped connection both end the chunk
+    auto finish = [res, state, id, path, start = offset.value(), length, &sessions, &writer, &thumbnailer, loop,
+                      &control]() {
+        state->finished = true;
+        writer.Finish(state->upload, [=, &sessions, &thumbnailer, &control](const UploadWriter::Result &result) {
+            const uintmax_t committed = start + static_cast<uintmax_t>(result.written);
+            const auto progress = sessions.Commit(id, committed,
+                static_cast<long long>(state->received) - static_cast<long long>(result.written));
+            const auto complete = progress == UploadSessions::Progress::Complete;
+
+            loop->defer([=, &sessions, &control]() {
+                control.Publish(uploadEvent(path, complete ? "thumbnail" : "receiving", committed, length));
+                if (state->aborted) {
+                    return;
+                }
+                if (std::exchange(state->paused, false)) {
+                    res->resume();
+                }
+                const char *status = ResponseCodes::HTTP_204_NO_CONTENT;
+                if (not result.checksumMatched) {
+                    status = ResponseCodes::HTTP_460_CHECKSUM_MISMATCH;
+                } else if (not result.success) {
+                    status = ResponseCodes::HTTP_500_INTERNAL_SERVER_ERROR;
+                } else if (progress == UploadSessions::Progress::Conflict) {
+                    status = ResponseCodes::HTTP_409_CONFLICT;
+                }
+                // a complete session is gone, its offset is the length and it expires no more
+                auto current = sessions.Find(id);
+                if (not current.has_value()) {
+                    current.emplace();
+                    current->length = length;
+                    current->offset = committed;
+                }
+                respondTus(res, status, current);
+            });
+            if (complete) {
+                thumbnailer.Queue(path, thumbnailPath(path.filename()), [=, &control]() {
+                    loop->defer([=, &control]() { control.Publish(uploadEvent(path, "done", committed, length)); });
+                });
+            }
+        });
+    };
+
+    res->onData([res, state, &writer, length, start = offset.value(), finish](std::string_view chunk, bool isLast) {
+        if (state->finished) {
+            return;
+        }
+        if (start + state->received + chunk.size() > length) {
+            // more than announced, keep what fits and refuse the rest
+            chunk = chunk.substr(0, static_cast<size_t>(length - start - state->received));
+            isLast = true;
+        }
+        if (not writer.Append(state->upload, chunk) && not state->paused) {
+            state->paused = true;
+            res->pause();
+        }
+        state->received += chunk.size();
+        if (isLast) {
+            finish();
+        }
+    });
+    res->onAborted([state, finish]() {
+        state->aborted = true;
+        if (not state->finished) {
+            finish();
+        }
     });
 }
 
-void deleteVideo(uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
+std::string_view videoContentType(const fs::path &path) {
+    const auto extension = path.extension().string();
+    if (extension == ".mp4" || extension == ".m4v") {
+        return "video/mp4";
+    }
+    if (extension == ".webm") {
+        return "video/webm";
+    }
+    if (extension == ".mkv") {
+        return "video/x-matroska";
+    }
+    if (extension == ".gif") {
+        return "image/gif";
+    }
+    return "application/octet-stream";
+}
+
+void getVideo(uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
     auto urlDecoded = UrlDecode(std::string(req->getParameter(0)));
     auto path = videoFolder / fs::path(urlDecoded).filename();
-    fs::remove(videoFolder / fs::path(urlDecoded).filename());
-    fs::remove(thumbnailPath(fs::path(urlDecoded).filename()));
+    FileStreamer::Serve(res, req, path, videoContentType(path));
+}
 
-    res->writeStatus(ResponseCodes::HTTP_204_NO_CONTENT);
-    res->writeHeader("Access-Control-Allow-Origin", "*");
-    res->end();
+// commands below are shared by the REST routes and the control channel
+
+CommandResult deleteVideoFile(std::string_view filename) {
+    const auto name = fs::path(filename).filename();
+    fs::remove(videoFolder / name);
+    fs::remove(thumbnailPath(name));
+    return {ResponseCodes::HTTP_204_NO_CONTENT};
 }
 
-void postPlayFile(uWS::HttpResponse<false> *res, uWS::HttpRequest *req, VideoPlayer &player) {
-    auto urlDecoded = UrlDecode(std::string(req->getParameter(0)));
-    auto path = videoFolder / fs::path(urlDecoded).filename();
+void deleteVideo(uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
+    respondResult(res, deleteVideoFile(UrlDecode(std::string(req->getParameter(0)))));
+}
+
+CommandResult playFile(VideoPlayer &player, std::string_view filename) {
+    auto path = videoFolder / fs::path(filename).filename();
     if (not player.PlayFile(path)) {
-        std::cerr << "Could not find file " << path << std::endl;
-        res->writeStatus(ResponseCodes::HTTP_404_NOT_FOUND);
-        res->writeHeader("content-type", "text/html");
-        res->writeHeader("Access-Control-Allow-Origin", "*");
-        res->end(RESPONSE_404);
+        std::cerr << "Could not play file " << path << std::endl;
+        return {ResponseCodes::HTTP_404_NOT_FOUND};
+    }
+    return {ResponseCodes::HTTP_204_NO_CONTENT};
+}
+
+void postPlayFile(uWS::HttpResponse<false> *res, uWS::HttpRequest *req, VideoPlayer &player) {
+    respondResult(res, playFile(player, UrlDecode(std::string(req->getParameter(0)))));
+}
+
+nlohmann::json playlistJson(VideoPlayer &player) {
+    const auto playlist = player.GetPlaylist();
+    const auto stats = player.GetTransitionStats();
+
+    const auto toMs = [](std::chrono::microseconds us) { return static_cast<double>(us.count()) / 1000.; };
+    nlohmann::json transitions{{"count", stats.transitions}, {"prefetchHits", stats.prefetchHits},
+        {"prefetchMisses", stats.prefetchMisses}};
+    if (stats.transitions > 0) {
+        transitions["gapMs"] = {{"last", toMs(stats.lastGap)}, {"min", toMs(stats.minGap)},
+            {"max", toMs(stats.maxGap)}, {"average", toMs(stats.totalGap) / stats.transitions}};
+        transitions["expectedGapMs"] = toMs(stats.lastExpected);
+    }
+
+    return {{"playlist", playlist.has_value() ? playlist->ToJson() : nlohmann::json()},
+        {"transitions", std::move(transitions)}};
+}
+
+void getPlaylist(uWS::HttpResponse<false> *res, uWS::HttpRequest *req, VideoPlayer &player) {
+    respondJson(res, playlistJson(player));
+}
+
+CommandResult setPlaylist(VideoPlayer &player, const nlohmann::json &json) {
+    auto playlist = Playlist::FromJson(json, videoFolder);
+    if (not playlist.has_value()) {
+        return {ResponseCodes::HTTP_400_BAD_REQUEST};
+    }
+    player.PlayPlaylist(std::move(playlist.value()));
+    return {ResponseCodes::HTTP_204_NO_CONTENT};
+}
+
+void putPlaylist(uWS::HttpResponse<false> *res, uWS::HttpRequest *req, VideoPlayer &player) {
+    readJsonBody(res, [&player](uWS::HttpResponse<false> *response, const nlohmann::json &json) {
+        respondResult(response, setPlaylist(player, json));
+    });
+}
+
+CommandResult seek(VideoPlayer &player, MediaIndex &index, double seconds) {
+    if (seconds < 0) {
+        return {ResponseCodes::HTTP_400_BAD_REQUEST};
+    }
+    const auto file = player.GetCurrentFile();
+    const auto keyframes = file.has_value() ? index.GetKeyframes(file->filename()) : nullptr;
+    const auto result = player.Seek(seconds, keyframes.get());
+    if (not result.has_value()) {
+        return {ResponseCodes::HTTP_404_NOT_FOUND};
+    }
+
+    const auto stats = player.GetSeekStats();
+    const auto toMs = [](std::chrono::microseconds us) { return static_cast<double>(us.count()) / 1000.; };
+    return {ResponseCodes::HTTP_200_OK,
+        {{"position", result->position}, {"latencyMs", toMs(result->latency)},
+            {"skippedFrames", result->skippedFrames}, {"budgetExceeded", result->budgetExceeded},
+            {"indexed", keyframes != nullptr},
+            {"stats", {{"seeks", stats.seeks}, {"maxLatencyMs", toMs(stats.maxLatency)},
+                          {"averageLatencyMs", toMs(stats.totalLatency) / stats.seeks},
+                          {"budgetExceeded", stats.budgetExceeded}}}}};
+}
+
+void postSeek(uWS::HttpResponse<false> *res, uWS::HttpRequest *req, VideoPlayer &player, MediaIndex &index) {
+    const auto parameter = std::string(req->getParameter(0));
+    char *end{};
+    const double seconds = std::strtod(parameter.c_str(), &end);
+    if (parameter.empty() || *end != '\0') {
+        respondStatus(res, ResponseCodes::HTTP_400_BAD_REQUEST);
         return;
     }
+    respondResult(res, seek(player, index, seconds));
+}
 
-    res->writeStatus(ResponseCodes::HTTP_204_NO_CONTENT);
+CommandResult showText(VideoPlayer &player, const nlohmann::json &json, const Configuration::Text &configuration) {
+    if (not json.is_object() || not json.contains("text") || not json["text"].is_string()) {
+        return {ResponseCodes::HTTP_400_BAD_REQUEST};
+    }
+
+    TextStyle style;
+    style.x = json.value("x", 0);
+    style.y = json.value("y", 0);
+    style.intensity = static_cast<uint8_t>(std::clamp(json.value("intensity", 15), 0, 15));
+    style.scrollSpeed = json.value("scroll", 0);
+    style.wavy = json.value("wavy", false);
+    style.waveAmplitude = json.value("amplitude", style.waveAmplitude);
+
+    try {
+        player.Play(std::make_unique<TextDecoder>(json["text"].get<std::string>(), style, configuration.font,
+            json.value("size", configuration.size), player.GetWidth(), player.GetHeight(), player.GetFormat()));
+    } catch (const std::exception &e) {
+        std::cerr << "Could not show text: " << e.what() << std::endl;
+        return {ResponseCodes::HTTP_500_INTERNAL_SERVER_ERROR};
+    }
+    return {ResponseCodes::HTTP_204_NO_CONTENT};
+}
+
+void postText(uWS::HttpResponse<false> *res, uWS::HttpRequest *req, VideoPlayer &player,
+    const Configuration::Text &configuration) {
+    readJsonBody(res, [&player, &configuration](uWS::HttpResponse<false> *response, const nlohmann::json &json) {
+        respondResult(response, showText(player, json, configuration));
+    });
+}
+
+CommandResult playAnimation(VideoPlayer &player, const nlohmann::json &json, int frameRate,
+    std::shared_ptr<AnimationStats> &current) {
+    auto scene = Scene::FromJson(json);
+    if (not scene.has_value()) {
+        return {ResponseCodes::HTTP_400_BAD_REQUEST};
+    }
+    current = std::make_shared<AnimationStats>();
+    player.Play(std::make_unique<AnimationDecoder>(std::move(scene.value()), player.GetWidth(), player.GetHeight(),
+        player.GetFormat(), std::chrono::microseconds(1000000 / frameRate), current));
+    return {ResponseCodes::HTTP_204_NO_CONTENT};
+}
+
+void postAnimation(uWS::HttpResponse<false> *res, uWS::HttpRequest *req, VideoPlayer &player, int frameRate,
+    std::shared_ptr<AnimationStats> &current) {
+    readJsonBody(res, [&player, frameRate, &current](uWS::HttpResponse<false> *response, const nlohmann::json &json) {
+        respondResult(response, playAnimation(player, json, frameRate, current));
+    });
+}
+
+void getAnimation(uWS::HttpResponse<false> *res, uWS::HttpRequest *req, const AnimationStats *stats) {
+    if (stats == nullptr) {
+        respondStatus(res, ResponseCodes::HTTP_404_NOT_FOUND);
+        return;
+    }
+    const long long frames = stats->frames;
+    respondJson(res, {{"frames", frames}, {"budgetUs", stats->budget.count()},
+                         {"averageRenderUs", frames > 0 ? stats->renderTime / frames : 0},
+                         {"maxRenderUs", stats->maxRenderTime.load()}, {"overBudget", stats->overBudget.load()}});
+}
+
+std::optional<int> parseLayerId(uWS::HttpRequest *req) {
+    const auto parameter = std::string(req->getParameter(0));
+    char *end{};
+    const long id = std::strtol(parameter.c_str(), &end, 10);
+    if (parameter.empty() || *end != '\0' || id < 0) {
+        return std::nullopt;
+    }
+    return static_cast<int>(id);
+}
+
+// fields missing from the json keep their value from placement, nullopt on an unknown blend mode
+std::optional<LayerPlacement> readPlacement(const nlohmann::json &json, LayerPlacement placement) {
+    placement.x = json.value("x", placement.x);
+    placement.y = json.value("y", placement.y);
+    placement.opacity = static_cast<uint8_t>(std::clamp(json.value("opacity", int{placement.opacity}), 0, 15));
+    placement.visible = json.value("visible", placement.visible);
+    if (json.contains("blend")) {
+        const auto blend = json["blend"].is_string() ? parseBlendMode(json["blend"].get<std::string>()) : std::nullopt;
+        if (not blend.has_value()) {
+            return std::nullopt;
+        }
+        placement.blend = blend.value();
+    }
+    return placement;
+}
+
+nlohmann::json layersJson(const Compositor &compositor) {
+    auto layers = nlohmann::json::array();
+    for (const auto &layer : compositor.GetLayers()) {
+        layers.push_back({{"id", layer.id}, {"type", layer.type}, {"width", layer.width}, {"height", layer.height},
+            {"x", layer.placement.x}, {"y", layer.placement.y}, {"opacity", layer.placement.opacity},
+            {"blend", toString(layer.placement.blend)}, {"visible", layer.placement.visible}});
+    }
+
+    const auto stats = compositor.GetStats();
+    const auto frames = std::max(stats.frames, 1LL);
+    return {{"layers", std::move(layers)},
+        {"stats", {{"frames", stats.frames}, {"idleFrames", stats.idleFrames},
+                      {"averageComposedPixels", stats.composedPixels / frames}, {"blends", stats.blends},
+                      {"skippedBlends", stats.skippedBlends}}}};
+}
+
+void getLayers(uWS::HttpResponse<false> *res, uWS::HttpRequest *req, const Compositor &compositor) {
+    respondJson(res, layersJson(compositor));
+}
+
+// layers are held in memory at full size, whatever lies off screen included
+const auto MaxLayerSize = 1024;
+
+std::shared_ptr<Layer> makeLayer(
+    const nlohmann::json &json, PixelFormat format, const Configuration::Text &configuration) {
+    const auto type = json.value("type", std::string());
+    const int width = json.value("width", 0);
+    const int height = json.value("height", 0);
+    if (width > MaxLayerSize || height > MaxLayerSize) {
+        return nullptr;
+    }
+
+    if (type == "solid" && width > 0 && height > 0) {
+        return std::make_shared<SolidLayer>(width, height, format,
+            static_cast<uint8_t>(std::clamp(json.value("intensity", 15), 0, 15)));
+    }
+    if (type == "sprite" && json.contains("pixels") && json["pixels"].is_array()) {
+        // one 0-15 value per pixel, row by row
+        return std::make_shared<SpriteLayer>(width, height, format, json["pixels"].get<std::vector<uint8_t>>());
+    }
+    if (type == "text" && json.contains("text") && json["text"].is_string()) {
+        TextStyle style;
+        style.intensity = static_cast<uint8_t>(std::clamp(json.value("intensity", 15), 0, 15));
+        style.scrollSpeed = json.value("scroll", 0);
+        style.wavy = json.value("wavy", false);
+        style.waveAmplitude = json.value("amplitude", style.waveAmplitude);
+        auto layer = std::make_shared<TextLayer>(json["text"].get<std::string>(), style, configuration.font,
+            json.value("size", configuration.size), width, format);
+        // fitted to an empty text, or one the font has none of the characters of
+        return layer->GetSurface().width > 0 ? layer : nullptr;
+    }
+    return nullptr;
+}
+
+CommandResult addLayer(
+    Compositor &compositor, const nlohmann::json &json, PixelFormat format, const Configuration::Text &configuration) {
+    const auto placement = json.is_object() ? readPlacement(json, {}) : std::nullopt;
+    if (not placement.has_value()) {
+        return {ResponseCodes::HTTP_400_BAD_REQUEST};
+    }
+
+    std::shared_ptr<Layer> layer;
+    try {
+        layer = makeLayer(json, format, configuration);
+    } catch (const std::exception &e) {
+        // bad sizes and pixel counts end up here as well as font errors
+        std::cerr << "Could not create layer: " << e.what() << std::endl;
+    }
+    if (layer == nullptr) {
+        return {ResponseCodes::HTTP_400_BAD_REQUEST};
+    }
+    return {ResponseCodes::HTTP_200_OK, {{"id", compositor.Add(std::move(layer), placement.value())}}};
+}
+
+void postLayer(uWS::HttpResponse<false> *res, uWS::HttpRequest *req, Compositor &compositor, PixelFormat format,
+    const Configuration::Text &configuration) {
+    readJsonBody(res,
+        [&compositor, format, &configuration](uWS::HttpResponse<false> *response, const nlohmann::json &json) {
+            respondResult(response, addLayer(compositor, json, format, configuration));
+        });
+}
+
+CommandResult updateLayer(Compositor &compositor, int id, const nlohmann::json &json) {
+    const auto current = compositor.GetPlacement(id);
+    if (not current.has_value()) {
+        return {ResponseCodes::HTTP_404_NOT_FOUND};
+    }
+    const auto placement = json.is_object() ? readPlacement(json, current.value()) : std::nullopt;
+    if (not placement.has_value()) {
+        return {ResponseCodes::HTTP_400_BAD_REQUEST};
+    }
+    if (not compositor.SetPlacement(id, placement.value())) {
+        return {ResponseCodes::HTTP_404_NOT_FOUND};
+    }
+    return {ResponseCodes::HTTP_204_NO_CONTENT};
+}
+
+void patchLayer(uWS::HttpResponse<false> *res, uWS::HttpRequest *req, Compositor &compositor) {
+    const auto id = parseLayerId(req);
+    if (not id.has_value() || not compositor.GetPlacement(id.value()).has_value()) {
+        respondStatus(res, ResponseCodes::HTTP_404_NOT_FOUND);
+        return;
+    }
+
+    readJsonBody(res, [&compositor, id = id.value()](uWS::HttpResponse<false> *response, const nlohmann::json &json) {
+        respondResult(response, updateLayer(compositor, id, json));
+    });
+}
+
+CommandResult removeLayer(Compositor &compositor, int id) {
+    // the video is the base of the stack, hide it instead
+    for (const auto &layer : compositor.GetLayers()) {
+        if (layer.id == id && layer.type == "video") {
+            return {ResponseCodes::HTTP_409_CONFLICT};
+        }
+    }
+    if (not compositor.Remove(id)) {
+        return {ResponseCodes::HTTP_404_NOT_FOUND};
+    }
+    return {ResponseCodes::HTTP_204_NO_CONTENT};
+}
+
+void deleteLayer(uWS::HttpResponse<false> *res, uWS::HttpRequest *req, Compositor &compositor) {
+    const auto id = parseLayerId(req);
+    if (not id.has_value()) {
+        respondStatus(res, ResponseCodes::HTTP_404_NOT_FOUND);
+        return;
+    }
+    respondResult(res, removeLayer(compositor, id.value()));
+}
+
+void getPreviewStats(
+    uWS::HttpResponse<false> *res, uWS::HttpRequest *req, const PreviewRing &ring, const PreviewBroadcaster &preview) {
+    const auto published = ring.GetStats();
+    const auto sent = preview.GetStats();
+    const auto averagePublish = published.published > 0 ? published.publishTime / published.published : 0;
+    respondJson(res, {{"viewers", sent.viewers}, {"published", published.published},
+                         {"averagePublishNs", averagePublish},
+                         {"maxPublishNs", published.maxPublishTime}, {"sent", sent.sent}, {"dropped", sent.dropped},
+                         {"keyframes", sent.keyframes}, {"bytes", sent.bytes},
+                         {"averageEncodeUs", sent.encodes > 0 ? sent.encodeTime / sent.encodes : 0}});
+}
+
+// a full frame of the largest panel is 8 KiB, PackBits adds at most one byte in 128
+const auto LiveMaxMessageSize = 16 * 1024;
+
+void getLiveStats(uWS::HttpResponse<false> *res, uWS::HttpRequest *req, const LiveInput &live) {
+    const auto stats = live.GetStats();
+    nlohmann::json json{{"senders", stats.senders}, {"sessions", stats.sessions}, {"received", stats.received},
+        {"keyframes", stats.keyframes}, {"deltas", stats.deltas}, {"bytes", stats.bytes}, {"lost", stats.lost},
+        {"undecodable", stats.undecodable}, {"rejected", stats.rejected}};
+
+    // of the current or last sender
+    if (const auto feed = live.GetFeedStats(); feed.has_value()) {
+        const auto toMs = [](std::chrono::microseconds us) { return static_cast<double>(us.count()) / 1000.; };
+        const auto shown = std::max(feed->shown, 1LL);
+        json["buffer"] = {{"pushed", feed->pushed}, {"shown", feed->shown}, {"skipped", feed->skipped},
+            {"late", feed->late}, {"jitterMs", toMs(feed->jitter)}, {"targetDelayMs", toMs(feed->targetDelay)},
+            {"depth", feed->depth}, {"maxDepth", feed->maxDepth}, {"averageDepth", feed->averageDepth},
+            {"bufferMs", {{"last", toMs(feed->lastBufferTime)}, {"max", toMs(feed->maxBufferTime)},
+                             {"average", toMs(feed->totalBufferTime) / static_cast<double>(shown)}}},
+            {"latencyMs", {{"last", toMs(feed->lastLatency)}, {"max", toMs(feed->maxLatency)},
+                              {"average", toMs(feed->totalLatency) / static_cast<double>(shown)}}}};
+    }
+    respondJson(res, json);
+}
+
+void getThumbnail(uWS::HttpResponse<false> *res, uWS::HttpRequest *req, AssetCache &thumbnails) {
+    serveAsset(res, req, thumbnails, UrlDecode(std::string(req->getParameter(0))));
+}
+
+void getControlStats(uWS::HttpResponse<false> *res, uWS::HttpRequest *req, const ControlChannel &control) {
+    const auto stats = control.GetStats();
+    respondJson(res, {{"clients", stats.clients}, {"commands", stats.commands}, {"failed", stats.failed},
+                         {"events", stats.events}, {"coalescedEvents", stats.coalesced},
+                         {"averageCommandUs", stats.commands > 0 ? stats.commandTime / stats.commands : 0},
+                         {"maxCommandUs", stats.maxCommandTime}});
+}
+
+// ?since= is a time on the steady clock in µs, as "now" was in an earlier answer or as clock_gettime(CLOCK_MONOTONIC)
+// gives it to other processes on the badge; only misses after it are listed
+void getRenderStats(uWS::HttpResponse<false> *res, uWS::HttpRequest *req, const DeadlineMonitor &deadlines) {
+    const auto toUs = [](std::chrono::steady_clock::time_point time) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+    };
+    const auto toMs = [](std::chrono::microseconds us) { return static_cast<double>(us.count()) / 1000.; };
+
+    long long since{};
+    const auto query = req->getQuery("since");
+    std::from_chars(query.data(), query.data() + query.size(), since);
+
+    const auto stats = deadlines.GetStats();
+    const auto averageLate = stats.misses > 0 ? toMs(stats.totalLate) / static_cast<double>(stats.misses) : 0.;
+    auto misses = nlohmann::json::array();
+    const auto from = std::chrono::steady_clock::time_point(std::chrono::microseconds(since));
+    for (const auto &miss : deadlines.GetMisses(from)) {
+        misses.push_back({{"atUs", toUs(miss.at)}, {"lateMs", toMs(miss.late)}, {"preempted", miss.preempted},
+            {"faulted", miss.faulted}});
+    }
+    const auto schedule = deadlines.GetSchedule();
+    respondJson(res, {{"nowUs", toUs(std::chrono::steady_clock::now())}, {"frames", stats.frames},
+                         {"deadlineMisses", stats.misses}, {"maxLateMs", toMs(stats.maxLate)},
+                         {"averageLateMs", averageLate},
+                         {"renderThread", {{"minorFaults", stats.minorFaults}, {"majorFaults", stats.majorFaults},
+                                              {"preemptions", stats.preemptions}}},
+                         {"realtime", {{"requested", schedule.requested}, {"fifo", schedule.fifo},
+                                          {"priority", schedule.priority}, {"memoryLocked", schedule.memoryLocked},
+                                          {"backgroundNice", schedule.backgroundNice}}},
+                         {"misses", misses}});
+}
+
+// time and CPU time are booked per mode, the draw is estimated from the CPU's share on top of what the badge idles at
+void getPowerStats(uWS::HttpResponse<false> *res, uWS::HttpRequest *req, const Governor &governor,
+    const Configuration::Power &configuration) {
+    const auto stats = governor.GetStats();
+    auto modes = nlohmann::json::object();
+    for (size_t i{0}; i < stats.modes.size(); i++) {
+        const auto &mode = stats.modes[i];
+        const auto seconds = std::chrono::duration<double>(mode.time).count();
+        const auto load = seconds > 0. ? std::chrono::duration<double>(mode.cpuTime).count() / seconds : 0.;
+        const auto milliwatts = configuration.baseMilliwatts + configuration.cpuMilliwatts * load;
+        modes[Governor::GetName(static_cast<Governor::Mode>(i))] = {{"seconds", seconds},
+            {"cpuPercent", load * 100.}, {"fps", seconds > 0. ? static_cast<double>(mode.frames) / seconds : 0.},
+            {"pushesPerSecond", seconds > 0. ? static_cast<double>(mode.pushes) / seconds : 0.},
+            {"estimatedMilliwatts", milliwatts},
+            {"hoursOnBattery", configuration.batteryWattHours > 0.
+                                   ? nlohmann::json(configuration.batteryWattHours * 1000. / milliwatts)
+                                   : nlohmann::json()}};
+    }
+    respondJson(res, {{"mode", Governor::GetName(stats.mode)},
+                         {"intervalMs", static_cast<double>(stats.interval.count()) / 1000.},
+                         {"batteryPercent", stats.batteryPercent.has_value() ? nlohmann::json(*stats.batteryPercent)
+                                                                             : nlohmann::json()},
+                         {"temperature",
+                             stats.temperature.has_value() ? nlohmann::json(*stats.temperature) : nlohmann::json()},
+                         {"throttled", stats.throttled}, {"modes", modes}});
+}
+
+// the error is the follower's timeline minus the master's, measured before each correction
+void getSyncStats(uWS::HttpResponse<false> *res, uWS::HttpRequest *req, const PeerSync &sync, VideoPlayer &player,
+    Configuration::Sync::Role role) {
+    const auto toMs = [](std::chrono::microseconds us) { return static_cast<double>(us.count()) / 1000.; };
+    const auto steadyUs = [](std::chrono::steady_clock::time_point time) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+    };
+    const auto stats = sync.GetStats();
+    const auto timeline = player.GetTimeline();
+    nlohmann::json lastShown;
+    if (timeline.has_value() && timeline->lastShown.has_value()) {
+        lastShown = {{"ptsUs", static_cast<int64_t>(timeline->lastShown->presentationTime * 1000.)},
+            {"shownAtUs", steadyUs(timeline->lastShown->shownAt)}};
+    }
+    const auto *roleName = role == Configuration::Sync::Role::Master     ? "master"
+                           : role == Configuration::Sync::Role::Follower ? "follower"
+                                                                         : "off";
+    respondJson(res, {{"role", roleName},
+                         {"followers", stats.followers}, {"locked", stats.locked}, {"master", stats.master},
+                         {"exchanges", stats.exchanges}, {"unanswered", stats.unanswered},
+                         {"offsetMs", toMs(stats.offset)}, {"driftPpm", stats.driftPpm},
+                         {"roundTripMs", toMs(stats.roundTrip)}, {"errorSamples", stats.errorSamples},
+                         {"lastErrorMs", toMs(stats.lastError)}, {"maxErrorMs", toMs(stats.maxError)},
+                         {"averageErrorMs",
+                             stats.errorSamples > 0 ? toMs(stats.totalError) / static_cast<double>(stats.errorSamples)
+                                                    : 0.},
+                         {"corrections", stats.corrections}, {"seeks", stats.seeks},
+                         {"missingFiles", stats.missingFiles},
+                         // on the steady clock in µs, for comparing instances on one host
+                         {"timeline", timeline.has_value()
+                                          ? nlohmann::json{{"file", timeline->file.filename().string()},
+                                                {"startUs", steadyUs(timeline->start)},
+                                                {"durationUs", timeline->duration.count()}, {"lastShown", lastShown}}
+                                          : nlohmann::json()}});
+}
+
+// per stage of the render path the time and, where the kernel has them, hardware counters; counts are totals, scaled
+// up where the counters were shared, with the share of the time they ran as coverage
+void getPerfStats(uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
+    const auto status = Perf::GetStatus();
+    auto events = nlohmann::json::object();
+    for (int i{0}; i < Perf::EventCount; i++) {
+        events[Perf::EventName(static_cast<Perf::Event>(i))] = status.events[i];
+    }
+    auto stages = nlohmann::json::object();
+    for (const auto &stage : Perf::Collect()) {
+        const auto calls = static_cast<double>(std::max(stage.count, 1LL));
+        auto counters = nlohmann::json::object();
+        for (int i{0}; i < Perf::EventCount; i++) {
+            if (stage.counts[i].has_value()) {
+                counters[Perf::EventName(static_cast<Perf::Event>(i))] = {{"total", *stage.counts[i]},
+                    {"perCall", static_cast<double>(*stage.counts[i]) / calls}, {"coverage", stage.coverage[i]}};
+            }
+        }
+        const auto &cycles = stage.counts[Perf::Cycles];
+        const auto &instructions = stage.counts[Perf::Instructions];
+        const auto perKiloInstruction = [&instructions](const std::optional<uint64_t> &count) {
+            return count.has_value() && instructions.value_or(0) > 0
+                       ? nlohmann::json(static_cast<double>(*count) * 1000. / static_cast<double>(*instructions))
+                       : nlohmann::json();
+        };
+        stages[stage.name] = {{"count", stage.count},
+            {"averageUs", static_cast<double>(stage.time.count()) / 1000. / calls},
+            {"totalMs", static_cast<double>(stage.time.count()) / 1e6}, {"counters", counters},
+            {"instructionsPerCycle", cycles.value_or(0) > 0 && instructions.has_value()
+                                         ? nlohmann::json(static_cast<double>(*instructions) /
+                                                          static_cast<double>(*cycles))
+                                         : nlohmann::json()},
+            {"cacheMissesPerKiloInstruction", perKiloInstruction(stage.counts[Perf::CacheMisses])},
+            {"branchMissesPerKiloInstruction", perKiloInstruction(stage.counts[Perf::BranchMisses])}};
+    }
+    respondJson(res, {{"enabled", status.enabled}, {"available", status.available}, {"userOnly", status.userOnly},
+                         {"events", events}, {"reason", status.reason}, {"stages", stages}});
+}
+
+// ?seconds= is how far back to go, 10 by default; the file opens in ui.perfetto.dev or chrome://tracing
+void getTrace(uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
+    int seconds{10};
+    const auto query = req->getQuery("seconds");
+    std::from_chars(query.data(), query.data() + query.size(), seconds);
+    const auto trace = Trace::Dump(std::chrono::seconds(std::clamp(seconds, 1, 600)));
+
+    res->writeStatus(ResponseCodes::HTTP_200_OK);
+    res->writeHeader("content-type", "application/json");
+    res->writeHeader("content-disposition", "attachment; filename=\"nametag-trace.json\"");
     res->writeHeader("Access-Control-Allow-Origin", "*");
-    res->end();
+    res->end(trace);
 }
 
-const auto thumbnailRoot = fs::current_path() / "videos/thumbnails";
+// the listing as it is served, with the event's name spliced in front of its fields
+std::string libraryEvent(const MediaIndex &index) {
+    const auto listing = index.GetListing();
+    return std::format(R"({{"event":"library","etag":{},{})", nlohmann::json(listing.etag).dump(),
+        std::string_view(*listing.body).substr(1));
+}
 
-void getThumbnail(uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
-    std::cout << "th " << thumbnailRoot / UrlDecode(std::string(req->getParameter(0))) << std::endl;
-    serveFile(res, thumbnailRoot / UrlDecode(std::string(req->getParameter(0))));
+nlohmann::json playbackState(VideoPlayer &player) {
+    const auto file = player.GetCurrentFile();
+    const auto playlist = player.GetPlaylist();
+    return {{"file", file.has_value() ? nlohmann::json(file->filename().string()) : nlohmann::json()},
+        {"playlist", playlist.has_value() ? playlist->ToJson() : nlohmann::json()}};
 }
 
 void options(uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
@@ -216,18 +1195,279 @@ void options(uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
     res->end();
 }
 
-void WebServer::run(VideoPlayer &player) {
+WebServer::WebServer(VideoPlayer &player, MediaIndex &index, Compositor &compositor, const PreviewRing &preview,
+    const DeadlineMonitor &deadlines, const Governor &governor, const PeerSync &sync,
+    const Configuration &configuration)
+    : _player{player}, _index{index}, _compositor{compositor}, _deadlines{deadlines}, _governor{governor},
+      _sync{sync}, _configuration{configuration},
+      _uploadSessions{videoFolder / "uploads", videoFolder, std::chrono::hours(configuration.uploads.expireHours)},
+      // the build tool puts content hashes into the names of everything under static/
+      _frontend{frontendRoot, "static/"}, _thumbnails{index.GetThumbnailFolder()},
+      _previewRing{preview}, _preview{preview, configuration.preview.frameRate}, _live{player},
+      _port{configuration.server.port} {
+    RegisterCommands();
+}
+
+void WebServer::RegisterCommands() {
+    // arguments sit next to "cmd" in the request, missing or mistyped ones are answered with 400 by the channel
+    const auto noContent = CommandResult{ResponseCodes::HTTP_204_NO_CONTENT};
+    _control.Register("videos", [this](const nlohmann::json &) {
+        return CommandResult{ResponseCodes::HTTP_200_OK, nlohmann::json::parse(*_index.GetListing().body)};
+    });
+    _control.Register("delete", [](const nlohmann::json &request) {
+        return deleteVideoFile(request.at("file").get<std::string>());
+    });
+    _control.Register("play", [this](const nlohmann::json &request) {
+        return playFile(_player, request.at("file").get<std::string>());
+    });
+    _control.Register("stop", [this, noContent](const nlohmann::json &) {
+        _player.Play(std::make_unique<IdleDecoder>());
+        return noContent;
+    });
+    _control.Register("playback", [this](const nlohmann::json &) {
+        return CommandResult{ResponseCodes::HTTP_200_OK, playbackState(_player)};
+    });
+    _control.Register("seek", [this](const nlohmann::json &request) {
+        return seek(_player, _index, request.at("seconds").get<double>());
+    });
+    _control.Register(
+        "playlist", [this](const nlohmann::json &request) { return setPlaylist(_player, request); });
+    _control.Register("getPlaylist", [this](const nlohmann::json &) {
+        return CommandResult{ResponseCodes::HTTP_200_OK, playlistJson(_player)};
+    });
+    _control.Register("stopPlaylist", [this, noContent](const nlohmann::json &) {
+        _player.StopPlaylist();
+        return noContent;
+    });
+    _control.Register("next", [this, noContent](const nlohmann::json &) {
+        _player.Next();
+        return noContent;
+    });
+    _control.Register("previous", [this, noContent](const nlohmann::json &) {
+        _player.Previous();
+        return noContent;
+    });
+    _control.Register("text", [this](const nlohmann::json &request) {
+        return showText(_player, request, _configuration.text);
+    });
+    _control.Register("animation", [this](const nlohmann::json &request) {
+        return playAnimation(_player, request, _configuration.animation.frameRate, _animationStats);
+    });
+    _control.Register("layers", [this](const nlohmann::json &) {
+        return CommandResult{ResponseCodes::HTTP_200_OK, layersJson(_compositor)};
+    });
+    _control.Register("addLayer", [this](const nlohmann::json &request) {
+        return addLayer(_compositor, request, _player.GetFormat(), _configuration.text);
+    });
+    // "id" belongs to the request, the layer goes by "layer"
+    _control.Register("updateLayer", [this](const nlohmann::json &request) {
+        return updateLayer(_compositor, request.at("layer").get<int>(), request);
+    });
+    _control.Register("removeLayer", [this](const nlohmann::json &request) {
+        return removeLayer(_compositor, request.at("layer").get<int>());
+    });
+}
+
+// a span per request on the server thread; what the handler hands on to other threads or callbacks is not in it
+template <class Handler> auto traced(const char *route, Handler handler) {
+    return [route, handler = std::move(handler)](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
+        Trace::Scope trace{"http", route};
+        handler(res, req);
+    };
+}
+
+void WebServer::run() {
+    // the loop of this thread, which the upload writer hands its results back to
+    auto *loop = uWS::Loop::get();
+    _loop = loop;
+    _uploadSessions.Load();
+    _frontend.Start();
+    _thumbnails.Start();
+    _preview.Start();
+    _control.Start();
+    // both fire on other threads, the events are built on this one once it gets to them
+    _index.SetListener([this]() { _control.Notify("library", [this]() { return libraryEvent(_index); }); });
+    _player.SetListener([this]() {
+        _control.Notify("playback", [this]() {
+            auto event = playbackState(_player);
+            event["event"] = "playback";
+            return event.dump();
+        });
+    });
     uWS::App()
-        .get("/", getRoot)
-        .get("/*", getFile)
-        .get("/videos", getVideos)
-        .post("/videos/:video", postVideo)
-        .del("/videos/:file", deleteVideo)
+        .get("/",
+            traced("GET /",
+                [this](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
+                    serveAsset(res, req, _frontend, "index.html");
+                }))
+        .get("/*",
+            traced("GET /*",
+                [this](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) { getFile(res, req, _frontend); }))
+        .get("/videos",
+            traced("GET /videos",
+                [this](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) { getVideos(res, req, _index); }))
+        .post("/videos/:video",
+            traced("POST /videos/:video",
+                [this, loop](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
+                    postVideo(res, req, _uploads, _thumbnailer, loop, _control, _player, _configuration.uploads);
+                }))
+        .get("/uploads",
+            traced("GET /uploads",
+                [this](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
+                    getUploads(res, req, _uploads, _uploadSessions, _player);
+                }))
+        // resumable uploads, following tus 1.0
+        .options("/uploads", traced("OPTIONS /uploads", optionsUploads))
+        .options("/uploads/*", traced("OPTIONS /uploads/*", optionsUploads))
+        .post("/uploads",
+            traced("POST /uploads",
+                [this](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
+                    postUploadSession(res, req, _uploadSessions);
+                }))
+        .head("/uploads/:id",
+            traced("HEAD /uploads/:id",
+                [this](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
+                    headUploadSession(res, req, _uploadSessions);
+                }))
+        .patch("/uploads/:id",
+            traced("PATCH /uploads/:id",
+                [this, loop](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
+                    patchUploadSession(res, req, _uploadSessions, _uploads, _thumbnailer, loop, _control);
+                }))
+        .del("/uploads/:id",
+            traced("DELETE /uploads/:id",
+                [this](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
+                    deleteUploadSession(res, req, _uploadSessions);
+                }))
+        .get("/videos/:file", traced("GET /videos/:file", getVideo))
+        .del("/videos/:file", traced("DELETE /videos/:file", deleteVideo))
         // play specific video
         .post("/videos/:file/play",
-            [&player](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) { postPlayFile(res, req, player); })
-        .get("/thumbnails/:thumbnail", getThumbnail)
-        .options("/*", options)
+            traced("POST /videos/:file/play",
+                [this](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) { postPlayFile(res, req, _player); }))
+        .get("/playlist",
+            traced("GET /playlist",
+                [this](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) { getPlaylist(res, req, _player); }))
+        .put("/playlist",
+            traced("PUT /playlist",
+                [this](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) { putPlaylist(res, req, _player); }))
+        .del("/playlist",
+            traced("DELETE /playlist",
+                [this](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
+                    _player.StopPlaylist();
+                    respondNoContent(res);
+                }))
+        .post("/playlist/next",
+            traced("POST /playlist/next",
+                [this](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
+                    _player.Next();
+                    respondNoContent(res);
+                }))
+        .post("/playlist/previous",
+            traced("POST /playlist/previous",
+                [this](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
+                    _player.Previous();
+                    respondNoContent(res);
+                }))
+        .post("/player/seek/:seconds",
+            traced("POST /player/seek/:seconds",
+                [this](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) { postSeek(res, req, _player, _index); }))
+        .post("/text",
+            traced("POST /text",
+                [this](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
+                    postText(res, req, _player, _configuration.text);
+                }))
+        .post("/animation",
+            traced("POST /animation",
+                [this](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
+                    postAnimation(res, req, _player, _configuration.animation.frameRate, _animationStats);
+                }))
+        .get("/animation",
+            traced("GET /animation",
+                [this](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
+                    getAnimation(res, req, _animationStats.get());
+                }))
+        .get("/layers",
+            traced("GET /layers",
+                [this](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) { getLayers(res, req, _compositor); }))
+        .post("/layers",
+            traced("POST /layers",
+                [this](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
+                    postLayer(res, req, _compositor, _player.GetFormat(), _configuration.text);
+                }))
+        .patch("/layers/:id",
+            traced("PATCH /layers/:id",
+                [this](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) { patchLayer(res, req, _compositor); }))
+        .del("/layers/:id",
+            traced("DELETE /layers/:id",
+                [this](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) { deleteLayer(res, req, _compositor); }))
+        .get("/thumbnails/:thumbnail",
+            traced("GET /thumbnails/:thumbnail",
+                [this](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) { getThumbnail(res, req, _thumbnails); }))
+        .ws<PreviewClient>("/preview",
+            {.compression = uWS::DISABLED,
+                .maxPayloadLength = 1024,
+                .idleTimeout = 120,
+                .maxBackpressure = 256 * 1024,
+                .closeOnBackpressureLimit = false,
+                .upgrade =
+                    [this](uWS::HttpResponse<false> *res, uWS::HttpRequest *req, us_socket_context_t *context) {
+                        // ?fps= lowers the rate for this viewer
+                        int frameRate{};
+                        const auto query = req->getQuery("fps");
+                        std::from_chars(query.data(), query.data() + query.size(), frameRate);
+                        res->upgrade<PreviewClient>(_preview.MakeClient(frameRate),
+                            req->getHeader("sec-websocket-key"), req->getHeader("sec-websocket-protocol"),
+                            req->getHeader("sec-websocket-extensions"), context);
+                    },
+                .open = [this](PreviewSocket *socket) { _preview.Open(socket); },
+                .close = [this](PreviewSocket *socket, int, std::string_view) { _preview.Close(socket); }})
+        .get("/preview/stats",
+            traced("GET /preview/stats",
+                [this](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
+                    getPreviewStats(res, req, _previewRing, _preview);
+                }))
+        .ws<ControlClient>("/control",
+            {.compression = uWS::DISABLED,
+                .maxPayloadLength = MaxJsonBodySize,
+                .idleTimeout = 120,
+                .maxBackpressure = 1024 * 1024,
+                .closeOnBackpressureLimit = true,
+                .open = [this](ControlSocket *socket) { _control.Open(socket); },
+                .message = [this](ControlSocket *socket, std::string_view message,
+                               uWS::OpCode) { _control.Receive(socket, message); },
+                .close = [this](ControlSocket *socket, int, std::string_view) { _control.Close(socket); }})
+        .get("/control/stats",
+            traced("GET /control/stats",
+                [this](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) { getControlStats(res, req, _control); }))
+        // frames rendered by a phone or laptop, shown as they arrive
+        .ws<LiveClient>("/live",
+            {.compression = uWS::DISABLED,
+                .maxPayloadLength = LiveMaxMessageSize,
+                .idleTimeout = 120,
+                .open = [this](LiveSocket *socket) { _live.Open(socket); },
+                .message = [this](LiveSocket *socket, std::string_view message,
+                               uWS::OpCode) { _live.Receive(socket, message); },
+                .close = [this](LiveSocket *socket, int, std::string_view) { _live.Close(socket); }})
+        .get("/live/stats",
+            traced("GET /live/stats",
+                [this](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) { getLiveStats(res, req, _live); }))
+        .get("/render/stats",
+            traced("GET /render/stats",
+                [this](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) { getRenderStats(res, req, _deadlines); }))
+        .get("/power/stats",
+            traced("GET /power/stats",
+                [this](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
+                    getPowerStats(res, req, _governor, _configuration.power);
+                }))
+        .get("/sync/stats",
+            traced("GET /sync/stats",
+                [this](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
+                    getSyncStats(res, req, _sync, _player, _configuration.sync.role);
+                }))
+        .get("/perf/stats", traced("GET /perf/stats", getPerfStats))
+        .get("/trace", traced("GET /trace", getTrace))
+        .options("/*", traced("OPTIONS /*", options))
         .listen(_port,
             [this](auto *token) {
                 this->_socket = token;
@@ -237,6 +1477,24 @@ void WebServer::run(VideoPlayer &player) {
                 }
             })
         .run();
+    _preview.Stop();
+    _player.SetListener({});
+    _index.SetListener({});
+    _control.Stop();
 }
 
-void WebServer::halt() { us_listen_socket_close(0, _socket); }
+void WebServer::halt() {
+    auto *loop = _loop.load();
+    if (loop == nullptr) {
+        us_listen_socket_close(0, _socket);
+        return;
+    }
+    // sockets belong to the server thread, and connected viewers would keep its loop running
+    loop->defer([this]() {
+        us_listen_socket_close(0, _socket);
+        _preview.Stop();
+        _preview.CloseAll();
+        _control.CloseAll();
+        _live.CloseAll();
+    });
+}
@@ -1,26 +1,75 @@
 #ifndef CONVENTION_NAMETAG_SERVER_HPP
 #define CONVENTION_NAMETAG_SERVER_HPP
 
+#include "drawers/compositor.hpp"
+#include "assetCache.hpp"
+#include "controlChannel.hpp"
+#include "fileStreamer.hpp"
+#include "liveInput.hpp"
+#include "peerSync.hpp"
+#include "preview.hpp"
+#include "thumbnailer.hpp"
+#include "uploadSessions.hpp"
+#include "uploadWriter.hpp"
+#include "util/configuration.hpp"
+#include "util/deadlineMonitor.hpp"
+#include "util/governor.hpp"
+#include "video/animationDecoder.hpp"
+#include "video/mediaIndex.hpp"
 #include "video/videoPlayer.hpp"
 
 #include <App.h>
 #include <libusockets.h>
 #include <nlohmann/json.hpp>
 
+#include <atomic>
+#include <memory>
 #include <string>
 
+// resolves %xx escapes in a path parameter
+std::string UrlDecode(std::string encoded);
+
 class WebServer {
   public:
-    explicit WebServer() = default;
+    WebServer(VideoPlayer &player, MediaIndex &index, Compositor &compositor, const PreviewRing &preview,
+        const DeadlineMonitor &deadlines, const Governor &governor, const PeerSync &sync,
+        const Configuration &configuration);
     ~WebServer() = default;
 
-    void run(VideoPlayer &player);
+    void run();
     void halt();
 
   private:
+    void RegisterCommands();
+
+    VideoPlayer &_player;
+    MediaIndex &_index;
+    Compositor &_compositor;
+    const DeadlineMonitor &_deadlines;
+    const Governor &_governor;
+    const PeerSync &_sync;
+    const Configuration &_configuration;
+
+    // of the scene posted last, only touched on the server's thread
+    std::shared_ptr<AnimationStats> _animationStats;
+
+    // before the writer, whose thread hands it finished uploads until it is joined
+    Thumbnailer _thumbnailer;
+    UploadWriter _uploads;
+    UploadSessions _uploadSessions;
+    AssetCache _frontend;
+    AssetCache _thumbnails;
+    const PreviewRing &_previewRing;
+    PreviewBroadcaster _preview;
+    ControlChannel _control;
+    LiveInput _live;
+
+    // set once run has started
+    std::atomic<uWS::Loop *> _loop{};
+
     us_listen_socket_t *_socket{};
 
-    short _port{8080};
+    int _port{8080};
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,79 @@
+#include "thumbnailer.hpp"
+#include "util/trace.hpp"
+
+#include <spawn.h>
+#include <sys/wait.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+extern char **environ;
+
+namespace {
+// ffmpeg gets the names as arguments of their own, no shell ever sees them
+void runFfmpeg(const std::filesystem::path &video, const std::filesystem::path &thumbnail) {
+    std::vector<std::string> arguments{"ffmpeg", "-nostdin", "-i", video.string(), "-filter:v", "thumbnail=500",
+        "-frames:v", "1", thumbnail.string()};
+    std::vector<char *> argv;
+    for (auto &argument : arguments) {
+        argv.push_back(argument.data());
+    }
+    argv.push_back(nullptr);
+
+    pid_t pid{};
+    if (const int error = posix_spawnp(&pid, "ffmpeg", nullptr, nullptr, argv.data(), environ); error != 0) {
+        std::cerr << "Thumbnails: failed to start ffmpeg: " << std::strerror(error) << std::endl;
+        return;
+    }
+    int status{};
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    if (not WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        std::cerr << "Thumbnails: ffmpeg failed for " << video << std::endl;
+    }
+}
+} // namespace
+
+Thumbnailer::Thumbnailer() : _thread{[this]() { Run(); }} {}
+
+Thumbnailer::~Thumbnailer() {
+    {
+        auto lock = std::lock_guard<std::mutex>(_access);
+        _running = false;
+    }
+    _wake.notify_one();
+    _thread.join();
+}
+
+void Thumbnailer::Queue(std::filesystem::path video, std::filesystem::path thumbnail, std::function<void()> onDone) {
+    {
+        auto lock = std::lock_guard<std::mutex>(_access);
+        _jobs.push_back({std::move(video), std::move(thumbnail), std::move(onDone)});
+    }
+    _wake.notify_one();
+}
+
+void Thumbnailer::Run() {
+    Trace::SetThreadName("thumbnails");
+    while (true) {
+        Job job;
+        {
+            auto lock = std::unique_lock<std::mutex>(_access);
+            _wake.wait(lock, [this]() { return not _running || not _jobs.empty(); });
+            if (not _running) {
+                break;
+            }
+            job = std::move(_jobs.front());
+            _jobs.pop_front();
+        }
+
+        {
+            Trace::Scope trace{"upload", "thumbnail"};
+            runFfmpeg(job.video, job.thumbnail);
+        }
+        job.onDone();
+    }
+}
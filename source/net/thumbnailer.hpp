@@ -0,0 +1,47 @@
+#ifndef CONVENTION_NAMETAG_THUMBNAILER_HPP
+#define CONVENTION_NAMETAG_THUMBNAILER_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/**
+ * @brief Makes thumbnails of finished uploads with ffmpeg on a thread of its own
+ *
+ * ffmpeg runs for seconds on the badge. On the upload writer's thread that held up the chunks of every other upload
+ * and kept their sockets paused, so finished uploads are queued here instead and handled one after the other.
+ *
+ * Queue is meant for any thread; onDone runs on the thumbnail thread.
+ */
+class Thumbnailer {
+  public:
+    Thumbnailer();
+    ~Thumbnailer();
+
+    Thumbnailer(const Thumbnailer &) = delete;
+    Thumbnailer &operator=(const Thumbnailer &) = delete;
+
+    void Queue(std::filesystem::path video, std::filesystem::path thumbnail, std::function<void()> onDone);
+
+  private:
+    struct Job {
+        std::filesystem::path video;
+        std::filesystem::path thumbnail;
+        std::function<void()> onDone;
+    };
+
+    void Run();
+
+    // jobs still queued on shutdown are dropped, their thumbnails are missing until the video is uploaded again
+    std::deque<Job> _jobs;
+    std::mutex _access;
+    std::condition_variable _wake;
+    bool _running{true};
+    // last, so the thread only starts once everything above is initialized
+    std::thread _thread;
+};
+
+#endif // CONVENTION_NAMETAG_THUMBNAILER_HPP
@@ -0,0 +1,240 @@
+#include "uploadSessions.hpp"
+#include "util/durableFile.hpp"
+
+#include <fcntl.h>
+#include <nlohmann/json.hpp>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+namespace fs = std::filesystem;
+
+namespace {
+std::string makeId() {
+    std::random_device random;
+    return std::format("{:08x}{:08x}{:08x}{:08x}", random(), random(), random(), random());
+}
+
+int64_t toSeconds(std::chrono::system_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::seconds>(time.time_since_epoch()).count();
+}
+} // namespace
+
+UploadSessions::UploadSessions(fs::path folder, fs::path targetFolder, std::chrono::seconds lifetime)
+    : _folder{std::move(folder)}, _targetFolder{std::move(targetFolder)}, _lifetime{lifetime} {}
+
+void UploadSessions::Load() {
+    std::error_code error;
+    fs::create_directories(_folder, error);
+
+    auto lock = std::lock_guard<std::mutex>(_access);
+    for (const auto &entry : fs::directory_iterator(_folder, error)) {
+        const auto &path = entry.path();
+        if (path.extension() != ".json") {
+            // part files are looked at along with their session, anything else is left over
+            if (not fs::exists(fs::path(path).replace_extension(".json"))) {
+                fs::remove(path, error);
+            }
+            continue;
+        }
+
+        const auto part = fs::path(path).replace_extension(".part");
+        const auto size = fs::file_size(part, error);
+        if (error) {
+            std::cerr << "Dropping upload session without data " << path << std::endl;
+            fs::remove(path, error);
+            continue;
+        }
+
+        UploadSession session;
+        session.id = path.stem().string();
+        bool readable{};
+        try {
+            std::ifstream file(path);
+            const auto json = nlohmann::json::parse(file, nullptr, false);
+            if (json.is_object()) {
+                session.filename = json.value("filename", std::string());
+                session.length = json.value("length", uintmax_t{});
+                session.offset = std::min(json.value("offset", uintmax_t{}), size);
+                session.expires =
+                    std::chrono::system_clock::time_point(std::chrono::seconds(json.value("expires", 0LL)));
+                readable = true;
+            }
+        } catch (const nlohmann::json::exception &) {
+        }
+        if (not readable) {
+            // the data may be all a client has confirmed, it is only given up once the session would have expired
+            const auto written = fs::last_write_time(part, error);
+            if (not error && written + _lifetime > fs::file_time_type::clock::now()) {
+                std::cerr << "Keeping the data of unreadable upload session " << path << std::endl;
+                continue;
+            }
+            std::cerr << "Dropping unreadable upload session " << path << std::endl;
+            Delete(session.id);
+            continue;
+        }
+        if (session.filename.empty()) {
+            Delete(session.id);
+            continue;
+        }
+        if (size > session.offset) {
+            // the tail of a chunk that was never committed
+            fs::resize_file(part, session.offset, error);
+        }
+        _sessions.emplace(session.id, std::move(session));
+    }
+    CollectExpired();
+    _stats.sessions = static_cast<int>(_sessions.size());
+}
+
+std::optional<UploadSession> UploadSessions::Create(const std::string &filename, uintmax_t length) {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    CollectExpired();
+
+    UploadSession session;
+    session.id = makeId();
+    session.filename = filename;
+    session.length = length;
+    session.expires = std::chrono::system_clock::now() + _lifetime;
+
+    std::ofstream part(GetPartPath(session.id), std::ios::binary);
+    if (not part.good()) {
+        std::cerr << "Could not create upload session for " << filename << std::endl;
+        return std::nullopt;
+    }
+    Save(session);
+
+    _stats.created++;
+    _sessions.emplace(session.id, session);
+    _stats.sessions = static_cast<int>(_sessions.size());
+    return session;
+}
+
+std::optional<UploadSession> UploadSessions::Find(std::string_view id) const {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    if (const auto it = _sessions.find(id); it != _sessions.end()) {
+        return it->second;
+    }
+    return std::nullopt;
+}
+
+bool UploadSessions::IsTarget(std::string_view filename) const {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    for (const auto &[id, session] : _sessions) {
+        if (session.filename == filename) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool UploadSessions::Acquire(std::string_view id) {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    const auto it = _sessions.find(id);
+    if (it == _sessions.end() || it->second.busy) {
+        return false;
+    }
+    it->second.busy = true;
+    return true;
+}
+
+UploadSessions::Progress UploadSessions::Commit(std::string_view id, uintmax_t offset, long long discarded) {
+    UploadSession session;
+    bool changed{};
+    {
+        auto lock = std::lock_guard<std::mutex>(_access);
+        const auto it = _sessions.find(id);
+        if (it == _sessions.end()) {
+            return Progress::Conflict;
+        }
+        _stats.discardedBytes += discarded;
+        if (offset != it->second.offset) {
+            _stats.committedBytes += static_cast<long long>(offset) - static_cast<long long>(it->second.offset);
+            it->second.offset = offset;
+            it->second.expires = std::chrono::system_clock::now() + _lifetime;
+            changed = true;
+        }
+        session = it->second;
+    }
+
+    // still busy meanwhile, so the session cannot be terminated or completed twice
+    auto progress = Progress::Partial;
+    if (session.offset == session.length) {
+        const auto target = _targetFolder / session.filename;
+        // fails instead of replacing a file that appeared meanwhile
+        if (renameat2(AT_FDCWD, GetPartPath(id).c_str(), AT_FDCWD, target.c_str(), RENAME_NOREPLACE) == 0) {
+            auto lock = std::lock_guard<std::mutex>(_access);
+            Delete(session.id);
+            _sessions.erase(session.id);
+            _stats.completed++;
+            _stats.sessions = static_cast<int>(_sessions.size());
+            return Progress::Complete;
+        }
+        std::cerr << "Could not move upload to " << target << ": " << std::strerror(errno) << std::endl;
+        progress = Progress::Conflict;
+    }
+    if (changed) {
+        Save(session);
+    }
+
+    auto lock = std::lock_guard<std::mutex>(_access);
+    if (const auto it = _sessions.find(id); it != _sessions.end()) {
+        it->second.busy = false;
+    }
+    return progress;
+}
+
+bool UploadSessions::Terminate(std::string_view id) {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    const auto it = _sessions.find(id);
+    if (it == _sessions.end() || it->second.busy) {
+        return false;
+    }
+    Delete(it->first);
+    _sessions.erase(it);
+    _stats.terminated++;
+    _stats.sessions = static_cast<int>(_sessions.size());
+    return true;
+}
+
+fs::path UploadSessions::GetPartPath(std::string_view id) const { return _folder / std::format("{}.part", id); }
+
+UploadSessions::Stats UploadSessions::GetStats() const {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    return _stats;
+}
+
+void UploadSessions::Save(const UploadSession &session) const {
+    const nlohmann::json json{{"filename", session.filename}, {"length", session.length}, {"offset", session.offset},
+        {"expires", toSeconds(session.expires)}};
+    // replaced in one step, a crash leaves the previous offset, which only costs resending a chunk
+    if (not DurableFile::Replace(_folder / (session.id + ".json"), json.dump())) {
+        std::cerr << "Could not save upload session " << session.id << ": " << std::strerror(errno) << std::endl;
+        return;
+    }
+    DurableFile::SyncFolder(_folder);
+}
+
+void UploadSessions::Delete(const std::string &id) const {
+    std::error_code error;
+    fs::remove(GetPartPath(id), error);
+    fs::remove(_folder / (id + ".json"), error);
+}
+
+void UploadSessions::CollectExpired() {
+    const auto now = std::chrono::system_clock::now();
+    std::erase_if(_sessions, [this, now](const auto &entry) {
+        if (entry.second.busy || entry.second.expires > now) {
+            return false;
+        }
+        Delete(entry.first);
+        _stats.expired++;
+        return true;
+    });
+    _stats.sessions = static_cast<int>(_sessions.size());
+}
@@ -0,0 +1,91 @@
+#ifndef CONVENTION_NAMETAG_UPLOADSESSIONS_HPP
+#define CONVENTION_NAMETAG_UPLOADSESSIONS_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+struct UploadSession {
+    std::string id;
+    // what the video is called in the target folder once complete
+    std::string filename;
+    uintmax_t length{};
+    // bytes fsynced and confirmed to the client, a chunk counts only once it is complete and verified
+    uintmax_t offset{};
+    // the epoch for a session that is complete and gone
+    std::chrono::system_clock::time_point expires;
+    // a chunk is being received
+    bool busy{};
+};
+
+/**
+ * @brief Uploads in progress that survive disconnects and restarts, after the tus protocol
+ *
+ * Each session has <folder>/<id>.part with the data received so far and <folder>/<id>.json with its target, length
+ * and committed offset. The offset is rewritten after every chunk has been fsynced; on start, part files are cut
+ * back to it, so data that was never confirmed to a client cannot end up in a video. A session file that cannot be
+ * read on start leaves its part file alone until the session would have expired. Sessions untouched for longer
+ * than their lifetime are deleted whenever a new one is created. Complete files are renamed into the target folder,
+ * where the media index picks them up like any other new video.
+ *
+ * Creation and lookups happen on the server thread, chunks are committed from the upload writer's thread.
+ */
+class UploadSessions {
+  public:
+    UploadSessions(std::filesystem::path folder, std::filesystem::path targetFolder, std::chrono::seconds lifetime);
+
+    // picks up the sessions of earlier runs
+    void Load();
+
+    // nullopt if its files cannot be created
+    std::optional<UploadSession> Create(const std::string &filename, uintmax_t length);
+    [[nodiscard]] std::optional<UploadSession> Find(std::string_view id) const;
+    // whether a session is going to write filename
+    [[nodiscard]] bool IsTarget(std::string_view filename) const;
+
+    // marks the session busy, false if it is already or does not exist
+    bool Acquire(std::string_view id);
+    enum class Progress { Partial, Complete, Conflict };
+    // ends a chunk and clears busy: offset is where the data on disk ends now, discarded what was received but not
+    // kept. Once all data is there the file is moved to the target folder and the session ends, Conflict if a file of
+    // that name appeared meanwhile
+    Progress Commit(std::string_view id, uintmax_t offset, long long discarded);
+    // deletes an idle session and its data, false if it is busy or unknown
+    bool Terminate(std::string_view id);
+
+    [[nodiscard]] std::filesystem::path GetPartPath(std::string_view id) const;
+
+    struct Stats {
+        int sessions{};
+        long long created{};
+        long long completed{};
+        long long expired{};
+        long long terminated{};
+        long long committedBytes{};
+        // received but thrown away: chunks cut off or failing their checksum, the airtime resuming did not save
+        long long discardedBytes{};
+    };
+    [[nodiscard]] Stats GetStats() const;
+
+  private:
+    // atomically replaces the session's json
+    void Save(const UploadSession &session) const;
+    // _access must be held for these
+    void Delete(const std::string &id) const;
+    void CollectExpired();
+
+    std::filesystem::path _folder;
+    std::filesystem::path _targetFolder;
+    std::chrono::seconds _lifetime;
+
+    std::map<std::string, UploadSession, std::less<>> _sessions;
+    Stats _stats;
+    mutable std::mutex _access;
+};
+
+#endif // CONVENTION_NAMETAG_UPLOADSESSIONS_HPP
@@ -0,0 +1,321 @@
+#include "uploadWriter.hpp"
+#include "trace.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+namespace {
+// page aligned buffers let the kernel copy whole pages, and match the erase blocks of the SD card far better
+const auto BufferAlignment = 4096;
+const auto MaxFreeBuffers = 8;
+
+void updateMax(std::atomic<long long> &max, long long value) {
+    long long current = max;
+    while (value > current && not max.compare_exchange_weak(current, value)) {
+    }
+}
+} // namespace
+
+struct UploadWriter::Upload {
+    std::filesystem::path path;
+    int fd{-1};
+    // where a resumed upload started, nullopt for a new file
+    std::optional<uintmax_t> resumedAt;
+    std::optional<Checksum> checksum;
+    std::shared_ptr<GrowingFile> growing;
+    std::function<void()> onDrained;
+    std::chrono::steady_clock::time_point start{std::chrono::steady_clock::now()};
+
+    // server thread only
+    Buffer buffer;
+    size_t filled{};
+
+    std::atomic<int> pending{};
+    // set while the socket is paused, whoever clears it resumes
+    std::atomic<bool> waiting{};
+    std::atomic<bool> aborted{};
+
+    // writer thread only
+    long long written{};
+    bool failed{};
+};
+
+UploadWriter::UploadWriter() : _thread{[this]() { Run(); }} {}
+
+UploadWriter::~UploadWriter() {
+    {
+        auto lock = std::lock_guard<std::mutex>(_access);
+        _running = false;
+    }
+    _wake.notify_one();
+    _thread.join();
+}
+
+std::shared_ptr<UploadWriter::Upload> UploadWriter::Open(
+    const std::filesystem::path &path, std::function<void()> onDrained, std::shared_ptr<GrowingFile> growing) {
+    const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        if (errno != EEXIST) {
+            std::cerr << "Could not create " << path << ": " << std::strerror(errno) << std::endl;
+        }
+        return nullptr;
+    }
+
+    auto upload = std::make_shared<Upload>();
+    upload->path = path;
+    upload->fd = fd;
+    upload->growing = std::move(growing);
+    upload->onDrained = std::move(onDrained);
+    upload->buffer = TakeBuffer();
+    _active++;
+    return upload;
+}
+
+std::shared_ptr<UploadWriter::Upload> UploadWriter::Resume(const std::filesystem::path &path, uintmax_t offset,
+    std::optional<Checksum> checksum, std::function<void()> onDrained) {
+    const int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    // whatever lies past the offset was never confirmed to the client
+    if (fd < 0 || ftruncate(fd, static_cast<off_t>(offset)) != 0 ||
+        lseek(fd, static_cast<off_t>(offset), SEEK_SET) < 0) {
+        std::cerr << "Could not resume " << path << ": " << std::strerror(errno) << std::endl;
+        if (fd >= 0) {
+            close(fd);
+        }
+        return nullptr;
+    }
+
+    auto upload = std::make_shared<Upload>();
+    upload->path = path;
+    upload->fd = fd;
+    upload->resumedAt = offset;
+    upload->checksum = std::move(checksum);
+    upload->onDrained = std::move(onDrained);
+    upload->buffer = TakeBuffer();
+    _active++;
+    return upload;
+}
+
+bool UploadWriter::Append(const std::shared_ptr<Upload> &upload, std::string_view chunk) {
+    const auto start = std::chrono::steady_clock::now();
+
+    bool accepting = true;
+    while (not chunk.empty()) {
+        const size_t count = std::min(chunk.size(), BufferSize - upload->filled);
+        std::memcpy(upload->buffer.get() + upload->filled, chunk.data(), count);
+        upload->filled += count;
+        chunk.remove_prefix(count);
+        if (upload->filled < BufferSize) {
+            break;
+        }
+
+        const size_t size = std::exchange(upload->filled, 0);
+        if (++upload->pending >= MaxPendingBuffers && not upload->waiting) {
+            upload->waiting = true;
+            _pauses++;
+            // the writer may have drained everything before it could see the flag
+            if (upload->pending <= MaxPendingBuffers / 2 && upload->waiting.exchange(false)) {
+                _pauses--;
+            } else {
+                accepting = false;
+            }
+        }
+        Queue(Job{Job::Type::Write, upload, std::move(upload->buffer), size, {}});
+        upload->buffer = TakeBuffer();
+    }
+
+    const auto elapsed =
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    _loopTime += elapsed;
+    updateMax(_maxLoopTime, elapsed);
+    return accepting && not upload->waiting;
+}
+
+void UploadWriter::Finish(const std::shared_ptr<Upload> &upload, std::function<void(const Result &)> onDone) {
+    const size_t size = std::exchange(upload->filled, 0);
+    Queue(Job{Job::Type::Finish, upload, std::move(upload->buffer), size, std::move(onDone)});
+}
+
+void UploadWriter::Abort(const std::shared_ptr<Upload> &upload) {
+    upload->aborted = true;
+    Queue(Job{Job::Type::Abort, upload, std::move(upload->buffer), 0, {}});
+}
+
+UploadWriter::Stats UploadWriter::GetStats() const {
+    Stats stats;
+    stats.active = _active;
+    stats.completed = _completed;
+    stats.failed = _failed;
+    stats.bytes = _bytes;
+    stats.lastMBps = _lastMBps;
+    stats.averageMBps = _transferTime > 0 ? static_cast<double>(_bytes) / static_cast<double>(_transferTime) : 0.;
+    stats.pauses = _pauses;
+    stats.checksumMismatches = _checksumMismatches;
+    stats.maxFsyncTime = _maxFsyncTime;
+    stats.loopTime = _loopTime;
+    stats.maxLoopTime = _maxLoopTime;
+    return stats;
+}
+
+void UploadWriter::Queue(Job job) {
+    {
+        auto lock = std::lock_guard<std::mutex>(_access);
+        _jobs.push_back(std::move(job));
+    }
+    _wake.notify_one();
+}
+
+void UploadWriter::Run() {
+    Trace::SetThreadName("upload writer");
+    while (true) {
+        Job job;
+        {
+            auto lock = std::unique_lock<std::mutex>(_access);
+            _wake.wait(lock, [this]() { return not _running || not _jobs.empty(); });
+            if (not _running) {
+                break;
+            }
+            job = std::move(_jobs.front());
+            _jobs.pop_front();
+        }
+
+        auto &upload = *job.upload;
+        switch (job.type) {
+        case Job::Type::Write:
+            if (not upload.aborted) {
+                Write(upload, job.buffer.get(), job.size);
+            }
+            break;
+        case Job::Type::Finish: {
+            Write(upload, job.buffer.get(), job.size);
+            const bool matched = upload.failed || not upload.checksum.has_value() || upload.checksum->Matches();
+            if (not matched) {
+                _checksumMismatches++;
+            }
+            Close(upload, not upload.failed && matched);
+            const bool success = not upload.failed && matched;
+            if (success) {
+                const long long elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - upload.start)
+                                              .count();
+                // bytes per µs are MB/s
+                _lastMBps = static_cast<double>(upload.written) / static_cast<double>(std::max(elapsed, 1LL));
+                _bytes += upload.written;
+                _transferTime += elapsed;
+                _completed++;
+            } else {
+                _failed++;
+            }
+            job.onDone(Result{success, matched, success ? upload.written : 0});
+            break;
+        }
+        case Job::Type::Abort:
+            Close(upload, false);
+            _failed++;
+            break;
+        }
+
+        if (job.buffer) {
+            ReturnBuffer(std::move(job.buffer));
+        }
+        if (job.type == Job::Type::Write && --upload.pending <= MaxPendingBuffers / 2 &&
+            upload.waiting.exchange(false)) {
+            upload.onDrained();
+        }
+    }
+
+    // shutting down, the server thread is gone and nobody is left to answer; partial files are not kept
+    for (auto &job : _jobs) {
+        Close(*job.upload, false);
+    }
+    _jobs.clear();
+}
+
+void UploadWriter::Write(Upload &upload, const uint8_t *data, size_t size) {
+    Trace::Scope trace{"upload", "write", static_cast<int64_t>(size)};
+    if (upload.checksum.has_value()) {
+        upload.checksum->Update(data, size);
+    }
+    while (size > 0 && not upload.failed) {
+        const ssize_t count = write(upload.fd, data, size);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Could not write " << upload.path << ": " << std::strerror(errno) << std::endl;
+            upload.failed = true;
+            return;
+        }
+        data += count;
+        size -= static_cast<size_t>(count);
+        upload.written += count;
+    }
+    if (upload.growing && not upload.failed) {
+        upload.growing->Grow(upload.resumedAt.value_or(0) + static_cast<uintmax_t>(upload.written));
+    }
+}
+
+void UploadWriter::Close(Upload &upload, bool keep) {
+    if (upload.fd < 0) {
+        return;
+    }
+    if (keep) {
+        const auto start = std::chrono::steady_clock::now();
+        Trace::Scope trace{"upload", "fsync", upload.written};
+        if (fsync(upload.fd) != 0) {
+            std::cerr << "Could not sync " << upload.path << ": " << std::strerror(errno) << std::endl;
+            upload.failed = true;
+            keep = false;
+        }
+        updateMax(_maxFsyncTime,
+            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+        // the upload is on disk now, its pages would only push the playing video out of the page cache
+        posix_fadvise(upload.fd, 0, 0, POSIX_FADV_DONTNEED);
+    }
+    if (not keep && upload.resumedAt.has_value()) {
+        // earlier chunks were confirmed to the client already, only this one is dropped
+        if (ftruncate(upload.fd, static_cast<off_t>(upload.resumedAt.value())) != 0) {
+            std::cerr << "Could not truncate " << upload.path << ": " << std::strerror(errno) << std::endl;
+        }
+        close(upload.fd);
+        upload.fd = -1;
+        _active--;
+        return;
+    }
+    close(upload.fd);
+    upload.fd = -1;
+    if (not keep) {
+        std::error_code error;
+        std::filesystem::remove(upload.path, error);
+    }
+    if (upload.growing) {
+        // a reader keeps its descriptor, but knows now not to wait for the rest
+        upload.growing->End(keep);
+    }
+    _active--;
+}
+
+UploadWriter::Buffer UploadWriter::TakeBuffer() {
+    {
+        auto lock = std::lock_guard<std::mutex>(_access);
+        if (not _freeBuffers.empty()) {
+            auto buffer = std::move(_freeBuffers.back());
+            _freeBuffers.pop_back();
+            return buffer;
+        }
+    }
+    return Buffer{static_cast<uint8_t *>(std::aligned_alloc(BufferAlignment, BufferSize))};
+}
+
+void UploadWriter::ReturnBuffer(Buffer buffer) {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    if (_freeBuffers.size() < MaxFreeBuffers) {
+        _freeBuffers.push_back(std::move(buffer));
+    }
+}
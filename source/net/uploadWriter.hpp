@@ -0,0 +1,133 @@
+#ifndef CONVENTION_NAMETAG_UPLOADWRITER_HPP
+#define CONVENTION_NAMETAG_UPLOADWRITER_HPP
+
+#include "util/checksum.hpp"
+#include "util/growingFile.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Writes uploads to disk on a dedicated thread
+ *
+ * A write to the SD card can block for tens of milliseconds, which on the web server's single thread stalls every
+ * other request. Here the server only copies received chunks into page aligned buffers; full buffers are queued to the
+ * writer thread, which writes them whole at buffer aligned offsets. An upload may have a few buffers in flight, past
+ * that Append asks the caller to pause the socket until the writer reports the upload drained.
+ *
+ * Open, Append, Finish and Abort are meant for the server thread; the callbacks run on the writer thread.
+ */
+class UploadWriter {
+  public:
+    static constexpr size_t BufferSize = 256 * 1024;
+    // per upload, the socket is paused at this many and resumed at half of it
+    static constexpr int MaxPendingBuffers = 4;
+
+    struct Upload;
+
+    UploadWriter();
+    ~UploadWriter();
+
+    UploadWriter(const UploadWriter &) = delete;
+    UploadWriter &operator=(const UploadWriter &) = delete;
+
+    struct Result {
+        // everything appended is on disk
+        bool success{};
+        // false if the data did not match the checksum it came with, then none of it was kept
+        bool checksumMatched{true};
+        // bytes of this upload that made it to disk
+        long long written{};
+    };
+
+    // nullptr if the file exists or cannot be created; onDrained runs once a paused upload can take data again.
+    // growing, if given, is kept informed about the data on disk for playback while the upload arrives
+    std::shared_ptr<Upload> Open(const std::filesystem::path &path, std::function<void()> onDrained,
+        std::shared_ptr<GrowingFile> growing = nullptr);
+    // continues an existing file at offset, anything after it is cut off; nullptr if it cannot be opened
+    std::shared_ptr<Upload> Resume(const std::filesystem::path &path, uintmax_t offset,
+        std::optional<Checksum> checksum, std::function<void()> onDrained);
+    // false if the upload has too many buffers in flight and its socket should be paused
+    bool Append(const std::shared_ptr<Upload> &upload, std::string_view chunk);
+    // writes the remainder and fsyncs, onDone tells whether it made it to disk in full; a resumed upload that failed is
+    // cut back to where it started
+    void Finish(const std::shared_ptr<Upload> &upload, std::function<void(const Result &)> onDone);
+    // drops queued data and removes the new file, or cuts a resumed one back to where it started
+    void Abort(const std::shared_ptr<Upload> &upload);
+
+    struct Stats {
+        int active{};
+        long long completed{};
+        long long failed{};
+        long long bytes{};
+        // of the upload completed last, and of all of them, first chunk to fsync done
+        double lastMBps{};
+        double averageMBps{};
+        long long pauses{};
+        long long checksumMismatches{};
+        long long maxFsyncTime{};
+        // µs the server thread spent in Append, the stall uploads cause to other requests
+        long long loopTime{};
+        long long maxLoopTime{};
+    };
+    [[nodiscard]] Stats GetStats() const;
+
+  private:
+    struct AlignedFree {
+        void operator()(uint8_t *buffer) const { std::free(buffer); }
+    };
+    using Buffer = std::unique_ptr<uint8_t, AlignedFree>;
+
+    struct Job {
+        enum class Type { Write, Finish, Abort };
+        Type type{Type::Write};
+        std::shared_ptr<Upload> upload;
+        Buffer buffer;
+        size_t size{};
+        std::function<void(const Result &)> onDone;
+    };
+
+    void Run();
+    void Queue(Job job);
+    void Write(Upload &upload, const uint8_t *data, size_t size);
+    void Close(Upload &upload, bool keep);
+
+    Buffer TakeBuffer();
+    void ReturnBuffer(Buffer buffer);
+
+    std::deque<Job> _jobs;
+    // recycled so steady uploads do not allocate
+    std::vector<Buffer> _freeBuffers;
+    std::mutex _access;
+    std::condition_variable _wake;
+
+    std::atomic<int> _active{};
+    std::atomic<long long> _completed{};
+    std::atomic<long long> _failed{};
+    std::atomic<long long> _bytes{};
+    std::atomic<long long> _transferTime{};
+    std::atomic<double> _lastMBps{};
+    std::atomic<long long> _pauses{};
+    std::atomic<long long> _checksumMismatches{};
+    std::atomic<long long> _maxFsyncTime{};
+    std::atomic<long long> _loopTime{};
+    std::atomic<long long> _maxLoopTime{};
+
+    bool _running{true};
+    // last, so the thread only starts once everything above is initialized
+    std::thread _thread;
+};
+
+#endif // CONVENTION_NAMETAG_UPLOADWRITER_HPP
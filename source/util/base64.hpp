@@ -0,0 +1,56 @@
+#ifndef CONVENTION_NAMETAG_BASE64_HPP
+#define CONVENTION_NAMETAG_BASE64_HPP
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// standard alphabet, padding optional; nullopt on anything else
+inline std::optional<std::string> decodeBase64(std::string_view encoded) {
+    const auto value = [](char c) -> int {
+        if (c >= 'A' && c <= 'Z') {
+            return c - 'A';
+        }
+        if (c >= 'a' && c <= 'z') {
+            return c - 'a' + 26;
+        }
+        if (c >= '0' && c <= '9') {
+            return c - '0' + 52;
+        }
+        if (c == '+') {
+            return 62;
+        }
+        if (c == '/') {
+            return 63;
+        }
+        return -1;
+    };
+
+    while (not encoded.empty() && encoded.back() == '=') {
+        encoded.remove_suffix(1);
+    }
+    if (encoded.size() % 4 == 1) {
+        return std::nullopt;
+    }
+
+    std::string decoded;
+    decoded.reserve(encoded.size() * 3 / 4);
+    uint32_t bits{};
+    int count{};
+    for (const char c : encoded) {
+        const int digit = value(c);
+        if (digit < 0) {
+            return std::nullopt;
+        }
+        bits = (bits << 6) | static_cast<uint32_t>(digit);
+        count += 6;
+        if (count >= 8) {
+            count -= 8;
+            decoded.push_back(static_cast<char>((bits >> count) & 0xff));
+        }
+    }
+    return decoded;
+}
+
+#endif // CONVENTION_NAMETAG_BASE64_HPP
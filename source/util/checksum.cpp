@@ -0,0 +1,133 @@
+#include "checksum.hpp"
+#include "base64.hpp"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+uint32_t rotateLeft(uint32_t value, int bits) { return (value << bits) | (value >> (32 - bits)); }
+} // namespace
+
+std::optional<Checksum> Checksum::FromHeader(std::string_view header) {
+    const auto space = header.find(' ');
+    if (space == std::string_view::npos) {
+        return std::nullopt;
+    }
+    const auto algorithm = header.substr(0, space);
+    auto digest = decodeBase64(header.substr(space + 1));
+    if (not digest.has_value()) {
+        return std::nullopt;
+    }
+
+    Checksum checksum;
+    if (algorithm == "sha1" && digest->size() == 20) {
+        checksum._algorithm = Algorithm::Sha1;
+    } else if (algorithm == "crc32" && digest->size() == 4) {
+        checksum._algorithm = Algorithm::Crc32;
+    } else {
+        return std::nullopt;
+    }
+    checksum._expected = std::move(digest.value());
+    return checksum;
+}
+
+void Checksum::Update(const uint8_t *data, size_t size) {
+    if (_algorithm == Algorithm::Crc32) {
+        _crc = crc32_z(_crc, data, size);
+        return;
+    }
+
+    _sha1Length += size;
+    if (_sha1Filled > 0) {
+        const size_t count = std::min(size, _sha1Block.size() - _sha1Filled);
+        std::memcpy(_sha1Block.data() + _sha1Filled, data, count);
+        _sha1Filled += count;
+        data += count;
+        size -= count;
+        if (_sha1Filled < _sha1Block.size()) {
+            return;
+        }
+        Sha1Block(_sha1Block.data());
+        _sha1Filled = 0;
+    }
+    for (; size >= _sha1Block.size(); data += _sha1Block.size(), size -= _sha1Block.size()) {
+        Sha1Block(data);
+    }
+    std::memcpy(_sha1Block.data(), data, size);
+    _sha1Filled = size;
+}
+
+bool Checksum::Matches() {
+    if (_algorithm == Algorithm::Crc32) {
+        const uint8_t digest[4]{static_cast<uint8_t>(_crc >> 24), static_cast<uint8_t>(_crc >> 16),
+            static_cast<uint8_t>(_crc >> 8), static_cast<uint8_t>(_crc)};
+        return std::memcmp(digest, _expected.data(), sizeof(digest)) == 0;
+    }
+    const auto digest = Sha1Digest();
+    return std::memcmp(digest.data(), _expected.data(), digest.size()) == 0;
+}
+
+void Checksum::Sha1Block(const uint8_t *block) {
+    std::array<uint32_t, 80> w{};
+    for (int i{0}; i < 16; i++) {
+        w[i] = static_cast<uint32_t>(block[4 * i]) << 24 | static_cast<uint32_t>(block[4 * i + 1]) << 16 |
+               static_cast<uint32_t>(block[4 * i + 2]) << 8 | static_cast<uint32_t>(block[4 * i + 3]);
+    }
+    for (int i{16}; i < 80; i++) {
+        w[i] = rotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    auto [a, b, c, d, e] = _sha1State;
+    for (int i{0}; i < 80; i++) {
+        uint32_t f;
+        uint32_t k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5a827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ed9eba1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8f1bbcdc;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xca62c1d6;
+        }
+        const uint32_t next = rotateLeft(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rotateLeft(b, 30);
+        b = a;
+        a = next;
+    }
+    _sha1State[0] += a;
+    _sha1State[1] += b;
+    _sha1State[2] += c;
+    _sha1State[3] += d;
+    _sha1State[4] += e;
+}
+
+std::array<uint8_t, 20> Checksum::Sha1Digest() {
+    // a one bit, zeros up to 8 bytes short of a block, then the length in bits
+    const uint64_t bits = _sha1Length * 8;
+    _sha1Block[_sha1Filled++] = 0x80;
+    if (_sha1Filled > 56) {
+        std::memset(_sha1Block.data() + _sha1Filled, 0, _sha1Block.size() - _sha1Filled);
+        Sha1Block(_sha1Block.data());
+        _sha1Filled = 0;
+    }
+    std::memset(_sha1Block.data() + _sha1Filled, 0, 56 - _sha1Filled);
+    for (int i{0}; i < 8; i++) {
+        _sha1Block[56 + i] = static_cast<uint8_t>(bits >> (56 - 8 * i));
+    }
+    Sha1Block(_sha1Block.data());
+
+    std::array<uint8_t, 20> digest{};
+    for (int i{0}; i < 20; i++) {
+        digest[i] = static_cast<uint8_t>(_sha1State[i / 4] >> (24 - 8 * (i % 4)));
+    }
+    return digest;
+}
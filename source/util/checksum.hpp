@@ -0,0 +1,44 @@
+#ifndef CONVENTION_NAMETAG_CHECKSUM_HPP
+#define CONVENTION_NAMETAG_CHECKSUM_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief Verifies data against a digest the client sent along, as in tus' Upload-Checksum
+ *
+ * sha1 is what every tus client offers; crc32 comes from zlib and costs a fraction of it on the Pi Zero.
+ */
+class Checksum {
+  public:
+    // "<algorithm> <base64 digest>", nullopt for an unknown algorithm or a digest of the wrong size
+    static std::optional<Checksum> FromHeader(std::string_view header);
+    // for the Tus-Checksum-Algorithm header
+    static constexpr std::string_view Algorithms = "sha1,crc32";
+
+    void Update(const uint8_t *data, size_t size);
+    // consumes the state, call once after the last Update
+    [[nodiscard]] bool Matches();
+
+  private:
+    enum class Algorithm { Sha1, Crc32 };
+
+    void Sha1Block(const uint8_t *block);
+    std::array<uint8_t, 20> Sha1Digest();
+
+    Algorithm _algorithm{Algorithm::Sha1};
+    std::string _expected;
+
+    unsigned long _crc{};
+
+    std::array<uint32_t, 5> _sha1State{0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+    std::array<uint8_t, 64> _sha1Block{};
+    size_t _sha1Filled{};
+    uint64_t _sha1Length{};
+};
+
+#endif // CONVENTION_NAMETAG_CHECKSUM_HPP
@@ -0,0 +1,107 @@
+#include "configuration.hpp"
+
+#include <cpptoml.h>
+
+#include <algorithm>
+#include <iostream>
+
+Configuration Configuration::Load(const std::filesystem::path &file) {
+    Configuration configuration;
+
+    std::shared_ptr<cpptoml::table> toml;
+    try {
+        toml = cpptoml::parse_file(file.string());
+    } catch (const cpptoml::parse_exception &e) {
+        std::cerr << "Could not read " << file << ", using defaults: " << e.what() << std::endl;
+        return configuration;
+    }
+
+    configuration.text.font =
+        toml->get_qualified_as<std::string>("text.font").value_or(configuration.text.font.string());
+    configuration.text.size =
+        static_cast<int>(toml->get_qualified_as<int64_t>("text.size").value_or(configuration.text.size));
+    const auto frameRate =
+        toml->get_qualified_as<int64_t>("animation.frameRate").value_or(configuration.animation.frameRate);
+    configuration.animation.frameRate = static_cast<int>(std::clamp<int64_t>(frameRate, 1, 1000));
+    const auto previewRate =
+        toml->get_qualified_as<int64_t>("preview.frameRate").value_or(configuration.preview.frameRate);
+    configuration.preview.frameRate = static_cast<int>(std::clamp<int64_t>(previewRate, 1, 60));
+    const auto expireHours =
+        toml->get_qualified_as<int64_t>("uploads.expireHours").value_or(configuration.uploads.expireHours);
+    configuration.uploads.expireHours = static_cast<int>(std::clamp<int64_t>(expireHours, 1, 24 * 30));
+    const auto stallTimeout =
+        toml->get_qualified_as<int64_t>("uploads.stallTimeoutMs").value_or(configuration.uploads.stallTimeoutMs);
+    configuration.uploads.stallTimeoutMs = static_cast<int>(std::clamp<int64_t>(stallTimeout, 100, 60 * 1000));
+    configuration.realtime.enabled =
+        toml->get_qualified_as<bool>("realtime.enabled").value_or(configuration.realtime.enabled);
+    const auto priority =
+        toml->get_qualified_as<int64_t>("realtime.priority").value_or(configuration.realtime.priority);
+    configuration.realtime.priority = static_cast<int>(std::clamp<int64_t>(priority, 1, 99));
+    configuration.realtime.lockMemory =
+        toml->get_qualified_as<bool>("realtime.lockMemory").value_or(configuration.realtime.lockMemory);
+    const auto backgroundNice =
+        toml->get_qualified_as<int64_t>("realtime.backgroundNice").value_or(configuration.realtime.backgroundNice);
+    configuration.realtime.backgroundNice = static_cast<int>(std::clamp<int64_t>(backgroundNice, 0, 19));
+    configuration.trace.enabled = toml->get_qualified_as<bool>("trace.enabled").value_or(configuration.trace.enabled);
+    const auto traceEvents =
+        toml->get_qualified_as<int64_t>("trace.eventsPerThread").value_or(configuration.trace.eventsPerThread);
+    configuration.trace.eventsPerThread = static_cast<int>(std::clamp<int64_t>(traceEvents, 1024, 1024 * 1024));
+    configuration.perf.enabled = toml->get_qualified_as<bool>("perf.enabled").value_or(configuration.perf.enabled);
+
+    // 0 only where it means no cap
+    const auto powerRate = [&toml](const char *key, int fallback, int minimum) {
+        return static_cast<int>(
+            std::clamp<int64_t>(toml->get_qualified_as<int64_t>(key).value_or(fallback), minimum, 1000));
+    };
+    auto &power = configuration.power;
+    power.maxFrameRate = powerRate("power.maxFrameRate", power.maxFrameRate, 0);
+    power.staticFrameRate = powerRate("power.staticFrameRate", power.staticFrameRate, 1);
+    power.batteryCapacity =
+        toml->get_qualified_as<std::string>("power.batteryCapacity").value_or(power.batteryCapacity);
+    const auto lowBattery =
+        toml->get_qualified_as<int64_t>("power.lowBatteryPercent").value_or(power.lowBatteryPercent);
+    power.lowBatteryPercent = static_cast<int>(std::clamp<int64_t>(lowBattery, 0, 100));
+    power.lowBatteryFrameRate = powerRate("power.lowBatteryFrameRate", power.lowBatteryFrameRate, 1);
+    const auto throttle =
+        toml->get_qualified_as<int64_t>("power.throttleTemperature").value_or(power.throttleTemperature);
+    power.throttleTemperature = static_cast<int>(std::clamp<int64_t>(throttle, 0, 120));
+    power.throttledFrameRate = powerRate("power.throttledFrameRate", power.throttledFrameRate, 1);
+    const auto baseMilliwatts = toml->get_qualified_as<int64_t>("power.baseMilliwatts").value_or(power.baseMilliwatts);
+    power.baseMilliwatts = static_cast<int>(std::clamp<int64_t>(baseMilliwatts, 0, 100000));
+    const auto cpuMilliwatts = toml->get_qualified_as<int64_t>("power.cpuMilliwatts").value_or(power.cpuMilliwatts);
+    power.cpuMilliwatts = static_cast<int>(std::clamp<int64_t>(cpuMilliwatts, 0, 100000));
+    power.batteryWattHours =
+        std::max(toml->get_qualified_as<double>("power.batteryWattHours").value_or(power.batteryWattHours), 0.);
+
+    auto &keys = configuration.keys;
+    keys.enabled = toml->get_qualified_as<bool>("keys.enabled").value_or(keys.enabled);
+    keys.chip = toml->get_qualified_as<std::string>("keys.chip").value_or(keys.chip);
+    const auto debounce = toml->get_qualified_as<int64_t>("keys.debounceMs").value_or(keys.debounceMs);
+    keys.debounceMs = static_cast<int>(std::clamp<int64_t>(debounce, 1, 100));
+    const auto longPress = toml->get_qualified_as<int64_t>("keys.longPressMs").value_or(keys.longPressMs);
+    keys.longPressMs = static_cast<int>(std::clamp<int64_t>(longPress, 100, 10000));
+    const auto repeat = toml->get_qualified_as<int64_t>("keys.repeatMs").value_or(keys.repeatMs);
+    keys.repeatMs = static_cast<int>(std::clamp<int64_t>(repeat, 20, 10000));
+
+    const auto serverPort = toml->get_qualified_as<int64_t>("server.port").value_or(configuration.server.port);
+    configuration.server.port = static_cast<int>(std::clamp<int64_t>(serverPort, 1, 65535));
+
+    auto &sync = configuration.sync;
+    const auto role = toml->get_qualified_as<std::string>("sync.role").value_or("off");
+    if (role == "master") {
+        sync.role = Sync::Role::Master;
+    } else if (role == "follower") {
+        sync.role = Sync::Role::Follower;
+    } else if (role != "off") {
+        std::cerr << "Unknown sync.role \"" << role << "\", not syncing" << std::endl;
+    }
+    sync.master = toml->get_qualified_as<std::string>("sync.master").value_or(sync.master);
+    const auto syncPort = toml->get_qualified_as<int64_t>("sync.port").value_or(sync.port);
+    sync.port = static_cast<int>(std::clamp<int64_t>(syncPort, 1, 65535));
+    const auto syncInterval = toml->get_qualified_as<int64_t>("sync.intervalMs").value_or(sync.intervalMs);
+    sync.intervalMs = static_cast<int>(std::clamp<int64_t>(syncInterval, 50, 60 * 1000));
+    const auto tolerance = toml->get_qualified_as<int64_t>("sync.toleranceMs").value_or(sync.toleranceMs);
+    sync.toleranceMs = static_cast<int>(std::clamp<int64_t>(tolerance, 0, 1000));
+
+    return configuration;
+}
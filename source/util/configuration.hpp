@@ -0,0 +1,105 @@
+#ifndef CONVENTION_NAMETAG_CONFIGURATION_HPP
+#define CONVENTION_NAMETAG_CONFIGURATION_HPP
+
+#include <filesystem>
+#include <string>
+
+/**
+ * @brief Settings from configuration.toml, anything missing keeps its default
+ */
+struct Configuration {
+    struct Text {
+        std::filesystem::path font{"/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf"};
+        int size{16};
+    } text;
+
+    struct Animation {
+        // the panel's maximum rate, scenes render at this pace and this is their per frame time budget
+        int frameRate{100};
+    } animation;
+
+    struct Preview {
+        // highest rate the panel is streamed to WebSocket viewers at
+        int frameRate{15};
+    } preview;
+
+    struct Uploads {
+        // resumable uploads left alone for this long are deleted
+        int expireHours{24};
+        // a video played while it is uploaded waits this long for missing data before it loops back to the start
+        int stallTimeoutMs{5000};
+    } uploads;
+
+    struct Realtime {
+        // render thread under SCHED_FIFO, which needs root, CAP_SYS_NICE or an rtprio limit; without, it keeps
+        // normal scheduling and the rest of this still applies
+        bool enabled{false};
+        int priority{50};
+        // keeps memory from being paged out, needs CAP_IPC_LOCK or an unlimited memlock limit
+        bool lockMemory{true};
+        // niceness of the web server, the prefetch thread and every other thread but the render thread
+        int backgroundNice{10};
+    } realtime;
+
+    struct Trace {
+        // a span costs two clock reads, cheap enough to leave on and look back once a hitch happened
+        bool enabled{true};
+        // per thread; the render thread records about five a frame, so this covers a good half minute at 100 fps
+        int eventsPerThread{16384};
+    } trace;
+
+    struct Perf {
+        // hardware counters around each stage of the render path, two syscalls a stage; GET /perf/stats has them
+        bool enabled{false};
+    } perf;
+
+    struct Power {
+        // cap on the panel's rate, 0 leaves it to the content
+        int maxFrameRate{0};
+        // once nothing changed on the panel for a second, until something does
+        int staticFrameRate{10};
+        // sysfs file with the charge in percent, like /sys/class/power_supply/battery/capacity; empty if there is none
+        std::string batteryCapacity;
+        int lowBatteryPercent{20};
+        int lowBatteryFrameRate{15};
+        // while the SoC is this hot in °C or its clock is capped, 0 ignores thermal and cpufreq state
+        int throttleTemperature{75};
+        int throttledFrameRate{15};
+        // for the estimates per mode: the badge's draw when idle and what a fully busy core adds, the battery's size
+        int baseMilliwatts{500};
+        int cpuMilliwatts{400};
+        double batteryWattHours{0.};
+    } power;
+
+    struct Keys {
+        // the joystick and three keys of the SH1106 HAT, read through the GPIO character device
+        bool enabled{false};
+        std::string chip{"/dev/gpiochip0"};
+        // edges this soon after the one acted on are contact bounce
+        int debounceMs{10};
+        // held this long counts as a long press, after that the key repeats every repeatMs
+        int longPressMs{600};
+        int repeatMs{150};
+    } keys;
+
+    struct Server {
+        int port{8080};
+    } server;
+
+    struct Sync {
+        // a master serves its clock and what it plays, followers play the same in lockstep
+        enum class Role { Off, Master, Follower } role{Role::Off};
+        // followers: address of the master, empty to find it by broadcast on the LAN
+        std::string master;
+        // UDP, the master listens on it
+        int port{47800};
+        // followers: between clock exchanges
+        int intervalMs{1000};
+        // followers: timelines further apart than this are moved into line
+        int toleranceMs{2};
+    } sync;
+
+    static Configuration Load(const std::filesystem::path &file);
+};
+
+#endif // CONVENTION_NAMETAG_CONFIGURATION_HPP
@@ -0,0 +1,67 @@
+#include "deadlineMonitor.hpp"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <utility>
+
+DeadlineMonitor::DeadlineMonitor(std::chrono::microseconds fallbackInterval) : _fallbackInterval{fallbackInterval} {}
+
+void DeadlineMonitor::FrameDone(std::chrono::steady_clock::time_point now, std::chrono::microseconds interval) {
+    // RUSAGE_THREAD: the caller's own, a few hundred ns
+    rusage usage{};
+    getrusage(RUSAGE_THREAD, &usage);
+    const auto minorFaults = usage.ru_minflt - std::exchange(_minorFaults, usage.ru_minflt);
+    const auto majorFaults = usage.ru_majflt - std::exchange(_majorFaults, usage.ru_majflt);
+    const auto preemptions = usage.ru_nivcsw - std::exchange(_preemptions, usage.ru_nivcsw);
+
+    const auto previous = std::exchange(_lastFrame, now);
+    if (previous == std::chrono::steady_clock::time_point{}) {
+        return;
+    }
+    if (interval.count() <= 0) {
+        interval = _fallbackInterval;
+    }
+    const auto late = std::chrono::duration_cast<std::chrono::microseconds>(now - previous) - interval;
+
+    auto lock = std::lock_guard<std::mutex>(_access);
+    _stats.frames++;
+    _stats.minorFaults += minorFaults;
+    _stats.majorFaults += majorFaults;
+    _stats.preemptions += preemptions;
+    if (late <= interval / 2) {
+        return;
+    }
+    _misses[static_cast<size_t>(_stats.misses) % Capacity] =
+        Miss{now, late, preemptions > 0, minorFaults + majorFaults > 0};
+    _stats.misses++;
+    _stats.maxLate = std::max(_stats.maxLate, late);
+    _stats.totalLate += late;
+}
+
+std::vector<DeadlineMonitor::Miss> DeadlineMonitor::GetMisses(std::chrono::steady_clock::time_point since) const {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    const auto count = static_cast<size_t>(_stats.misses);
+    std::vector<Miss> misses;
+    for (size_t i = count > Capacity ? count - Capacity : 0; i < count; i++) {
+        if (const auto &miss = _misses[i % Capacity]; miss.at > since) {
+            misses.push_back(miss);
+        }
+    }
+    return misses;
+}
+
+DeadlineMonitor::Stats DeadlineMonitor::GetStats() const {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    return _stats;
+}
+
+void DeadlineMonitor::SetSchedule(const Realtime::Schedule &schedule) {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    _schedule = schedule;
+}
+
+Realtime::Schedule DeadlineMonitor::GetSchedule() const {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    return _schedule;
+}
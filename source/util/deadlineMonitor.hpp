@@ -0,0 +1,74 @@
+#ifndef CONVENTION_NAMETAG_DEADLINEMONITOR_HPP
+#define CONVENTION_NAMETAG_DEADLINEMONITOR_HPP
+
+#include "realtime.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Counts render loop iterations that came later than the frames they show were due
+ *
+ * A frame is missed when the time since the previous one exceeds its interval by more than half an interval. The
+ * interval is the playing decoder's, or the panel's fastest rate for decoders without one. Misses are kept with their
+ * time on the steady clock, which on Linux all processes share, so a load test on the same host can line them up
+ * with its requests. Each frame the render thread's page faults and preemptions are sampled, so a miss shows whether
+ * the thread lost the CPU or waited on memory.
+ *
+ * FrameDone is for the render thread, the rest for anyone.
+ */
+class DeadlineMonitor {
+  public:
+    explicit DeadlineMonitor(std::chrono::microseconds fallbackInterval);
+
+    // interval is what the frame just shown should have taken, zero for the fallback
+    void FrameDone(std::chrono::steady_clock::time_point now, std::chrono::microseconds interval);
+
+    struct Miss {
+        std::chrono::steady_clock::time_point at;
+        // past the interval
+        std::chrono::microseconds late;
+        // during the late frame
+        bool preempted;
+        bool faulted;
+    };
+    // misses after since, oldest first, at most the last Capacity
+    [[nodiscard]] std::vector<Miss> GetMisses(std::chrono::steady_clock::time_point since) const;
+
+    struct Stats {
+        long long frames{};
+        long long misses{};
+        std::chrono::microseconds maxLate{};
+        std::chrono::microseconds totalLate{};
+        // of the render thread since its first frame, what real-time mode should keep near zero
+        long long minorFaults{};
+        long long majorFaults{};
+        long long preemptions{};
+    };
+    [[nodiscard]] Stats GetStats() const;
+
+    // what the render thread runs under
+    void SetSchedule(const Realtime::Schedule &schedule);
+    [[nodiscard]] Realtime::Schedule GetSchedule() const;
+
+  private:
+    static constexpr size_t Capacity = 1024;
+
+    const std::chrono::microseconds _fallbackInterval;
+    std::chrono::steady_clock::time_point _lastFrame;
+    // of the render thread at the last frame
+    long long _minorFaults{};
+    long long _majorFaults{};
+    long long _preemptions{};
+
+    // the last Capacity misses, _stats.misses is where the next one goes
+    std::array<Miss, Capacity> _misses{};
+    Stats _stats;
+    Realtime::Schedule _schedule;
+    mutable std::mutex _access;
+};
+
+#endif // CONVENTION_NAMETAG_DEADLINEMONITOR_HPP
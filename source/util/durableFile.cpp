@@ -0,0 +1,58 @@
+#include "durableFile.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace {
+// errno is what the caller reports, not whatever close leaves in it
+void closeKeepingErrno(int fd) {
+    const int error = errno;
+    close(fd);
+    errno = error;
+}
+} // namespace
+
+namespace DurableFile {
+bool Replace(const std::filesystem::path &path, std::string_view data) {
+    const auto temporary = std::filesystem::path(path) += ".tmp";
+    const int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    while (not data.empty()) {
+        const auto count = write(fd, data.data(), data.size());
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            if (count == 0) {
+                errno = ENOSPC;
+            }
+            closeKeepingErrno(fd);
+            return false;
+        }
+        data.remove_prefix(static_cast<size_t>(count));
+    }
+    if (fsync(fd) != 0) {
+        closeKeepingErrno(fd);
+        return false;
+    }
+    close(fd);
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+void SyncFolder(const std::filesystem::path &folder) {
+    const int fd = open(folder.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0 || fsync(fd) != 0) {
+        std::cerr << "Could not sync " << folder << ": " << std::strerror(errno) << std::endl;
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+} // namespace DurableFile
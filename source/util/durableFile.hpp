@@ -0,0 +1,20 @@
+#ifndef CONVENTION_NAMETAG_DURABLEFILE_HPP
+#define CONVENTION_NAMETAG_DURABLEFILE_HPP
+
+#include <filesystem>
+#include <string_view>
+
+/**
+ * @brief Replacing small state files so that a power cut leaves either the old or the new one
+ *
+ * The badge is switched off by pulling the battery. A rename only survives that once the renamed file's data and the
+ * folder holding it are on the card, so the file is synced before it is renamed and the folder after.
+ */
+namespace DurableFile {
+// writes data to path.tmp, syncs it and renames it over path; false with errno set if any step failed
+[[nodiscard]] bool Replace(const std::filesystem::path &path, std::string_view data);
+// makes the renames within folder durable, once after a batch of Replace calls is enough
+void SyncFolder(const std::filesystem::path &folder);
+} // namespace DurableFile
+
+#endif // CONVENTION_NAMETAG_DURABLEFILE_HPP
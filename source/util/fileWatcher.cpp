@@ -0,0 +1,126 @@
+#include "fileWatcher.hpp"
+#include "trace.hpp"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <iostream>
+
+FileWatcher::FileWatcher()
+    : _inotifyFd{inotify_init1(IN_NONBLOCK | IN_CLOEXEC)}, _wakeFd{eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)} {
+    if (_inotifyFd < 0) {
+        std::cerr << "Could not initialize inotify: " << std::strerror(errno) << std::endl;
+    }
+}
+
+FileWatcher::~FileWatcher() {
+    Stop();
+    if (_inotifyFd >= 0) {
+        close(_inotifyFd);
+    }
+    if (_wakeFd >= 0) {
+        close(_wakeFd);
+    }
+}
+
+bool FileWatcher::Watch(const std::filesystem::path &directory, uint32_t mask, Callback callback) {
+    if (_inotifyFd < 0) {
+        return false;
+    }
+    const int wd = inotify_add_watch(_inotifyFd, directory.c_str(), mask);
+    if (wd < 0) {
+        std::cerr << "Could not watch " << directory << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    auto lock = std::lock_guard<std::mutex>(_access);
+    _watches[wd] = WatchEntry{directory, std::move(callback)};
+    return true;
+}
+
+void FileWatcher::Post(std::function<void()> task) {
+    {
+        auto lock = std::lock_guard<std::mutex>(_access);
+        _tasks.push_back(std::move(task));
+    }
+    Wake();
+}
+
+void FileWatcher::Start() {
+    if (_running) {
+        return;
+    }
+    _running = true;
+    _thread = std::thread([this]() { Run(); });
+}
+
+void FileWatcher::Stop() {
+    if (not _running) {
+        return;
+    }
+    _running = false;
+    Wake();
+    _thread.join();
+}
+
+void FileWatcher::Wake() {
+    const uint64_t one{1};
+    [[maybe_unused]] auto written = write(_wakeFd, &one, sizeof(one));
+}
+
+void FileWatcher::Run() {
+    Trace::SetThreadName("file watcher");
+    // inotify guarantees events to be aligned and no larger than this
+    alignas(inotify_event) char events[4096];
+
+    pollfd fds[2]{{_inotifyFd, POLLIN, 0}, {_wakeFd, POLLIN, 0}};
+
+    while (_running) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "File watcher poll failed: " << std::strerror(errno) << std::endl;
+            return;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            uint64_t count;
+            [[maybe_unused]] auto read_ = read(_wakeFd, &count, sizeof(count));
+
+            std::deque<std::function<void()>> tasks;
+            {
+                auto lock = std::lock_guard<std::mutex>(_access);
+                std::swap(tasks, _tasks);
+            }
+            for (auto &task : tasks) {
+                task();
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            ssize_t length;
+            while ((length = read(_inotifyFd, events, sizeof(events))) > 0) {
+                for (char *ptr = events; ptr < events + length;) {
+                    const auto *event = reinterpret_cast<const inotify_event *>(ptr);
+                    ptr += sizeof(inotify_event) + event->len;
+
+                    WatchEntry *entry;
+                    {
+                        auto lock = std::lock_guard<std::mutex>(_access);
+                        auto it = _watches.find(event->wd);
+                        if (it == _watches.end()) {
+                            continue;
+                        }
+                        entry = &it->second;
+                    }
+                    entry->callback(entry->directory, event->len > 0 ? std::string(event->name) : std::string(),
+                        event->mask);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef CONVENTION_NAMETAG_FILEWATCHER_HPP
+#define CONVENTION_NAMETAG_FILEWATCHER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+/**
+ * @brief inotify wrapper running its callbacks on a dedicated thread
+ *
+ * The thread blocks in poll() until the kernel reports a change or work is posted, so an idle watcher costs nothing.
+ */
+class FileWatcher {
+  public:
+    // directory that was watched, name of the affected entry inside it, inotify event mask
+    using Callback = std::function<void(const std::filesystem::path &, const std::string &, uint32_t)>;
+
+    FileWatcher();
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher &) = delete;
+    FileWatcher &operator=(const FileWatcher &) = delete;
+
+    bool Watch(const std::filesystem::path &directory, uint32_t mask, Callback callback);
+    // run a task on the watcher thread, serialized with the callbacks
+    void Post(std::function<void()> task);
+
+    void Start();
+    void Stop();
+
+  private:
+    void Run();
+    void Wake();
+
+    struct WatchEntry {
+        std::filesystem::path directory;
+        Callback callback;
+    };
+
+    int _inotifyFd{-1};
+    int _wakeFd{-1};
+
+    std::unordered_map<int, WatchEntry> _watches;
+    std::deque<std::function<void()>> _tasks;
+    std::mutex _access;
+
+    std::thread _thread;
+    std::atomic<bool> _running{false};
+};
+
+#endif // CONVENTION_NAMETAG_FILEWATCHER_HPP
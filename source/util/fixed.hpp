@@ -0,0 +1,101 @@
+#ifndef CONVENTION_NAMETAG_FIXED_HPP
+#define CONVENTION_NAMETAG_FIXED_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <compare>
+#include <cstdint>
+#include <numbers>
+
+/**
+ * @brief Q16.16 fixed point number
+ *
+ * The Pi Zero's ARM1176 has a VFP unit but no NEON, and every float to int conversion on the way to a pixel address
+ * stalls it. Rasterization stays in integer registers instead, products go through 64 bit.
+ */
+struct Fixed {
+    static constexpr int FractionBits = 16;
+    static constexpr int32_t One = 1 << FractionBits;
+
+    int32_t raw{};
+
+    static constexpr Fixed FromRaw(int32_t value) { return Fixed{value}; }
+    static constexpr Fixed FromInt(int value) { return Fixed{value * One}; }
+    // for parsing input only, never per pixel
+    static Fixed FromDouble(double value) { return Fixed{static_cast<int32_t>(std::lround(value * One))}; }
+
+    [[nodiscard]] constexpr int Floor() const { return raw >> FractionBits; }
+    [[nodiscard]] constexpr int Ceil() const { return static_cast<int>((int64_t{raw} + One - 1) >> FractionBits); }
+    [[nodiscard]] constexpr int Round() const { return static_cast<int>((int64_t{raw} + One / 2) >> FractionBits); }
+
+    constexpr Fixed operator+(Fixed other) const { return Fixed{raw + other.raw}; }
+    constexpr Fixed operator-(Fixed other) const { return Fixed{raw - other.raw}; }
+    constexpr Fixed operator-() const { return Fixed{-raw}; }
+    constexpr Fixed operator*(Fixed other) const {
+        return Fixed{static_cast<int32_t>((int64_t{raw} * other.raw) >> FractionBits)};
+    }
+    // saturates instead of overflowing or trapping on zero
+    constexpr Fixed operator/(Fixed other) const {
+        if (other.raw == 0) {
+            return Fixed{raw < 0 ? INT32_MIN : INT32_MAX};
+        }
+        const int64_t quotient = int64_t{raw} * One / other.raw;
+        return Fixed{static_cast<int32_t>(std::clamp<int64_t>(quotient, INT32_MIN, INT32_MAX))};
+    }
+    constexpr Fixed &operator+=(Fixed other) { return *this = *this + other; }
+    constexpr Fixed &operator-=(Fixed other) { return *this = *this - other; }
+
+    constexpr auto operator<=>(const Fixed &other) const = default;
+};
+
+constexpr Fixed lerp(Fixed from, Fixed to, Fixed t) { return from + (to - from) * t; }
+
+constexpr Fixed abs(Fixed value) { return value.raw < 0 ? -value : value; }
+
+// integer square root, bit by bit
+constexpr uint64_t isqrt(uint64_t value) {
+    uint64_t root{};
+    for (uint64_t bit = uint64_t{1} << 62; bit != 0; bit >>= 2) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+    }
+    return root;
+}
+
+// the square root of a Q32.32 value is Q16.16, so the root keeps all fraction bits
+constexpr Fixed sqrt(Fixed value) {
+    if (value.raw <= 0) {
+        return {};
+    }
+    return Fixed::FromRaw(static_cast<int32_t>(isqrt(static_cast<uint64_t>(value.raw) << Fixed::FractionBits)));
+}
+
+namespace detail {
+// one period of sine in Q16.16, plus one entry so interpolation never wraps
+inline const auto SineTable = []() {
+    std::array<int32_t, 1025> table{};
+    for (size_t i{0}; i < table.size(); i++) {
+        table[i] = static_cast<int32_t>(std::lround(Fixed::One * std::sin(2. * std::numbers::pi * i / 1024.)));
+    }
+    return table;
+}();
+} // namespace detail
+
+// angles are in turns, 1.0 is 360 degrees; 1024 steps per turn, linearly interpolated
+inline Fixed sinTurns(Fixed turns) {
+    const auto position = static_cast<uint32_t>(turns.raw) & (Fixed::One - 1);
+    const auto index = position >> 6;
+    const auto fraction = static_cast<int32_t>(position & 0x3F);
+    const int32_t from = detail::SineTable[index];
+    const int32_t to = detail::SineTable[index + 1];
+    return Fixed::FromRaw(from + (((to - from) * fraction) >> 6));
+}
+
+inline Fixed cosTurns(Fixed turns) { return sinTurns(turns + Fixed::FromRaw(Fixed::One / 4)); }
+
+#endif // CONVENTION_NAMETAG_FIXED_HPP
@@ -0,0 +1,177 @@
+#include "governor.hpp"
+#include "trace.hpp"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <utility>
+
+namespace {
+// without anything sent to the panel for this long, the content counts as static
+const auto StaticAfter = std::chrono::seconds(1);
+const auto SampleInterval = std::chrono::seconds(1);
+
+const auto ThermalZone = "/sys/class/thermal/thermal_zone0/temp";
+// the thermal framework caps the clock by lowering the policy's maximum
+const auto CurrentMaxFrequency = "/sys/devices/system/cpu/cpu0/cpufreq/scaling_max_freq";
+const auto MaxFrequency = "/sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_max_freq";
+// Raspberry Pi firmware: bit 1 the ARM clock is capped, bit 2 it is throttled right now
+const auto FirmwareThrottled = "/sys/devices/platform/soc/soc:firmware/get_throttled";
+
+std::optional<long long> readNumber(const std::filesystem::path &path, int base = 10) {
+    std::ifstream file(path);
+    std::string text;
+    if (not(file >> text)) {
+        return std::nullopt;
+    }
+    try {
+        return std::stoll(text, nullptr, base);
+    } catch (const std::exception &) {
+        return std::nullopt;
+    }
+}
+
+std::chrono::microseconds intervalOf(int frameRate) {
+    return frameRate > 0 ? std::chrono::microseconds(1000000 / frameRate) : std::chrono::microseconds{};
+}
+
+std::chrono::microseconds cpuTime() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    const auto toUs = [](const timeval &time) {
+        return std::chrono::seconds(time.tv_sec) + std::chrono::microseconds(time.tv_usec);
+    };
+    return toUs(usage.ru_utime) + toUs(usage.ru_stime);
+}
+} // namespace
+
+Governor::Governor(const Configuration::Power &configuration) : _configuration{configuration} {}
+
+Governor::~Governor() { Stop(); }
+
+void Governor::Start() {
+    _cpuTime = cpuTime();
+    _running = true;
+    _thread = std::thread(&Governor::Run, this);
+}
+
+void Governor::Stop() {
+    {
+        auto lock = std::lock_guard<std::mutex>(_access);
+        _running = false;
+    }
+    _wake.notify_one();
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+
+const char *Governor::GetName(Mode mode) {
+    switch (mode) {
+    case Mode::Playing:
+        return "playing";
+    case Mode::Static:
+        return "static";
+    case Mode::LowBattery:
+        return "lowBattery";
+    case Mode::Throttled:
+        return "throttled";
+    default:
+        return "";
+    }
+}
+
+void Governor::Pace(std::chrono::steady_clock::time_point frameStart, std::chrono::microseconds content, bool pushed) {
+    const auto now = std::chrono::steady_clock::now();
+    if (pushed) {
+        _lastPush = now;
+    }
+
+    auto interval = std::max(content, intervalOf(_configuration.maxFrameRate));
+    auto mode = Mode::Playing;
+    if (_throttled.load(std::memory_order_relaxed)) {
+        mode = Mode::Throttled;
+        interval = std::max(interval, intervalOf(_configuration.throttledFrameRate));
+    } else if (_lowBattery.load(std::memory_order_relaxed)) {
+        mode = Mode::LowBattery;
+        interval = std::max(interval, intervalOf(_configuration.lowBatteryFrameRate));
+    }
+    // static beats the others, it is the slowest anyway
+    if (now - _lastPush > StaticAfter) {
+        mode = Mode::Static;
+        interval = std::max(interval, intervalOf(_configuration.staticFrameRate));
+    }
+    _interval.store(interval.count(), std::memory_order_relaxed);
+    _mode.store(mode, std::memory_order_relaxed);
+    {
+        auto lock = std::lock_guard<std::mutex>(_access);
+        auto &stats = _stats.modes[static_cast<size_t>(mode)];
+        stats.time += now - std::exchange(_lastPace, now);
+        stats.frames++;
+        stats.pushes += pushed ? 1 : 0;
+    }
+
+    // at the content's own rate the decoder waits for its frames already
+    if (interval > content && frameStart + interval > now) {
+        Trace::Scope trace{"render", "governor", interval.count()};
+        std::this_thread::sleep_until(frameStart + interval);
+    }
+}
+
+Governor::Stats Governor::GetStats() const {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    auto stats = _stats;
+    stats.mode = _mode.load(std::memory_order_relaxed);
+    stats.interval = GetInterval();
+    return stats;
+}
+
+void Governor::Run() {
+    Trace::SetThreadName("governor");
+    auto lock = std::unique_lock<std::mutex>(_access);
+    while (not _wake.wait_for(lock, SampleInterval, [this]() { return not _running; })) {
+        lock.unlock();
+        Sample();
+        lock.lock();
+    }
+}
+
+void Governor::Sample() {
+    std::optional<int> battery;
+    if (not _configuration.batteryCapacity.empty()) {
+        if (const auto capacity = readNumber(_configuration.batteryCapacity); capacity.has_value()) {
+            battery = static_cast<int>(capacity.value());
+        }
+    }
+
+    std::optional<double> temperature;
+    bool throttled{};
+    if (_configuration.throttleTemperature > 0) {
+        if (const auto milliDegrees = readNumber(ThermalZone); milliDegrees.has_value()) {
+            temperature = static_cast<double>(milliDegrees.value()) / 1000.;
+            throttled = temperature.value() >= _configuration.throttleTemperature;
+        }
+        const auto capped = readNumber(CurrentMaxFrequency);
+        const auto maximum = readNumber(MaxFrequency);
+        throttled = throttled || (capped.has_value() && maximum.has_value() && capped.value() < maximum.value());
+        if (const auto flags = readNumber(FirmwareThrottled, 16); flags.has_value()) {
+            throttled = throttled || (flags.value() & 0b110) != 0;
+        }
+    }
+
+    _lowBattery.store(battery.has_value() && battery.value() <= _configuration.lowBatteryPercent,
+        std::memory_order_relaxed);
+    _throttled.store(throttled, std::memory_order_relaxed);
+
+    // the CPU time since the last sample goes to the mode the loop is in now, close enough at one second
+    const auto cpu = cpuTime();
+    auto lock = std::lock_guard<std::mutex>(_access);
+    _stats.modes[static_cast<size_t>(_mode.load(std::memory_order_relaxed))].cpuTime += cpu - _cpuTime;
+    _cpuTime = cpu;
+    _stats.batteryPercent = battery;
+    _stats.temperature = temperature;
+    _stats.throttled = throttled;
+}
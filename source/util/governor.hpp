@@ -0,0 +1,86 @@
+#ifndef CONVENTION_NAMETAG_GOVERNOR_HPP
+#define CONVENTION_NAMETAG_GOVERNOR_HPP
+
+#include "configuration.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+/**
+ * @brief Paces the render loop no faster than the panel needs to change, to save battery
+ *
+ * The loop runs at the content's frame rate under the configured cap. It slows down to the static rate once nothing
+ * was sent to the panel for a second, and to lower rates while the battery is low or the SoC is throttling; video
+ * decoders drop the frames that are due before the loop gets to them. A thread of its own samples the battery,
+ * thermal and cpufreq state from sysfs every second and books the process' CPU time to the mode the loop was in, so
+ * each mode comes with an estimate of its draw for planning a day on battery.
+ *
+ * Pace is for the render thread, the rest for anyone.
+ */
+class Governor {
+  public:
+    explicit Governor(const Configuration::Power &configuration);
+    ~Governor();
+
+    Governor(const Governor &) = delete;
+    Governor &operator=(const Governor &) = delete;
+
+    void Start();
+    void Stop();
+
+    enum class Mode { Playing, Static, LowBattery, Throttled, Count };
+    static const char *GetName(Mode mode);
+
+    // render thread, after each frame: pushed tells if anything was sent to the panel, content is the decoder's
+    // interval or zero; sleeps until the next frame is due
+    void Pace(std::chrono::steady_clock::time_point frameStart, std::chrono::microseconds content, bool pushed);
+    // what the next frame should take, zero if the loop is not held back
+    [[nodiscard]] std::chrono::microseconds GetInterval() const {
+        return std::chrono::microseconds(_interval.load(std::memory_order_relaxed));
+    }
+
+    struct ModeStats {
+        std::chrono::nanoseconds time{};
+        std::chrono::microseconds cpuTime{};
+        long long frames{};
+        long long pushes{};
+    };
+    struct Stats {
+        Mode mode{};
+        std::chrono::microseconds interval{};
+        std::optional<int> batteryPercent;
+        std::optional<double> temperature;
+        bool throttled{};
+        std::array<ModeStats, static_cast<size_t>(Mode::Count)> modes{};
+    };
+    [[nodiscard]] Stats GetStats() const;
+
+  private:
+    void Run();
+    void Sample();
+
+    const Configuration::Power _configuration;
+
+    // render thread only
+    std::chrono::steady_clock::time_point _lastPush{std::chrono::steady_clock::now()};
+    std::chrono::steady_clock::time_point _lastPace{std::chrono::steady_clock::now()};
+
+    std::atomic<int64_t> _interval{};
+    std::atomic<Mode> _mode{Mode::Playing};
+    std::atomic<bool> _lowBattery{};
+    std::atomic<bool> _throttled{};
+
+    Stats _stats;
+    std::chrono::microseconds _cpuTime{};
+    bool _running{};
+    mutable std::mutex _access;
+    std::condition_variable _wake;
+    std::thread _thread;
+};
+
+#endif // CONVENTION_NAMETAG_GOVERNOR_HPP
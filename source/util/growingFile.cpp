@@ -0,0 +1,41 @@
+#include "growingFile.hpp"
+
+GrowingFile::GrowingFile(std::filesystem::path path, uintmax_t length) : _path{std::move(path)}, _length{length} {}
+
+void GrowingFile::Grow(uintmax_t size) {
+    {
+        auto lock = std::lock_guard<std::mutex>(_access);
+        _size = size;
+    }
+    _grown.notify_all();
+}
+
+void GrowingFile::End(bool complete) {
+    {
+        auto lock = std::lock_guard<std::mutex>(_access);
+        _ended = true;
+        _complete = complete;
+    }
+    _grown.notify_all();
+}
+
+uintmax_t GrowingFile::WaitBeyond(uintmax_t offset, std::chrono::milliseconds timeout) {
+    auto lock = std::unique_lock<std::mutex>(_access);
+    _grown.wait_for(lock, timeout, [this, offset]() { return _ended || _size > offset; });
+    return _size;
+}
+
+uintmax_t GrowingFile::GetSize() const {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    return _size;
+}
+
+bool GrowingFile::Ended() const {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    return _ended;
+}
+
+bool GrowingFile::Complete() const {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    return _complete;
+}
@@ -0,0 +1,48 @@
+#ifndef CONVENTION_NAMETAG_GROWINGFILE_HPP
+#define CONVENTION_NAMETAG_GROWINGFILE_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+
+/**
+ * @brief A file still being uploaded, for reading along while it arrives
+ *
+ * The upload writer reports how far the data on disk reaches after every write and when the upload ends; readers wait
+ * for the bytes they need instead of taking the current end of the file for the end of the video.
+ */
+class GrowingFile {
+  public:
+    // length is the size the file will have once complete, 0 if unknown
+    GrowingFile(std::filesystem::path path, uintmax_t length);
+
+    // writer thread
+    void Grow(uintmax_t size);
+    void End(bool complete);
+
+    // blocks until more than offset bytes are on disk, the upload ended or timeout passed; returns the bytes on disk
+    uintmax_t WaitBeyond(uintmax_t offset, std::chrono::milliseconds timeout);
+
+    [[nodiscard]] const std::filesystem::path &GetPath() const { return _path; }
+    [[nodiscard]] uintmax_t GetLength() const { return _length; }
+    [[nodiscard]] std::chrono::steady_clock::time_point GetStart() const { return _start; }
+    [[nodiscard]] uintmax_t GetSize() const;
+    // no more data is coming, successful or not
+    [[nodiscard]] bool Ended() const;
+    [[nodiscard]] bool Complete() const;
+
+  private:
+    const std::filesystem::path _path;
+    const uintmax_t _length;
+    const std::chrono::steady_clock::time_point _start{std::chrono::steady_clock::now()};
+
+    uintmax_t _size{};
+    bool _ended{};
+    bool _complete{};
+    mutable std::mutex _access;
+    std::condition_variable _grown;
+};
+
+#endif // CONVENTION_NAMETAG_GROWINGFILE_HPP
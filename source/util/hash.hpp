@@ -0,0 +1,21 @@
+#ifndef CONVENTION_NAMETAG_HASH_HPP
+#define CONVENTION_NAMETAG_HASH_HPP
+
+#include <cstdint>
+#include <format>
+#include <string>
+#include <string_view>
+
+// FNV-1a, plenty for cache validators
+constexpr uint64_t fnv1a(std::string_view data, uint64_t hash = 0xcbf29ce484222325ULL) {
+    for (const char c : data) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// strong ETag header value for the given content
+inline std::string makeETag(std::string_view data) { return std::format("\"{:016x}\"", fnv1a(data)); }
+
+#endif // CONVENTION_NAMETAG_HASH_HPP
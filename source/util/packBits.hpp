@@ -0,0 +1,67 @@
+#ifndef CONVENTION_NAMETAG_PACKBITS_HPP
+#define CONVENTION_NAMETAG_PACKBITS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+/**
+ * PackBits: a control byte n of 0-127 is followed by n + 1 literal bytes, one of 129-255 by a byte repeated 257 - n
+ * times. XOR deltas are mostly zero, which this shrinks to 2 bytes per 128.
+ */
+inline void packBits(const uint8_t *data, size_t size, std::string &out) {
+    size_t i{0};
+    while (i < size) {
+        size_t run{1};
+        while (i + run < size && run < 128 && data[i + run] == data[i]) {
+            run++;
+        }
+        if (run >= 2) {
+            out.push_back(static_cast<char>(257 - run));
+            out.push_back(static_cast<char>(data[i]));
+            i += run;
+            continue;
+        }
+
+        // literals until a run of three starts, two equal bytes are cheaper inside a literal
+        const size_t start = i;
+        while (i < size && i - start < 128) {
+            if (i + 2 < size && data[i] == data[i + 1] && data[i] == data[i + 2]) {
+                break;
+            }
+            i++;
+        }
+        out.push_back(static_cast<char>(i - start - 1));
+        out.append(reinterpret_cast<const char *>(data + start), i - start);
+    }
+}
+
+// false unless the data unpacks to exactly size bytes
+inline bool unpackBits(const uint8_t *data, size_t length, uint8_t *out, size_t size) {
+    size_t written{0};
+    size_t i{0};
+    while (i < length) {
+        const uint8_t control = data[i++];
+        if (control < 128) {
+            const size_t count = control + 1u;
+            if (i + count > length || written + count > size) {
+                return false;
+            }
+            std::memcpy(out + written, data + i, count);
+            i += count;
+            written += count;
+        } else if (control > 128) {
+            const size_t count = 257u - control;
+            if (i >= length || written + count > size) {
+                return false;
+            }
+            std::memset(out + written, data[i++], count);
+            written += count;
+        }
+        // 128 is a no-op in PackBits
+    }
+    return written == size;
+}
+
+#endif // CONVENTION_NAMETAG_PACKBITS_HPP
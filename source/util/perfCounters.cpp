@@ -0,0 +1,270 @@
+#include "perfCounters.hpp"
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <string_view>
+
+namespace {
+constexpr std::array<uint64_t, Perf::EventCount> EventConfigs{PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+struct Group {
+    int leader{-1};
+    // in the order read returns them, the leader first
+    std::vector<Perf::Event> events;
+    std::vector<int> members;
+};
+
+// opened by its thread the first time it enters a stage, closed when it ends
+struct Counters {
+    ~Counters() {
+        for (const auto &group : groups) {
+            for (const int fd : group.members) {
+                close(fd);
+            }
+            close(group.leader);
+        }
+    }
+
+    bool opened{};
+    std::vector<Group> groups;
+};
+
+struct Totals {
+    const char *name;
+    long long count{};
+    std::chrono::nanoseconds time{};
+    std::array<uint64_t, Perf::EventCount> values{};
+    std::array<uint64_t, Perf::EventCount> enabled{};
+    std::array<uint64_t, Perf::EventCount> running{};
+};
+
+// a thread's own stages; its lock is only ever contended by Collect
+struct ThreadTotals {
+    std::mutex access;
+    // a handful, looked up by name since the same literal may have a copy per translation unit
+    std::vector<Totals> stages;
+};
+
+std::atomic<bool> enabled{false};
+thread_local Counters counters;
+
+std::mutex totalsAccess;
+Perf::Status status{.reason = "disabled in the configuration"};
+// outlive their threads, like the trace rings
+std::vector<std::unique_ptr<ThreadTotals>> threadTotals;
+thread_local ThreadTotals *totals{};
+
+int openEvent(Perf::Event event, int group, bool userOnly) {
+    perf_event_attr attributes{};
+    attributes.size = sizeof(attributes);
+    attributes.type = PERF_TYPE_HARDWARE;
+    attributes.config = EventConfigs[event];
+    attributes.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attributes.exclude_kernel = userOnly ? 1 : 0;
+    attributes.exclude_hv = 1;
+    // the calling thread on whichever CPU it runs
+    return static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, group, PERF_FLAG_FD_CLOEXEC));
+}
+
+// puts each event into the first group that takes it; the kernel refuses members a group's PMU cannot count at once
+void openCounters() {
+    counters.opened = true;
+    Perf::Status opened;
+    opened.enabled = true;
+    // SPI transfers spend their time in the kernel, count it where allowed
+    bool userOnly{};
+    for (int i{0}; i < Perf::EventCount; i++) {
+        const auto event = static_cast<Perf::Event>(i);
+        int fd{-1};
+        for (auto &group : counters.groups) {
+            if (fd = openEvent(event, group.leader, userOnly); fd >= 0) {
+                group.events.push_back(event);
+                group.members.push_back(fd);
+                break;
+            }
+        }
+        if (fd < 0) {
+            fd = openEvent(event, -1, userOnly);
+            if (fd < 0 && errno == EACCES && not userOnly) {
+                userOnly = true;
+                fd = openEvent(event, -1, userOnly);
+            }
+            if (fd >= 0) {
+                counters.groups.push_back({fd, {event}, {}});
+            }
+        }
+        if (fd < 0) {
+            opened.reason += std::string(opened.reason.empty() ? "" : ", ") + Perf::EventName(event) + ": " +
+                             std::strerror(errno);
+            continue;
+        }
+        opened.events[i] = true;
+        opened.available = true;
+    }
+    opened.userOnly = userOnly && opened.available;
+
+    auto lock = std::lock_guard<std::mutex>(totalsAccess);
+    status = opened;
+}
+
+Totals &stageTotals(std::vector<Totals> &stages, const char *name) {
+    for (auto &stage : stages) {
+        if (std::string_view(stage.name) == name) {
+            return stage;
+        }
+    }
+    return stages.emplace_back(Totals{name});
+}
+
+ThreadTotals &ownTotals() {
+    if (totals == nullptr) {
+        auto lock = std::lock_guard<std::mutex>(totalsAccess);
+        threadTotals.push_back(std::make_unique<ThreadTotals>());
+        totals = threadTotals.back().get();
+    }
+    return *totals;
+}
+} // namespace
+
+namespace Perf {
+void Configure(bool enable) {
+    enabled.store(enable, std::memory_order_relaxed);
+    auto lock = std::lock_guard<std::mutex>(totalsAccess);
+    status.enabled = enable;
+    status.reason = enable ? "no stage ran yet" : "disabled in the configuration";
+}
+
+bool Enabled() { return enabled.load(std::memory_order_relaxed); }
+
+void Add(const char *name, std::chrono::nanoseconds time, const Reading *before, const Reading *after) {
+    auto &own = ownTotals();
+    auto lock = std::lock_guard<std::mutex>(own.access);
+    auto &stage = stageTotals(own.stages, name);
+    stage.count++;
+    stage.time += time;
+    if (before == nullptr || after == nullptr) {
+        return;
+    }
+    for (int i{0}; i < EventCount; i++) {
+        stage.values[i] += after->values[i] - before->values[i];
+        stage.enabled[i] += after->enabled[i] - before->enabled[i];
+        stage.running[i] += after->running[i] - before->running[i];
+    }
+}
+
+bool Read(Reading &reading) {
+    if (not counters.opened) {
+        openCounters();
+    }
+    if (counters.groups.empty()) {
+        return false;
+    }
+    // nr, time enabled, time running, then a value per event
+    std::array<uint64_t, 3 + EventCount> buffer{};
+    for (const auto &group : counters.groups) {
+        const auto size = (3 + group.events.size()) * sizeof(uint64_t);
+        if (read(group.leader, buffer.data(), size) != static_cast<ssize_t>(size)) {
+            return false;
+        }
+        for (size_t i{0}; i < group.events.size(); i++) {
+            const auto event = group.events[i];
+            reading.values[event] = buffer[3 + i];
+            reading.enabled[event] = buffer[1];
+            reading.running[event] = buffer[2];
+        }
+    }
+    return true;
+}
+
+Status GetStatus() {
+    auto lock = std::lock_guard<std::mutex>(totalsAccess);
+    return status;
+}
+
+std::vector<StageStats> Collect() {
+    std::vector<Totals> sums;
+    {
+        auto lock = std::lock_guard<std::mutex>(totalsAccess);
+        for (const auto &thread : threadTotals) {
+            auto threadLock = std::lock_guard<std::mutex>(thread->access);
+            for (const auto &stage : thread->stages) {
+                auto &sum = stageTotals(sums, stage.name);
+                sum.count += stage.count;
+                sum.time += stage.time;
+                for (int i{0}; i < EventCount; i++) {
+                    sum.values[i] += stage.values[i];
+                    sum.enabled[i] += stage.enabled[i];
+                    sum.running[i] += stage.running[i];
+                }
+            }
+        }
+    }
+
+    std::vector<StageStats> stages;
+    stages.reserve(sums.size());
+    for (const auto &stage : sums) {
+        StageStats stats{stage.name, stage.count, stage.time, {}, {}};
+        for (int i{0}; i < EventCount; i++) {
+            if (stage.running[i] == 0) {
+                continue;
+            }
+            const auto share = static_cast<double>(stage.running[i]) / static_cast<double>(stage.enabled[i]);
+            stats.counts[i] = static_cast<uint64_t>(static_cast<double>(stage.values[i]) / share);
+            stats.coverage[i] = share;
+        }
+        stages.push_back(stats);
+    }
+    return stages;
+}
+
+std::string Summary(const StageStats &stage) {
+    const auto &cycles = stage.counts[Cycles];
+    const auto &instructions = stage.counts[Instructions];
+    if (not cycles.has_value() && not instructions.has_value()) {
+        return "no counters";
+    }
+    const auto calls = static_cast<double>(std::max(stage.count, 1LL));
+    std::string summary;
+    if (cycles.has_value()) {
+        summary += std::format("{:.0f} cycles", static_cast<double>(*cycles) / calls);
+    }
+    if (cycles.value_or(0) > 0 && instructions.has_value()) {
+        summary += std::format(", {:.2f} IPC", static_cast<double>(*instructions) / static_cast<double>(*cycles));
+    }
+    if (instructions.value_or(0) > 0) {
+        const auto perKilo = [&instructions](const std::optional<uint64_t> &count) {
+            return count.has_value() ? std::format("{:.2f}", static_cast<double>(*count) * 1000. /
+                                                                 static_cast<double>(*instructions))
+                                     : std::string("?");
+        };
+        summary += std::format(", {} cache and {} branch misses per 1k instructions",
+            perKilo(stage.counts[CacheMisses]), perKilo(stage.counts[BranchMisses]));
+    }
+    return summary.starts_with(", ") ? summary.substr(2) : summary;
+}
+
+const char *EventName(Event event) {
+    switch (event) {
+    case Cycles:
+        return "cycles";
+    case Instructions:
+        return "instructions";
+    case CacheMisses:
+        return "cacheMisses";
+    case BranchMisses:
+        return "branchMisses";
+    default:
+        return "";
+    }
+}
+} // namespace Perf
@@ -0,0 +1,70 @@
+#ifndef CONVENTION_NAMETAG_PERFCOUNTERS_HPP
+#define CONVENTION_NAMETAG_PERFCOUNTERS_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * Hardware counters around the stages of the render path: cycles, instructions, cache misses and branch misses
+ *
+ * The stages are Trace::Stage spans, which read the counters on entry and exit around the clock reads of the span.
+ * Each thread that counts opens its own counters with perf_event_open the first time it enters a stage. Cores with
+ * fewer counters than events, like the ARM1176 with the cycle counter and two more, get the events that do not fit in
+ * a second group that the kernel takes turns with; their totals are scaled up by the time they did not run, and the
+ * share of the time they ran is reported with them. Each thread adds its stages up by name on its own, Collect sums
+ * them over all threads; nested stages count within the outer one too.
+ *
+ * Without counters, because the kernel lacks them or perf_event_paranoid forbids them, stages are still timed and
+ * the reason is reported. Names must be string literals, only the pointers are kept.
+ */
+namespace Perf {
+enum Event { Cycles, Instructions, CacheMisses, BranchMisses, EventCount };
+
+// before any thread counts; disabled, a stage is a single relaxed load
+void Configure(bool enabled);
+[[nodiscard]] bool Enabled();
+
+struct Reading {
+    std::array<uint64_t, EventCount> values{};
+    // of the group each event is in, ns
+    std::array<uint64_t, EventCount> enabled{};
+    std::array<uint64_t, EventCount> running{};
+};
+// the calling thread's counters, opened on its first call; false if it has none
+bool Read(Reading &reading);
+// one run of a stage on the calling thread, counted if both readings were taken; takes only the thread's own lock
+void Add(const char *name, std::chrono::nanoseconds time, const Reading *before, const Reading *after);
+
+struct Status {
+    bool enabled{};
+    // on the last thread that tried to open its counters
+    bool available{};
+    // user space only, perf_event_paranoid allows no more
+    bool userOnly{};
+    std::array<bool, EventCount> events{};
+    // why some or all counters are missing
+    std::string reason;
+};
+[[nodiscard]] Status GetStatus();
+
+struct StageStats {
+    const char *name;
+    long long count;
+    std::chrono::nanoseconds time;
+    // scaled up where the event did not run all the time, nullopt where it never ran
+    std::array<std::optional<uint64_t>, EventCount> counts;
+    // share of the stage's time the event was counted, 1 without multiplexing
+    std::array<double, EventCount> coverage;
+};
+[[nodiscard]] std::vector<StageStats> Collect();
+// cycles per call, instructions per cycle and misses per thousand instructions, for printing next to the time
+[[nodiscard]] std::string Summary(const StageStats &stage);
+
+[[nodiscard]] const char *EventName(Event event);
+} // namespace Perf
+
+#endif // CONVENTION_NAMETAG_PERFCOUNTERS_HPP
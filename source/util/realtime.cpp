@@ -0,0 +1,106 @@
+#include "realtime.hpp"
+
+#include <linux/capability.h>
+#include <malloc.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#ifndef MCL_ONFAULT
+// older headers, kernels know it since 4.4
+#define MCL_ONFAULT 4
+#endif
+
+namespace {
+// deeper than the render loop gets, decoding and composition included
+const size_t StackPrefault = 256 * 1024;
+
+// touches the stack pages the render loop will use, so they are not faulted in during a frame
+void prefaultStack() {
+    char stack[StackPrefault];
+    // unlike memset, not optimized away for a buffer nobody reads
+    explicit_bzero(stack, sizeof(stack));
+}
+
+// in the effective set, root without it in a container included
+bool hasCapability(int capability) {
+    __user_cap_header_struct header{_LINUX_CAPABILITY_VERSION_3, 0};
+    __user_cap_data_struct data[_LINUX_CAPABILITY_U32S_3]{};
+    if (syscall(SYS_capget, &header, data) != 0) {
+        return false;
+    }
+    return (data[capability / 32].effective & (1U << (capability % 32))) != 0;
+}
+} // namespace
+
+namespace Realtime {
+void DemoteBackground(const Configuration::Realtime &configuration, Schedule &schedule) {
+    schedule.requested = configuration.enabled;
+    if (not configuration.enabled) {
+        return;
+    }
+    // on Linux the niceness belongs to the thread, and raising it needs no privileges
+    if (setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), configuration.backgroundNice) == 0) {
+        schedule.backgroundNice = configuration.backgroundNice;
+    } else {
+        std::cerr << "Could not lower the priority of background threads: " << std::strerror(errno) << std::endl;
+    }
+}
+
+void EnterRenderThread(const Configuration::Realtime &configuration, Schedule &schedule) {
+    if (not configuration.enabled) {
+        return;
+    }
+
+    // with a memlock limit, every mapping past it would fail from here on, thread stacks included, unless CAP_IPC_LOCK
+    // lifts the limit
+    rlimit memlock{};
+    const bool unlimited = hasCapability(CAP_IPC_LOCK) ||
+                           (getrlimit(RLIMIT_MEMLOCK, &memlock) == 0 && memlock.rlim_cur == RLIM_INFINITY);
+    if (configuration.lockMemory && not unlimited) {
+        std::cerr << "Not locking memory, the memlock limit of " << memlock.rlim_cur / 1024
+                  << " KiB is too low; needs CAP_IPC_LOCK or an unlimited memlock limit" << std::endl;
+    } else if (configuration.lockMemory) {
+        // freed memory stays with the process, so decoders opened later reuse pages that are already locked in
+        mallopt(M_TRIM_THRESHOLD, -1);
+        mallopt(M_MMAP_MAX, 0);
+        // only as pages are touched: locking up front would fault in every thread's 8 MiB stack reservation
+        if (mlockall(MCL_CURRENT | MCL_FUTURE | MCL_ONFAULT) == 0) {
+            schedule.memoryLocked = true;
+            prefaultStack();
+        } else {
+            std::cerr << "Could not lock memory: " << std::strerror(errno) << std::endl;
+        }
+    }
+
+    // an rtprio limit lets unprivileged users go up to it, better a lower priority than none
+    auto priority = configuration.priority;
+    if (rlimit limit{}; geteuid() != 0 && getrlimit(RLIMIT_RTPRIO, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY &&
+                        limit.rlim_cur > 0) {
+        priority = std::min(priority, static_cast<int>(limit.rlim_cur));
+    }
+    sched_param parameters{};
+    parameters.sched_priority = priority;
+    // 0 is the calling thread
+    if (sched_setscheduler(0, SCHED_FIFO | SCHED_RESET_ON_FORK, &parameters) == 0) {
+        schedule.fifo = true;
+        schedule.priority = priority;
+        std::cout << "Rendering under SCHED_FIFO, priority " << priority << std::endl;
+        // the reset on fork keeps a positive niceness, threads started from here would get the background's
+        if (setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 0) != 0) {
+            std::cerr << "Threads started by the render thread stay at nice " << schedule.backgroundNice << ": "
+                      << std::strerror(errno) << std::endl;
+        }
+    } else {
+        std::cerr << "Could not enter real-time scheduling (" << std::strerror(errno)
+                  << "), needs CAP_SYS_NICE or an rtprio limit; rendering with normal priority" << std::endl;
+    }
+}
+} // namespace Realtime
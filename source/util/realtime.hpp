@@ -0,0 +1,32 @@
+#ifndef CONVENTION_NAMETAG_REALTIME_HPP
+#define CONVENTION_NAMETAG_REALTIME_HPP
+
+#include "configuration.hpp"
+
+/**
+ * Real-time mode for the render loop, so that a burst of requests cannot starve the panel on a single core
+ *
+ * Threads inherit their creator's niceness, so lowering the main thread's before it starts anything demotes the
+ * server, the prefetch thread and the index at once. The main thread then turns into the render thread and alone goes
+ * SCHED_FIFO; with SCHED_RESET_ON_FORK, threads it starts later on, like libav's decoding threads, fall back to
+ * normal scheduling. The reset leaves a positive niceness alone, so the render thread first goes back to nice 0 where
+ * it may, putting those threads ahead of the background; without the privilege they run at the background's
+ * niceness. Each step that lacks the privileges is reported and skipped, the rest still applies.
+ */
+namespace Realtime {
+// what was asked for and what the process was allowed
+struct Schedule {
+    bool requested{};
+    bool fifo{};
+    int priority{};
+    bool memoryLocked{};
+    int backgroundNice{};
+};
+
+// main thread, before any other thread is started
+void DemoteBackground(const Configuration::Realtime &configuration, Schedule &schedule);
+// render thread, right before the loop
+void EnterRenderThread(const Configuration::Realtime &configuration, Schedule &schedule);
+} // namespace Realtime
+
+#endif // CONVENTION_NAMETAG_REALTIME_HPP
@@ -0,0 +1,192 @@
+#include "trace.hpp"
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+struct Event {
+    const char *category;
+    const char *name;
+    // steady clock, ns
+    int64_t start;
+    // -1 for instants
+    int64_t duration;
+    int64_t argument;
+};
+
+// written by its thread only, read by Dump
+struct Ring {
+    explicit Ring(size_t capacity) : events(capacity) {}
+
+    std::vector<Event> events;
+    // events written so far, the next goes to head % capacity
+    std::atomic<uint64_t> head{};
+    long tid{syscall(SYS_gettid)};
+    std::atomic<const char *> name{};
+};
+
+std::atomic<bool> enabled{true};
+size_t eventsPerThread{16384};
+
+// rings outlive their threads, a thread that ended may still be in the window
+std::mutex ringsAccess;
+std::vector<std::unique_ptr<Ring>> rings;
+thread_local Ring *ring{};
+
+int64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+Ring &threadRing() {
+    if (ring == nullptr) {
+        auto lock = std::lock_guard<std::mutex>(ringsAccess);
+        rings.push_back(std::make_unique<Ring>(eventsPerThread));
+        ring = rings.back().get();
+    }
+    return *ring;
+}
+
+void record(const Event &event) {
+    auto &target = threadRing();
+    const auto head = target.head.load(std::memory_order_relaxed);
+    target.events[head % target.events.size()] = event;
+    target.head.store(head + 1, std::memory_order_release);
+}
+
+// JSON strings of the names, which are literals without anything to escape but may still contain a quote
+std::string quoted(const char *text) {
+    std::string result{'"'};
+    for (const char *c = text; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            result += '\\';
+        }
+        result += *c;
+    }
+    return result + '"';
+}
+} // namespace
+
+namespace Trace {
+void Configure(bool enable, size_t events) {
+    enabled.store(enable, std::memory_order_relaxed);
+    eventsPerThread = std::max<size_t>(events, 64);
+}
+
+void SetThreadName(const char *name) { threadRing().name.store(name, std::memory_order_relaxed); }
+
+Scope::Scope(const char *category, const char *name, int64_t argument)
+    : _category{category}, _name{name}, _argument{argument},
+      _start{enabled.load(std::memory_order_relaxed) ? now() : 0} {}
+
+Scope::~Scope() {
+    if (_start != 0) {
+        record({_category, _name, _start, now() - _start, _argument});
+    }
+}
+
+Stage::Stage(const char *category, const char *name, int64_t argument)
+    : _category{category}, _name{name}, _argument{argument}, _traced{enabled.load(std::memory_order_relaxed)},
+      _timed{Perf::Enabled()} {
+    if (_timed) {
+        _counted = Perf::Read(_before);
+    }
+    // the clock is read inside the counter reads, the time leaves them out
+    if (_traced || _timed) {
+        _start = now();
+    }
+}
+
+Stage::~Stage() {
+    if (_start == 0) {
+        return;
+    }
+    const auto duration = now() - _start;
+    // before the ring and the totals are written, which is not the stage's work
+    Perf::Reading after;
+    const bool counted = _counted && Perf::Read(after);
+    if (_traced) {
+        record({_category, _name, _start, duration, _argument});
+    }
+    if (_timed) {
+        Perf::Add(_name, std::chrono::nanoseconds(duration), counted ? &_before : nullptr, counted ? &after : nullptr);
+    }
+}
+
+void Instant(const char *category, const char *name, int64_t argument) {
+    if (enabled.load(std::memory_order_relaxed)) {
+        record({category, name, now(), -1, argument});
+    }
+}
+
+std::vector<Span> Collect(std::chrono::steady_clock::time_point since) {
+    const auto from = std::chrono::duration_cast<std::chrono::nanoseconds>(since.time_since_epoch()).count();
+
+    std::vector<Span> spans;
+    std::vector<Event> events;
+    auto lock = std::lock_guard<std::mutex>(ringsAccess);
+    for (const auto &source : rings) {
+        const auto capacity = source->events.size();
+        const auto head = source->head.load(std::memory_order_acquire);
+        const auto begin = head > capacity ? head - capacity : 0;
+        events.assign(source->events.begin(), source->events.end());
+        // the writer may have lapped the copy meanwhile, the slots it reached since are not trustworthy
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const auto after = source->head.load(std::memory_order_relaxed);
+        const auto valid = std::max(begin, after >= capacity ? after - capacity + 1 : 0);
+
+        for (auto i = valid; i < head; i++) {
+            const auto &event = events[i % capacity];
+            if (event.start + std::max<int64_t>(event.duration, 0) < from) {
+                continue;
+            }
+            spans.push_back({event.category, event.name, source->tid,
+                std::chrono::steady_clock::time_point(std::chrono::nanoseconds(event.start)),
+                std::chrono::nanoseconds(event.duration), event.argument});
+        }
+    }
+    return spans;
+}
+
+std::string Dump(std::chrono::microseconds window) {
+    const auto spans = Collect(std::chrono::steady_clock::now() - window);
+    const auto toUs = [](std::chrono::nanoseconds time) { return static_cast<double>(time.count()) / 1e3; };
+
+    std::string json = R"({"displayTimeUnit":"ms","traceEvents":[)";
+    bool first{true};
+    const auto append = [&json, &first](const std::string &event) {
+        json += first ? "" : ",\n";
+        json += event;
+        first = false;
+    };
+    {
+        auto lock = std::lock_guard<std::mutex>(ringsAccess);
+        for (const auto &source : rings) {
+            const auto name = source->name.load(std::memory_order_relaxed);
+            append(std::format(R"({{"ph":"M","name":"thread_name","pid":1,"tid":{},"args":{{"name":{}}}}})",
+                source->tid, quoted(name != nullptr ? name : "thread")));
+        }
+    }
+    // Chrome counts in µs
+    for (const auto &span : spans) {
+        const auto start = toUs(span.start.time_since_epoch());
+        if (span.duration.count() < 0) {
+            append(std::format(R"({{"ph":"i","s":"t","cat":{},"name":{},"pid":1,"tid":{},"ts":{:.3f},)"
+                               R"("args":{{"value":{}}}}})",
+                quoted(span.category), quoted(span.name), span.tid, start, span.argument));
+        } else {
+            append(std::format(R"({{"ph":"X","cat":{},"name":{},"pid":1,"tid":{},"ts":{:.3f},"dur":{:.3f},)"
+                               R"("args":{{"value":{}}}}})",
+                quoted(span.category), quoted(span.name), span.tid, start, toUs(span.duration), span.argument));
+        }
+    }
+    return json + "]}";
+}
+} // namespace Trace
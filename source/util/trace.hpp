@@ -0,0 +1,88 @@
+#ifndef CONVENTION_NAMETAG_TRACE_HPP
+#define CONVENTION_NAMETAG_TRACE_HPP
+
+#include "perfCounters.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Flight recorder for single hitches: what each thread did over the last seconds, as Chrome trace JSON
+ *
+ * Every thread that records gets a ring of its own the first time it does, so recording takes no lock and touches no
+ * memory shared with other writers: a span is two clock reads and one store into the ring, published with a release
+ * store of the ring's head. Rings overwrite their oldest events. Dumping copies each ring while its thread keeps
+ * writing and then drops whatever may have been overwritten during the copy.
+ *
+ * Names and categories must be string literals, only the pointers are kept.
+ */
+namespace Trace {
+// before any thread records; disabled, recording is a single relaxed load
+void Configure(bool enabled, size_t eventsPerThread);
+
+// how the calling thread shows up in the trace
+void SetThreadName(const char *name);
+
+// a span on the calling thread, from construction to destruction
+class Scope {
+  public:
+    Scope(const char *category, const char *name, int64_t argument = 0);
+    ~Scope();
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    const char *_category;
+    const char *_name;
+    int64_t _argument;
+    // 0 if recording was off when the span began
+    int64_t _start;
+};
+
+// a span that is also a stage of the render path: with perf.enabled its time and the calling thread's hardware counters
+// are added up under its name, from the same two clock reads as the span; see perfCounters.hpp
+class Stage {
+  public:
+    Stage(const char *category, const char *name, int64_t argument = 0);
+    ~Stage();
+
+    Stage(const Stage &) = delete;
+    Stage &operator=(const Stage &) = delete;
+
+  private:
+    const char *_category;
+    const char *_name;
+    int64_t _argument;
+    bool _traced;
+    bool _timed;
+    // the counters were read when the stage began
+    bool _counted{};
+    Perf::Reading _before;
+    // 0 if neither recording nor counting was on when the stage began
+    int64_t _start{};
+};
+
+// a point in time on the calling thread, like a decoder being swapped
+void Instant(const char *category, const char *name, int64_t argument = 0);
+
+struct Span {
+    const char *category;
+    const char *name;
+    long tid;
+    std::chrono::steady_clock::time_point start;
+    // negative for instants
+    std::chrono::nanoseconds duration;
+    int64_t argument;
+};
+// what all threads recorded that ended at or after since, for tools that add it up themselves
+std::vector<Span> Collect(std::chrono::steady_clock::time_point since);
+
+// the events of all threads that ended within the last window, as a Chrome/Perfetto trace JSON document
+std::string Dump(std::chrono::microseconds window);
+} // namespace Trace
+
+#endif // CONVENTION_NAMETAG_TRACE_HPP
@@ -0,0 +1,72 @@
+#include "animationDecoder.hpp"
+
+#include <algorithm>
+#include <thread>
+
+AnimationDecoder::AnimationDecoder(Scene scene, int width, int height, PixelFormat format,
+    std::chrono::microseconds frameInterval, std::shared_ptr<AnimationStats> stats)
+    : _scene{std::move(scene)}, _frameInterval{frameInterval}, _stats{std::move(stats)},
+      _scratchFrame{nullptr, width, height, format}, _startTime{std::chrono::steady_clock::now()},
+      _nextFrame{_startTime} {
+    _scratch.resize(_scratchFrame.Size());
+    _scratchFrame.data = _scratch.data();
+    _stats->budget = _frameInterval;
+}
+
+void AnimationDecoder::DecodeFrame(uint8_t *buffer, int bufferSize) {
+    Render(_scratchFrame);
+    unpackToRgb(_scratchFrame, buffer, bufferSize);
+}
+
+bool AnimationDecoder::DecodeNativeFrame(const FrameView &frame) {
+    if (frame.format != _scratchFrame.format || frame.width != _scratchFrame.width ||
+        frame.height != _scratchFrame.height) {
+        return false;
+    }
+    Render(frame);
+    return true;
+}
+
+void AnimationDecoder::Start(std::chrono::steady_clock::time_point startTime) {
+    _startTime = startTime;
+    _nextFrame = startTime;
+}
+
+void AnimationDecoder::Delay(std::chrono::steady_clock::duration pause) {
+    _startTime += pause;
+    _nextFrame += pause;
+}
+
+Fixed AnimationDecoder::SceneTime(std::chrono::steady_clock::time_point now) const {
+    // playlists schedule the start slightly ahead
+    const auto elapsed =
+        std::max<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now - _startTime).count(), 0);
+    const int64_t duration = int64_t{_scene.duration.raw} * 1000000 / Fixed::One;
+    if (duration <= 0) {
+        return {};
+    }
+    // wrap in microseconds, the scene's Q16.16 seconds would overflow after 9 hours
+    const int64_t position = _scene.loop ? elapsed % duration : std::min<int64_t>(elapsed, duration);
+    return Fixed::FromRaw(static_cast<int32_t>(position * Fixed::One / 1000000));
+}
+
+void AnimationDecoder::Render(const FrameView &frame) {
+    std::this_thread::sleep_until(_nextFrame);
+    const auto now = std::chrono::steady_clock::now();
+    // don't try to catch up on frames missed while the render loop was busy
+    _nextFrame = std::max(_nextFrame + _frameInterval, now);
+
+    Rasterizer rasterizer(frame);
+    _scene.Render(rasterizer, SceneTime(now));
+
+    const auto renderTime =
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - now).count();
+    _stats->frames++;
+    _stats->renderTime += renderTime;
+    if (renderTime > _stats->maxRenderTime) {
+        _stats->maxRenderTime = renderTime;
+    }
+    if (renderTime > _frameInterval.count()) {
+        _stats->overBudget++;
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef CONVENTION_NAMETAG_ANIMATIONDECODER_HPP
+#define CONVENTION_NAMETAG_ANIMATIONDECODER_HPP
+
+#include "decoder.hpp"
+#include "drawers/scene.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+// shared with the web server, which reports on the scene that is playing
+struct AnimationStats {
+    // render time a frame may take without falling behind the frame rate
+    std::chrono::microseconds budget{};
+
+    std::atomic<long long> frames{};
+    // µs spent rasterizing, waiting for the next frame excluded
+    std::atomic<long long> renderTime{};
+    std::atomic<long long> maxRenderTime{};
+    std::atomic<long long> overBudget{};
+};
+
+/**
+ * @brief Plays a Scene, rasterized straight into the panel's format at a fixed frame rate
+ */
+class AnimationDecoder : public Decoder {
+  public:
+    AnimationDecoder(Scene scene, int width, int height, PixelFormat format, std::chrono::microseconds frameInterval,
+        std::shared_ptr<AnimationStats> stats);
+
+    void DecodeFrame(uint8_t *buffer, int bufferSize) override;
+    bool DecodeNativeFrame(const FrameView &frame) override;
+
+    void Start(std::chrono::steady_clock::time_point startTime) override;
+    void Delay(std::chrono::steady_clock::duration pause) override;
+    [[nodiscard]] std::chrono::microseconds GetFrameInterval() const override { return _frameInterval; }
+
+  private:
+    void Render(const FrameView &frame);
+    // seconds into the scene, wrapped into the loop
+    [[nodiscard]] Fixed SceneTime(std::chrono::steady_clock::time_point now) const;
+
+    Scene _scene;
+    std::chrono::microseconds _frameInterval;
+    std::shared_ptr<AnimationStats> _stats;
+
+    // packed scratch frame for the rgb fallback
+    std::vector<uint8_t> _scratch;
+    FrameView _scratchFrame;
+
+    std::chrono::steady_clock::time_point _startTime;
+    std::chrono::steady_clock::time_point _nextFrame;
+};
+
+#endif // CONVENTION_NAMETAG_ANIMATIONDECODER_HPP
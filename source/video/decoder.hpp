@@ -1,6 +1,9 @@
 #ifndef CONVENTION_NAMETAG_DECODER_HPP
 #define CONVENTION_NAMETAG_DECODER_HPP
 
+#include "drawers/frame.hpp"
+
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 
@@ -9,6 +12,17 @@ class Decoder {
     virtual ~Decoder() = default;
 
     virtual void DecodeFrame(uint8_t *buffer, int bufferSize) = 0;
+    // decoders able to draw in the panel's packed format do so here and return true, skipping rgb conversion
+    virtual bool DecodeNativeFrame(const FrameView &frame) { return false; }
+
+    // called when the decoder becomes the active one, frames are timed relative to this point
+    virtual void Start(std::chrono::steady_clock::time_point startTime) {}
+    // playback was paused this long, the frames still to come move back by as much; negative moves them ahead
+    virtual void Delay(std::chrono::steady_clock::duration pause) {}
+    // true once there is nothing left to show, the buffer of the last DecodeFrame call is left untouched then
+    [[nodiscard]] virtual bool Finished() const { return false; }
+    // nominal time between two frames, zero if unknown
+    [[nodiscard]] virtual std::chrono::microseconds GetFrameInterval() const { return {}; }
 
   private:
 };
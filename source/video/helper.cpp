@@ -1,12 +1,18 @@
 #include "helper.hpp"
 
 extern "C" {
+#include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
 }
 
+#include <algorithm>
 #include <cstring>
 #include <format>
+#include <fstream>
 #include <iostream>
+#include <string_view>
+
+std::string thumbnailFilename(const std::string &filename) { return std::format("{}.thumb.webp", filename); }
 
 std::optional<double> getVideoDuration(const std::filesystem::path &fileName) {
     AVFormatContext *context = avformat_alloc_context();
@@ -35,4 +41,170 @@ std::optional<double> getVideoDuration(const std::filesystem::path &fileName) {
     avformat_free_context(context);
 
     return duration;
-}
\ No newline at end of file
+}
+
+std::optional<VideoInfo> probeVideo(const std::filesystem::path &fileName) {
+    AVFormatContext *context = avformat_alloc_context();
+    if (const auto r = avformat_open_input(&context, fileName.c_str(), nullptr, nullptr); r != 0) {
+        std::cerr << std::format("Error while trying to probe {}: {}", fileName.c_str(), std::strerror(AVERROR(r)))
+                  << std::endl;
+        return std::nullopt;
+    }
+    // required for frame rates of containers that don't store them in the header
+    avformat_find_stream_info(context, nullptr);
+
+    std::optional<VideoInfo> info;
+    for (int i = 0; i < static_cast<int>(context->nb_streams); i++) {
+        const auto *stream = context->streams[i];
+        if (stream->codecpar->codec_type != AVMEDIA_TYPE_VIDEO) {
+            continue;
+        }
+
+        info = VideoInfo{};
+        info->width = stream->codecpar->width;
+        info->height = stream->codecpar->height;
+        info->codec = avcodec_get_name(stream->codecpar->codec_id);
+
+        if (stream->duration != AV_NOPTS_VALUE) {
+            info->duration = static_cast<double>(stream->duration) * av_q2d(stream->time_base);
+        } else if (context->duration != AV_NOPTS_VALUE) {
+            info->duration = static_cast<double>(context->duration) / AV_TIME_BASE;
+        }
+
+        const auto rate = stream->avg_frame_rate.num != 0 ? stream->avg_frame_rate : stream->r_frame_rate;
+        if (rate.num != 0 && rate.den != 0) {
+            info->frameRate = av_q2d(rate);
+        }
+
+        info->frameCount = stream->nb_frames;
+        if (info->frameCount <= 0) {
+            // not stored by every container, estimate instead
+            info->frameCount = static_cast<int64_t>(info->duration * info->frameRate + 0.5);
+        }
+        break;
+    }
+
+    avformat_close_input(&context);
+    avformat_free_context(context);
+
+    return info;
+}
+
+std::optional<KeyframeIndex> buildKeyframeIndex(const std::filesystem::path &fileName) {
+    AVFormatContext *context = avformat_alloc_context();
+    if (const auto r = avformat_open_input(&context, fileName.c_str(), nullptr, nullptr); r != 0) {
+        return std::nullopt;
+    }
+
+    const int streamIndex = av_find_best_stream(context, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (streamIndex < 0) {
+        avformat_close_input(&context);
+        return std::nullopt;
+    }
+
+    KeyframeIndex index;
+    index.timeBaseNum = context->streams[streamIndex]->time_base.num;
+    index.timeBaseDen = context->streams[streamIndex]->time_base.den;
+
+    AVPacket *packet = av_packet_alloc();
+    while (av_read_frame(context, packet) >= 0) {
+        if (packet->stream_index == streamIndex && (packet->flags & AV_PKT_FLAG_KEY) != 0) {
+            const auto pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+            if (pts != AV_NOPTS_VALUE) {
+                index.keyframes.push_back({pts, packet->pos});
+            }
+        }
+        av_packet_unref(packet);
+    }
+    av_packet_free(&packet);
+    avformat_close_input(&context);
+
+    std::sort(index.keyframes.begin(), index.keyframes.end(),
+        [](const Keyframe &a, const Keyframe &b) { return a.pts < b.pts; });
+    return index;
+}
+
+namespace {
+// "NTKF" + version
+const uint32_t KeyframeIndexMagic = 0x464b544e;
+const uint32_t KeyframeIndexVersion = 1;
+} // namespace
+
+bool saveKeyframeIndex(const KeyframeIndex &index, const std::filesystem::path &fileName) {
+    std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+    const uint32_t header[]{KeyframeIndexMagic, KeyframeIndexVersion, static_cast<uint32_t>(index.timeBaseNum),
+        static_cast<uint32_t>(index.timeBaseDen), static_cast<uint32_t>(index.keyframes.size())};
+    file.write(reinterpret_cast<const char *>(header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(index.keyframes.data()),
+        static_cast<std::streamsize>(index.keyframes.size() * sizeof(Keyframe)));
+    return file.good();
+}
+
+std::optional<KeyframeIndex> loadKeyframeIndex(const std::filesystem::path &fileName) {
+    std::ifstream file(fileName, std::ios::binary);
+    uint32_t header[5];
+    if (not file.read(reinterpret_cast<char *>(header), sizeof(header)) || header[0] != KeyframeIndexMagic ||
+        header[1] != KeyframeIndexVersion) {
+        return std::nullopt;
+    }
+
+    KeyframeIndex index;
+    index.timeBaseNum = static_cast<int>(header[2]);
+    index.timeBaseDen = static_cast<int>(header[3]);
+    index.keyframes.resize(header[4]);
+    if (not file.read(reinterpret_cast<char *>(index.keyframes.data()),
+            static_cast<std::streamsize>(index.keyframes.size() * sizeof(Keyframe)))) {
+        return std::nullopt;
+    }
+    return index;
+}
+
+StreamLayout probeStreamLayout(std::span<const uint8_t> head) {
+    // MPEG-TS, sync bytes at the start of every 188 byte packet
+    const size_t packet = 188;
+    if (not head.empty() && head[0] == 0x47) {
+        if (head.size() < 3 * packet) {
+            return StreamLayout::Pending;
+        }
+        return head[packet] == 0x47 && head[2 * packet] == 0x47 ? StreamLayout::Progressive : StreamLayout::Complete;
+    }
+
+    // MP4, top level boxes until either the index or the media data shows up
+    const auto read32 = [&head](size_t position) {
+        return uint64_t{head[position]} << 24 | uint64_t{head[position + 1]} << 16 |
+               uint64_t{head[position + 2]} << 8 | uint64_t{head[position + 3]};
+    };
+    size_t position{0};
+    while (position + 8 <= head.size()) {
+        const auto type = std::string_view(reinterpret_cast<const char *>(head.data() + position + 4), 4);
+        if (position == 0 && type != "ftyp" && type != "styp") {
+            return StreamLayout::Complete;
+        }
+        // moof only occurs in fragmented files, which carry their moov up front as well
+        if (type == "moov" || type == "moof") {
+            return StreamLayout::Progressive;
+        }
+        if (type == "mdat") {
+            return StreamLayout::Complete;
+        }
+
+        uint64_t size = read32(position);
+        if (size == 1) {
+            if (position + 16 > head.size()) {
+                return StreamLayout::Pending;
+            }
+            size = read32(position + 8) << 32 | read32(position + 12);
+        } else if (size == 0) {
+            // runs to the end of the file, nothing follows
+            return StreamLayout::Complete;
+        }
+        if (size < 8) {
+            return StreamLayout::Complete;
+        }
+        if (size >= head.size() - position) {
+            return StreamLayout::Pending;
+        }
+        position += static_cast<size_t>(size);
+    }
+    return StreamLayout::Pending;
+}
@@ -1,9 +1,55 @@
 #ifndef CONVENTION_NAMETAG_HELPER_HPP
 #define CONVENTION_NAMETAG_HELPER_HPP
 
+#include <cstdint>
 #include <filesystem>
 #include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+struct VideoInfo {
+    double duration{};
+    int width{};
+    int height{};
+    std::string codec;
+    double frameRate{};
+    int64_t frameCount{};
+};
+
+struct Keyframe {
+    // in stream time base
+    int64_t pts;
+    // byte offset of the packet, -1 if the demuxer doesn't know
+    int64_t position;
+};
+
+struct KeyframeIndex {
+    int timeBaseNum{1};
+    int timeBaseDen{1};
+    // sorted by pts
+    std::vector<Keyframe> keyframes;
+};
+
+std::string thumbnailFilename(const std::string &filename);
 
 std::optional<double> getVideoDuration(const std::filesystem::path &fileName);
+// full stream probe, expensive (reads and decodes the first packets), keep off the event loop
+std::optional<VideoInfo> probeVideo(const std::filesystem::path &fileName);
+// reads every packet of the file once, without decoding
+std::optional<KeyframeIndex> buildKeyframeIndex(const std::filesystem::path &fileName);
+bool saveKeyframeIndex(const KeyframeIndex &index, const std::filesystem::path &fileName);
+std::optional<KeyframeIndex> loadKeyframeIndex(const std::filesystem::path &fileName);
+
+enum class StreamLayout {
+    // the head seen so far does not tell yet
+    Pending,
+    // MPEG-TS, fragmented MP4 or MP4 with its moov ahead of the media data, playable from the front
+    Progressive,
+    // the index comes last or the container is not one known to work, the whole file is needed
+    Complete,
+};
+// whether a file can be played while its tail is still missing, judging by its first bytes
+StreamLayout probeStreamLayout(std::span<const uint8_t> head);
 
 #endif // CONVENTION_NAMETAG_HELPER_HPP
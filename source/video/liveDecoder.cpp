@@ -0,0 +1,167 @@
+#include "liveDecoder.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+// the target delay never goes below this, it covers the time between a push and the render thread picking it up
+const auto MinTargetDelay = std::chrono::microseconds(10000);
+const auto MaxTargetDelay = std::chrono::microseconds(500000);
+// jitter estimates to buffer, three cover nearly all frames on a Wi-Fi link with the occasional retransmit
+const double JitterFactor = 3.;
+// the lowest transit is looked for again this often, so clock drift and route changes do not stick forever
+const auto TransitWindow = std::chrono::seconds(10);
+// frames beyond this are dropped from the front, a sender far ahead of its timestamps would otherwise fill memory
+const size_t MaxDepth = 32;
+// the render loop runs at least this often without new frames
+const auto MaxFrameWait = std::chrono::microseconds(10000);
+} // namespace
+
+void LiveFeed::Push(uint32_t timestamp, std::vector<uint8_t> pixels) {
+    const auto arrival = std::chrono::steady_clock::now();
+    {
+        auto lock = std::lock_guard<std::mutex>(_access);
+        // 32 bit milliseconds wrap after 49 days, the step from the previous one is what counts
+        _unwrapped = _lastTimestamp.has_value() ? _unwrapped + static_cast<int32_t>(timestamp - _lastTimestamp.value())
+                                                : timestamp;
+        _lastTimestamp = timestamp;
+
+        Frame frame{_unwrapped * 1000, arrival, std::move(pixels)};
+        const auto transit = ToMicroseconds(arrival) - frame.timestamp;
+        if (not _lastTransit.has_value()) {
+            _windowTransit = transit;
+            _baseTransit = transit;
+            _windowStart = arrival;
+        } else {
+            _jitter += (static_cast<double>(std::abs(transit - _lastTransit.value())) - _jitter) / 16.;
+            _windowTransit = std::min(_windowTransit, transit);
+            _baseTransit = std::min(_baseTransit, transit);
+            if (arrival - _windowStart > TransitWindow) {
+                _baseTransit = _windowTransit;
+                _windowTransit = transit;
+                _windowStart = arrival;
+            }
+        }
+        _lastTransit = transit;
+
+        _stats.pushed++;
+        if (Due(frame) < arrival) {
+            _stats.late++;
+        }
+        _frames.push_back(std::move(frame));
+        if (_frames.size() > MaxDepth) {
+            _frames.pop_front();
+            _stats.skipped++;
+        }
+    }
+    _pushed.notify_one();
+}
+
+void LiveFeed::Close() {
+    {
+        auto lock = std::lock_guard<std::mutex>(_access);
+        _closed = true;
+    }
+    _pushed.notify_one();
+}
+
+bool LiveFeed::Next(std::vector<uint8_t> &out, std::chrono::microseconds maxWait) {
+    auto lock = std::unique_lock<std::mutex>(_access);
+    const auto sampleDepth = [this]() {
+        _stats.depth = static_cast<int>(_frames.size());
+        _stats.maxDepth = std::max(_stats.maxDepth, _stats.depth);
+        _depthTotal += _stats.depth;
+        _depthSamples++;
+    };
+
+    const auto deadline = std::chrono::steady_clock::now() + maxWait;
+    auto now = std::chrono::steady_clock::now();
+    while (_frames.empty() || Due(_frames.front()) > now) {
+        if (now >= deadline) {
+            sampleDepth();
+            return false;
+        }
+        // woken early by a push, the new frame may be due already when the buffer ran dry
+        _pushed.wait_until(lock, _frames.empty() ? deadline : std::min(deadline, Due(_frames.front())));
+        now = std::chrono::steady_clock::now();
+    }
+    sampleDepth();
+
+    size_t newest{0};
+    while (newest + 1 < _frames.size() && Due(_frames[newest + 1]) <= now) {
+        newest++;
+    }
+    auto &frame = _frames[newest];
+    const auto bufferTime = std::chrono::duration_cast<std::chrono::microseconds>(now - frame.arrival);
+    const auto latency = std::chrono::microseconds(ToMicroseconds(now) - frame.timestamp - _baseTransit);
+    // swapped rather than copied, the frames are the size of the buffer handed in
+    std::swap(out, frame.pixels);
+    _frames.erase(_frames.begin(), _frames.begin() + static_cast<std::ptrdiff_t>(newest) + 1);
+
+    _stats.shown++;
+    _stats.skipped += static_cast<long long>(newest);
+    _stats.lastBufferTime = bufferTime;
+    _stats.maxBufferTime = std::max(_stats.maxBufferTime, bufferTime);
+    _stats.totalBufferTime += bufferTime;
+    _stats.lastLatency = latency;
+    _stats.maxLatency = std::max(_stats.maxLatency, latency);
+    _stats.totalLatency += latency;
+    return true;
+}
+
+bool LiveFeed::Finished() const {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    return _closed && _frames.empty();
+}
+
+LiveFeed::Stats LiveFeed::GetStats() const {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    auto stats = _stats;
+    stats.jitter = std::chrono::microseconds(static_cast<int64_t>(_jitter));
+    stats.targetDelay = TargetDelay();
+    stats.averageDepth =
+        _depthSamples > 0 ? static_cast<double>(_depthTotal) / static_cast<double>(_depthSamples) : 0.;
+    return stats;
+}
+
+std::chrono::microseconds LiveFeed::TargetDelay() const {
+    return std::clamp(MinTargetDelay + std::chrono::microseconds(static_cast<int64_t>(JitterFactor * _jitter)),
+        MinTargetDelay, MaxTargetDelay);
+}
+
+std::chrono::steady_clock::time_point LiveFeed::Due(const Frame &frame) const {
+    return std::chrono::steady_clock::time_point(std::chrono::microseconds(frame.timestamp + _baseTransit)) +
+           TargetDelay();
+}
+
+int64_t LiveFeed::ToMicroseconds(std::chrono::steady_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+}
+
+LiveDecoder::LiveDecoder(std::shared_ptr<LiveFeed> feed, int width, int height, PixelFormat format)
+    : _feed{std::move(feed)}, _current(FrameView{nullptr, width, height, format}.Size()),
+      _view{_current.data(), width, height, format} {}
+
+void LiveDecoder::DecodeFrame(uint8_t *buffer, int bufferSize) {
+    Update();
+    unpackToRgb(_view, buffer, bufferSize);
+}
+
+bool LiveDecoder::DecodeNativeFrame(const FrameView &frame) {
+    if (frame.format != _view.format || frame.Size() != _current.size()) {
+        return false;
+    }
+    Update();
+    std::memcpy(frame.data, _current.data(), _current.size());
+    return true;
+}
+
+void LiveDecoder::Update() {
+    if (_feed->Next(_current, MaxFrameWait)) {
+        _view.data = _current.data();
+    } else if (_feed->Finished()) {
+        // the sender left, like the idle decoder
+        std::fill(_current.begin(), _current.end(), 0);
+    }
+}
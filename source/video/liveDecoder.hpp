@@ -0,0 +1,115 @@
+#ifndef CONVENTION_NAMETAG_LIVEDECODER_HPP
+#define CONVENTION_NAMETAG_LIVEDECODER_HPP
+
+#include "decoder.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+/**
+ * @brief Jitter buffer for frames rendered elsewhere and pushed over the network
+ *
+ * Frames carry the sender's timestamp. The lowest transit time seen recently (arrival minus timestamp, with an unknown
+ * clock offset in it) stands for a frame that came through without delay; each frame is shown at its timestamp plus
+ * that transit plus a target delay. The target follows the interarrival jitter, estimated as in RFC 3550, so it grows
+ * as soon as frames come in late and shrinks again on a calm network. When several frames are due only the newest is
+ * shown, a live source would rather skip than fall behind.
+ *
+ * Push and Close are for the server thread, Next for the render thread.
+ */
+class LiveFeed {
+  public:
+    // a complete frame in the panel's format; timestamp in ms of the sender's clock
+    void Push(uint32_t timestamp, std::vector<uint8_t> pixels);
+    // the sender is gone, what is buffered is still played out
+    void Close();
+
+    // waits up to maxWait for a frame to become due and swaps the newest due one into out, false if none did
+    bool Next(std::vector<uint8_t> &out, std::chrono::microseconds maxWait);
+    // closed and played out
+    [[nodiscard]] bool Finished() const;
+
+    struct Stats {
+        long long pushed{};
+        long long shown{};
+        // due together with a newer frame, or pushed out of a full buffer
+        long long skipped{};
+        // arrived after the time they should have been shown
+        long long late{};
+        std::chrono::microseconds jitter{};
+        std::chrono::microseconds targetDelay{};
+        // frames buffered when the render thread looked, and on average
+        int depth{};
+        int maxDepth{};
+        double averageDepth{};
+        // arrival to shown
+        std::chrono::microseconds lastBufferTime{};
+        std::chrono::microseconds maxBufferTime{};
+        std::chrono::microseconds totalBufferTime{};
+        // shown relative to the fastest delivery seen, what the network and the buffer add to the sender's latency
+        std::chrono::microseconds lastLatency{};
+        std::chrono::microseconds maxLatency{};
+        std::chrono::microseconds totalLatency{};
+    };
+    [[nodiscard]] Stats GetStats() const;
+
+  private:
+    struct Frame {
+        // µs of the sender's clock, unwrapped
+        int64_t timestamp;
+        std::chrono::steady_clock::time_point arrival;
+        std::vector<uint8_t> pixels;
+    };
+
+    // _access must be held for these
+    [[nodiscard]] std::chrono::microseconds TargetDelay() const;
+    [[nodiscard]] std::chrono::steady_clock::time_point Due(const Frame &frame) const;
+    // µs since the epoch of the steady clock
+    static int64_t ToMicroseconds(std::chrono::steady_clock::time_point time);
+
+    std::deque<Frame> _frames;
+    bool _closed{};
+
+    std::optional<uint32_t> _lastTimestamp;
+    int64_t _unwrapped{};
+    // arrival minus timestamp in µs: of the previous frame, the lowest in the current window and the one in use
+    std::optional<int64_t> _lastTransit;
+    int64_t _windowTransit{};
+    int64_t _baseTransit{};
+    std::chrono::steady_clock::time_point _windowStart;
+    // RFC 3550 jitter estimate, µs
+    double _jitter{};
+
+    Stats _stats;
+    long long _depthSamples{};
+    long long _depthTotal{};
+    mutable std::mutex _access;
+    std::condition_variable _pushed;
+};
+
+/**
+ * @brief Shows what a LiveFeed delivers, straight in the panel's format
+ */
+class LiveDecoder : public Decoder {
+  public:
+    LiveDecoder(std::shared_ptr<LiveFeed> feed, int width, int height, PixelFormat format);
+
+    void DecodeFrame(uint8_t *buffer, int bufferSize) override;
+    bool DecodeNativeFrame(const FrameView &frame) override;
+
+  private:
+    // paces the render loop: returns once a new frame is up, or after a while without one
+    void Update();
+
+    std::shared_ptr<LiveFeed> _feed;
+    std::vector<uint8_t> _current;
+    FrameView _view;
+};
+
+#endif // CONVENTION_NAMETAG_LIVEDECODER_HPP
@@ -0,0 +1,315 @@
+#include "mediaIndex.hpp"
+
+#include "util/durableFile.hpp"
+#include "util/hash.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <sys/inotify.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+namespace {
+const auto IndexVersion = 1;
+const auto ThumbnailSuffix = std::string_view(".thumb.webp");
+
+bool isMediaFile(const fs::directory_entry &entry) {
+    const auto name = entry.path().filename().string();
+    return not name.empty() && name[0] != '.' && entry.is_regular_file();
+}
+
+std::optional<MediaEntry> statFile(const fs::path &path) {
+    std::error_code error;
+    const auto size = fs::file_size(path, error);
+    if (error) {
+        return std::nullopt;
+    }
+    const auto mtime = fs::last_write_time(path, error);
+    if (error) {
+        return std::nullopt;
+    }
+
+    MediaEntry entry;
+    entry.size = size;
+    entry.mtime = std::chrono::duration_cast<std::chrono::nanoseconds>(mtime.time_since_epoch()).count();
+    return entry;
+}
+} // namespace
+
+MediaIndex::MediaIndex(fs::path folder) : _folder{std::move(folder)} {}
+
+MediaIndex::~MediaIndex() { Stop(); }
+
+void MediaIndex::Start() {
+    fs::create_directories(GetThumbnailFolder());
+    fs::create_directories(GetMetadataFolder());
+
+    Load();
+
+    _watcher.Watch(_folder, IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE,
+        [this](const fs::path &, const std::string &name, uint32_t mask) {
+            if (name.empty() || name[0] == '.' || (mask & IN_ISDIR)) {
+                return;
+            }
+            if (mask & (IN_DELETE | IN_MOVED_FROM)) {
+                Remove(name);
+            } else {
+                Update(name);
+            }
+        });
+    _watcher.Watch(GetThumbnailFolder(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE,
+        [this](const fs::path &, const std::string &name, uint32_t mask) {
+            if (not name.ends_with(ThumbnailSuffix)) {
+                return;
+            }
+            SetThumbnail(name.substr(0, name.size() - ThumbnailSuffix.size()),
+                (mask & (IN_DELETE | IN_MOVED_FROM)) == 0);
+        });
+
+    // anything changed while not running gets picked up off the calling thread
+    _watcher.Post([this]() { Reconcile(); });
+    _watcher.Start();
+}
+
+void MediaIndex::Stop() { _watcher.Stop(); }
+
+MediaIndex::Listing MediaIndex::GetListing() const {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    return _listing;
+}
+
+void MediaIndex::SetListener(std::function<void()> listener) {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    _listener = std::move(listener);
+}
+
+std::optional<MediaEntry> MediaIndex::Find(const std::string &filename) const {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    if (auto it = _entries.find(filename); it != _entries.end()) {
+        return it->second;
+    }
+    return std::nullopt;
+}
+
+void MediaIndex::Load() {
+    std::ifstream file(GetMetadataFolder() / "index.json");
+
+    auto lock = std::lock_guard<std::mutex>(_access);
+    if (file.good()) {
+        const auto json = nlohmann::json::parse(file, nullptr, false);
+        // a file cut short on the SD card may still parse, as something else; the index is rebuilt from the folder then
+        bool readable = not json.is_discarded() && json.is_object() && json.contains("entries") &&
+                        json.at("entries").is_object();
+        try {
+            readable = readable && json.value("version", 0) == IndexVersion;
+            if (readable) {
+                for (const auto &[name, value] : json.at("entries").items()) {
+                    MediaEntry entry;
+                    entry.size = value.value("size", uintmax_t{});
+                    entry.mtime = value.value("mtime", int64_t{});
+                    entry.thumbnail = value.value("thumbnail", false);
+                    if (value.contains("codec")) {
+                        entry.info = VideoInfo{value.value("duration", 0.),
+                            value.value("width", 0),
+                            value.value("height", 0),
+                            value.value("codec", std::string()),
+                            value.value("frameRate", 0.),
+                            value.value("frameCount", int64_t{})};
+                    }
+                    _entries.emplace(name, std::move(entry));
+                }
+            }
+        } catch (const nlohmann::json::exception &) {
+            // the version or an entry of the wrong type
+            readable = false;
+            _entries.clear();
+        }
+        if (not readable) {
+            std::cerr << "Discarding unreadable media index" << std::endl;
+        }
+    }
+    RebuildListing();
+}
+
+void MediaIndex::Save() const {
+    nlohmann::json entries = nlohmann::json::object();
+    {
+        auto lock = std::lock_guard<std::mutex>(_access);
+        for (const auto &[name, entry] : _entries) {
+            nlohmann::json value{{"size", entry.size}, {"mtime", entry.mtime}, {"thumbnail", entry.thumbnail}};
+            if (entry.info.has_value()) {
+                value["duration"] = entry.info->duration;
+                value["width"] = entry.info->width;
+                value["height"] = entry.info->height;
+                value["codec"] = entry.info->codec;
+                value["frameRate"] = entry.info->frameRate;
+                value["frameCount"] = entry.info->frameCount;
+            }
+            entries[name] = std::move(value);
+        }
+    }
+
+    // a power cut never leaves a truncated index behind, which would mean probing the whole library at the next boot
+    const auto serialized = nlohmann::json{{"version", IndexVersion}, {"entries", std::move(entries)}}.dump();
+    if (not DurableFile::Replace(GetMetadataFolder() / "index.json", serialized)) {
+        std::cerr << "Could not write media index: " << std::strerror(errno) << std::endl;
+        return;
+    }
+    DurableFile::SyncFolder(GetMetadataFolder());
+}
+
+void MediaIndex::Reconcile() {
+    std::vector<std::string> present;
+    if (std::error_code error; fs::is_directory(_folder, error)) {
+        for (const auto &entry : fs::directory_iterator(_folder, error)) {
+            if (isMediaFile(entry)) {
+                present.push_back(entry.path().filename().string());
+            }
+        }
+    }
+
+    std::vector<std::string> stale;
+    {
+        auto lock = std::lock_guard<std::mutex>(_access);
+        for (const auto &[name, entry] : _entries) {
+            if (std::find(present.begin(), present.end(), name) == present.end()) {
+                stale.push_back(name);
+            }
+        }
+    }
+    for (const auto &name : stale) {
+        Remove(name, false);
+    }
+    for (const auto &name : present) {
+        Update(name, false);
+    }
+    Save();
+}
+
+void MediaIndex::Update(const std::string &filename, bool save) {
+    const auto path = _folder / filename;
+    auto entry = statFile(path);
+    if (not entry.has_value()) {
+        return;
+    }
+    entry->thumbnail = fs::exists(GetThumbnailFolder() / thumbnailFilename(filename));
+
+    bool known{false};
+    {
+        auto lock = std::lock_guard<std::mutex>(_access);
+        if (auto it = _entries.find(filename); it != _entries.end()) {
+            if (it->second.size == entry->size && it->second.mtime == entry->mtime) {
+                if (it->second.thumbnail != entry->thumbnail) {
+                    it->second.thumbnail = entry->thumbnail;
+                    RebuildListing();
+                }
+                entry->info = it->second.info;
+                known = true;
+            }
+        }
+    }
+
+    if (not known) {
+        // probing is the expensive part, don't hold the lock for it
+        entry->info = probeVideo(path);
+        std::error_code error;
+        fs::remove(GetKeyframePath(filename), error);
+        {
+            auto lock = std::lock_guard<std::mutex>(_access);
+            _entries[filename] = entry.value();
+            _keyframes.erase(filename);
+            RebuildListing();
+        }
+        if (save) {
+            Save();
+        }
+    }
+
+    if (entry->info.has_value() && not fs::exists(GetKeyframePath(filename))) {
+        if (const auto keyframes = buildKeyframeIndex(path); keyframes.has_value()) {
+            saveKeyframeIndex(keyframes.value(), GetKeyframePath(filename));
+        }
+    }
+}
+
+std::shared_ptr<const KeyframeIndex> MediaIndex::GetKeyframes(const std::string &filename) {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    if (auto it = _keyframes.find(filename); it != _keyframes.end()) {
+        return it->second;
+    }
+
+    auto keyframes = loadKeyframeIndex(GetKeyframePath(filename));
+    if (not keyframes.has_value()) {
+        return nullptr;
+    }
+    // only what is played gets asked for, so a handful of entries at most
+    if (_keyframes.size() >= 4) {
+        _keyframes.erase(_keyframes.begin());
+    }
+    auto shared = std::make_shared<const KeyframeIndex>(std::move(keyframes.value()));
+    _keyframes[filename] = shared;
+    return shared;
+}
+
+void MediaIndex::Remove(const std::string &filename, bool save) {
+    {
+        auto lock = std::lock_guard<std::mutex>(_access);
+        _keyframes.erase(filename);
+        if (_entries.erase(filename) == 0) {
+            return;
+        }
+        RebuildListing();
+    }
+    std::error_code error;
+    fs::remove(GetKeyframePath(filename), error);
+    if (save) {
+        Save();
+    }
+}
+
+void MediaIndex::SetThumbnail(const std::string &filename, bool present) {
+    {
+        auto lock = std::lock_guard<std::mutex>(_access);
+        auto it = _entries.find(filename);
+        if (it == _entries.end() || it->second.thumbnail == present) {
+            return;
+        }
+        it->second.thumbnail = present;
+        RebuildListing();
+    }
+    Save();
+}
+
+MediaIndex::Listing MediaIndex::BuildListing(const std::map<std::string, MediaEntry> &entries) {
+    auto videos = nlohmann::json::array();
+    for (const auto &[name, entry] : entries) {
+        nlohmann::json video{{"filename", name}, {"thumbnail", thumbnailFilename(name)},
+            {"thumbnailReady", entry.thumbnail}, {"size", entry.size}};
+        if (entry.info.has_value()) {
+            video["duration"] = entry.info->duration;
+            video["width"] = entry.info->width;
+            video["height"] = entry.info->height;
+            video["codec"] = entry.info->codec;
+            video["frameRate"] = entry.info->frameRate;
+            video["frameCount"] = entry.info->frameCount;
+        }
+        videos.push_back(std::move(video));
+    }
+
+    auto body = std::make_shared<const std::string>(nlohmann::json{{"videos", std::move(videos)}}.dump());
+    auto etag = makeETag(*body);
+    return {std::move(body), std::move(etag)};
+}
+
+void MediaIndex::RebuildListing() {
+    _listing = BuildListing(_entries);
+    if (_listener) {
+        _listener();
+    }
+}
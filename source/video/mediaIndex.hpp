@@ -0,0 +1,87 @@
+#ifndef CONVENTION_NAMETAG_MEDIAINDEX_HPP
+#define CONVENTION_NAMETAG_MEDIAINDEX_HPP
+
+#include "helper.hpp"
+#include "util/fileWatcher.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+
+struct MediaEntry {
+    // cache key, an entry is only trusted while both still match the file
+    uintmax_t size{};
+    int64_t mtime{};
+
+    // empty if the file could not be probed
+    std::optional<VideoInfo> info;
+    bool thumbnail{};
+};
+
+/**
+ * @brief Persistent metadata of the video library
+ *
+ * Probing a file means opening it with libavformat, so this is done once per file and kept on disk in
+ * <folder>/metadata/index.json, next to a keyframe index per file used for seeking. inotify keeps the index up to
+ * date, all probing happens on the watcher thread.
+ */
+class MediaIndex {
+  public:
+    explicit MediaIndex(std::filesystem::path folder);
+    ~MediaIndex();
+
+    void Start();
+    void Stop();
+
+    struct Listing {
+        // shared so responses can be sent without copying the body
+        std::shared_ptr<const std::string> body;
+        std::string etag;
+    };
+    // JSON document served by GET /videos
+    [[nodiscard]] Listing GetListing() const;
+    // what GetListing returns for these entries
+    static Listing BuildListing(const std::map<std::string, MediaEntry> &entries);
+    // called on the watcher thread whenever the listing changed, with the index locked
+    void SetListener(std::function<void()> listener);
+    [[nodiscard]] std::optional<MediaEntry> Find(const std::string &filename) const;
+    // built once per file next to the index, nullptr until available
+    [[nodiscard]] std::shared_ptr<const KeyframeIndex> GetKeyframes(const std::string &filename);
+
+    [[nodiscard]] const std::filesystem::path &GetFolder() const { return _folder; }
+    [[nodiscard]] std::filesystem::path GetMetadataFolder() const { return _folder / "metadata"; }
+    [[nodiscard]] std::filesystem::path GetThumbnailFolder() const { return _folder / "thumbnails"; }
+    [[nodiscard]] std::filesystem::path GetKeyframePath(const std::string &filename) const {
+        return GetMetadataFolder() / (filename + ".keyframes");
+    }
+
+  private:
+    void Load();
+    void Save() const;
+    void Reconcile();
+
+    // save is false while reconciling, which writes the index once at the end
+    void Update(const std::string &filename, bool save = true);
+    void Remove(const std::string &filename, bool save = true);
+    void SetThumbnail(const std::string &filename, bool present);
+
+    // _access must be held
+    void RebuildListing();
+
+    std::filesystem::path _folder;
+
+    std::map<std::string, MediaEntry> _entries;
+    std::map<std::string, std::shared_ptr<const KeyframeIndex>> _keyframes;
+    Listing _listing;
+    std::function<void()> _listener;
+    mutable std::mutex _access;
+
+    FileWatcher _watcher;
+};
+
+#endif // CONVENTION_NAMETAG_MEDIAINDEX_HPP
@@ -0,0 +1,37 @@
+#include "playerLayer.hpp"
+#include "trace.hpp"
+
+#include <cstring>
+
+PlayerLayer::PlayerLayer(VideoPlayer &player, Converter converter)
+    : Layer(player.GetWidth(), player.GetHeight(), player.GetFormat()), _player{player},
+      _converter{std::move(converter)}, _rgb(static_cast<size_t>(player.GetWidth()) * player.GetHeight() * 3),
+      _previous(_pixels.size()) {}
+
+Rect PlayerLayer::Update(std::chrono::steady_clock::time_point) {
+    if (not _player.FetchFrame(_rgb.data(), static_cast<int>(_rgb.size()), _surface)) {
+        Trace::Stage stage{"video", "convert"};
+        _converter(_rgb.data(), _surface.data);
+    }
+
+    // a byte row is one pixel row on Gray4 and a page of 8 rows on Mono1Paged
+    const bool paged = _surface.format == PixelFormat::Mono1Paged;
+    const int rows = paged ? _surface.height / 8 : _surface.height;
+    const auto stride = _pixels.size() / rows;
+
+    int first{-1};
+    int last{-1};
+    for (int row{0}; row < rows; row++) {
+        if (std::memcmp(_pixels.data() + row * stride, _previous.data() + row * stride, stride) != 0) {
+            first = first < 0 ? row : first;
+            last = row;
+        }
+    }
+    if (first < 0) {
+        return {};
+    }
+    std::memcpy(_previous.data() + first * stride, _pixels.data() + first * stride, (last - first + 1) * stride);
+
+    const int scale = paged ? 8 : 1;
+    return {0, first * scale, _surface.width, (last - first + 1) * scale};
+}
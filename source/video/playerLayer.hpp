@@ -0,0 +1,35 @@
+#ifndef CONVENTION_NAMETAG_PLAYERLAYER_HPP
+#define CONVENTION_NAMETAG_PLAYERLAYER_HPP
+
+#include "drawers/layer.hpp"
+#include "videoPlayer.hpp"
+
+#include <functional>
+#include <vector>
+
+/**
+ * @brief The video player as the bottom compositor layer
+ *
+ * Fetching the frame paces the render loop like it did before there was a compositor. Decoders don't report what
+ * changed, so the new frame is compared against the previous one and only the band of rows that differ is reported;
+ * paused or static content costs a compare instead of a recomposition.
+ */
+class PlayerLayer : public Layer {
+  public:
+    // packs an rgb frame of the player's size into the panel format, the driver's conversion
+    using Converter = std::function<void(const uint8_t *rgb, uint8_t *packed)>;
+
+    PlayerLayer(VideoPlayer &player, Converter converter);
+
+    Rect Update(std::chrono::steady_clock::time_point now) override;
+    [[nodiscard]] const char *GetType() const override { return "video"; }
+
+  private:
+    VideoPlayer &_player;
+    Converter _converter;
+
+    std::vector<uint8_t> _rgb;
+    std::vector<uint8_t> _previous;
+};
+
+#endif // CONVENTION_NAMETAG_PLAYERLAYER_HPP
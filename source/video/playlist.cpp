@@ -0,0 +1,98 @@
+#include "playlist.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+namespace fs = std::filesystem;
+
+Playlist::Playlist(std::vector<PlaylistItem> items, bool shuffle, bool repeat)
+    : _items{std::move(items)}, _shuffle{shuffle}, _repeat{repeat} {
+    _order = MakeOrder();
+    _nextOrder = MakeOrder();
+}
+
+std::optional<Playlist> Playlist::FromJson(const nlohmann::json &json, const fs::path &folder) {
+    if (not json.is_object() || not json.contains("items") || not json["items"].is_array()) {
+        return std::nullopt;
+    }
+
+    std::vector<PlaylistItem> items;
+    for (const auto &entry : json["items"]) {
+        if (not entry.is_object() || not entry.contains("file") || not entry["file"].is_string()) {
+            return std::nullopt;
+        }
+        PlaylistItem item;
+        // only the filename, never allow escaping the video folder
+        item.file = folder / fs::path(entry["file"].get<std::string>()).filename();
+        item.duration = std::chrono::milliseconds(static_cast<int64_t>(entry.value("duration", 0.) * 1000.));
+        item.loops = std::max(entry.value("loops", 1), 1);
+        if (not fs::is_regular_file(item.file)) {
+            return std::nullopt;
+        }
+        items.push_back(std::move(item));
+    }
+    if (items.empty()) {
+        return std::nullopt;
+    }
+
+    return Playlist(std::move(items), json.value("shuffle", false), json.value("repeat", true));
+}
+
+nlohmann::json Playlist::ToJson() const {
+    auto items = nlohmann::json::array();
+    for (const auto &item : _items) {
+        items.push_back({{"file", item.file.filename().string()},
+            {"duration", static_cast<double>(item.duration.count()) / 1000.}, {"loops", item.loops}});
+    }
+    return {{"items", std::move(items)}, {"shuffle", _shuffle}, {"repeat", _repeat},
+        {"current", Current().file.filename().string()}, {"position", _position}};
+}
+
+const PlaylistItem *Playlist::PeekNext() const {
+    if (_position + 1 < _order.size()) {
+        return &_items[_order[_position + 1]];
+    }
+    if (_repeat) {
+        return &_items[_nextOrder.front()];
+    }
+    return nullptr;
+}
+
+bool Playlist::Advance() {
+    if (_position + 1 < _order.size()) {
+        _position++;
+        return true;
+    }
+    if (not _repeat) {
+        return false;
+    }
+    _order = std::move(_nextOrder);
+    _nextOrder = MakeOrder();
+    _position = 0;
+    return true;
+}
+
+void Playlist::Retreat() {
+    if (_position > 0) {
+        _position--;
+    }
+}
+
+void Playlist::Resume(size_t position, const fs::path &current) {
+    if (position < _order.size() && _items[_order[position]].file == current) {
+        _position = position;
+        return;
+    }
+    const auto found = std::find_if(
+        _order.begin(), _order.end(), [this, &current](size_t item) { return _items[item].file == current; });
+    _position = found != _order.end() ? static_cast<size_t>(found - _order.begin()) : 0;
+}
+
+std::vector<size_t> Playlist::MakeOrder() {
+    std::vector<size_t> order(_items.size());
+    std::iota(order.begin(), order.end(), 0);
+    if (_shuffle) {
+        std::shuffle(order.begin(), order.end(), _random);
+    }
+    return order;
+}
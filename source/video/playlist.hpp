@@ -0,0 +1,57 @@
+#ifndef CONVENTION_NAMETAG_PLAYLIST_HPP
+#define CONVENTION_NAMETAG_PLAYLIST_HPP
+
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <optional>
+#include <random>
+#include <vector>
+
+struct PlaylistItem {
+    std::filesystem::path file;
+    // play for this long regardless of the clip length, zero plays the clip
+    std::chrono::milliseconds duration{};
+    // how often the clip is played, ignored if a duration is set
+    int loops{1};
+};
+
+class Playlist {
+  public:
+    Playlist(std::vector<PlaylistItem> items, bool shuffle, bool repeat);
+
+    // {"items": [{"file": "a.mp4", "duration": 5.0, "loops": 2}], "shuffle": false, "repeat": true}
+    static std::optional<Playlist> FromJson(const nlohmann::json &json, const std::filesystem::path &folder);
+    [[nodiscard]] nlohmann::json ToJson() const;
+
+    [[nodiscard]] const PlaylistItem &Current() const { return _items[_order[_position]]; }
+    // item played after the current one, nullptr if the playlist ends there
+    [[nodiscard]] const PlaylistItem *PeekNext() const;
+
+    // false if the end was reached and the playlist doesn't repeat
+    bool Advance();
+    void Retreat();
+    // continue at position, or wherever current ended up if the order was shuffled anew
+    void Resume(size_t position, const std::filesystem::path &current);
+
+    [[nodiscard]] size_t GetPosition() const { return _position; }
+    [[nodiscard]] size_t GetSize() const { return _items.size(); }
+
+  private:
+    std::vector<size_t> MakeOrder();
+
+    std::vector<PlaylistItem> _items;
+    // play order, a permutation of the item indices when shuffled
+    std::vector<size_t> _order;
+    // order of the next round, drawn ahead of time so PeekNext is stable
+    std::vector<size_t> _nextOrder;
+    size_t _position{};
+
+    bool _shuffle;
+    bool _repeat;
+
+    std::mt19937 _random{std::random_device{}()};
+};
+
+#endif // CONVENTION_NAMETAG_PLAYLIST_HPP
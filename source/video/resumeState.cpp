@@ -0,0 +1,148 @@
+#include "resumeState.hpp"
+#include "durableFile.hpp"
+#include "trace.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+namespace {
+// between two saves, changes in the meantime are written together
+const auto MinSaveInterval = std::chrono::seconds(5);
+} // namespace
+
+ResumeState::ResumeState(fs::path folder) : _folder{std::move(folder)} {}
+
+ResumeState::~ResumeState() { Stop(); }
+
+bool ResumeState::Restore(VideoPlayer &player, const fs::path &videoFolder) const {
+    std::ifstream file(_folder / "resume.json");
+    const auto state = nlohmann::json::parse(file, nullptr, false);
+    if (not state.is_object()) {
+        return false;
+    }
+
+    // whatever is gone or cannot be opened anymore is skipped, the badge starts idle then
+    try {
+        if (const auto &saved = state.value("playlist", nlohmann::json()); saved.is_object()) {
+            auto playlist = Playlist::FromJson(saved, videoFolder);
+            if (not playlist.has_value()) {
+                return false;
+            }
+            playlist->Resume(saved.value("position", size_t{0}),
+                videoFolder / fs::path(saved.value("current", std::string())).filename());
+            player.PlayPlaylist(std::move(playlist.value()));
+            return true;
+        }
+        if (const auto &saved = state.value("file", nlohmann::json()); saved.is_string()) {
+            return player.PlayFile(videoFolder / fs::path(saved.get<std::string>()).filename());
+        }
+    } catch (const std::exception &error) {
+        std::cerr << "Could not resume playback: " << error.what() << std::endl;
+    }
+    return false;
+}
+
+bool ResumeState::LoadFrame(const FrameView &frame) const {
+    std::ifstream file(_folder / "resume.json");
+    const auto state = nlohmann::json::parse(file, nullptr, false);
+    if (not state.is_object() || not state.contains("frame") ||
+        state["frame"] != nlohmann::json{{"width", frame.width}, {"height", frame.height},
+                              {"format", static_cast<int>(frame.format)}}) {
+        return false;
+    }
+
+    std::ifstream pixels(_folder / "resume.frame", std::ios::binary);
+    pixels.read(reinterpret_cast<char *>(frame.data), static_cast<std::streamsize>(frame.Size()));
+    return pixels.gcount() == static_cast<std::streamsize>(frame.Size());
+}
+
+void ResumeState::Start(VideoPlayer &player) {
+    _player = &player;
+    // what plays now was resumed or nothing, either way there is nothing new to save
+    _captured = player.GetChanges();
+    _seen = _captured;
+    _savedChanges = _captured;
+    _frameChanges = _captured;
+    _running = true;
+    _thread = std::thread(&ResumeState::Run, this);
+}
+
+void ResumeState::Stop() {
+    {
+        auto lock = std::lock_guard<std::mutex>(_access);
+        _running = false;
+    }
+    _wake.notify_one();
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+
+void ResumeState::OfferFrame(const FrameView &frame) {
+    if (_player == nullptr) {
+        return;
+    }
+    const auto changes = _player->GetChanges();
+    if (changes == _captured) {
+        return;
+    }
+    // the frame composed while the change happened may still show what played before, the next one cannot
+    if (changes != _seen) {
+        _seen = changes;
+        return;
+    }
+    _captured = changes;
+    {
+        auto lock = std::lock_guard<std::mutex>(_access);
+        _frame.assign(frame.data, frame.data + frame.Size());
+        _frameFormat = {nullptr, frame.width, frame.height, frame.format};
+        _frameChanges = changes;
+    }
+    _wake.notify_one();
+}
+
+void ResumeState::Run() {
+    Trace::SetThreadName("resume state");
+    auto lock = std::unique_lock<std::mutex>(_access);
+    while (true) {
+        _wake.wait(lock, [this]() { return not _running || _frameChanges != _savedChanges; });
+        if (not _running) {
+            return;
+        }
+        const auto frame = _frame;
+        const auto format = _frameFormat;
+        _savedChanges = _frameChanges;
+
+        lock.unlock();
+        Save(frame, format);
+        lock.lock();
+
+        _wake.wait_for(lock, MinSaveInterval, [this]() { return not _running; });
+    }
+}
+
+void ResumeState::Save(const std::vector<uint8_t> &frame, const FrameView &format) const {
+    const auto file = _player->GetCurrentFile();
+    const auto playlist = _player->GetPlaylist();
+    const nlohmann::json state{
+        {"file", file.has_value() ? nlohmann::json(file->filename().string()) : nlohmann::json()},
+        {"playlist", playlist.has_value() ? playlist->ToJson() : nlohmann::json()},
+        {"frame", {{"width", format.width}, {"height", format.height}, {"format", static_cast<int>(format.format)}}}};
+
+    std::error_code error;
+    fs::create_directories(_folder, error);
+    // the frame first, a power cut in between leaves the new frame with the old state, which is at worst off by one
+    // playlist item; both are replaced whole
+    const auto save = [this](const std::string &name, std::string_view data) {
+        if (not DurableFile::Replace(_folder / name, data)) {
+            std::cerr << "Could not save " << _folder / name << ": " << std::strerror(errno) << std::endl;
+        }
+    };
+    save("resume.frame", std::string_view(reinterpret_cast<const char *>(frame.data()), frame.size()));
+    save("resume.json", state.dump());
+    DurableFile::SyncFolder(_folder);
+}
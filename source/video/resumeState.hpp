@@ -0,0 +1,64 @@
+#ifndef CONVENTION_NAMETAG_RESUMESTATE_HPP
+#define CONVENTION_NAMETAG_RESUMESTATE_HPP
+
+#include "drawers/frame.hpp"
+#include "videoPlayer.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief What was playing, kept across restarts so the badge powers up showing it again
+ *
+ * <folder>/resume.json holds the playing file or the playlist with its position, <folder>/resume.frame one of the
+ * first frames shown of it, in the panel's format, to put up before the panel's first decoded frame is ready. The
+ * render thread notices changes by polling the player and hands over a frame shortly after each; a thread of its own
+ * writes both, write-then-rename and at most every few seconds, so a playlist of short clips does not wear the SD
+ * card.
+ */
+class ResumeState {
+  public:
+    explicit ResumeState(std::filesystem::path folder);
+    ~ResumeState();
+
+    ResumeState(const ResumeState &) = delete;
+    ResumeState &operator=(const ResumeState &) = delete;
+
+    // plays what the last run left off with, files are looked up in videoFolder; false if there was nothing left
+    bool Restore(VideoPlayer &player, const std::filesystem::path &videoFolder) const;
+    // copies the saved frame into frame if it was taken on a panel like this one
+    bool LoadFrame(const FrameView &frame) const;
+
+    void Start(VideoPlayer &player);
+    void Stop();
+
+    // render thread, after every frame
+    void OfferFrame(const FrameView &frame);
+
+  private:
+    void Run();
+    void Save(const std::vector<uint8_t> &frame, const FrameView &format) const;
+
+    const std::filesystem::path _folder;
+    VideoPlayer *_player{};
+
+    // render thread only: the player's changes when a frame was last kept, and when they were first seen
+    uint64_t _captured{};
+    uint64_t _seen{};
+
+    // the kept frame, with data pointing nowhere
+    std::vector<uint8_t> _frame;
+    FrameView _frameFormat{};
+    uint64_t _frameChanges{};
+    uint64_t _savedChanges{};
+    bool _running{};
+    std::mutex _access;
+    std::condition_variable _wake;
+    std::thread _thread;
+};
+
+#endif // CONVENTION_NAMETAG_RESUMESTATE_HPP
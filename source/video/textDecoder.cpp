@@ -0,0 +1,71 @@
+#include "textDecoder.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+namespace {
+// animated text runs at the panel's pace; static text has no rate of its own and refreshes as fast as the render loop
+// goes, the governor slows that down once nothing changed for a while
+const auto AnimatedFrameInterval = std::chrono::microseconds(1000000 / 60);
+} // namespace
+
+TextDecoder::TextDecoder(const std::string &text, const TextStyle &style, const std::filesystem::path &font,
+    int pixelSize, int width, int height, PixelFormat format)
+    : _renderer{font, pixelSize, format}, _style{style}, _scratchFrame{nullptr, width, height, format},
+      _startTime{std::chrono::steady_clock::now()}, _nextFrame{_startTime} {
+    _renderer.SetText(text);
+    _scratch.resize(_scratchFrame.Size());
+    _scratchFrame.data = _scratch.data();
+}
+
+TextDecoder::~TextDecoder() {
+    if (_frameCount > 0) {
+        const auto &stats = _renderer.GetAtlas().GetStats();
+        printf("Text render time:   %09.3lfµs (%d glyph cache misses, %d evictions)\n",
+            static_cast<double>(_renderTime) / _frameCount, stats.misses, stats.evictions);
+    }
+}
+
+void TextDecoder::DecodeFrame(uint8_t *buffer, int bufferSize) {
+    Render(_scratchFrame);
+    unpackToRgb(_scratchFrame, buffer, bufferSize);
+}
+
+bool TextDecoder::DecodeNativeFrame(const FrameView &frame) {
+    if (frame.format != _scratchFrame.format || frame.width != _scratchFrame.width ||
+        frame.height != _scratchFrame.height) {
+        return false;
+    }
+    Render(frame);
+    return true;
+}
+
+void TextDecoder::Start(std::chrono::steady_clock::time_point startTime) {
+    _startTime = startTime;
+    _nextFrame = startTime;
+}
+
+void TextDecoder::Delay(std::chrono::steady_clock::duration pause) {
+    _startTime += pause;
+    _nextFrame += pause;
+}
+
+std::chrono::microseconds TextDecoder::GetFrameInterval() const {
+    return _style.wavy || _style.scrollSpeed != 0 ? AnimatedFrameInterval : std::chrono::microseconds{};
+}
+
+void TextDecoder::Render(const FrameView &frame) {
+    std::this_thread::sleep_until(_nextFrame);
+    const auto now = std::chrono::steady_clock::now();
+    // don't try to catch up on frames missed while the render loop was busy
+    _nextFrame = std::max(_nextFrame + GetFrameInterval(), now);
+
+    std::memset(frame.data, 0, frame.Size());
+    _renderer.Render(frame, _style, std::chrono::duration_cast<std::chrono::microseconds>(now - _startTime));
+
+    const auto renderTime = std::chrono::steady_clock::now() - now;
+    _renderTime += std::chrono::duration_cast<std::chrono::microseconds>(renderTime).count();
+    _frameCount++;
+}
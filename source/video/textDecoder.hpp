@@ -0,0 +1,45 @@
+#ifndef CONVENTION_NAMETAG_TEXTDECODER_HPP
+#define CONVENTION_NAMETAG_TEXTDECODER_HPP
+
+#include "decoder.hpp"
+#include "drawers/textRenderer.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Shows a line of text, rendered straight into the panel's format
+ */
+class TextDecoder : public Decoder {
+  public:
+    TextDecoder(const std::string &text, const TextStyle &style, const std::filesystem::path &font, int pixelSize,
+        int width, int height, PixelFormat format);
+    ~TextDecoder() override;
+
+    void DecodeFrame(uint8_t *buffer, int bufferSize) override;
+    bool DecodeNativeFrame(const FrameView &frame) override;
+
+    void Start(std::chrono::steady_clock::time_point startTime) override;
+    void Delay(std::chrono::steady_clock::duration pause) override;
+    [[nodiscard]] std::chrono::microseconds GetFrameInterval() const override;
+
+  private:
+    void Render(const FrameView &frame);
+
+    TextRenderer _renderer;
+    TextStyle _style;
+
+    // packed scratch frame for the rgb fallback
+    std::vector<uint8_t> _scratch;
+    FrameView _scratchFrame;
+
+    std::chrono::steady_clock::time_point _startTime;
+    std::chrono::steady_clock::time_point _nextFrame;
+
+    long long int _renderTime{};
+    int _frameCount{};
+};
+
+#endif // CONVENTION_NAMETAG_TEXTDECODER_HPP
@@ -1,13 +1,70 @@
 #include "videoDecoder.hpp"
+#include "trace.hpp"
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
 #include <iostream>
 #include <stdexcept>
 #include <thread>
 
+namespace {
+// upper bound for decoding forward from a keyframe, keeps scrubbing responsive on long GOPs
+const auto MaxSeekDecodeTime = std::chrono::milliseconds(150);
+
+// growing files are read in blocks of this size
+const auto IoBufferSize = 32 * 1024;
+// a growing file is only demuxed further while this much is on disk ahead of the demuxer, so the render thread does
+// not end up waiting for the upload in the middle of a packet; the upload writer adds data in 256 KiB steps anyway
+const int64_t StarvationMargin = 256 * 1024;
+const auto StarvedPollInterval = std::chrono::milliseconds(10);
+// frames left out in one call at most; a video that cannot be decoded in time, or a clock that jumped, would otherwise
+// keep the render thread decoding with the decoder lock held and the panel frozen. Enough to keep a 60 fps video at
+// its speed down to about 7 fps, below the default rates the governor falls back to
+const int MaxDroppedFrames = 8;
+} // namespace
+
 VideoDecoder::VideoDecoder(const std::filesystem::path &file, int width, int height)
     : _formatContext{avformat_alloc_context()}, _outWidth{width}, _outHeight{height} {
-    auto filename = std::string(file);
+    try {
+        Open(std::string(file));
+    } catch (...) {
+        // the destructor does not run for a constructor that throws
+        Release();
+        throw;
+    }
+}
+
+VideoDecoder::VideoDecoder(
+    std::shared_ptr<GrowingFile> growing, int width, int height, std::chrono::milliseconds stallTimeout)
+    : _formatContext{avformat_alloc_context()}, _growing{std::move(growing)}, _stallTimeout{stallTimeout},
+      _outWidth{width}, _outHeight{height} {
+    // OpenGrowing retries this for as long as the upload is not playable yet, nothing may leak on the way out
+    try {
+        _fd = open(_growing->GetPath().c_str(), O_RDONLY | O_CLOEXEC);
+        if (_fd < 0) {
+            throw std::runtime_error("failed to open growing video file!");
+        }
+        auto *buffer = static_cast<uint8_t *>(av_malloc(IoBufferSize));
+        _io = avio_alloc_context(buffer, IoBufferSize, 0, this, &VideoDecoder::ReadGrowing, nullptr,
+            &VideoDecoder::SeekGrowing);
+        if (_io == nullptr) {
+            av_free(buffer);
+            throw std::runtime_error("failed to allocate I/O context!");
+        }
+        _formatContext->pb = _io;
+        _formatContext->flags |= AVFMT_FLAG_CUSTOM_IO;
+        Open(_growing->GetPath().string());
+    } catch (...) {
+        Release();
+        throw;
+    }
+}
+
+void VideoDecoder::Open(const std::string &filename) {
     if (avformat_open_input(&_formatContext, filename.c_str(), nullptr, nullptr) != 0) {
         throw std::runtime_error("failed to open video file!");
     }
@@ -49,6 +106,8 @@ VideoDecoder::VideoDecoder(const std::filesystem::path &file, int width, int hei
     }
 
     avformat_find_stream_info(_formatContext, nullptr);
+    // MPEG-TS and the like start well after zero
+    _firstPts = _videoStream->start_time != AV_NOPTS_VALUE ? _videoStream->start_time : 0;
 
     // AV_PIX_FMT_GRAY8 = Y component of YUV
     _swsContext = sws_getContext(_codecParameters->width, _codecParameters->height,
@@ -57,32 +116,171 @@ VideoDecoder::VideoDecoder(const std::filesystem::path &file, int width, int hei
 
     av_image_alloc(_rgbFrameBuffer->data, _rgbFrameBuffer->linesize, _outWidth, _outHeight, AV_PIX_FMT_GRAY8, 1);
 
+    if (const auto rate = _videoStream->avg_frame_rate; rate.num > 0 && rate.den > 0) {
+        _frameInterval = std::chrono::microseconds(static_cast<int64_t>(1000000. / av_q2d(rate)));
+    }
+
     _startTime = std::chrono::steady_clock::now();
 }
 
-VideoDecoder::~VideoDecoder() {
-    av_freep(&_rgbFrameBuffer->data[0]);
-    av_frame_unref(_rgbFrameBuffer);
-    // avcodec_close(_codecContext);
+VideoDecoder::~VideoDecoder() { Release(); }
+
+void VideoDecoder::Release() {
+    if (_rgbFrameBuffer != nullptr) {
+        av_freep(&_rgbFrameBuffer->data[0]);
+    }
+    av_frame_free(&_rgbFrameBuffer);
+    av_frame_free(&_frame);
+    av_packet_free(&_packet);
+    sws_freeContext(_swsContext);
+    avcodec_free_context(&_codecContext);
     avformat_close_input(&_formatContext);
     avformat_free_context(_formatContext);
+    // custom I/O is left to its owner, the buffer may have been replaced by ffmpeg meanwhile
+    if (_io != nullptr) {
+        av_freep(&_io->buffer);
+        avio_context_free(&_io);
+    }
+    if (_fd >= 0) {
+        close(_fd);
+        _fd = -1;
+    }
 }
 
 void VideoDecoder::DecodeFrame(uint8_t *outBuffer, int bufferSize) {
     assert(bufferSize >= av_image_get_buffer_size(AV_PIX_FMT_GRAY8, 256, 64, 1));
 
-    AVFrame *frame = av_frame_alloc();
-    AVPacket packet;
+    // a frame rate capped below the video's must not turn into slow motion, frames due already are left out; past
+    // MaxDroppedFrames the next one is shown late instead, and playback catches up over the following calls
+    int dropped{};
+    while (dropped < MaxDroppedFrames && _prefetched.size() > 1 && Overdue(_prefetched.front().presentationTime)) {
+        Trace::Instant("video", "drop");
+        _prefetched.pop_front();
+        dropped++;
+    }
+    if (not _prefetched.empty()) {
+        const auto &prefetched = _prefetched.front();
+        WaitUntil(prefetched.presentationTime);
+        Trace::Stage stage{"video", "convert"};
+        WriteOutput(prefetched.pixels.data(), outBuffer, bufferSize);
+        _lastShown = ShownFrame{prefetched.presentationTime, std::chrono::steady_clock::now()};
+        _prefetched.pop_front();
+        _framesShown++;
+        return;
+    }
+
+    // decoding cannot be skipped, the frames after depend on it, but scaling and conversion can
+    bool received{};
+    while ((received = ReceiveFrame(_frame)) && dropped < MaxDroppedFrames &&
+           Overdue(PresentationTime(_frame->best_effort_timestamp))) {
+        Trace::Instant("video", "drop");
+        av_frame_unref(_frame);
+        dropped++;
+    }
+    if (not received) {
+        if (_starvedSince.has_value()) {
+            // the previous frame stays up; wake up as soon as the upload moves instead of spinning the render loop
+            _growing->WaitBeyond(_growing->GetSize(), StarvedPollInterval);
+        }
+        return;
+    }
+
+    // wait until the right moment
+    // TODO: wait elsewhere
+    const auto presentationTime = PresentationTime(_frame->best_effort_timestamp);
+    WaitUntil(presentationTime);
 
-    while (true) {
-        int ret = av_read_frame(_formatContext, &packet);
-        if (ret < 0) {
-            std::cerr << "Error or EOF when reading frame (" << ret << ")" << std::endl;
+    {
+        Trace::Stage stage{"video", "sws_scale"};
+        sws_scale(_swsContext, _frame->data, _frame->linesize, 0, _codecContext->height, _rgbFrameBuffer->data,
+            _rgbFrameBuffer->linesize);
+    }
+    av_frame_unref(_frame);
+
+    Trace::Stage stage{"video", "convert"};
+    WriteOutput(_rgbFrameBuffer->data[0], outBuffer, bufferSize);
+    _lastShown = ShownFrame{presentationTime, std::chrono::steady_clock::now()};
+    _framesShown++;
+}
+
+void VideoDecoder::Start(std::chrono::steady_clock::time_point startTime) { _startTime = startTime; }
+
+std::chrono::microseconds VideoDecoder::GetDuration() const {
+    if (_videoStream->duration != AV_NOPTS_VALUE) {
+        return std::chrono::microseconds(
+            static_cast<int64_t>(static_cast<double>(_videoStream->duration) * av_q2d(_videoStream->time_base) * 1e6));
+    }
+    if (_formatContext->duration != AV_NOPTS_VALUE) {
+        return std::chrono::microseconds(_formatContext->duration * 1000000 / AV_TIME_BASE);
+    }
+    return {};
+}
+
+void VideoDecoder::Prefetch(int frames) {
+    while (static_cast<int>(_prefetched.size()) < frames && ReceiveFrame(_frame)) {
+        _prefetched.push_back(Scale(_frame));
+    }
+}
+
+VideoDecoder::ScaledFrame VideoDecoder::Scale(AVFrame *frame) {
+    ScaledFrame scaled{std::vector<uint8_t>(static_cast<size_t>(_outWidth * _outHeight)),
+        PresentationTime(frame->best_effort_timestamp)};
+
+    uint8_t *planes[4]{scaled.pixels.data()};
+    int linesizes[4]{_outWidth};
+    Trace::Stage stage{"video", "sws_scale"};
+    sws_scale(_swsContext, frame->data, frame->linesize, 0, _codecContext->height, planes, linesizes);
+    av_frame_unref(frame);
+    return scaled;
+}
+
+bool VideoDecoder::ReceiveFrame(AVFrame *frame) {
+    Trace::Stage stage{"video", "decode"};
+    while (not _finished) {
+        int ret = avcodec_receive_frame(_codecContext, frame);
+        if (ret >= 0) {
+            return true;
+        }
+        if (ret == AVERROR_EOF || (ret == AVERROR(EAGAIN) && _draining)) {
+            // codec fully drained, loop around unless the loop budget is spent
+            _loops++;
+            if (_loopLimit > 0 && _loops >= _loopLimit) {
+                _finished = true;
+                return false;
+            }
             Replay();
             continue;
         }
-        if (packet.stream_index == _streamIndex) {
-            ret = avcodec_send_packet(_codecContext, &packet);
+        if (ret != AVERROR(EAGAIN)) {
+            if (ret == AVERROR(EINVAL)) {
+                std::cerr << "Massive fail when decoding this frame" << std::endl;
+            } else {
+                std::cerr << "Unknown frame error (" << ret << ")" << std::endl;
+            }
+            std::exit(-1);
+        }
+
+        // codec wants more input, unless reading it would mean waiting for the upload
+        if (Starved()) {
+            return false;
+        }
+        ret = av_read_frame(_formatContext, _packet);
+        if (ret < 0) {
+            // EOF, flush out the frames still held back by the codec
+            avcodec_send_packet(_codecContext, nullptr);
+            _draining = true;
+            continue;
+        }
+        if (_packet->stream_index == _streamIndex) {
+            if (_seekTarget.has_value()) {
+                // a few frames of margin for reordering, the frames around the target must be decoded for real
+                const auto margin = static_cast<int64_t>(
+                    4 * std::chrono::duration<double>(_frameInterval).count() / av_q2d(_videoStream->time_base));
+                _codecContext->skip_frame =
+                    _packet->pts != AV_NOPTS_VALUE && _packet->pts < _seekTarget.value() - margin ? AVDISCARD_NONREF
+                                                                                                  : AVDISCARD_DEFAULT;
+            }
+            ret = avcodec_send_packet(_codecContext, _packet);
             if (ret < 0) {
                 if (ret == AVERROR(EAGAIN)) {
                     std::cerr << "Previous packet not finished" << std::endl;
@@ -97,49 +295,183 @@ void VideoDecoder::DecodeFrame(uint8_t *outBuffer, int bufferSize) {
                 }
                 std::exit(-1);
             }
-            while (ret >= 0) {
-                ret = avcodec_receive_frame(_codecContext, frame);
-                if (ret < 0) {
-                    if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
-                        std::cerr << "Empty packet?" << std::endl;
-                        break;
-                    } else if (ret == AVERROR(EINVAL)) {
-                        std::cerr << "Massive fail when decoding this frame" << std::endl;
-                    } else if (ret < 0) {
-                        std::cerr << "Unknown frame error (" << ret << ")" << std::endl;
-                    }
-                    std::exit(-1);
-                }
-                /*
-                  std::cout << "frame pts: " << frame->pts << std::endl;
-                  std::cout << "      best effort: " <<
-                  frame->best_effort_timestamp << std::endl;
-                 */
-
-                // wait until the right moment
-                // TODO: wait elsewhere
-                auto nextFrameTime = frame->best_effort_timestamp * av_q2d(_videoStream->time_base) * 1000.;
-                std::this_thread::sleep_until(_startTime + std::chrono::milliseconds(static_cast<int>(nextFrameTime)));
-
-                sws_scale(_swsContext, frame->data, frame->linesize, 0, _codecContext->height, _rgbFrameBuffer->data,
-                    _rgbFrameBuffer->linesize);
-
-                for (int s = 0; s < 3; s++) {
-                    for (int i = 0; i < bufferSize / 3; i++) {
-                        outBuffer[i * 3 + s] = _rgbFrameBuffer->data[0][s * bufferSize / 3 + i];
-                    }
-                }
-                av_frame_unref(frame);
-                av_packet_unref(&packet);
+        }
+        av_packet_unref(_packet);
+    }
+    return false;
+}
 
-                return;
-            }
+VideoDecoder::SeekResult VideoDecoder::Seek(double seconds, const KeyframeIndex *keyframes) {
+    const auto begin = std::chrono::steady_clock::now();
+    const auto timeBase = av_q2d(_videoStream->time_base);
+
+    if (_videoStream->duration != AV_NOPTS_VALUE) {
+        seconds = std::clamp(seconds, 0., static_cast<double>(_videoStream->duration) * timeBase);
+    }
+    const auto target = _firstPts + static_cast<int64_t>(seconds / timeBase);
+
+    if (keyframes != nullptr && not keyframes->keyframes.empty()) {
+        // the index was built from the same stream, so the time bases match
+        const auto &list = keyframes->keyframes;
+        auto it = std::upper_bound(
+            list.begin(), list.end(), target, [](int64_t pts, const Keyframe &keyframe) { return pts < keyframe.pts; });
+        const auto &keyframe = it == list.begin() ? *it : *std::prev(it);
+
+        if (keyframe.position >= 0 && (_formatContext->iformat->flags & AVFMT_NO_BYTE_SEEK) == 0) {
+            av_seek_frame(_formatContext, _streamIndex, keyframe.position, AVSEEK_FLAG_BYTE);
+        } else {
+            av_seek_frame(_formatContext, _streamIndex, keyframe.pts, AVSEEK_FLAG_BACKWARD);
         }
+    } else {
+        // no index yet, let the demuxer find the keyframe
+        av_seek_frame(_formatContext, _streamIndex, target, AVSEEK_FLAG_BACKWARD);
+    }
+    avcodec_flush_buffers(_codecContext);
+    _prefetched.clear();
+    _draining = false;
+    _finished = false;
+
+    // decode forward to the last frame not after the target, only that one gets scaled
+    const auto halfFrame = static_cast<int64_t>(std::chrono::duration<double>(_frameInterval).count() / timeBase / 2);
+    SeekResult result{seconds, 0, {}, false};
+    _seekTarget = target;
+    bool haveFrame{false};
+    while (ReceiveFrame(_frame)) {
+        haveFrame = true;
+        if (_frame->best_effort_timestamp + halfFrame >= target) {
+            break;
+        }
+        if (std::chrono::steady_clock::now() - begin > MaxSeekDecodeTime) {
+            result.budgetExceeded = true;
+            break;
+        }
+        av_frame_unref(_frame);
+        result.skippedFrames++;
+        haveFrame = false;
+    }
+    _seekTarget.reset();
+    _codecContext->skip_frame = AVDISCARD_DEFAULT;
+
+    if (haveFrame) {
+        _prefetched.push_back(Scale(_frame));
+        const auto presentationTime = _prefetched.back().presentationTime;
+
+        // continue the timeline from the frame that was landed on
+        _startTime = std::chrono::steady_clock::now() - std::chrono::milliseconds(static_cast<int>(presentationTime));
+        result.position = presentationTime / 1000.;
+    }
+
+    result.latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin);
+    return result;
+}
+
+void VideoDecoder::WriteOutput(const uint8_t *scaled, uint8_t *outBuffer, int bufferSize) const {
+    // gray to rgb, all channels carry the same value
+    for (int i = 0; i < bufferSize / 3; i++) {
+        outBuffer[i * 3 + 0] = scaled[i];
+        outBuffer[i * 3 + 1] = scaled[i];
+        outBuffer[i * 3 + 2] = scaled[i];
+    }
+}
+
+void VideoDecoder::WaitUntil(double presentationTime) const {
+    if (not _paced) {
+        return;
     }
+    std::this_thread::sleep_until(_startTime + std::chrono::milliseconds(static_cast<int>(presentationTime)));
+}
+
+bool VideoDecoder::Overdue(double presentationTime) const {
+    if (not _paced || _frameInterval.count() <= 0) {
+        return false;
+    }
+    // the next frame is due as well
+    return _startTime + std::chrono::milliseconds(static_cast<int>(presentationTime)) + _frameInterval <=
+           std::chrono::steady_clock::now();
+}
+
+double VideoDecoder::PresentationTime(int64_t pts) const {
+    return static_cast<double>(pts - _firstPts) * av_q2d(_videoStream->time_base) * 1000.;
 }
 
 void VideoDecoder::Replay() {
-    av_seek_frame(_formatContext, _streamIndex, 0, AVSEEK_FLAG_BACKWARD);
+    av_seek_frame(_formatContext, _streamIndex, _firstPts, AVSEEK_FLAG_BACKWARD);
     avcodec_flush_buffers(_codecContext);
+    _draining = false;
     _startTime = std::chrono::steady_clock::now();
 }
+
+int VideoDecoder::ReadGrowing(void *opaque, uint8_t *buffer, int size) {
+    auto &decoder = *static_cast<VideoDecoder *>(opaque);
+    const auto position = static_cast<uintmax_t>(decoder._readPosition);
+    // only blocks while the upload is still going and has not got this far yet
+    const auto available = decoder._growing->WaitBeyond(position, decoder._stallTimeout);
+    if (available <= position) {
+        // read to the end, or the upload stalled for too long; either way the video ends here for now
+        return AVERROR_EOF;
+    }
+
+    const auto count = std::min(static_cast<uintmax_t>(size), available - position);
+    const ssize_t result = pread(decoder._fd, buffer, static_cast<size_t>(count), static_cast<off_t>(position));
+    if (result < 0) {
+        return AVERROR(errno);
+    }
+    if (result == 0) {
+        return AVERROR_EOF;
+    }
+    decoder._readPosition += result;
+    return static_cast<int>(result);
+}
+
+int64_t VideoDecoder::SeekGrowing(void *opaque, int64_t offset, int whence) {
+    auto &decoder = *static_cast<VideoDecoder *>(opaque);
+    // the announced length until the upload is done, lets the demuxer know where the file ends
+    const auto length = static_cast<int64_t>(
+        decoder._growing->Complete() ? decoder._growing->GetSize() : decoder._growing->GetLength());
+
+    switch (whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE:
+        return length > 0 ? length : AVERROR(ENOSYS);
+    case SEEK_SET:
+        decoder._readPosition = offset;
+        break;
+    case SEEK_CUR:
+        decoder._readPosition += offset;
+        break;
+    case SEEK_END:
+        if (length <= 0) {
+            return AVERROR(ENOSYS);
+        }
+        decoder._readPosition = length + offset;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    return decoder._readPosition;
+}
+
+bool VideoDecoder::Starved() {
+    if (not _growing || _growing->Ended()) {
+        return false;
+    }
+
+    // counting what the demuxer has buffered already; near the end, the rest of the file is enough
+    const auto position = avio_tell(_io);
+    const auto ahead = static_cast<int64_t>(_growing->GetSize()) - position;
+    const auto length = static_cast<int64_t>(_growing->GetLength());
+    const auto wanted = length > 0 ? std::min(StarvationMargin, length - position) : StarvationMargin;
+    const auto now = std::chrono::steady_clock::now();
+    if (ahead < wanted) {
+        if (not _starvedSince.has_value()) {
+            _starvedSince = now;
+            _stalls++;
+        }
+        return true;
+    }
+    if (_starvedSince.has_value()) {
+        // as if paused, the frames after the stall keep their spacing instead of rushing to catch up
+        _startTime += now - _starvedSince.value();
+        _starvedSince.reset();
+    }
+    return false;
+}
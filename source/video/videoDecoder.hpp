@@ -2,6 +2,8 @@
 #define CONVENTION_NAMETAG_VIDEODECODER_HPP
 
 #include "decoder.hpp"
+#include "helper.hpp"
+#include "util/growingFile.hpp"
 
 // extern C required
 extern "C" {
@@ -12,32 +14,131 @@ extern "C" {
 }
 
 #include <chrono>
+#include <deque>
 #include <filesystem>
+#include <memory>
+#include <optional>
 #include <string>
+#include <vector>
 
 class VideoDecoder : public Decoder {
   public:
     explicit VideoDecoder(const std::filesystem::path &file, int width, int height);
+    // plays a file while it is still being uploaded, reads wait for the data up to stallTimeout
+    VideoDecoder(std::shared_ptr<GrowingFile> growing, int width, int height, std::chrono::milliseconds stallTimeout);
     ~VideoDecoder() override;
 
+    VideoDecoder(const VideoDecoder &) = delete;
+    VideoDecoder &operator=(const VideoDecoder &) = delete;
+
     void DecodeFrame(uint8_t *outBuffer, int bufferSize) override;
 
+    void Start(std::chrono::steady_clock::time_point startTime) override;
+    void Delay(std::chrono::steady_clock::duration pause) override { _startTime += pause; }
+    [[nodiscard]] bool Finished() const override { return _finished && _prefetched.empty(); }
+    [[nodiscard]] std::chrono::microseconds GetFrameInterval() const override { return _frameInterval; }
+
+    // decode and scale the first frames ahead of time, so starting playback costs no decode time
+    void Prefetch(int frames);
+    // stop after the video has been played this many times, 0 loops forever
+    void SetLoopLimit(int loops) { _loopLimit = loops; }
+    [[nodiscard]] int GetLoops() const { return _loops; }
+    // off hands frames out as fast as they decode instead of at their presentation time, for benchmarking
+    void SetPaced(bool paced) { _paced = paced; }
+    [[nodiscard]] long long GetFramesShown() const { return _framesShown; }
+    struct ShownFrame {
+        double presentationTime; // ms since the stream's first frame
+        // when it was written to the output, the panel gets it with the next push
+        std::chrono::steady_clock::time_point shownAt;
+    };
+    // nullopt until the first frame is out
+    [[nodiscard]] std::optional<ShownFrame> GetLastShown() const { return _lastShown; }
+    // when the current loop started, frames are due at this plus their presentation time
+    [[nodiscard]] std::chrono::steady_clock::time_point GetStartTime() const { return _startTime; }
+    // of one loop, zero if the container does not tell
+    [[nodiscard]] std::chrono::microseconds GetDuration() const;
+    // times playback of a growing file paused to let the upload catch up
+    [[nodiscard]] int GetStalls() const { return _stalls; }
+
+    struct SeekResult {
+        // seconds, where playback continues
+        double position;
+        // decoded but never shown on the way from the keyframe to the target
+        int skippedFrames;
+        std::chrono::microseconds latency;
+        // gave up decoding forward before reaching the target
+        bool budgetExceeded;
+    };
+    // jump to the keyframe at or before the target, then decode forward to it within MaxSeekDecodeTime
+    SeekResult Seek(double seconds, const KeyframeIndex *keyframes);
+
   private:
+    void Open(const std::string &filename);
+    // frees everything, for the destructor and for constructors that throw
+    void Release();
+
+    // the AVIOContext callbacks for growing files
+    static int ReadGrowing(void *opaque, uint8_t *buffer, int size);
+    static int64_t SeekGrowing(void *opaque, int64_t offset, int whence);
+    // too little of a growing file is ahead of the demuxer to read a packet without waiting
+    bool Starved();
+
+    struct ScaledFrame {
+        std::vector<uint8_t> pixels;
+        double presentationTime; // ms since start
+    };
+    // ms since the stream's first frame
+    [[nodiscard]] double PresentationTime(int64_t pts) const;
+
+    // false once the last loop has ended
+    bool ReceiveFrame(AVFrame *frame);
+    // scales and releases the frame
+    ScaledFrame Scale(AVFrame *frame);
+    void WriteOutput(const uint8_t *scaled, uint8_t *outBuffer, int bufferSize) const;
+    void WaitUntil(double presentationTime) const;
+    // its successor is due already, showing it would only hold up playback
+    [[nodiscard]] bool Overdue(double presentationTime) const;
     void Replay();
 
     AVFormatContext *_formatContext{};
-    int _streamIndex;
-    AVCodecParameters *_codecParameters;
-    AVCodecContext *_codecContext;
-    struct SwsContext *_swsContext;
-    AVStream *_videoStream;
+    // custom I/O, only for growing files
+    AVIOContext *_io{};
+    std::shared_ptr<GrowingFile> _growing;
+    std::chrono::milliseconds _stallTimeout{};
+    int _fd{-1};
+    int64_t _readPosition{};
+    std::optional<std::chrono::steady_clock::time_point> _starvedSince;
+    int _stalls{};
+    int _streamIndex{-1};
+    AVCodecParameters *_codecParameters{};
+    AVCodecContext *_codecContext{};
+    struct SwsContext *_swsContext{};
+    AVStream *_videoStream{};
+    // pts of the first frame, presentation times and seek positions count from it
+    int64_t _firstPts{};
 
     AVFrame *_rgbFrameBuffer{av_frame_alloc()};
+    AVFrame *_frame{av_frame_alloc()};
+    AVPacket *_packet{av_packet_alloc()};
 
     const int _outWidth;
     const int _outHeight;
 
     std::chrono::time_point<std::chrono::steady_clock> _startTime;
+    std::chrono::microseconds _frameInterval{};
+
+    std::deque<ScaledFrame> _prefetched;
+
+    // while seeking, packets well before this pts skip decoding of non-reference frames
+    std::optional<int64_t> _seekTarget;
+
+    long long _framesShown{};
+    std::optional<ShownFrame> _lastShown;
+    int _loops{};
+    int _loopLimit{};
+    bool _paced{true};
+    bool _draining{false};
+    bool _finished{false};
 };
 
 #endif
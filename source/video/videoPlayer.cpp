@@ -1,22 +1,453 @@
 #include "videoPlayer.hpp"
+#include "trace.hpp"
 #include "videoDecoder.hpp"
 
-VideoPlayer::VideoPlayer(int width, int height) : _width{width}, _height{height} {}
+#include <fstream>
+#include <iostream>
 
-void VideoPlayer::FetchFrame(uint8_t *buffer, int bufferSize) {
+namespace {
+// frames decoded ahead for the next playlist item, enough to hide the first sws_scale and a slow keyframe
+const auto PrefetchFrames = 2;
+
+// how often a pending upload is checked for having been cancelled
+const auto GrowingPollInterval = std::chrono::milliseconds(200);
+// an upload whose layout is still unclear after this much is treated as needing the complete file
+const size_t MaxLayoutProbe = 1024 * 1024;
+// the render loop runs at least this often while paused, there is no decoder to wait for
+const auto PausedPollInterval = std::chrono::milliseconds(10);
+} // namespace
+
+VideoPlayer::VideoPlayer(int width, int height, PixelFormat format)
+    : _width{width}, _height{height}, _format{format} {
+    _prefetchThread = std::thread([this]() { PrefetchWorker(); });
+}
+
+VideoPlayer::~VideoPlayer() {
+    {
+        auto lock = std::lock_guard<std::mutex>(_decoderAccess);
+        _running = false;
+    }
+    _prefetchWanted.notify_one();
+    _prefetchThread.join();
+}
+
+bool VideoPlayer::FetchFrame(uint8_t *buffer, int bufferSize, const FrameView &native) {
     // TODO: "faster" alternatives to locking every frame?
-    auto lock = std::lock_guard<std::mutex>(_decoderAccess);
-    _activeDecoder->DecodeFrame(buffer, bufferSize);
+    auto lock = std::unique_lock<std::mutex>(_decoderAccess);
+
+    if (_playlist.has_value()) {
+        if (const int step = _pendingStep.exchange(0); step != 0) {
+            Advance(step, false);
+        } else if (not _paused && ItemExpired(std::chrono::steady_clock::now())) {
+            Advance(1, true);
+        }
+    }
+
+    if (_paused) {
+        // the frame from before stays in native, nothing changes
+        _pausedSince = _pausedSince.value_or(std::chrono::steady_clock::now());
+        lock.unlock();
+        std::this_thread::sleep_for(PausedPollInterval);
+        return true;
+    }
+    if (_pausedSince.has_value()) {
+        const auto pause = std::chrono::steady_clock::now() - _pausedSince.value();
+        _activeDecoder->Delay(pause);
+        _itemStart += pause;
+        _pausedSince.reset();
+    }
+
+    const auto decode = [&]() {
+        if (_activeDecoder->DecodeNativeFrame(native)) {
+            return true;
+        }
+        _activeDecoder->DecodeFrame(buffer, bufferSize);
+        return false;
+    };
+
+    bool isNative = decode();
+    if (_activeDecoder->Finished() && _playlist.has_value()) {
+        // the buffer was left untouched, fill it from the next item right away
+        Advance(1, true);
+        isNative = decode();
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    if (_transitionExpected.has_value()) {
+        const auto gap = std::chrono::duration_cast<std::chrono::microseconds>(now - _lastFrameTime);
+        _stats.transitions++;
+        _stats.lastGap = gap;
+        _stats.minGap = std::min(_stats.minGap, gap);
+        _stats.maxGap = std::max(_stats.maxGap, gap);
+        _stats.totalGap += gap;
+        _stats.lastExpected = _transitionExpected.value();
+        _transitionExpected.reset();
+    }
+    _lastFrameTime = now;
+
+    if (_uploadStart.has_value() && _progressive->GetFramesShown() > 0) {
+        const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(now - _uploadStart.value());
+        _progressiveStats.firstFrames++;
+        _progressiveStats.lastFirstFrame = latency;
+        _progressiveStats.minFirstFrame = std::min(_progressiveStats.minFirstFrame, latency);
+        _progressiveStats.totalFirstFrame += latency;
+        _uploadStart.reset();
+    }
+    return isNative;
 }
 
 bool VideoPlayer::PlayFile(const std::filesystem::path &file) {
     // clean up previous player first
     // TODO: any ffmpeg components we can reuse?
-    if (std::filesystem::exists(file) && std::filesystem::is_regular_file(file)) {
+    if (not std::filesystem::exists(file) || not std::filesystem::is_regular_file(file)) {
+        return false;
+    }
+    // opened before anything is touched, a file that cannot be played leaves the current one playing
+    std::unique_ptr<VideoDecoder> decoder;
+    try {
+        decoder = std::make_unique<VideoDecoder>(file, _width, _height);
+    } catch (const std::exception &e) {
+        std::cerr << "Could not open " << file << ": " << e.what() << std::endl;
+        return false;
+    }
+
+    auto lock = std::lock_guard<std::mutex>(_decoderAccess);
+    _playlist.reset();
+    _next.reset();
+    _generation++;
+    _growing.reset();
+    EndProgressive();
+    _activeDecoder.reset();
+    Activate(std::move(decoder), std::chrono::steady_clock::now());
+    _currentFile = file;
+    return true;
+}
+
+void VideoPlayer::Play(std::unique_ptr<Decoder> decoder) {
+    auto lock = std::lock_guard<std::mutex>(_decoderAccess);
+    _playlist.reset();
+    _next.reset();
+    _generation++;
+    _growing.reset();
+    Activate(std::move(decoder), std::chrono::steady_clock::now());
+}
+
+void VideoPlayer::PlayGrowing(std::shared_ptr<GrowingFile> file, std::chrono::milliseconds stallTimeout) {
+    auto lock = std::lock_guard<std::mutex>(_decoderAccess);
+    _growing = std::move(file);
+    _stallTimeout = stallTimeout;
+    _prefetchWanted.notify_one();
+}
+
+void VideoPlayer::PlayPlaylist(Playlist playlist) {
+    auto lock = std::lock_guard<std::mutex>(_decoderAccess);
+    _playlist = std::move(playlist);
+    _next.reset();
+    _generation++;
+    _pendingStep = 0;
+    _growing.reset();
+
+    EndProgressive();
+    _activeDecoder.reset();
+    Activate(OpenCurrent(), std::chrono::steady_clock::now());
+    _prefetchWanted.notify_one();
+}
+
+void VideoPlayer::StopPlaylist() {
+    auto lock = std::lock_guard<std::mutex>(_decoderAccess);
+    if (not _playlist.has_value()) {
+        return;
+    }
+    _playlist.reset();
+    _next.reset();
+    _generation++;
+    Activate(std::make_unique<IdleDecoder>(), std::chrono::steady_clock::now());
+}
+
+std::optional<Playlist> VideoPlayer::GetPlaylist() {
+    auto lock = std::lock_guard<std::mutex>(_decoderAccess);
+    return _playlist;
+}
+
+std::optional<std::filesystem::path> VideoPlayer::GetCurrentFile() {
+    auto lock = std::lock_guard<std::mutex>(_decoderAccess);
+    return _currentFile;
+}
+
+void VideoPlayer::SetListener(std::function<void()> listener) {
+    auto lock = std::lock_guard<std::mutex>(_decoderAccess);
+    _listener = std::move(listener);
+}
+
+std::optional<VideoDecoder::SeekResult> VideoPlayer::Seek(double seconds, const KeyframeIndex *keyframes) {
+    // holding the lock keeps the render thread from showing anything until the target frame is ready
+    auto lock = std::lock_guard<std::mutex>(_decoderAccess);
+    auto *decoder = dynamic_cast<VideoDecoder *>(_activeDecoder.get());
+    if (decoder == nullptr) {
+        return std::nullopt;
+    }
+
+    // resumes, the frame landed on is shown and playback goes on from there
+    _paused = false;
+    _pausedSince.reset();
+    const auto result = decoder->Seek(seconds, keyframes);
+    _seekStats.seeks++;
+    _seekStats.lastLatency = result.latency;
+    _seekStats.maxLatency = std::max(_seekStats.maxLatency, result.latency);
+    _seekStats.totalLatency += result.latency;
+    _seekStats.budgetExceeded += result.budgetExceeded ? 1 : 0;
+    return result;
+}
+
+std::optional<VideoPlayer::Timeline> VideoPlayer::GetTimeline() {
+    auto lock = std::lock_guard<std::mutex>(_decoderAccess);
+    const auto *decoder = dynamic_cast<const VideoDecoder *>(_activeDecoder.get());
+    if (decoder == nullptr || not _currentFile.has_value()) {
+        return std::nullopt;
+    }
+    return Timeline{_currentFile.value(), decoder->GetStartTime(), decoder->GetDuration(), decoder->GetLastShown()};
+}
+
+void VideoPlayer::Shift(std::chrono::steady_clock::duration by) {
+    auto lock = std::lock_guard<std::mutex>(_decoderAccess);
+    _activeDecoder->Delay(by);
+    _itemStart += by;
+}
+
+VideoPlayer::SeekStats VideoPlayer::GetSeekStats() {
+    auto lock = std::lock_guard<std::mutex>(_decoderAccess);
+    return _seekStats;
+}
+
+VideoPlayer::ProgressiveStats VideoPlayer::GetProgressiveStats() {
+    auto lock = std::lock_guard<std::mutex>(_decoderAccess);
+    auto stats = _progressiveStats;
+    if (_progressive != nullptr) {
+        stats.stalls += _progressive->GetStalls();
+    }
+    return stats;
+}
+
+std::chrono::microseconds VideoPlayer::GetFrameInterval() {
+    auto lock = std::lock_guard<std::mutex>(_decoderAccess);
+    return _activeDecoder->GetFrameInterval();
+}
+
+VideoPlayer::TransitionStats VideoPlayer::GetTransitionStats() {
+    auto lock = std::lock_guard<std::mutex>(_decoderAccess);
+    return _stats;
+}
+
+void VideoPlayer::Advance(int step, bool seamless) {
+    std::unique_ptr<Decoder> decoder;
+    if (step > 0) {
+        if (not _playlist->Advance()) {
+            _playlist.reset();
+            _next.reset();
+            _generation++;
+            Activate(std::make_unique<IdleDecoder>(), std::chrono::steady_clock::now());
+            return;
+        }
+        if (_next) {
+            decoder = std::move(_next);
+            _stats.prefetchHits++;
+        } else {
+            _stats.prefetchMisses++;
+        }
+    } else {
+        _playlist->Retreat();
+        _next.reset();
+    }
+    _generation++;
+
+    if (not decoder) {
+        decoder = OpenCurrent();
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    if (seamless) {
+        // first frame of the new item goes where the next frame of the old one would have gone
+        const auto interval = _activeDecoder->GetFrameInterval();
+        startTime = std::max(startTime, _lastFrameTime + interval);
+        _transitionExpected = interval;
+    }
+    Activate(std::move(decoder), startTime);
+    _prefetchWanted.notify_one();
+}
+
+void VideoPlayer::Activate(std::unique_ptr<Decoder> decoder, std::chrono::steady_clock::time_point startTime) {
+    Trace::Instant("video", "swap decoder", static_cast<int64_t>(_generation));
+    EndProgressive();
+    _activeDecoder = std::move(decoder);
+    _activeDecoder->Start(startTime);
+    _itemStart = startTime;
+    _paused = false;
+    _pausedSince.reset();
+    _changes++;
+    _currentFile.reset();
+    if (_playlist.has_value()) {
+        _currentFile = _playlist->Current().file;
+    }
+    if (_listener) {
+        _listener();
+    }
+}
+
+void VideoPlayer::TogglePause() {
+    auto lock = std::lock_guard<std::mutex>(_decoderAccess);
+    _paused = not _paused;
+}
+
+void VideoPlayer::EndProgressive() {
+    if (_progressive != nullptr) {
+        _progressiveStats.stalls += _progressive->GetStalls();
+        _progressive = nullptr;
+    }
+    _uploadStart.reset();
+}
+
+std::unique_ptr<VideoDecoder> VideoPlayer::OpenItem(const PlaylistItem &item) {
+    try {
+        auto decoder = std::make_unique<VideoDecoder>(item.file, _width, _height);
+        // duration limited items loop until their time is up
+        decoder->SetLoopLimit(item.duration.count() > 0 ? 0 : item.loops);
+        return decoder;
+    } catch (const std::exception &e) {
+        std::cerr << "Could not open playlist item " << item.file << ": " << e.what() << std::endl;
+        return nullptr;
+    }
+}
+
+std::unique_ptr<Decoder> VideoPlayer::OpenCurrent() {
+    for (size_t attempt{0}; attempt < _playlist->GetSize(); attempt++) {
+        if (auto decoder = OpenItem(_playlist->Current())) {
+            return decoder;
+        }
+        if (not _playlist->Advance()) {
+            break;
+        }
+    }
+    std::cerr << "No playable item left in playlist" << std::endl;
+    _playlist.reset();
+    return std::make_unique<IdleDecoder>();
+}
+
+bool VideoPlayer::ItemExpired(std::chrono::steady_clock::time_point now) const {
+    const auto duration = _playlist->Current().duration;
+    return duration.count() > 0 && now - _itemStart >= duration;
+}
+
+void VideoPlayer::PrefetchWorker() {
+    Trace::SetThreadName("prefetch");
+    auto lock = std::unique_lock<std::mutex>(_decoderAccess);
+    while (true) {
+        _prefetchWanted.wait(lock, [this]() {
+            return not _running || _growing ||
+                   (_playlist.has_value() && not _next && _prefetchedGeneration != _generation &&
+                       _playlist->PeekNext() != nullptr);
+        });
+        if (not _running) {
+            return;
+        }
+
+        if (_growing) {
+            const auto file = _growing;
+            const auto stallTimeout = _stallTimeout;
+            lock.unlock();
+            auto decoder = OpenGrowing(file, stallTimeout);
+            lock.lock();
+            if (_growing != file) {
+                // something else was played meanwhile
+                _progressiveStats.cancelled++;
+                continue;
+            }
+            _growing.reset();
+            if (not decoder) {
+                _progressiveStats.cancelled++;
+                continue;
+            }
+
+            _playlist.reset();
+            _next.reset();
+            _generation++;
+            auto *progressive = decoder.get();
+            Activate(std::move(decoder), std::chrono::steady_clock::now());
+            _currentFile = file->GetPath();
+            _progressive = progressive;
+            _uploadStart = file->GetStart();
+            _progressiveStats.started++;
+            continue;
+        }
+
+        const auto generation = _generation;
+        const auto item = *_playlist->PeekNext();
+        _prefetchedGeneration = generation;
+
+        // opening, probing and decoding the first frames is the slow part of a transition
+        lock.unlock();
+        auto decoder = OpenItem(item);
+        if (decoder) {
+            decoder->Prefetch(PrefetchFrames);
+        }
+        lock.lock();
+
+        if (decoder && generation == _generation) {
+            _next = std::move(decoder);
+        }
+    }
+}
+
+std::unique_ptr<VideoDecoder> VideoPlayer::OpenGrowing(
+    const std::shared_ptr<GrowingFile> &file, std::chrono::milliseconds stallTimeout) {
+    const auto wanted = [this, &file]() {
         auto lock = std::lock_guard<std::mutex>(_decoderAccess);
-        _activeDecoder.reset();
-        _activeDecoder = std::make_unique<VideoDecoder>(file, _width, _height);
-        return true;
+        return _running && _growing == file;
+    };
+
+    std::vector<uint8_t> head;
+    auto layout = StreamLayout::Pending;
+    while (not file->Complete()) {
+        // once the layout is known, only the end of the upload matters
+        const auto size =
+            file->WaitBeyond(layout == StreamLayout::Pending ? head.size() : file->GetSize(), GrowingPollInterval);
+        if (not wanted() || (file->Ended() && not file->Complete())) {
+            return nullptr;
+        }
+        if (layout != StreamLayout::Pending) {
+            if (layout == StreamLayout::Progressive) {
+                break;
+            }
+            // the index is at the end, nothing to do but wait for it
+            continue;
+        }
+        if (size <= head.size()) {
+            continue;
+        }
+
+        head.resize(static_cast<size_t>(std::min<uintmax_t>(size, MaxLayoutProbe)));
+        std::ifstream stream(file->GetPath(), std::ios::binary);
+        stream.read(reinterpret_cast<char *>(head.data()), static_cast<std::streamsize>(head.size()));
+        head.resize(static_cast<size_t>(stream.gcount()));
+        layout = probeStreamLayout(head);
+        if (layout == StreamLayout::Pending && head.size() >= MaxLayoutProbe) {
+            layout = StreamLayout::Complete;
+        }
+        if (layout == StreamLayout::Progressive) {
+            break;
+        }
+    }
+    if (layout != StreamLayout::Progressive) {
+        auto lock = std::lock_guard<std::mutex>(_decoderAccess);
+        _progressiveStats.waitedForCompletion++;
+    }
+
+    try {
+        // the stream probe reads a few packets ahead, and may wait for them here
+        auto decoder = std::make_unique<VideoDecoder>(file, _width, _height, stallTimeout);
+        decoder->Prefetch(PrefetchFrames);
+        return decoder;
+    } catch (const std::exception &e) {
+        std::cerr << "Could not play upload " << file->GetPath() << ": " << e.what() << std::endl;
+        return nullptr;
     }
-    return false;
 }
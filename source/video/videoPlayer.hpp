@@ -3,26 +3,169 @@
 
 #include "decoder.hpp"
 #include "idleDecoder.hpp"
+#include "playlist.hpp"
+#include "videoDecoder.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <filesystem>
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <thread>
 
 class VideoPlayer {
   public:
-    VideoPlayer(int width, int height);
-    ~VideoPlayer() = default;
+    VideoPlayer(int width, int height, PixelFormat format);
+    ~VideoPlayer();
 
-    void FetchFrame(uint8_t *buffer, int bufferSize);
+    // true if the frame was drawn straight into native, otherwise buffer holds rgb to convert
+    bool FetchFrame(uint8_t *buffer, int bufferSize, const FrameView &native);
+    // false if the file is missing or cannot be opened, what was playing then goes on
     bool PlayFile(const std::filesystem::path &file);
+    // show anything else than a file, stops the playlist
+    void Play(std::unique_ptr<Decoder> decoder);
+    // plays an upload while it arrives, once its head shows it can be played from the front. The prefetch thread waits
+    // for that and opens the file, whatever is played in the meantime cancels it; reads wait up to stallTimeout for
+    // the upload to catch up
+    void PlayGrowing(std::shared_ptr<GrowingFile> file, std::chrono::milliseconds stallTimeout);
+
+    void PlayPlaylist(Playlist playlist);
+    void StopPlaylist();
+    // applied by the render thread on the next frame
+    void Next() { _pendingStep = 1; }
+    void Previous() { _pendingStep = -1; }
+    // holds the current frame, playing something else or seeking resumes
+    void TogglePause();
+    [[nodiscard]] std::optional<Playlist> GetPlaylist();
+    [[nodiscard]] std::optional<std::filesystem::path> GetCurrentFile();
+
+    // called whenever what is playing changes, possibly on the render thread and with the player locked, so it must
+    // not call back into the player
+    void SetListener(std::function<void()> listener);
+    // bumped whenever what is playing changes, cheap enough to poll every frame
+    [[nodiscard]] uint64_t GetChanges() const { return _changes.load(std::memory_order_relaxed); }
+
+    // nullopt if nothing seekable is playing
+    std::optional<VideoDecoder::SeekResult> Seek(double seconds, const KeyframeIndex *keyframes);
+
+    struct Timeline {
+        std::filesystem::path file;
+        // of the current loop, frames are due at this plus their presentation time
+        std::chrono::steady_clock::time_point start;
+        // of one loop, zero if unknown
+        std::chrono::microseconds duration;
+        // what is actually on the panel, start moves with Shift whether or not a frame followed it
+        std::optional<VideoDecoder::ShownFrame> lastShown;
+    };
+    // nullopt unless a video file is playing
+    [[nodiscard]] std::optional<Timeline> GetTimeline();
+    // moves the frames still to come by this much, those due already are skipped or the current one is held longer
+    void Shift(std::chrono::steady_clock::duration by);
+
+    [[nodiscard]] int GetWidth() const { return _width; }
+    [[nodiscard]] int GetHeight() const { return _height; }
+    [[nodiscard]] PixelFormat GetFormat() const { return _format; }
+    // how long the current frame is meant to be shown, zero if what is playing has no rate of its own
+    [[nodiscard]] std::chrono::microseconds GetFrameInterval();
+
+    struct TransitionStats {
+        int transitions{};
+        int prefetchHits{};
+        int prefetchMisses{};
+        // time between the last frame of an item and the first frame of the next
+        std::chrono::microseconds lastGap{};
+        std::chrono::microseconds minGap{std::chrono::microseconds::max()};
+        std::chrono::microseconds maxGap{};
+        std::chrono::microseconds totalGap{};
+        // what the gap should have been, the outgoing item's frame interval
+        std::chrono::microseconds lastExpected{};
+    };
+    [[nodiscard]] TransitionStats GetTransitionStats();
+
+    struct SeekStats {
+        int seeks{};
+        std::chrono::microseconds lastLatency{};
+        std::chrono::microseconds maxLatency{};
+        std::chrono::microseconds totalLatency{};
+        // seeks that hit the forward decode budget and landed before the target
+        int budgetExceeded{};
+    };
+    [[nodiscard]] SeekStats GetSeekStats();
+
+    struct ProgressiveStats {
+        // uploads played while they arrived
+        int started{};
+        // only started once the upload was complete, mostly MP4s with their index at the end
+        int waitedForCompletion{};
+        // failed or were replaced before they could be played
+        int cancelled{};
+        // upload start to the first frame handed to the panel
+        int firstFrames{};
+        std::chrono::microseconds lastFirstFrame{};
+        std::chrono::microseconds minFirstFrame{std::chrono::microseconds::max()};
+        std::chrono::microseconds totalFirstFrame{};
+        // playback paused to let the upload catch up
+        int stalls{};
+    };
+    [[nodiscard]] ProgressiveStats GetProgressiveStats();
 
   private:
+    // _decoderAccess must be held for all of these
+    void Advance(int step, bool seamless);
+    void Activate(std::unique_ptr<Decoder> decoder, std::chrono::steady_clock::time_point startTime);
+    std::unique_ptr<VideoDecoder> OpenItem(const PlaylistItem &item);
+    std::unique_ptr<Decoder> OpenCurrent();
+    // counts the stalls of the upload being played, before its decoder goes away
+    void EndProgressive();
+    // prefetch thread, without the lock: waits until the head of the upload shows it can be played from the front, or
+    // else for the whole upload, then opens it; nullptr if it failed or was cancelled
+    std::unique_ptr<VideoDecoder> OpenGrowing(
+        const std::shared_ptr<GrowingFile> &file, std::chrono::milliseconds stallTimeout);
+    [[nodiscard]] bool ItemExpired(std::chrono::steady_clock::time_point now) const;
+
+    void PrefetchWorker();
+
     std::unique_ptr<Decoder> _activeDecoder{std::make_unique<IdleDecoder>()};
 
     int _width;
     int _height;
+    PixelFormat _format;
 
     std::mutex _decoderAccess;
+
+    std::optional<Playlist> _playlist;
+    std::optional<std::filesystem::path> _currentFile;
+    std::chrono::steady_clock::time_point _itemStart;
+    std::atomic<int> _pendingStep{};
+    bool _paused{};
+    // set by the render thread once it saw the pause
+    std::optional<std::chrono::steady_clock::time_point> _pausedSince;
+
+    std::chrono::steady_clock::time_point _lastFrameTime;
+    std::optional<std::chrono::microseconds> _transitionExpected;
+    TransitionStats _stats;
+    SeekStats _seekStats;
+    ProgressiveStats _progressiveStats;
+    std::function<void()> _listener;
+    std::atomic<uint64_t> _changes{};
+
+    // decoder of the upcoming playlist item, opened and primed by the prefetch thread
+    std::unique_ptr<VideoDecoder> _next;
+    // bumped whenever what comes next changes, stale prefetches are dropped
+    uint64_t _generation{};
+    uint64_t _prefetchedGeneration{};
+    // upload waiting to be opened by the prefetch thread
+    std::shared_ptr<GrowingFile> _growing;
+    std::chrono::milliseconds _stallTimeout{};
+    // the active decoder if it plays an upload, and when that upload started until its first frame is shown
+    VideoDecoder *_progressive{};
+    std::optional<std::chrono::steady_clock::time_point> _uploadStart;
+    std::condition_variable _prefetchWanted;
+    std::thread _prefetchThread;
+    bool _running{true};
 };
 
 #endif // CONVENTION_NAMETAG_VIDEOPLAYER_HPP
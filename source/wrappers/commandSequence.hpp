@@ -0,0 +1,58 @@
+#ifndef CONVENTION_NAMETAG_COMMANDSEQUENCE_HPP
+#define CONVENTION_NAMETAG_COMMANDSEQUENCE_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+
+namespace Wrappers {
+/**
+ * @brief Commands and their arguments, grouped by the level DC has to be at while they are sent
+ *
+ * Consecutive commands, or consecutive argument bytes, are a single phase and go out in one SPI transfer instead of a
+ * transfer per byte. Everything is constexpr: init sequences are built at compile time into tables, window setup is
+ * built on the stack per frame. Capacity is in bytes, going beyond it throws, which fails the build for tables.
+ */
+template <size_t Capacity> class CommandSequence {
+  public:
+    struct Phase {
+        // DC high: arguments or display data, low: commands
+        bool data;
+        uint16_t begin;
+        uint16_t end;
+    };
+
+    constexpr CommandSequence &Command(uint8_t command) { return Append(false, command); }
+
+    template <class... Bytes> constexpr CommandSequence &Data(Bytes... bytes) {
+        (Append(true, static_cast<uint8_t>(bytes)), ...);
+        return *this;
+    }
+
+    [[nodiscard]] constexpr const std::array<uint8_t, Capacity> &GetBytes() const { return _bytes; }
+    [[nodiscard]] constexpr std::span<const Phase> GetPhases() const { return {_phases.data(), _phaseCount}; }
+    [[nodiscard]] constexpr size_t GetSize() const { return _size; }
+
+  private:
+    constexpr CommandSequence &Append(bool data, uint8_t byte) {
+        if (_size == Capacity) {
+            throw std::length_error("command sequence too long");
+        }
+        if (_phaseCount == 0 || _phases[_phaseCount - 1].data != data) {
+            _phases[_phaseCount++] = {data, static_cast<uint16_t>(_size), static_cast<uint16_t>(_size)};
+        }
+        _bytes[_size++] = byte;
+        _phases[_phaseCount - 1].end = static_cast<uint16_t>(_size);
+        return *this;
+    }
+
+    std::array<uint8_t, Capacity> _bytes{};
+    std::array<Phase, Capacity> _phases{};
+    size_t _size{};
+    size_t _phaseCount{};
+};
+} // namespace Wrappers
+
+#endif // CONVENTION_NAMETAG_COMMANDSEQUENCE_HPP
@@ -1,6 +1,8 @@
 #ifndef CONVENTION_NAMETAG_DRIVER_HPP
 #define CONVENTION_NAMETAG_DRIVER_HPP
 
+#include "commandSequence.hpp"
+#include "drawers/frame.hpp"
 #include "hardware.hpp"
 
 #include <algorithm> // std::max
@@ -38,6 +40,7 @@ struct SH1106 {
         Size = Width * Height,
         BufferSize = Size / 8
     };
+    static constexpr auto Format = PixelFormat::Mono1Paged;
 
     struct Registry {
         enum Commands : int {
@@ -274,6 +277,7 @@ struct SSD1305 {
         Size = Width * Height,
         BufferSize = Size / 8
     };
+    static constexpr auto Format = PixelFormat::Mono1Paged;
 
     struct Registry {
         /**
@@ -338,6 +342,7 @@ struct SSD1322 {
         Size = Width * Height,
         BufferSize = Size / 2
     };
+    static constexpr auto Format = PixelFormat::Gray4;
 
     struct Registry {
         enum Commands : int {
@@ -405,12 +410,11 @@ template <class DeviceType> class Driver {
             return;
         }
 
-        // set page address
-        WriteRegistry(DeviceType::Registry::Page + (y / 8));
-        // set low column address
-        WriteRegistry(DeviceType::Registry::SelectColumnLow + (x & 0x0f));
-        // set high column address
-        WriteRegistry(DeviceType::Registry::SelectColumnHigh + (x >> 4));
+        // page, low and high column address
+        Write(CommandSequence<3>()
+                  .Command(DeviceType::Registry::Page + (y / 8))
+                  .Command(DeviceType::Registry::SelectColumnLow + (x & 0x0f))
+                  .Command(DeviceType::Registry::SelectColumnHigh + (x >> 4)));
 
         /*
          * Cursor position is now set... but what does it do?
@@ -431,6 +435,8 @@ template <class DeviceType> class Driver {
 
     // used in constructor, cannot be pure virtual
     virtual void Display(){};
+    // sends only the given part of the buffer, panels without windowed writes send everything
+    virtual void DisplayRegion(const Rect &) { Display(); }
 
     void SetPanelPower(bool on = true) {
         if (on) {
@@ -442,6 +448,9 @@ template <class DeviceType> class Driver {
 
     virtual void CopyFramebuffer(const uint8_t *glBuffer) = 0;
 
+    // the packed display buffer, for drawing in the panel's own format
+    [[nodiscard]] FrameView GetFrame() { return {_buffer, _width, _height, DeviceType::Format}; }
+
     [[nodiscard]] int GetWidth() const { return _width; }
     [[nodiscard]] int GetHeight() const { return _height; }
 
@@ -455,12 +464,23 @@ template <class DeviceType> class Driver {
         }
     }
 
-    void WriteDataByte(uint8_t data) {
-        if constexpr (Hardware::UseSPI) {
-            Hardware::DC1();
-            Hardware::SPIWriteByte(data);
-        } else {
-            Hardware::I2CWriteByte(data, Pins::IICRAM);
+    // a transfer per phase rather than per byte; over I2C every byte still carries its own control byte
+    template <size_t Capacity> void Write(const CommandSequence<Capacity> &sequence) {
+        // SPI transfers are full duplex, what comes back overwrites the bytes sent
+        auto bytes = sequence.GetBytes();
+        for (const auto &phase : sequence.GetPhases()) {
+            if constexpr (Hardware::UseSPI) {
+                if (phase.data) {
+                    Hardware::DC1();
+                } else {
+                    Hardware::DC0();
+                }
+                Hardware::SPIWriteBytes(reinterpret_cast<char *>(bytes.data() + phase.begin), phase.end - phase.begin);
+            } else {
+                for (auto i{phase.begin}; i < phase.end; i++) {
+                    Hardware::I2CWriteByte(bytes[i], phase.data ? Pins::IICRAM : Pins::IICCMD);
+                }
+            }
         }
     }
 
@@ -507,7 +527,12 @@ class [[maybe_unused]] SH1106 : public Driver<HardwareSpecs::SH1106> {
 
     SH1106();
     void Display() override;
+    void DisplayRegion(const Rect &area) override;
     void CopyFramebuffer(const uint8_t *glBuffer) override;
+    // rgb to the packed buffer layout, for converting into buffers other than the driver's own
+    static void ConvertFramebuffer(const uint8_t *glBuffer, uint8_t *buffer);
+    // the brightness, as the segment current
+    void SetContrast(uint8_t level);
 
     uint8_t GetKeyUp();
     uint8_t GetKeyDown();
@@ -527,7 +552,12 @@ class [[maybe_unused]] SSD1322 : public Driver<HardwareSpecs::SSD1322> {
     SSD1322();
 
     void Display() override;
+    void DisplayRegion(const Rect &area) override;
     void CopyFramebuffer(const uint8_t *glBuffer) override;
+    // rgb to the packed buffer layout, for converting into buffers other than the driver's own
+    static void ConvertFramebuffer(const uint8_t *glBuffer, uint8_t *buffer);
+    // the brightness, as the segment current
+    void SetContrast(uint8_t level);
 
   private:
     void InitRegistry();
@@ -539,6 +569,10 @@ class [[maybe_unused]] SSD1305 : public Driver<HardwareSpecs::SSD1305> {
 
     void Display() override;
     void CopyFramebuffer(const uint8_t *glBuffer) override;
+    // rgb to the packed buffer layout, for converting into buffers other than the driver's own
+    static void ConvertFramebuffer(const uint8_t *glBuffer, uint8_t *buffer);
+    // the brightness, as the segment current
+    void SetContrast(uint8_t level);
 
   private:
     void InitRegistry();
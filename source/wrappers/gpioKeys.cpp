@@ -0,0 +1,219 @@
+#include "gpioKeys.hpp"
+#include "util/trace.hpp"
+
+#include <fcntl.h>
+#include <linux/gpio.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+namespace {
+const char *eventName(Wrappers::GpioKeys::Event event) {
+    switch (event) {
+    case Wrappers::GpioKeys::Event::Press:
+        return "press";
+    case Wrappers::GpioKeys::Event::Release:
+        return "release";
+    case Wrappers::GpioKeys::Event::LongPress:
+        return "long press";
+    case Wrappers::GpioKeys::Event::Repeat:
+        return "repeat";
+    default:
+        return "";
+    }
+}
+} // namespace
+
+namespace Wrappers {
+GpioKeys::GpioKeys(const Configuration::Keys &configuration, std::vector<uint32_t> pins, Handler handler)
+    : _configuration{configuration}, _pins{std::move(pins)}, _handler{std::move(handler)}, _keys(_pins.size()) {}
+
+GpioKeys::~GpioKeys() { Stop(); }
+
+bool GpioKeys::Start() {
+    if (_pins.empty() || _pins.size() > GPIO_V2_LINES_MAX) {
+        std::cerr << "Keys: " << _pins.size() << " pins cannot be requested" << std::endl;
+        return false;
+    }
+
+    const int chip = open(_configuration.chip.c_str(), O_RDONLY | O_CLOEXEC);
+    if (chip < 0) {
+        std::cerr << "Keys: failed to open " << _configuration.chip << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    gpio_v2_line_request request{};
+    for (size_t i{0}; i < _pins.size(); i++) {
+        request.offsets[i] = _pins[i];
+    }
+    request.num_lines = static_cast<uint32_t>(_pins.size());
+    std::strncpy(request.consumer, "nametag keys", sizeof(request.consumer) - 1);
+    // active low: the rising edge is the press; timestamps are CLOCK_MONOTONIC, the steady clock's
+    request.config.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_ACTIVE_LOW | GPIO_V2_LINE_FLAG_EDGE_RISING |
+                           GPIO_V2_LINE_FLAG_EDGE_FALLING | GPIO_V2_LINE_FLAG_BIAS_PULL_UP;
+    const int result = ioctl(chip, GPIO_V2_GET_LINE_IOCTL, &request);
+    close(chip);
+    if (result < 0) {
+        std::cerr << "Keys: failed to request lines: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    _lines = request.fd;
+    _wake = eventfd(0, EFD_CLOEXEC);
+
+    // keys held during startup count as pressed, without acting on them
+    gpio_v2_line_values values{0, (uint64_t{1} << _pins.size()) - 1};
+    if (ioctl(_lines, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) == 0) {
+        for (size_t i{0}; i < _keys.size(); i++) {
+            _keys[i].pressed = (values.bits >> i & 1) != 0;
+        }
+    }
+
+    _thread = std::thread(&GpioKeys::Run, this);
+    return true;
+}
+
+void GpioKeys::Stop() {
+    if (_thread.joinable()) {
+        const uint64_t one{1};
+        if (write(_wake, &one, sizeof(one)) < 0) {
+            std::cerr << "Keys: failed to wake the key thread: " << std::strerror(errno) << std::endl;
+        }
+        _thread.join();
+    }
+    if (_lines >= 0) {
+        close(_lines);
+        _lines = -1;
+    }
+    if (_wake >= 0) {
+        close(_wake);
+        _wake = -1;
+    }
+}
+
+GpioKeys::Stats GpioKeys::GetStats() const {
+    auto lock = std::lock_guard<std::mutex>(_access);
+    return _stats;
+}
+
+void GpioKeys::Run() {
+    Trace::SetThreadName("keys");
+    pollfd fds[2]{{_lines, POLLIN, 0}, {_wake, POLLIN, 0}};
+    gpio_v2_line_event events[16];
+
+    while (true) {
+        // no timer runs while no key is held or bouncing, poll sleeps until the next edge
+        int timeout{-1};
+        if (const auto next = NextTimer(); next.has_value()) {
+            const auto left =
+                std::chrono::ceil<std::chrono::milliseconds>(next.value() - std::chrono::steady_clock::now());
+            timeout = static_cast<int>(std::max<int64_t>(left.count(), 0));
+        }
+        if (poll(fds, 2, timeout) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Keys: poll failed: " << std::strerror(errno) << std::endl;
+            return;
+        }
+        if ((fds[1].revents & POLLIN) != 0) {
+            return;
+        }
+
+        if ((fds[0].revents & POLLIN) != 0) {
+            const auto bytes = read(_lines, events, sizeof(events));
+            const auto count = bytes > 0 ? static_cast<size_t>(bytes) / sizeof(gpio_v2_line_event) : 0;
+            for (size_t i{0}; i < count; i++) {
+                const auto &event = events[i];
+                const auto pin = std::find(_pins.begin(), _pins.end(), event.offset);
+                if (pin == _pins.end()) {
+                    continue;
+                }
+                const auto index = static_cast<int>(pin - _pins.begin());
+                auto &key = _keys[index];
+                const auto edge = std::chrono::steady_clock::time_point(std::chrono::nanoseconds(event.timestamp_ns));
+                const bool pressed = event.id == GPIO_V2_LINE_EVENT_RISING_EDGE;
+
+                {
+                    auto lock = std::lock_guard<std::mutex>(_access);
+                    _stats.edges++;
+                    if ((key.settled.has_value() && edge < key.settled.value()) || pressed == key.pressed) {
+                        _stats.bounces++;
+                        continue;
+                    }
+                }
+                key.settled = edge + std::chrono::milliseconds(_configuration.debounceMs);
+                Change(index, pressed, edge);
+            }
+        }
+        RunTimers(std::chrono::steady_clock::now());
+    }
+}
+
+void GpioKeys::Change(int key, bool pressed, std::chrono::steady_clock::time_point edge) {
+    auto &state = _keys[key];
+    state.pressed = pressed;
+    state.longPressed = false;
+    state.due.reset();
+    if (pressed) {
+        state.due = edge + std::chrono::milliseconds(_configuration.longPressMs);
+    }
+    Dispatch(key, pressed ? Event::Press : Event::Release, edge);
+}
+
+void GpioKeys::Dispatch(int key, Event event, std::chrono::steady_clock::time_point edge) {
+    {
+        Trace::Scope trace{"keys", eventName(event), key};
+        _handler(key, event);
+    }
+    // long presses and repeats come from timers, not from an edge
+    if (event != Event::Press && event != Event::Release) {
+        return;
+    }
+    const auto latency =
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - edge);
+    auto lock = std::lock_guard<std::mutex>(_access);
+    _stats.handled++;
+    _stats.lastLatency = latency;
+    _stats.maxLatency = std::max(_stats.maxLatency, latency);
+    _stats.totalLatency += latency;
+}
+
+std::optional<std::chrono::steady_clock::time_point> GpioKeys::NextTimer() const {
+    std::optional<std::chrono::steady_clock::time_point> next;
+    for (const auto &key : _keys) {
+        for (const auto &timer : {key.settled, key.due}) {
+            if (timer.has_value() && (not next.has_value() || timer.value() < next.value())) {
+                next = timer;
+            }
+        }
+    }
+    return next;
+}
+
+void GpioKeys::RunTimers(std::chrono::steady_clock::time_point now) {
+    for (int i{0}; i < static_cast<int>(_keys.size()); i++) {
+        auto &key = _keys[i];
+        if (key.settled.has_value() && key.settled.value() <= now) {
+            key.settled.reset();
+            // the bounce may have ended on the other level, its last edge was dropped then
+            gpio_v2_line_values values{0, uint64_t{1} << i};
+            if (ioctl(_lines, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) == 0) {
+                if (const bool pressed = (values.bits >> i & 1) != 0; pressed != key.pressed) {
+                    Change(i, pressed, now);
+                }
+            }
+        }
+        if (key.due.has_value() && key.due.value() <= now) {
+            const auto due = key.due.value();
+            key.due = now + std::chrono::milliseconds(_configuration.repeatMs);
+            Dispatch(i, key.longPressed ? Event::Repeat : Event::LongPress, due);
+            key.longPressed = true;
+        }
+    }
+}
+} // namespace Wrappers
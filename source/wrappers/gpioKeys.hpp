@@ -0,0 +1,89 @@
+#ifndef CONVENTION_NAMETAG_GPIOKEYS_HPP
+#define CONVENTION_NAMETAG_GPIOKEYS_HPP
+
+#include "util/configuration.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace Wrappers {
+/**
+ * @brief Keys wired to GPIO pins, pulled up and shorted to ground when pressed
+ *
+ * The lines are requested from the GPIO character device with edge detection in both directions, and a thread of its
+ * own sleeps in poll until the kernel reports an edge. There is no timeout while no key is held, so an idle keypad
+ * costs no CPU at all. The first edge of a press or release is acted on right away and the edges after it within the
+ * debounce time are dropped; the level is read again once it is over, in case the bounce settled the other way.
+ * Keys held down report a long press and then repeat.
+ *
+ * Handlers run on the key thread, they should hand work on rather than block.
+ */
+class GpioKeys {
+  public:
+    enum class Event { Press, Release, LongPress, Repeat };
+    // key is the index into pins
+    using Handler = std::function<void(int key, Event event)>;
+
+    GpioKeys(const Configuration::Keys &configuration, std::vector<uint32_t> pins, Handler handler);
+    ~GpioKeys();
+
+    GpioKeys(const GpioKeys &) = delete;
+    GpioKeys &operator=(const GpioKeys &) = delete;
+
+    // false if the lines cannot be had, the badge runs on without keys then
+    bool Start();
+    void Stop();
+
+    struct Stats {
+        long long edges{};
+        // edges within the debounce time of the one acted on
+        long long bounces{};
+        // presses and releases handled, the latency is from the edge the kernel reported to the handler returning
+        long long handled{};
+        std::chrono::microseconds lastLatency{};
+        std::chrono::microseconds maxLatency{};
+        std::chrono::microseconds totalLatency{};
+    };
+    [[nodiscard]] Stats GetStats() const;
+
+  private:
+    struct Key {
+        bool pressed{};
+        // edges are ignored until then, the level is checked again when it passes
+        std::optional<std::chrono::steady_clock::time_point> settled;
+        // next long press or repeat while held
+        std::optional<std::chrono::steady_clock::time_point> due;
+        bool longPressed{};
+    };
+
+    void Run();
+    // acts on a change of level, edge is when the kernel saw it
+    void Change(int key, bool pressed, std::chrono::steady_clock::time_point edge);
+    // edge is what the event goes back to: the level change, or the timer for long presses and repeats
+    void Dispatch(int key, Event event, std::chrono::steady_clock::time_point edge);
+    // the first timer to expire, nullopt if none is running
+    [[nodiscard]] std::optional<std::chrono::steady_clock::time_point> NextTimer() const;
+    void RunTimers(std::chrono::steady_clock::time_point now);
+
+    const Configuration::Keys _configuration;
+    const std::vector<uint32_t> _pins;
+    const Handler _handler;
+
+    // key thread only
+    std::vector<Key> _keys;
+
+    int _lines{-1};
+    // written by Stop to wake the thread
+    int _wake{-1};
+    Stats _stats;
+    mutable std::mutex _access;
+    std::thread _thread;
+};
+} // namespace Wrappers
+
+#endif // CONVENTION_NAMETAG_GPIOKEYS_HPP
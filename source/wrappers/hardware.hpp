@@ -36,6 +36,12 @@ inline void DC1() { bcm2835_gpio_write(DC, HIGH); }
 
 inline void EnablePin(uint8_t pin) { bcm2835_gpio_fsel(pin, BCM2835_GPIO_FSEL_OUTP); }
 
+// for keys that short the pin to ground
+inline void EnableInputPin(uint8_t pin) {
+    bcm2835_gpio_fsel(pin, BCM2835_GPIO_FSEL_INPT);
+    bcm2835_gpio_set_pud(pin, BCM2835_GPIO_PUD_UP);
+}
+
 inline uint8_t ReadPin(uint8_t pin) { return bcm2835_gpio_lev(pin); }
 
 bool Init();
@@ -1,15 +1,55 @@
 #include "driver.hpp"
+#include "util/trace.hpp"
+
+namespace {
+namespace HW = HardwareSpecs;
+
+// arguments go with DC low as well, so the whole sequence is a single transfer instead of 24
+constexpr auto InitSequence = Wrappers::CommandSequence<32>()
+                                  .Command(HW::SH1106::Registry::PanelOff)
+                                  .Command(HW::SH1106::Registry::SelectColumnLow + 0x0)
+                                  .Command(HW::SH1106::Registry::SelectColumnHigh + 0x0)
+                                  .Command(HW::SH1106::Registry::SelectLine + 0x0)
+                                  .Command(HW::SH1106::Registry::SetContrastControl)
+                                  .Command(HW::SH1106::Registry::ValueContrastControlReset)
+                                  .Command(HW::SH1106::Registry::SegmentRemapNormal)
+                                  .Command(HW::SH1106::Registry::ComRowScanDirection + 0x0)
+                                  .Command(HW::SH1106::Registry::SetMultiplexRatio)
+                                  .Command(HW::SH1106::Registry::ValueMultiplexRatioDefault)
+                                  .Command(HW::SH1106::Registry::SetDisplayOffset)
+                                  .Command(HW::SH1106::Registry::ValueDisplayOffsetDefault)
+                                  .Command(HW::SH1106::Registry::SetDisplayClockFreq)
+                                  .Command(HW::SH1106::Registry::ValueDisplayClockFreqDefault)
+                                  .Command(HW::SH1106::Registry::SetChargePeriod)
+                                  .Command(0xF1)
+                                  .Command(HW::SH1106::Registry::SetComPinsHWConf)
+                                  .Command(HW::SH1106::Registry::ValueComPinsHWConfDefault)
+                                  .Command(HW::SH1106::Registry::SetVCOMH)
+                                  .Command(0x40) // Set VCOM Deselect Level
+                                  .Command(HW::SH1106::Registry::SetPageAddressingMode)
+                                  .Command(0x02)
+                                  .Command(HW::SH1106::Registry::DisableForceDisplayOn)
+                                  .Command(HW::SH1106::Registry::DisableInverseDisplay);
+
+// page and column ahead of a page's pixels, one transfer instead of three
+constexpr auto pageSequence(int page, int column) {
+    return Wrappers::CommandSequence<3>()
+        .Command(HW::SH1106::Registry::Page + page)
+        .Command(column & 0x0F)
+        .Command(HW::SH1106::Registry::SelectColumnHigh + (column >> 4));
+}
+} // namespace
 
 namespace Wrappers {
 SH1106::SH1106() : Driver<HardwareSpecs::SH1106>::Driver() {
-    Hardware::EnablePin(Pins::KeyUpPin);
-    Hardware::EnablePin(Pins::KeyDownPin);
-    Hardware::EnablePin(Pins::KeyLeftPin);
-    Hardware::EnablePin(Pins::KeyRightPin);
-    Hardware::EnablePin(Pins::KeyPressPin);
-    Hardware::EnablePin(Pins::Key1Pin);
-    Hardware::EnablePin(Pins::Key2Pin);
-    Hardware::EnablePin(Pins::Key3Pin);
+    Hardware::EnableInputPin(Pins::KeyUpPin);
+    Hardware::EnableInputPin(Pins::KeyDownPin);
+    Hardware::EnableInputPin(Pins::KeyLeftPin);
+    Hardware::EnableInputPin(Pins::KeyRightPin);
+    Hardware::EnableInputPin(Pins::KeyPressPin);
+    Hardware::EnableInputPin(Pins::Key1Pin);
+    Hardware::EnableInputPin(Pins::Key2Pin);
+    Hardware::EnableInputPin(Pins::Key3Pin);
 
     // cannot put next lines in common constructor calling virtual from
     // constructor breaks
@@ -25,32 +65,48 @@ void SH1106::Display() {
     uint8_t *buffer{_buffer};
 
     for (uint8_t page{0}; page < 8; page++, buffer += _width) {
-        // set page address
-        WriteRegistry(HardwareSpecs::SH1106::Registry::Page + page);
-
-        // reset column address
-        WriteRegistry(HardwareSpecs::SH1106::Registry::SelectColumnLow);
-        WriteRegistry(HardwareSpecs::SH1106::Registry::SelectColumnHigh);
+        // set page address, reset column address
+        Write(pageSequence(page, HardwareSpecs::SH1106::Registry::SelectColumnLow));
 
         // write display buffer
         WriteData(buffer, _width);
     }
 }
 
-void SH1106::CopyFramebuffer(const uint8_t *glBuffer) {
+void SH1106::DisplayRegion(const Rect &area) {
+    // the low column command is 0x00-0x0F, SelectColumnLow already includes the offset of the first visible column
+    const int column = area.x + HardwareSpecs::SH1106::XOffset;
+
+    for (int page{area.y / 8}; page <= (area.Bottom() - 1) / 8; page++) {
+        Write(pageSequence(page, column));
+
+        WriteData(_buffer + page * _width + area.x, area.width);
+    }
+}
+
+void SH1106::SetContrast(uint8_t level) {
+    // a double byte command, the value goes with DC low as well
+    Write(CommandSequence<2>().Command(HardwareSpecs::SH1106::Registry::SetContrastControl).Command(level));
+}
+
+void SH1106::CopyFramebuffer(const uint8_t *glBuffer) { ConvertFramebuffer(glBuffer, _buffer); }
+
+void SH1106::ConvertFramebuffer(const uint8_t *glBuffer, uint8_t *buffer) {
+    const int width = HardwareSpecs::SH1106::Width;
+
     // gl buffer is formatted in RGB, so multiply index by 3 to use R channels
 
     for (int page{0}; page < 8; page++) {
-        for (int x{0}; x < _width; x++) {
-            const auto bufferIndex{x + page * _width};
-            _buffer[bufferIndex] = 0;
+        for (int x{0}; x < width; x++) {
+            const auto bufferIndex{x + page * width};
+            buffer[bufferIndex] = 0;
         }
 
         for (int y{0}; y < 8; y++) {
-            for (int x{0}; x < _width; x++) {
+            for (int x{0}; x < width; x++) {
                 // set pixel on if at least 50% bright
-                const uint8_t bitValue{glBuffer[(page * _width * 8 + y * _width + x) * 3] > 0x7F};
-                _buffer[page * _width + x] |= bitValue << y;
+                const uint8_t bitValue{glBuffer[(page * width * 8 + y * width + x) * 3] > 0x7F};
+                buffer[page * width + x] |= bitValue << y;
             }
         }
     }
@@ -73,43 +129,7 @@ uint8_t SH1106::GetKey2() { return Hardware::ReadPin(Pins::Key2Pin); }
 uint8_t SH1106::GetKey3() { return Hardware::ReadPin(Pins::Key3Pin); }
 
 void SH1106::InitRegistry() {
-    namespace HW = HardwareSpecs;
-
-    WriteRegistry(HW::SH1106::Registry::PanelOff);
-
-    WriteRegistry(HW::SH1106::Registry::SelectColumnLow + 0x0);
-    WriteRegistry(HW::SH1106::Registry::SelectColumnHigh + 0x0);
-
-    WriteRegistry(HW::SH1106::Registry::SelectLine + 0x0);
-
-    WriteRegistry(HW::SH1106::Registry::SetContrastControl);
-    WriteRegistry(HW::SH1106::Registry::ValueContrastControlReset);
-
-    WriteRegistry(HW::SH1106::Registry::SegmentRemapNormal);
-    WriteRegistry(HW::SH1106::Registry::ComRowScanDirection + 0x0);
-
-    WriteRegistry(HW::SH1106::Registry::SetMultiplexRatio);
-    WriteRegistry(HW::SH1106::Registry::ValueMultiplexRatioDefault);
-
-    WriteRegistry(HW::SH1106::Registry::SetDisplayOffset);
-    WriteRegistry(HW::SH1106::Registry::ValueDisplayOffsetDefault);
-
-    WriteRegistry(HW::SH1106::Registry::SetDisplayClockFreq);
-    WriteRegistry(HW::SH1106::Registry::ValueDisplayClockFreqDefault);
-
-    WriteRegistry(HW::SH1106::Registry::SetChargePeriod);
-    WriteRegistry(0xF1);
-
-    WriteRegistry(HW::SH1106::Registry::SetComPinsHWConf);
-    WriteRegistry(HW::SH1106::Registry::ValueComPinsHWConfDefault);
-
-    WriteRegistry(HW::SH1106::Registry::SetVCOMH);
-    WriteRegistry(0x40); // Set VCOM Deselect Level
-
-    WriteRegistry(HW::SH1106::Registry::SetPageAddressingMode);
-    WriteRegistry(0x02);
-
-    WriteRegistry(HW::SH1106::Registry::DisableForceDisplayOn);
-    WriteRegistry(HW::SH1106::Registry::DisableInverseDisplay);
+    Trace::Scope trace{"panel", "init"};
+    Write(InitSequence);
 }
 } // namespace Wrappers
\ No newline at end of file
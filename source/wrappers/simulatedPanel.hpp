@@ -0,0 +1,65 @@
+#ifndef CONVENTION_NAMETAG_SIMULATEDPANEL_HPP
+#define CONVENTION_NAMETAG_SIMULATEDPANEL_HPP
+
+#include "drawers/frame.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+namespace Wrappers {
+/**
+ * @brief Stands in for a panel on hosts without one
+ *
+ * Has the buffer of the real driver and takes as long to display as the SPI transfer would, so the render loop keeps
+ * its timing and everything around it can be run and measured on any machine. Nothing touches the hardware.
+ *
+ * Not in real time, it only adds up how long the transfers would have taken, for benchmarks on a virtual clock.
+ */
+template <class DeviceType> class SimulatedPanel {
+  public:
+    // core clock over the divider set up in Hardware::Init
+    static constexpr long long SpiClock = 250'000'000 / 20;
+
+    explicit SimulatedPanel(bool realTime = true) : _realTime{realTime} {}
+
+    void Display() { Transfer(DeviceType::BufferSize); }
+    // what the real driver sends for the window: whole 4 pixel columns on the SSD1322, whole pages on paged panels
+    void DisplayRegion(const Rect &area) {
+        if constexpr (DeviceType::Format == PixelFormat::Gray4) {
+            Transfer(((area.Right() + 3) / 4 - area.x / 4) * 2 * area.height);
+        } else {
+            Transfer(area.width * ((area.Bottom() + 7) / 8 - area.y / 8));
+        }
+    }
+
+    // nothing lights up, nothing to dim
+    void SetContrast(uint8_t) {}
+
+    [[nodiscard]] FrameView GetFrame() { return {_buffer, _width, _height, DeviceType::Format}; }
+
+    [[nodiscard]] int GetWidth() const { return _width; }
+    [[nodiscard]] int GetHeight() const { return _height; }
+    // all transfers so far
+    [[nodiscard]] std::chrono::microseconds GetTransferTime() const { return _transferTime; }
+
+  private:
+    void Transfer(long long bytes) {
+        // window and ram commands ahead of the data
+        const long long commandBytes = 7;
+        const auto time = std::chrono::microseconds((bytes + commandBytes) * 8 * 1'000'000 / SpiClock);
+        _transferTime += time;
+        if (_realTime) {
+            std::this_thread::sleep_for(time);
+        }
+    }
+
+    uint8_t _buffer[DeviceType::BufferSize]{};
+    int _width{DeviceType::Width};
+    int _height{DeviceType::Height};
+    bool _realTime;
+    std::chrono::microseconds _transferTime{};
+};
+} // namespace Wrappers
+
+#endif // CONVENTION_NAMETAG_SIMULATEDPANEL_HPP
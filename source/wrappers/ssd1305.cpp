@@ -1,4 +1,35 @@
 #include "driver.hpp"
+#include "util/trace.hpp"
+
+namespace {
+namespace HW = HardwareSpecs;
+
+// arguments go with DC low as well, so the whole sequence is a single transfer instead of 23
+constexpr auto InitSequence = Wrappers::CommandSequence<32>()
+                                  .Command(HW::SSD1305::Registry::PanelOff)
+                                  .Command(HW::SSD1305::Registry::SelectColumnLow + 0x04)
+                                  .Command(HW::SSD1305::Registry::SelectColumnHigh + 0x00)
+                                  .Command(HW::SSD1305::Registry::SetDisplayStartLine)
+                                  .Command(HW::SSD1305::Registry::SetContrastControl)
+                                  .Command(0x80) // ?
+                                  .Command(HW::SSD1305::Registry::SetSegmentRemap + 0x1)
+                                  .Command(HW::SSD1305::Registry::DisableInverseDisplay)
+                                  .Command(HW::SSD1305::Registry::SetMultiplexRatio)
+                                  .Command(0x1F)
+                                  .Command(HW::SSD1305::Registry::SetComOutputScanDir)
+                                  .Command(HW::SSD1305::Registry::SetDisplayOffset)
+                                  .Command(0x00)
+                                  .Command(HW::SSD1305::Registry::SetDisplayOscillatorFrequency)
+                                  .Command(0xF0)
+                                  .Command(HW::SSD1305::Registry::SetAreaColorMode)
+                                  .Command(0x05)
+                                  .Command(HW::SSD1305::Registry::SetPrechargePeriod)
+                                  .Command(0xC2) // Set Pre-Charge as 15 Clocks & Discharge as 1 Clock
+                                  .Command(HW::SSD1305::Registry::SetCOMPinsHardwareConfiguration)
+                                  .Command(0x12)
+                                  .Command(HW::SSD1305::Registry::SetVComH)
+                                  .Command(0x08);
+} // namespace
 
 namespace Wrappers {
 SSD1305::SSD1305() {
@@ -15,62 +46,47 @@ SSD1305::SSD1305() {
 void SSD1305::Display() {
     uint8_t *buffer{_buffer};
 
-    for (uint8_t page{0}; page < 8; page++, buffer += _width) {
-        // set page address
+    for (uint8_t page{0}; page < _height / 8; page++, buffer += _width) {
+        // set page address, reset column address
         // TODO: why no HardwareSpaces::SSD1305::Registry::Page?
-        WriteRegistry(HardwareSpecs::SH1106::Registry::Page + page);
-
-        // reset column address
-        WriteRegistry(0x04);
-        WriteRegistry(HardwareSpecs::SSD1305::Registry::SelectColumnHigh);
+        Write(CommandSequence<3>()
+                  .Command(HardwareSpecs::SH1106::Registry::Page + page)
+                  .Command(0x04)
+                  .Command(HardwareSpecs::SSD1305::Registry::SelectColumnHigh));
 
         // write display buffer
         WriteData(buffer, _width);
     }
 }
 
-void SSD1305::CopyFramebuffer(const uint8_t *glBuffer) {
-    for (int page{0}; page < 8; page++) {
-        for (int x{0}; x < _width; x++) {
-            const auto bufferIndex{x + page * _width};
-            _buffer[bufferIndex] = 0;
+void SSD1305::SetContrast(uint8_t level) {
+    Write(CommandSequence<2>().Command(HardwareSpecs::SSD1305::Registry::SetContrastControl).Command(level));
+}
+
+void SSD1305::CopyFramebuffer(const uint8_t *glBuffer) { ConvertFramebuffer(glBuffer, _buffer); }
+
+void SSD1305::ConvertFramebuffer(const uint8_t *glBuffer, uint8_t *buffer) {
+    const int width = HardwareSpecs::SSD1305::Width;
+
+    // 32 rows are 4 pages
+    for (int page{0}; page < HardwareSpecs::SSD1305::Height / 8; page++) {
+        for (int x{0}; x < width; x++) {
+            const auto bufferIndex{x + page * width};
+            buffer[bufferIndex] = 0;
         }
 
         for (int y{0}; y < 8; y++) {
-            for (int x{0}; x < _width; x++) {
+            for (int x{0}; x < width; x++) {
                 // set pixel on if at least 50% bright
-                const uint8_t bitValue{glBuffer[(page * _width * 8 + y * _width + x) * 3] > 0x7F};
-                _buffer[page * _width + x] |= bitValue << y;
+                const uint8_t bitValue{glBuffer[(page * width * 8 + y * width + x) * 3] > 0x7F};
+                buffer[page * width + x] |= bitValue << y;
             }
         }
     }
 }
 
 void SSD1305::InitRegistry() {
-    namespace HW = HardwareSpecs;
-
-    WriteRegistry(HW::SSD1305::Registry::PanelOff);
-    WriteRegistry(HW::SSD1305::Registry::SelectColumnLow + 0x04);
-    WriteRegistry(HW::SSD1305::Registry::SelectColumnHigh + 0x00);
-    WriteRegistry(HW::SSD1305::Registry::SetDisplayStartLine);
-    WriteRegistry(HW::SSD1305::Registry::SetContrastControl);
-    WriteRegistry(0x80); // ?
-    WriteRegistry(HW::SSD1305::Registry::SetSegmentRemap + 0x1);
-    WriteRegistry(HW::SSD1305::Registry::DisableInverseDisplay);
-    WriteRegistry(HW::SSD1305::Registry::SetMultiplexRatio);
-    WriteRegistry(0x1F);
-    WriteRegistry(HW::SSD1305::Registry::SetComOutputScanDir);
-    WriteRegistry(HW::SSD1305::Registry::SetDisplayOffset);
-    WriteRegistry(0x00);
-    WriteRegistry(HW::SSD1305::Registry::SetDisplayOscillatorFrequency);
-    WriteRegistry(0xF0);
-    WriteRegistry(HW::SSD1305::Registry::SetAreaColorMode);
-    WriteRegistry(0x05);
-    WriteRegistry(HW::SSD1305::Registry::SetPrechargePeriod);
-    WriteRegistry(0xC2); // Set Pre-Charge as 15 Clocks & Discharge as 1 Clock
-    WriteRegistry(HW::SSD1305::Registry::SetCOMPinsHardwareConfiguration);
-    WriteRegistry(0x12);
-    WriteRegistry(HW::SSD1305::Registry::SetVComH);
-    WriteRegistry(0x08);
+    Trace::Scope trace{"panel", "init"};
+    Write(InitSequence);
 }
 } // namespace Wrappers
\ No newline at end of file
@@ -1,4 +1,65 @@
 #include "driver.hpp"
+#include "util/trace.hpp"
+
+namespace {
+namespace HW = HardwareSpecs;
+
+// the panel's 256 columns are the middle of the controller's 480, addressed in groups of 4 pixels
+const auto ColumnOffset = 0x1C;
+
+// commands and arguments alternate, 33 transfers instead of 39
+constexpr auto InitSequence =
+    Wrappers::CommandSequence<48>()
+        .Command(HW::SSD1322::Registry::SetCommandLock)
+        .Data(0x12) // Unlock OLED driver IC
+        .Command(HW::SSD1322::Registry::PanelOff)
+        .Command(HW::SSD1322::Registry::SetClockDivider)
+        .Data(0x91)
+        .Command(HW::SSD1322::Registry::SetMultiplexRatio)
+        .Data(0x3F) // duty = 1/64
+        .Command(HW::SSD1322::Registry::SetDisplayOffset)
+        .Data(0x00)
+        .Command(HW::SSD1322::Registry::SetStartLine)
+        .Data(0x00)
+        .Command(HW::SSD1322::Registry::SetRemap)
+        // Horizontal address increment,Disable Column Address Re-map,Enable Nibble Re-map,Scan from COM[N-1] to
+        // COM0,Disable COM Split Odd Even; Enable Dual COM mode
+        .Data(0x14, 0x11)
+        .Command(HW::SSD1322::Registry::SetGPIO)
+        .Data(0x00) // Disable GPIO Pins Input
+        .Command(HW::SSD1322::Registry::FunctionSelect)
+        .Data(0x01) // selection external vdd
+        .Command(HW::SSD1322::Registry::DisplayEnhance)
+        // enables the external VSL; 0xfFD,Enhanced low GS display quality;default is 0xb5(normal),
+        .Data(0xA0, 0xFD)
+        .Command(HW::SSD1322::Registry::SetContrastCurrent)
+        .Data(0xFF) // 0xFF - default is 0x7f
+        .Command(HW::SSD1322::Registry::MasterCurrentControl)
+        .Data(0x0F) // default is 0x0F
+        .Command(HW::SSD1322::Registry::SelectDefaultGrayscale)
+        .Command(HW::SSD1322::Registry::SetPhaseLength)
+        .Data(0xE2) // default is 0x74
+        .Command(HW::SSD1322::Registry::DisplayEnhanceB)
+        .Data(0x82, 0x20) // Reserved;default is 0xa2(normal)
+        .Command(HW::SSD1322::Registry::SetPrechargeVoltage)
+        .Data(0x1F) // 0.6xVcc
+        .Command(HW::SSD1322::Registry::SetSecondPrechargePeriod)
+        .Data(0x08) // default
+        .Command(HW::SSD1322::Registry::SetVComH)
+        .Data(0x04) // 0.86xVcc;default is 0x04
+        .Command(HW::SSD1322::Registry::DisableInverseDisplay)
+        .Command(HW::SSD1322::Registry::ExitPartialDispaly);
+
+// window and RAM write ahead of the pixels, 5 transfers instead of 7
+constexpr auto windowSequence(int firstColumn, int lastColumn, int firstRow, int lastRow) {
+    return Wrappers::CommandSequence<7>()
+        .Command(HW::SSD1322::Registry::SetColumnAddress)
+        .Data(ColumnOffset + firstColumn, ColumnOffset + lastColumn)
+        .Command(HW::SSD1322::Registry::SetRowAddress)
+        .Data(firstRow, lastRow)
+        .Command(HW::SSD1322::Registry::WriteRam);
+}
+} // namespace
 
 namespace Wrappers {
 SSD1322::SSD1322() {
@@ -13,27 +74,46 @@ SSD1322::SSD1322() {
 }
 
 void SSD1322::Display() {
-    WriteRegistry(HardwareSpecs::SSD1322::Registry::SetColumnAddress);
-    const auto ColOffset{0x1C};
-    WriteDataByte(static_cast<uint8_t>(ColOffset + 0x00));
-    WriteDataByte(static_cast<uint8_t>(ColOffset + 0x3F));
-
-    WriteRegistry(HardwareSpecs::SSD1322::Registry::SetRowAddress);
-    WriteDataByte(0x00);
-    WriteDataByte(0x3F);
-
-    WriteRegistry(HardwareSpecs::SSD1322::Registry::WriteRam);
+    {
+        Trace::Scope trace{"panel", "window"};
+        Write(windowSequence(0x00, 0x3F, 0x00, 0x3F));
+    }
 
     WriteData(_buffer, HardwareSpecs::SSD1322::BufferSize);
 
     Hardware::DelayMS(0);
 }
 
-void SSD1322::CopyFramebuffer(const uint8_t *glBuffer) {
+void SSD1322::DisplayRegion(const Rect &area) {
+    const int firstColumn = area.x / 4;
+    const int lastColumn = (area.Right() + 3) / 4 - 1;
+
+    {
+        Trace::Scope trace{"panel", "window"};
+        Write(windowSequence(firstColumn, lastColumn, area.y, area.Bottom() - 1));
+    }
+
+    // the controller fills the window row by row, gather it so it still goes out in a single transfer
+    const int stride = (lastColumn - firstColumn + 1) * 2;
+    uint8_t window[HardwareSpecs::SSD1322::BufferSize];
+    for (int row{0}; row < area.height; row++) {
+        std::memcpy(window + row * stride, _buffer + (area.y + row) * _width / 2 + firstColumn * 2, stride);
+    }
+    WriteData(window, stride * area.height);
+}
+
+void SSD1322::SetContrast(uint8_t level) {
+    Write(CommandSequence<2>().Command(HardwareSpecs::SSD1322::Registry::SetContrastCurrent).Data(level));
+}
+
+void SSD1322::CopyFramebuffer(const uint8_t *glBuffer) { ConvertFramebuffer(glBuffer, _buffer); }
+
+void SSD1322::ConvertFramebuffer(const uint8_t *glBuffer, uint8_t *buffer) {
+    const int width = HardwareSpecs::SSD1322::Width;
     // gl buffer is formatted in RGB, so multiply index by 3 to use R channels
     for (unsigned y{0}; y < 64; y++) {
         for (unsigned x{0}; x < 256; x += 2) {
-            _buffer[(y * _width + x) / 2] = 0;
+            buffer[(y * width + x) / 2] = 0;
 
             // This is what I used for openGL
             // this doesn't work for my ffmpeg output
@@ -44,75 +124,15 @@ void SSD1322::CopyFramebuffer(const uint8_t *glBuffer) {
             //|= glBuffer[((63 - y) * _state.width + x + 1) * 3] >> 4;
 
             // left pixel is 4 high bits
-            _buffer[(y * _width + x) / 2] |= glBuffer[(y * _width + x) * 3] & 0xF0;
+            buffer[(y * width + x) / 2] |= glBuffer[(y * width + x) * 3] & 0xF0;
             // right pixel is 4 low bits
-            _buffer[(y * _width + x) / 2] |= glBuffer[(y * _width + x + 1) * 3] >> 4;
+            buffer[(y * width + x) / 2] |= glBuffer[(y * width + x + 1) * 3] >> 4;
         }
     }
 }
 
 void SSD1322::InitRegistry() {
-    namespace HW = HardwareSpecs;
-
-    WriteRegistry(HW::SSD1322::Registry::SetCommandLock);
-    WriteDataByte(0x12); // Unlock OLED driver IC
-
-    WriteRegistry(HW::SSD1322::Registry::PanelOff);
-
-    WriteRegistry(HW::SSD1322::Registry::SetClockDivider);
-    WriteDataByte(0x91);
-
-    WriteRegistry(HW::SSD1322::Registry::SetMultiplexRatio);
-    WriteDataByte(0x3F); // duty = 1/64
-
-    WriteRegistry(HW::SSD1322::Registry::SetDisplayOffset);
-    WriteDataByte(0x00);
-
-    WriteRegistry(HW::SSD1322::Registry::SetStartLine);
-    WriteDataByte(0x00);
-
-    WriteRegistry(HW::SSD1322::Registry::SetRemap);
-    WriteDataByte(0x14); // Horizontal address increment,Disable Column Address
-                         // Re-map,Enable Nibble Re-map,Scan from COM[N-1] to
-                         // COM0,Disable COM Split Odd Even
-    WriteDataByte(0x11); // Enable Dual COM mode
-
-    WriteRegistry(HW::SSD1322::Registry::SetGPIO);
-    WriteDataByte(0x00); // Disable GPIO Pins Input
-
-    WriteRegistry(HW::SSD1322::Registry::FunctionSelect);
-    WriteDataByte(0x01); // selection external vdd
-
-    WriteRegistry(HW::SSD1322::Registry::DisplayEnhance);
-    WriteDataByte(0xA0); // enables the external VSL
-    WriteDataByte(0xFD); // 0xfFD,Enhanced low GS display quality;default is 0xb5(normal),
-
-    WriteRegistry(HW::SSD1322::Registry::SetContrastCurrent);
-    WriteDataByte(0xFF); // 0xFF - default is 0x7f
-
-    WriteRegistry(HW::SSD1322::Registry::MasterCurrentControl);
-    WriteDataByte(0x0F); // default is 0x0F
-
-    WriteRegistry(HW::SSD1322::Registry::SelectDefaultGrayscale);
-
-    WriteRegistry(HW::SSD1322::Registry::SetPhaseLength);
-    WriteDataByte(0xE2); // default is 0x74
-
-    WriteRegistry(HW::SSD1322::Registry::DisplayEnhanceB);
-    WriteDataByte(0x82); // Reserved;default is 0xa2(normal)
-    WriteDataByte(0x20); //
-
-    WriteRegistry(HW::SSD1322::Registry::SetPrechargeVoltage);
-    WriteDataByte(0x1F); // 0.6xVcc
-
-    WriteRegistry(HW::SSD1322::Registry::SetSecondPrechargePeriod);
-    WriteDataByte(0x08); // default
-
-    WriteRegistry(HW::SSD1322::Registry::SetVComH);
-    WriteDataByte(0x04); // 0.86xVcc;default is 0x04
-
-    WriteRegistry(HW::SSD1322::Registry::DisableInverseDisplay);
-
-    WriteRegistry(HW::SSD1322::Registry::ExitPartialDispaly);
+    Trace::Scope trace{"panel", "init"};
+    Write(InitSequence);
 }
 } // namespace Wrappers
\ No newline at end of file
@@ -0,0 +1,930 @@
+/**
+ * Load test for the web server, run on the badge itself or on a host running `nametag --simulate`
+ *
+ * Starts a number of clients per kind of traffic, each on its own connection over loopback, and keeps them busy for a
+ * while: phones refreshing the library, fetching thumbnails and polling stats, uploads, remote controls on the control
+ * channel and preview viewers. Every request's latency is recorded, and afterwards the server's render loop deadline
+ * misses during the run are fetched from /render/stats. Both sides read the same monotonic clock, so misses can be
+ * lined up with the requests in flight when they happened: a kind of request that is in flight during misses much more
+ * often than during the rest of the run is blocking something the render thread waits for.
+ *
+ * Exits with 1 if a threshold given with --max-misses or --max-p99 is exceeded, 2 if the server could not be reached.
+ */
+#include <nlohmann/json.hpp>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+enum Kind : int { Videos, Thumbnails, Stats, Upload, Delete, Control, Preview, KindCount };
+// as given to --mix; delete has no clients of its own, uploads clean up after themselves
+const std::array<std::string_view, KindCount> KindNames{
+    "videos", "thumbnails", "stats", "upload", "delete", "control", "preview"};
+
+// polled in turn by stats clients, what dashboards keep open
+const std::array<std::string_view, 6> StatsTargets{
+    "/preview/stats", "/control/stats", "/live/stats", "/uploads", "/playlist", "/layers"};
+// cheap and expensive commands in turn
+const std::array<std::string_view, 3> ControlCommands{"playback", "layers", "videos"};
+
+const auto RequestTimeout = std::chrono::milliseconds(10000);
+// how often clients waiting on a socket look whether the run is over
+const auto StopPoll = std::chrono::milliseconds(250);
+const size_t SendChunk = 64 * 1024;
+
+struct Options {
+    std::string host{"127.0.0.1"};
+    int port{8080};
+    std::chrono::seconds duration{30};
+    std::chrono::seconds baseline{5};
+    // clients per kind
+    std::array<int, KindCount> mix{8, 4, 2, 1, 0, 2, 2};
+    size_t uploadSize{4 * 1024 * 1024};
+    // bytes per second, 0 as fast as loopback takes them
+    double uploadRate{};
+    std::chrono::milliseconds think{};
+    int previewFps{};
+    long long maxMisses{-1};
+    double maxP99{-1.};
+    bool json{};
+};
+
+struct Sample {
+    Kind kind;
+    Clock::time_point start;
+    std::chrono::microseconds duration;
+    bool ok;
+};
+
+// what one client recorded, only touched by its thread until it is joined
+struct ClientResults {
+    std::vector<Sample> samples;
+    long long bytes{};
+};
+
+/**
+ * @brief Blocking TCP connection with its own read buffer
+ */
+class Connection {
+  public:
+    Connection(const std::string &host, int port) {
+        _fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<uint16_t>(port));
+        if (_fd < 0 || inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1 ||
+            connect(_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+            Close();
+            return;
+        }
+        // requests are small and latency is what is measured
+        const int noDelay = 1;
+        setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    }
+    ~Connection() { Close(); }
+    Connection(const Connection &) = delete;
+    Connection &operator=(const Connection &) = delete;
+
+    [[nodiscard]] bool Connected() const { return _fd >= 0; }
+    void Close() {
+        if (_fd >= 0) {
+            close(_fd);
+        }
+        _fd = -1;
+    }
+
+    bool Send(std::string_view data) {
+        while (not data.empty() && _fd >= 0) {
+            const auto sent = send(_fd, data.data(), data.size(), MSG_NOSIGNAL);
+            if (sent <= 0) {
+                Close();
+                return false;
+            }
+            data.remove_prefix(static_cast<size_t>(sent));
+        }
+        return _fd >= 0;
+    }
+
+    // waits up to timeout for more data, false on timeout, error or the server closing
+    bool Fill(std::chrono::milliseconds timeout) {
+        if (_fd < 0) {
+            return false;
+        }
+        pollfd descriptor{_fd, POLLIN, 0};
+        if (poll(&descriptor, 1, static_cast<int>(timeout.count())) <= 0) {
+            return false;
+        }
+        char chunk[SendChunk];
+        const auto received = recv(_fd, chunk, sizeof(chunk), 0);
+        if (received <= 0) {
+            Close();
+            return false;
+        }
+        _buffer.append(chunk, static_cast<size_t>(received));
+        return true;
+    }
+
+    // without the line break
+    std::optional<std::string> ReadLine() {
+        size_t end{};
+        while ((end = _buffer.find("\r\n")) == std::string::npos) {
+            if (not Fill(RequestTimeout)) {
+                return std::nullopt;
+            }
+        }
+        auto line = _buffer.substr(0, end);
+        _buffer.erase(0, end + 2);
+        return line;
+    }
+
+    // appends length bytes to out; the timeout is per wait, so that callers can give up in between
+    bool Read(size_t length, std::string &out, std::chrono::milliseconds timeout = RequestTimeout) {
+        while (_buffer.size() < length) {
+            if (not Fill(timeout)) {
+                return false;
+            }
+        }
+        out.append(_buffer, 0, length);
+        _buffer.erase(0, length);
+        return true;
+    }
+
+    [[nodiscard]] bool Buffered() const { return not _buffer.empty(); }
+
+  private:
+    int _fd{-1};
+    std::string _buffer;
+};
+
+struct Response {
+    int status{};
+    std::string body;
+    bool keepAlive{true};
+};
+
+// reads the status line and headers, the body is left to the caller; header names in lower case
+std::optional<Response> readHead(Connection &connection, std::map<std::string, std::string> &headers) {
+    const auto statusLine = connection.ReadLine();
+    if (not statusLine.has_value() || statusLine->size() < 12) {
+        return std::nullopt;
+    }
+    Response response;
+    std::from_chars(statusLine->data() + 9, statusLine->data() + 12, response.status);
+    for (auto line = connection.ReadLine(); line.has_value() && not line->empty(); line = connection.ReadLine()) {
+        const auto colon = line->find(':');
+        if (colon == std::string::npos) {
+            continue;
+        }
+        auto name = line->substr(0, colon);
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+        const auto value = line->find_first_not_of(' ', colon + 1);
+        headers[name] = value == std::string::npos ? "" : line->substr(value);
+    }
+    if (headers.contains("connection") && headers["connection"] == "close") {
+        response.keepAlive = false;
+    }
+    return response;
+}
+
+std::optional<Response> httpRequest(Connection &connection, const Options &options, std::string_view method,
+    std::string_view target, std::string_view body = {}) {
+    std::string head = std::string(method) + " " + std::string(target) + " HTTP/1.1\r\nHost: " + options.host +
+                       "\r\nUser-Agent: nametag-loadtest\r\n";
+    if (not body.empty() || method == "POST") {
+        head += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    }
+    if (not connection.Send(head + "\r\n")) {
+        return std::nullopt;
+    }
+
+    // uploads are paced like a phone on Wi-Fi would send them, if asked to
+    const auto sendStart = Clock::now();
+    for (size_t sent{0}; sent < body.size(); sent += SendChunk) {
+        if (not connection.Send(body.substr(sent, SendChunk))) {
+            return std::nullopt;
+        }
+        if (options.uploadRate > 0) {
+            const auto due = static_cast<double>(sent + SendChunk) * 1e6 / options.uploadRate;
+            std::this_thread::sleep_until(sendStart + std::chrono::microseconds(static_cast<long long>(due)));
+        }
+    }
+
+    std::map<std::string, std::string> headers;
+    auto response = readHead(connection, headers);
+    if (not response.has_value()) {
+        return std::nullopt;
+    }
+    if (headers.contains("transfer-encoding") && headers["transfer-encoding"] == "chunked") {
+        for (auto line = connection.ReadLine(); line.has_value(); line = connection.ReadLine()) {
+            size_t size{};
+            std::from_chars(line->data(), line->data() + line->size(), size, 16);
+            if (size == 0) {
+                // trailers end with an empty line
+                while (line.has_value() && not line->empty()) {
+                    line = connection.ReadLine();
+                }
+                return response;
+            }
+            std::string lineBreak;
+            if (not connection.Read(size, response->body) || not connection.Read(2, lineBreak)) {
+                return std::nullopt;
+            }
+        }
+        return std::nullopt;
+    }
+    size_t length{};
+    if (headers.contains("content-length")) {
+        const auto &value = headers["content-length"];
+        std::from_chars(value.data(), value.data() + value.size(), length);
+    }
+    if (method != "HEAD" && not connection.Read(length, response->body)) {
+        return std::nullopt;
+    }
+    return response;
+}
+
+/**
+ * @brief Just enough of a WebSocket client for the control channel and the preview
+ */
+class WebSocket {
+  public:
+    struct Message {
+        int opcode{};
+        std::string payload;
+    };
+
+    WebSocket(const Options &options, std::string_view path) : _connection{options.host, options.port} {
+        // the key is only checked by the server for its form, a fixed one does
+        const std::string request = "GET " + std::string(path) + " HTTP/1.1\r\nHost: " + options.host +
+                                    "\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                                    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+        std::map<std::string, std::string> headers;
+        if (not _connection.Send(request)) {
+            return;
+        }
+        const auto response = readHead(_connection, headers);
+        _open = response.has_value() && response->status == 101;
+    }
+
+    [[nodiscard]] bool Open() const { return _open && _connection.Connected(); }
+
+    bool SendText(std::string_view text) {
+        std::string frame{'\x81'};
+        // clients must mask, the key does not need to be unpredictable here
+        const uint8_t mask[4]{0x12, 0x34, 0x56, 0x78};
+        if (text.size() < 126) {
+            frame += static_cast<char>(0x80 | text.size());
+        } else if (text.size() <= 0xffff) {
+            frame += '\xfe';
+            frame += static_cast<char>(text.size() >> 8);
+            frame += static_cast<char>(text.size() & 0xff);
+        } else {
+            frame += '\xff';
+            for (int shift{56}; shift >= 0; shift -= 8) {
+                frame += static_cast<char>((text.size() >> shift) & 0xff);
+            }
+        }
+        frame.append(reinterpret_cast<const char *>(mask), 4);
+        for (size_t i{0}; i < text.size(); i++) {
+            frame += static_cast<char>(text[i] ^ static_cast<char>(mask[i % 4]));
+        }
+        return _connection.Send(frame);
+    }
+
+    // a complete message, nullopt if none arrived within timeout or the socket closed; pings are answered on the way
+    std::optional<Message> Receive(std::chrono::milliseconds timeout) {
+        if (not _connection.Buffered() && not _connection.Fill(timeout)) {
+            return std::nullopt;
+        }
+        Message message;
+        for (;;) {
+            std::string header;
+            if (not _connection.Read(2, header)) {
+                return std::nullopt;
+            }
+            const bool fin = (header[0] & 0x80) != 0;
+            const int opcode = header[0] & 0x0f;
+            uint64_t length = header[1] & 0x7f;
+            if (length >= 126) {
+                std::string extended;
+                if (not _connection.Read(length == 126 ? 2 : 8, extended)) {
+                    return std::nullopt;
+                }
+                length = 0;
+                for (const auto byte : extended) {
+                    length = length << 8 | static_cast<uint8_t>(byte);
+                }
+            }
+            std::string payload;
+            if (not _connection.Read(length, payload)) {
+                return std::nullopt;
+            }
+            if (opcode == 0x8) {
+                _connection.Close();
+                return std::nullopt;
+            }
+            if (opcode == 0x9) {
+                SendControl(0xa, payload);
+                continue;
+            }
+            if (opcode != 0) {
+                message.opcode = opcode;
+            }
+            message.payload += payload;
+            if (fin && opcode != 0xa) {
+                return message;
+            }
+        }
+    }
+
+    void Close() {
+        SendControl(0x8, "");
+        _connection.Close();
+    }
+
+  private:
+    void SendControl(int opcode, std::string_view payload) {
+        std::string frame{static_cast<char>(0x80 | opcode), static_cast<char>(0x80 | payload.size())};
+        frame.append(4, '\0');
+        frame += payload;
+        _connection.Send(frame);
+    }
+
+    Connection _connection;
+    bool _open{};
+};
+
+std::string urlEncode(std::string_view text) {
+    std::string encoded;
+    for (const auto c : text) {
+        if (std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' || c == '.' || c == '~') {
+            encoded += c;
+        } else {
+            char escaped[4];
+            std::snprintf(escaped, sizeof(escaped), "%%%02X", static_cast<unsigned char>(c));
+            encoded += escaped;
+        }
+    }
+    return encoded;
+}
+
+std::vector<std::string> readyThumbnails(const Options &options) {
+    std::vector<std::string> thumbnails;
+    Connection connection(options.host, options.port);
+    const auto response = httpRequest(connection, options, "GET", "/videos");
+    if (not response.has_value() || response->status != 200) {
+        return thumbnails;
+    }
+    const auto listing = nlohmann::json::parse(response->body, nullptr, false);
+    if (listing.is_object() && listing.contains("videos")) {
+        for (const auto &video : listing["videos"]) {
+            if (video.value("thumbnailReady", false)) {
+                thumbnails.push_back("/thumbnails/" + urlEncode(video.value("thumbnail", "")));
+            }
+        }
+    }
+    return thumbnails;
+}
+
+/**
+ * @brief One client, looping until stop is set
+ */
+class Client {
+  public:
+    Client(const Options &options, Kind kind, int index, const std::vector<std::string> &thumbnails,
+        const std::string &uploadBody, const std::atomic<bool> &stop, ClientResults &results)
+        : _options{options}, _kind{kind}, _index{index}, _thumbnails{thumbnails}, _uploadBody{uploadBody},
+          _stop{stop}, _results{results} {}
+
+    void Run() {
+        if (_kind == Control) {
+            RunControl();
+        } else if (_kind == Preview) {
+            RunPreview();
+        } else {
+            RunHttp();
+        }
+    }
+
+  private:
+    void Record(Kind kind, Clock::time_point start, bool ok) {
+        _results.samples.push_back(
+            {kind, start, std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start), ok});
+    }
+
+    // keeps one connection alive like a browser would, and opens a new one after errors
+    bool Http(Kind kind, std::string_view method, const std::string &target, std::string_view body, int expected) {
+        if (not _connection || not _connection->Connected()) {
+            _connection = std::make_unique<Connection>(_options.host, _options.port);
+        }
+        const auto start = Clock::now();
+        const auto response = httpRequest(*_connection, _options, method, target, body);
+        const bool ok = response.has_value() && response->status == expected;
+        Record(kind, start, ok);
+        if (response.has_value()) {
+            _results.bytes += static_cast<long long>(response->body.size());
+        }
+        if (not response.has_value() || not response->keepAlive) {
+            _connection.reset();
+        }
+        return ok;
+    }
+
+    void RunHttp() {
+        for (size_t i{0}; not _stop; i++) {
+            switch (_kind) {
+            case Videos:
+                Http(Videos, "GET", "/videos", {}, 200);
+                break;
+            case Thumbnails:
+                Http(Thumbnails, "GET", _thumbnails[(i + static_cast<size_t>(_index)) % _thumbnails.size()], {}, 200);
+                break;
+            case Stats:
+                Http(Stats, "GET", std::string(StatsTargets[i % StatsTargets.size()]), {}, 200);
+                break;
+            default: {
+                const auto target = "/videos/loadtest-" + std::to_string(getpid()) + "-" + std::to_string(_index) +
+                                    "-" + std::to_string(i) + ".bin";
+                if (Http(Upload, "POST", target, _uploadBody, 201)) {
+                    Http(Delete, "DELETE", target, {}, 204);
+                }
+            }
+            }
+            std::this_thread::sleep_for(_options.think);
+        }
+    }
+
+    // round trips of commands, events pushed in between are skipped
+    void RunControl() {
+        while (not _stop) {
+            WebSocket socket(_options, "/control");
+            if (not socket.Open()) {
+                Record(Control, Clock::now(), false);
+                std::this_thread::sleep_for(StopPoll);
+                continue;
+            }
+            for (size_t id{1}; not _stop; id++) {
+                const auto start = Clock::now();
+                const nlohmann::json command{{"id", id}, {"cmd", ControlCommands[id % ControlCommands.size()]}};
+                bool answered{};
+                if (socket.SendText(command.dump())) {
+                    while (Clock::now() - start < RequestTimeout) {
+                        const auto message = socket.Receive(RequestTimeout);
+                        if (not message.has_value()) {
+                            break;
+                        }
+                        const auto reply = nlohmann::json::parse(message->payload, nullptr, false);
+                        if (reply.is_object() && reply.value("id", size_t{}) == id) {
+                            _results.bytes += static_cast<long long>(message->payload.size());
+                            answered = reply.value("status", 0) < 400;
+                            break;
+                        }
+                    }
+                }
+                Record(Control, start, answered);
+                if (not answered) {
+                    break;
+                }
+                std::this_thread::sleep_for(_options.think);
+            }
+            socket.Close();
+        }
+    }
+
+    // a viewer records the gaps between frames, a stalled server loop shows up as a long one
+    void RunPreview() {
+        const auto path = _options.previewFps > 0 ? "/preview?fps=" + std::to_string(_options.previewFps) : "/preview";
+        while (not _stop) {
+            WebSocket socket(_options, path);
+            if (not socket.Open()) {
+                Record(Preview, Clock::now(), false);
+                std::this_thread::sleep_for(StopPoll);
+                continue;
+            }
+            auto last = Clock::now();
+            while (not _stop) {
+                const auto message = socket.Receive(StopPoll);
+                if (message.has_value()) {
+                    Record(Preview, last, true);
+                    last = Clock::now();
+                    _results.bytes += static_cast<long long>(message->payload.size());
+                } else if (not socket.Open()) {
+                    break;
+                }
+            }
+            socket.Close();
+        }
+    }
+
+    const Options &_options;
+    const Kind _kind;
+    const int _index;
+    const std::vector<std::string> &_thumbnails;
+    const std::string &_uploadBody;
+    const std::atomic<bool> &_stop;
+    ClientResults &_results;
+    std::unique_ptr<Connection> _connection;
+};
+
+struct RenderStats {
+    long long frames{};
+    long long misses{};
+    // when the server took its numbers, on our clock
+    Clock::time_point now;
+    struct Miss {
+        Clock::time_point at;
+        std::chrono::microseconds late;
+        bool preempted;
+        bool faulted;
+    };
+    std::vector<Miss> recent;
+    // what the render thread runs under, as reported
+    nlohmann::json realtime;
+};
+
+long long toUs(Clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+}
+
+std::optional<RenderStats> fetchRenderStats(const Options &options, Clock::time_point since) {
+    Connection connection(options.host, options.port);
+    const auto response = httpRequest(connection, options, "GET", "/render/stats?since=" + std::to_string(toUs(since)));
+    if (not response.has_value() || response->status != 200) {
+        return std::nullopt;
+    }
+    const auto json = nlohmann::json::parse(response->body, nullptr, false);
+    if (not json.is_object()) {
+        return std::nullopt;
+    }
+    const auto fromUs = [](long long us) { return Clock::time_point(std::chrono::microseconds(us)); };
+    RenderStats stats{
+        json.value("frames", 0LL), json.value("deadlineMisses", 0LL), fromUs(json.value("nowUs", 0LL)), {}, {}};
+    for (const auto &miss : json.value("misses", nlohmann::json::array())) {
+        stats.recent.push_back({fromUs(miss.value("atUs", 0LL)),
+            std::chrono::microseconds(static_cast<long long>(miss.value("lateMs", 0.) * 1000.)),
+            miss.value("preempted", false), miss.value("faulted", false)});
+    }
+    stats.realtime = json.value("realtime", nlohmann::json::object());
+    return stats;
+}
+
+double toMs(std::chrono::microseconds us) { return static_cast<double>(us.count()) / 1000.; }
+
+// nearest rank, of sorted durations
+double percentile(std::span<const std::chrono::microseconds> sorted, double p) {
+    if (sorted.empty()) {
+        return 0.;
+    }
+    const auto rank = static_cast<size_t>(std::ceil(p / 100. * static_cast<double>(sorted.size())));
+    return toMs(sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1]);
+}
+
+bool inFlight(const Sample &sample, Clock::time_point from, Clock::time_point to) {
+    return sample.start < to && sample.start + sample.duration > from;
+}
+
+std::optional<Options> parseOptions(int argc, char **argv) {
+    Options options;
+    for (int i{1}; i < argc; i++) {
+        const std::string_view argument(argv[i]);
+        const std::string_view value = i + 1 < argc ? std::string_view(argv[i + 1]) : std::string_view();
+        const auto number = [&value]() {
+            double parsed{};
+            std::from_chars(value.data(), value.data() + value.size(), parsed);
+            return parsed;
+        };
+        if (argument == "--json") {
+            options.json = true;
+            continue;
+        }
+        if (value.empty()) {
+            return std::nullopt;
+        }
+        i++;
+        if (argument == "--host") {
+            options.host = value;
+        } else if (argument == "--port") {
+            options.port = static_cast<int>(number());
+        } else if (argument == "--duration") {
+            options.duration = std::chrono::seconds(static_cast<long long>(number()));
+        } else if (argument == "--baseline") {
+            options.baseline = std::chrono::seconds(static_cast<long long>(number()));
+        } else if (argument == "--upload-size") {
+            options.uploadSize = static_cast<size_t>(number() * 1024);
+        } else if (argument == "--upload-rate") {
+            options.uploadRate = number() * 1024;
+        } else if (argument == "--think") {
+            options.think = std::chrono::milliseconds(static_cast<long long>(number()));
+        } else if (argument == "--preview-fps") {
+            options.previewFps = static_cast<int>(number());
+        } else if (argument == "--max-misses") {
+            options.maxMisses = static_cast<long long>(number());
+        } else if (argument == "--max-p99") {
+            options.maxP99 = number();
+        } else if (argument == "--mix") {
+            // kinds left out have no clients
+            options.mix.fill(0);
+            for (size_t start{0}; start < value.size();) {
+                const auto end = std::min(value.find(',', start), value.size());
+                const auto entry = value.substr(start, end - start);
+                const auto equals = entry.find('=');
+                const auto name = entry.substr(0, equals);
+                const auto kind = std::find(KindNames.begin(), KindNames.end(), name);
+                if (equals == std::string_view::npos || kind == KindNames.end() || *kind == KindNames[Delete]) {
+                    std::cerr << "Unknown entry in --mix: " << entry << std::endl;
+                    return std::nullopt;
+                }
+                std::from_chars(entry.data() + equals + 1, entry.data() + entry.size(),
+                    options.mix[static_cast<size_t>(kind - KindNames.begin())]);
+                start = end + 1;
+            }
+        } else {
+            return std::nullopt;
+        }
+    }
+    return options;
+}
+
+void usage() {
+    std::cerr << "Usage: loadtest [options]\n"
+                 "  --host <ipv4>          server address (127.0.0.1)\n"
+                 "  --port <port>          server port (8080)\n"
+                 "  --duration <s>         length of the loaded run (30)\n"
+                 "  --baseline <s>         idle time before it, to count misses without load (5)\n"
+                 "  --mix <kind=n,...>     clients per kind: videos, thumbnails, stats, upload, control, preview\n"
+                 "                         (videos=8,thumbnails=4,stats=2,upload=1,control=2,preview=2)\n"
+                 "  --think <ms>           pause between a client's requests (0)\n"
+                 "  --upload-size <KiB>    size of each upload (4096)\n"
+                 "  --upload-rate <KiB/s>  pace of each upload, 0 unlimited (0)\n"
+                 "  --preview-fps <n>      frame rate asked for by preview viewers (server default)\n"
+                 "  --max-misses <n>       fail if the render loop misses more deadlines during the run\n"
+                 "  --max-p99 <ms>         fail if any kind's 99th percentile latency is above this\n"
+                 "  --json                 print the report as JSON\n";
+}
+} // namespace
+
+int main(int argc, char **argv) {
+    const auto parsed = parseOptions(argc, argv);
+    if (not parsed.has_value()) {
+        usage();
+        return 2;
+    }
+    auto options = parsed.value();
+
+    const auto baselineStart = Clock::now();
+    const auto idle = fetchRenderStats(options, baselineStart);
+    if (not idle.has_value()) {
+        std::cerr << "No render stats at " << options.host << ":" << options.port << ", is nametag running?"
+                  << std::endl;
+        return 2;
+    }
+    std::this_thread::sleep_for(options.baseline);
+    const auto baseline = fetchRenderStats(options, baselineStart);
+
+    const auto thumbnails = options.mix[Thumbnails] > 0 ? readyThumbnails(options) : std::vector<std::string>();
+    if (options.mix[Thumbnails] > 0 && thumbnails.empty()) {
+        std::cerr << "No thumbnails in the library, leaving out thumbnail clients" << std::endl;
+        options.mix[Thumbnails] = 0;
+    }
+    std::string uploadBody(options.uploadSize, '\0');
+    std::mt19937 random(std::random_device{}());
+    std::generate(uploadBody.begin(), uploadBody.end(), [&random]() { return static_cast<char>(random()); });
+
+    // the server's counters and clock are compared against a start on the same monotonic clock
+    const auto start = Clock::now();
+    std::atomic<bool> stop{};
+    std::vector<ClientResults> results(static_cast<size_t>(std::accumulate(options.mix.begin(), options.mix.end(), 0)));
+    std::vector<std::thread> threads;
+    for (int kind{0}, slot{0}; kind < KindCount; kind++) {
+        for (int i{0}; i < options.mix[static_cast<size_t>(kind)]; i++, slot++) {
+            threads.emplace_back([&, kind, i, slot]() {
+                Client(options, static_cast<Kind>(kind), i, thumbnails, uploadBody, stop,
+                    results[static_cast<size_t>(slot)])
+                    .Run();
+            });
+        }
+    }
+    std::this_thread::sleep_for(options.duration);
+    stop = true;
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    const auto end = Clock::now();
+
+    const auto render = fetchRenderStats(options, start);
+    if (not render.has_value()) {
+        std::cerr << "Render stats went away during the run" << std::endl;
+        return 2;
+    }
+    // loopback shares the clock, misses from another host could not be placed
+    const bool sameClock = std::chrono::abs(render->now - end) < std::chrono::seconds(1);
+    if (not sameClock) {
+        std::cerr << "The server's clock differs from ours, misses are not matched with requests" << std::endl;
+    }
+
+    std::vector<Sample> samples;
+    long long bytes{};
+    for (const auto &client : results) {
+        samples.insert(samples.end(), client.samples.begin(), client.samples.end());
+        bytes += client.bytes;
+    }
+    const auto seconds = std::chrono::duration<double>(end - start).count();
+    const auto loadedMisses = render->misses - (baseline.has_value() ? baseline->misses : idle->misses);
+    const auto idleMisses = baseline.has_value() ? baseline->misses - idle->misses : 0;
+
+    nlohmann::json report{{"durationS", seconds}, {"bytesReceived", bytes}};
+
+    // latency per kind, and the p99 each kind's slow requests are measured against
+    std::array<double, KindCount> p99{};
+    auto kinds = nlohmann::json::object();
+    for (int kind{0}; kind < KindCount; kind++) {
+        std::vector<std::chrono::microseconds> durations;
+        long long errors{};
+        for (const auto &sample : samples) {
+            if (sample.kind == kind) {
+                durations.push_back(sample.duration);
+                errors += sample.ok ? 0 : 1;
+            }
+        }
+        if (durations.empty()) {
+            continue;
+        }
+        std::sort(durations.begin(), durations.end());
+        p99[static_cast<size_t>(kind)] = percentile(durations, 99);
+        kinds[std::string(KindNames[static_cast<size_t>(kind)])] = {
+            {"clients", options.mix[static_cast<size_t>(kind)]}, {"requests", durations.size()}, {"errors", errors},
+            {"perSecond", static_cast<double>(durations.size()) / seconds}, {"p50Ms", percentile(durations, 50)},
+            {"p90Ms", percentile(durations, 90)}, {"p99Ms", p99[static_cast<size_t>(kind)]},
+            {"maxMs", toMs(durations.back())}};
+    }
+    report["latency"] = kinds;
+
+    const auto baselineSeconds = std::chrono::duration<double>(options.baseline).count();
+    report["render"] = {{"frames", render->frames}, {"missesDuringRun", loadedMisses},
+        {"missesPerSecond", static_cast<double>(loadedMisses) / seconds},
+        {"idleMissesPerSecond", baselineSeconds > 0 ? static_cast<double>(idleMisses) / baselineSeconds : 0.},
+        {"realtime", render->realtime}};
+
+    // which kinds were in flight during misses, against how often they were in flight at all
+    if (sameClock) {
+        std::vector<RenderStats::Miss> misses;
+        for (const auto &miss : render->recent) {
+            if (miss.at <= end) {
+                misses.push_back(miss);
+            }
+        }
+        std::uniform_int_distribution<long long> instant(toUs(start), toUs(end));
+        const int probes = 2000;
+        auto correlation = nlohmann::json::object();
+        for (int kind{0}; kind < KindCount; kind++) {
+            if (not kinds.contains(KindNames[static_cast<size_t>(kind)])) {
+                continue;
+            }
+            const auto anyInFlight = [&](Clock::time_point from, Clock::time_point to) {
+                return std::any_of(samples.begin(), samples.end(),
+                    [&](const Sample &sample) { return sample.kind == kind && inFlight(sample, from, to); });
+            };
+            int duringMisses{};
+            for (const auto &miss : misses) {
+                duringMisses += anyInFlight(miss.at - miss.late, miss.at) ? 1 : 0;
+            }
+            int atRandom{};
+            for (int i{0}; i < probes; i++) {
+                const auto at = Clock::time_point(std::chrono::microseconds(instant(random)));
+                atRandom += anyInFlight(at, at + std::chrono::microseconds(1)) ? 1 : 0;
+            }
+            // a slow request stalling the render loop would be in flight while the loop was late
+            long long slow{};
+            long long slowDuringMisses{};
+            for (const auto &sample : samples) {
+                if (sample.kind != kind || toMs(sample.duration) < p99[static_cast<size_t>(kind)]) {
+                    continue;
+                }
+                slow++;
+                slowDuringMisses += std::any_of(misses.begin(), misses.end(), [&sample](const auto &miss) {
+                    return inFlight(sample, miss.at - miss.late, miss.at);
+                }) ? 1 : 0;
+            }
+            const double shareDuringMisses =
+                misses.empty() ? 0. : static_cast<double>(duringMisses) / static_cast<double>(misses.size());
+            const double shareOverall = static_cast<double>(atRandom) / probes;
+            correlation[std::string(KindNames[static_cast<size_t>(kind)])] = {
+                {"inFlightDuringMisses", shareDuringMisses}, {"inFlightOverall", shareOverall},
+                {"lift", shareOverall > 0 ? shareDuringMisses / shareOverall : 0.}, {"slowRequests", slow},
+                {"slowDuringMisses", slowDuringMisses}};
+        }
+        report["correlation"] = correlation;
+
+        // why the render thread was late: it lost the CPU, or waited on memory
+        report["render"]["preempted"] = std::count_if(misses.begin(), misses.end(),
+            [&start](const auto &miss) { return miss.at >= start && miss.preempted; });
+        report["render"]["faulted"] = std::count_if(misses.begin(), misses.end(),
+            [&start](const auto &miss) { return miss.at >= start && miss.faulted; });
+
+        // per second of the run: requests started, their p99 and the misses
+        auto timeline = nlohmann::json::array();
+        const auto buckets = static_cast<size_t>(std::ceil(seconds));
+        std::vector<std::vector<std::chrono::microseconds>> durations(buckets);
+        std::vector<std::chrono::microseconds> maxLate(buckets);
+        std::vector<int> missCounts(buckets);
+        const auto bucketOf = [&start, buckets](Clock::time_point at) {
+            return std::min(static_cast<size_t>(std::chrono::duration_cast<std::chrono::seconds>(at - start).count()),
+                buckets - 1);
+        };
+        for (const auto &sample : samples) {
+            if (sample.kind != Preview && sample.start >= start) {
+                durations[bucketOf(sample.start)].push_back(sample.duration);
+            }
+        }
+        for (const auto &miss : misses) {
+            if (miss.at >= start) {
+                missCounts[bucketOf(miss.at)]++;
+                maxLate[bucketOf(miss.at)] = std::max(maxLate[bucketOf(miss.at)], miss.late);
+            }
+        }
+        for (size_t i{0}; i < buckets; i++) {
+            std::sort(durations[i].begin(), durations[i].end());
+            timeline.push_back({{"second", i}, {"requests", durations[i].size()},
+                {"p99Ms", percentile(durations[i], 99)}, {"misses", missCounts[i]}, {"maxLateMs", toMs(maxLate[i])}});
+        }
+        report["timeline"] = timeline;
+    }
+
+    bool failed{};
+    if (options.maxMisses >= 0 && loadedMisses > options.maxMisses) {
+        failed = true;
+    }
+    for (const auto value : p99) {
+        failed = failed || (options.maxP99 >= 0 && value > options.maxP99);
+    }
+    report["failed"] = failed;
+
+    if (options.json) {
+        std::cout << report.dump(2) << std::endl;
+        return failed ? 1 : 0;
+    }
+
+    printf("%-11s %7s %8s %6s %9s %9s %9s %9s %9s\n", "kind", "clients", "requests", "errors", "per s", "p50 ms",
+        "p90 ms", "p99 ms", "max ms");
+    for (const auto &[name, kind] : kinds.items()) {
+        printf("%-11s %7d %8zu %6lld %9.1lf %9.2lf %9.2lf %9.2lf %9.2lf\n", name.c_str(), kind["clients"].get<int>(),
+            kind["requests"].get<size_t>(), kind["errors"].get<long long>(), kind["perSecond"].get<double>(),
+            kind["p50Ms"].get<double>(), kind["p90Ms"].get<double>(), kind["p99Ms"].get<double>(),
+            kind["maxMs"].get<double>());
+    }
+    printf("\nRender loop: %lld deadline misses in %.1lfs of load (%.2lf/s, %.2lf/s idle)\n", loadedMisses, seconds,
+        report["render"]["missesPerSecond"].get<double>(), report["render"]["idleMissesPerSecond"].get<double>());
+    if (report["render"].contains("preempted") && loadedMisses > 0) {
+        printf("Of those, %lld came with the render thread preempted and %lld with page faults\n",
+            report["render"]["preempted"].get<long long>(), report["render"]["faulted"].get<long long>());
+    }
+    if (render->realtime.value("fifo", false)) {
+        printf("Render thread under SCHED_FIFO, priority %d\n", render->realtime.value("priority", 0));
+    }
+    if (report.contains("correlation") && loadedMisses > 0) {
+        printf("\n%-11s %16s %16s %6s %14s\n", "in flight", "during misses", "overall", "lift", "slow in misses");
+        for (const auto &[name, kind] : report["correlation"].items()) {
+            printf("%-11s %15.0lf%% %15.0lf%% %6.2lf %7lld of %4lld\n", name.c_str(),
+                kind["inFlightDuringMisses"].get<double>() * 100, kind["inFlightOverall"].get<double>() * 100,
+                kind["lift"].get<double>(), kind["slowDuringMisses"].get<long long>(),
+                kind["slowRequests"].get<long long>());
+        }
+    }
+    if (report.contains("timeline")) {
+        printf("\n%6s %8s %9s %6s %11s\n", "second", "requests", "p99 ms", "misses", "max late ms");
+        for (const auto &second : report["timeline"]) {
+            printf("%6zu %8zu %9.2lf %6d %11.2lf\n", second["second"].get<size_t>(), second["requests"].get<size_t>(),
+                second["p99Ms"].get<double>(), second["misses"].get<int>(), second["maxLateMs"].get<double>());
+        }
+    }
+    if (failed) {
+        printf("\nFAILED: over the limits given\n");
+    }
+    return failed ? 1 : 0;
+}
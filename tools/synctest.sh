@@ -0,0 +1,126 @@
+#!/usr/bin/env bash
+# Plays one clip on a sync master and a few followers on this machine and checks they stay within a frame.
+#
+# usage: tools/synctest.sh <nametag binary> <clip> [followers] [seconds] [max error ms]
+#
+# Each instance runs with --simulate in a directory of its own, with the clip in its library. As they share the steady
+# clock, the true error is taken from the frames they last showed: the follower's position at the moment it showed its
+# frame minus where the master was at that moment, going by the master's last frame, modulo the clip's length. It is
+# printed next to the error each follower measured itself. Needs curl and python3, ffprobe for the frame time.
+set -euo pipefail
+
+if [[ $# -lt 2 ]]; then
+    echo "usage: $0 <nametag binary> <clip> [followers] [seconds] [max error ms]" >&2
+    exit 2
+fi
+binary=$(realpath "$1")
+clip=$(realpath "$2")
+followers=${3:-2}
+seconds=${4:-30}
+name=$(basename "$clip")
+
+if [[ $# -ge 5 ]]; then
+    maxError=$5
+elif command -v ffprobe >/dev/null; then
+    rate=$(ffprobe -v error -select_streams v:0 -show_entries stream=avg_frame_rate -of csv=p=0 "$clip")
+    maxError=$(python3 -c "n, d = '$rate'.split('/'); print(round(1000 * int(d) / int(n), 3))")
+else
+    maxError=40
+fi
+
+basePort=18080
+syncPort=47899
+work=$(mktemp -d)
+pids=()
+cleanup() {
+    for pid in "${pids[@]}"; do
+        kill "$pid" 2>/dev/null || true
+    done
+    wait 2>/dev/null || true
+    rm -rf "$work"
+}
+trap cleanup EXIT
+
+for ((i = 0; i <= followers; i++)); do
+    dir="$work/$i"
+    mkdir -p "$dir/videos"
+    ln -s "$clip" "$dir/videos/$name"
+    role=follower
+    [[ $i -eq 0 ]] && role=master
+    cat >"$dir/configuration.toml" <<EOF
+[server]
+port = $((basePort + i))
+
+[sync]
+role = "$role"
+master = "127.0.0.1"
+port = $syncPort
+intervalMs = 250
+EOF
+    (cd "$dir" && exec "$binary" --simulate >"$dir/log" 2>&1) &
+    pids+=($!)
+done
+
+for ((i = 0; i <= followers; i++)); do
+    for _ in $(seq 50); do
+        curl -sf "http://127.0.0.1:$((basePort + i))/sync/stats" >/dev/null && break
+        sleep 0.1
+    done
+done
+curl -sf -X POST "http://127.0.0.1:$basePort/videos/$name/play" >/dev/null
+
+# the first seconds are spent locking on and starting the file
+sleep 3
+samples="$work/samples"
+end=$((SECONDS + seconds))
+while [[ $SECONDS -lt $end ]]; do
+    line=""
+    for ((i = 0; i <= followers; i++)); do
+        line+="$(curl -sf "http://127.0.0.1:$((basePort + i))/sync/stats" || echo null)"$'\t'
+    done
+    echo "$line" >>"$samples"
+    sleep 0.5
+done
+
+python3 - "$samples" "$maxError" "$followers" <<'EOF'
+import json
+import sys
+
+samples, maxError, followers = sys.argv[1], float(sys.argv[2]), int(sys.argv[3])
+true = [[] for _ in range(followers)]
+reported = [[] for _ in range(followers)]
+for line in open(samples):
+    stats = [json.loads(s) for s in line.rstrip("\n").split("\t") if s]
+    master = stats[0] and stats[0].get("timeline")
+    if not master:
+        continue
+    duration = master["durationUs"]
+    for i, follower in enumerate(stats[1:]):
+        timeline = follower and follower.get("timeline")
+        if not timeline or timeline["file"] != master["file"] or duration <= 0:
+            continue
+        # what was presented rather than the timeline's start, which is what the follower's corrections move
+        shown, masterShown = timeline["lastShown"], master["lastShown"]
+        if not shown or not masterShown:
+            continue
+        masterPosition = masterShown["ptsUs"] + (shown["shownAtUs"] - masterShown["shownAtUs"])
+        error = (shown["ptsUs"] - masterPosition) % duration
+        if error > duration / 2:
+            error -= duration
+        true[i].append(error / 1000)
+        reported[i].append(follower["lastErrorMs"])
+
+worst = 0.0
+for i in range(followers):
+    if not true[i]:
+        print(f"follower {i + 1}: never played the clip")
+        worst = float("inf")
+        continue
+    absolute = sorted(abs(e) for e in true[i])
+    print(f"follower {i + 1}: true error median {absolute[len(absolute) // 2]:.3f} ms, max {absolute[-1]:.3f} ms; "
+          f"reported max {max(abs(e) for e in reported[i]):.3f} ms over {len(absolute)} samples")
+    worst = max(worst, absolute[-1])
+
+print(f"worst {worst:.3f} ms, allowed {maxError} ms")
+sys.exit(0 if worst <= maxError else 1)
+EOF